@@ -0,0 +1,44 @@
+#pragma once
+#include "Macro.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+//   What a command does, apart from the
+//  phrase that triggers it. Aliases of one
+//  action all point at the same record so
+//  the strings are stored once and uses are
+//  counted across every alias
+
+namespace HNx
+{
+
+struct Action
+{
+  Action() = default;
+
+  Action(std::wstring t_exec,
+         std::wstring t_param,
+         std::shared_ptr<Macro const> t_macro = nullptr)
+    : exec(std::move(t_exec))
+    , param(std::move(t_param))
+    , macro(std::move(t_macro))
+  {}
+
+  // shared by address, never copied
+  Action(Action const&) = delete;
+  Action& operator=(Action const&) = delete;
+
+  std::wstring exec {};
+  std::wstring param {};
+
+  // set only for macro commands
+  std::shared_ptr<Macro const> macro {};
+
+  // dispatches through any of its aliases
+  std::atomic<uint64_t> uses {0};
+};
+
+}
@@ -0,0 +1,513 @@
+#include "Audio.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+//=================================//
+// HNx Voice Command Audio         //
+//=================================//
+// PCM sources and the ring they   //
+//  feed                           //
+//=================================//
+
+using namespace HNx;
+
+//=========================================================================
+//  AudioRing
+//=========================================================================
+
+HNx::AudioRing::AudioRing(size_t t_frames)
+{
+  size_t frames = 1;
+  while(frames < t_frames)
+    frames <<= 1;
+  m_buffer.resize(frames * AudioFrameSamples);
+  m_mask = frames - 1;
+}
+
+int16_t*
+HNx::AudioRing::slot(uint64_t t_index)
+{
+  return m_buffer.data() + (t_index & m_mask) * AudioFrameSamples;
+}
+
+int16_t*
+HNx::AudioRing::writeFrame()
+{
+  uint64_t tail = m_tail.load(std::memory_order_relaxed);
+  if(tail - m_head.load(std::memory_order_acquire) > m_mask)
+  {
+    m_overruns.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+  return slot(tail);
+}
+
+bool
+HNx::AudioRing::writable() const
+{
+  return m_tail.load(std::memory_order_relaxed) - m_head.load(std::memory_order_acquire) <= m_mask;
+}
+
+void
+HNx::AudioRing::commitFrame()
+{
+  m_tail.store(m_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  m_signal.fetch_add(1, std::memory_order_release);
+  m_signal.notify_one();
+}
+
+bool
+HNx::AudioRing::push(int16_t const* t_samples)
+{
+  int16_t* frame = writeFrame();
+  if(!frame)
+    return false;
+  std::memcpy(frame, t_samples, AudioFrameSamples * sizeof(int16_t));
+  commitFrame();
+  return true;
+}
+
+void
+HNx::AudioRing::close()
+{
+  m_closed.store(true, std::memory_order_release);
+  m_signal.fetch_add(1, std::memory_order_release);
+  m_signal.notify_all();
+}
+
+int16_t const*
+HNx::AudioRing::readFrame()
+{
+  uint64_t head = m_head.load(std::memory_order_relaxed);
+  uint64_t tail = m_tail.load(std::memory_order_acquire);
+  if(head == tail)
+  {
+    // once per dry spell, waiting for
+    //  the first frame doesn't count
+    if(!m_dry && tail != 0 && !closed())
+    {
+      m_dry = true;
+      m_underruns.fetch_add(1, std::memory_order_relaxed);
+    }
+    return nullptr;
+  }
+  m_dry = false;
+  return slot(head);
+}
+
+void
+HNx::AudioRing::releaseFrame()
+{
+  m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+bool
+HNx::AudioRing::waitFrame()
+{
+  while(true)
+  {
+    // read before checking so a commit or
+    //  close in between wakes the wait
+    uint32_t signal = m_signal.load(std::memory_order_acquire);
+    if(readFrame())
+      return true;
+    if(closed())
+      return readFrame() != nullptr;
+    m_signal.wait(signal, std::memory_order_acquire);
+  }
+}
+
+size_t
+HNx::AudioRing::available() const
+{
+  return static_cast<size_t>(m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire));
+}
+
+size_t
+HNx::AudioRing::capacity() const
+{
+  return m_mask + 1;
+}
+
+bool
+HNx::AudioRing::closed() const
+{
+  return m_closed.load(std::memory_order_acquire);
+}
+
+uint64_t
+HNx::AudioRing::overruns() const
+{
+  return m_overruns.load(std::memory_order_relaxed);
+}
+
+uint64_t
+HNx::AudioRing::underruns() const
+{
+  return m_underruns.load(std::memory_order_relaxed);
+}
+
+uint64_t
+HNx::AudioRing::framesWritten() const
+{
+  return m_tail.load(std::memory_order_relaxed);
+}
+
+//=========================================================================
+//  FileSource
+//=========================================================================
+
+namespace
+{
+
+uint32_t
+le32(unsigned char const* p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint16_t
+le16(unsigned char const* p)
+{
+  return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+// reads instead of seeking so pipes work
+bool
+skip(std::FILE* t_file, uint64_t t_bytes)
+{
+  unsigned char scratch[512];
+  while(t_bytes)
+  {
+    size_t n = static_cast<size_t>(std::min<uint64_t>(t_bytes, sizeof(scratch)));
+    if(std::fread(scratch, 1, n, t_file) != n)
+      return false;
+    t_bytes -= n;
+  }
+  return true;
+}
+
+}
+
+HNx::FileSource::FileSource(std::wstring const& t_path, PcmFormat t_raw)
+  : m_format(t_raw)
+{
+  if(t_path == L"-")
+  {
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    m_file = stdin;
+  }
+  else
+  {
+#ifdef _WIN32
+    m_file = _wfopen(t_path.c_str(), L"rb");
+#else
+    m_file = std::fopen(to_utf8(t_path).c_str(), "rb");
+#endif
+    m_owned = true;
+  }
+
+  if(!m_file)
+    throw std::runtime_error("Failed to open audio source.");
+
+  if(icase_equal(std::filesystem::path(t_path).extension().wstring(), L".wav"))
+  {
+    try
+    {
+      read_wav_header();
+    }
+    catch(...)
+    {
+      if(m_owned)
+        std::fclose(m_file);
+      throw;
+    }
+  }
+
+  try
+  {
+    auto converter = std::make_unique<PcmConverter>(m_format);
+    if(!converter->passthrough())
+      m_converter = std::move(converter);
+  }
+  catch(std::invalid_argument const& e)
+  {
+    if(m_owned)
+      std::fclose(m_file);
+    throw std::runtime_error(std::string("Audio source format is not supported: ") + e.what());
+  }
+}
+
+HNx::FileSource::~FileSource()
+{
+  if(m_owned && m_file)
+    std::fclose(m_file);
+}
+
+void
+HNx::FileSource::read_wav_header()
+{
+  unsigned char riff[12];
+  if(std::fread(riff, 1, sizeof(riff), m_file) != sizeof(riff)
+     || std::memcmp(riff, "RIFF", 4) != 0
+     || std::memcmp(riff + 8, "WAVE", 4) != 0)
+    throw std::runtime_error("Audio source is not a RIFF WAVE file.");
+
+  bool haveFormat = false;
+  while(true)
+  {
+    unsigned char chunk[8];
+    if(std::fread(chunk, 1, sizeof(chunk), m_file) != sizeof(chunk))
+      throw std::runtime_error("WAVE file has no data chunk.");
+    uint32_t size = le32(chunk + 4);
+
+    if(std::memcmp(chunk, "fmt ", 4) == 0)
+    {
+      // up to the end of WAVE_FORMAT_EXTENSIBLE's
+      //  sub format tag
+      unsigned char fmt[26] {};
+      size_t want = std::min<size_t>(size, sizeof(fmt));
+      if(size < 16 || std::fread(fmt, 1, want, m_file) != want
+         || !skip(m_file, size - want + (size & 1)))
+        throw std::runtime_error("WAVE format chunk is truncated.");
+
+      uint16_t tag = le16(fmt);
+      if(tag == 0xFFFE && want == sizeof(fmt))
+        tag = le16(fmt + 24);
+
+      uint16_t bits = le16(fmt + 14);
+      if(tag == 1 && bits == 16)
+        m_format.sample = SampleFormat::Int16;
+      else if(tag == 3 && bits == 32)
+        m_format.sample = SampleFormat::Float32;
+      else
+        throw std::runtime_error("WAVE file is not 16 bit PCM or 32 bit float.");
+      m_format.channels = le16(fmt + 2);
+      m_format.rate = le32(fmt + 4);
+      haveFormat = true;
+    }
+    else if(std::memcmp(chunk, "data", 4) == 0)
+    {
+      if(!haveFormat)
+        throw std::runtime_error("WAVE data chunk comes before its format.");
+
+      // streamed .wav files leave the size unset
+      m_remaining = size == 0xFFFFFFFF ? UINT64_MAX : size;
+      return;
+    }
+    else if(!skip(m_file, size + (size & 1)))
+      throw std::runtime_error("WAVE file has no data chunk.");
+  }
+}
+
+size_t
+HNx::FileSource::read_frames(size_t t_frames)
+{
+  size_t frameBytes = m_format.frameBytes();
+  size_t want = static_cast<size_t>(std::min<uint64_t>(t_frames, m_remaining / frameBytes));
+  if(want == 0)
+    return 0;
+
+  if(m_raw.size() < want * frameBytes)
+    m_raw.resize(want * frameBytes);
+  size_t got = std::fread(m_raw.data(), frameBytes, want, m_file);
+  if(m_remaining != UINT64_MAX)
+    m_remaining -= got * frameBytes;
+  return got;
+}
+
+size_t
+HNx::FileSource::read(int16_t* t_dst, size_t t_count)
+{
+  if(!m_converter)
+  {
+    size_t want = static_cast<size_t>(std::min<uint64_t>(t_count, m_remaining / sizeof(int16_t)));
+    if(want == 0)
+      return 0;
+
+    size_t got = std::fread(t_dst, sizeof(int16_t), want, m_file);
+    if(m_remaining != UINT64_MAX)
+      m_remaining -= got * sizeof(int16_t);
+    return got;
+  }
+
+  // converted straight into t_dst, a ring
+  //  frame when read by AudioPump
+  size_t done = 0;
+  while(done < t_count)
+  {
+    if(m_spillAt < m_spill.size())
+    {
+      size_t n = std::min(t_count - done, m_spill.size() - m_spillAt);
+      std::copy_n(m_spill.begin() + m_spillAt, n, t_dst + done);
+      m_spillAt += n;
+      done += n;
+      continue;
+    }
+
+    // too little room left for the output
+    //  of a single input frame
+    int16_t* out = t_dst + done;
+    size_t frames = m_converter->inputFor(t_count - done);
+    if(frames == 0)
+    {
+      frames = std::max<size_t>(1, m_converter->inputFor(AudioFrameSamples));
+      m_spill.resize(m_converter->maxOutput(frames));
+      out = m_spill.data();
+    }
+
+    frames = read_frames(frames);
+    if(frames == 0)
+      break;
+
+    size_t n = m_converter->process(m_raw.data(), frames, out);
+    if(out == m_spill.data())
+    {
+      m_spill.resize(n);
+      m_spillAt = 0;
+    }
+    else
+      done += n;
+  }
+  return done;
+}
+
+//=========================================================================
+//  ToneSource
+//=========================================================================
+
+HNx::ToneSource::ToneSource(double t_frequency, double t_amplitude, uint64_t t_samples)
+  : m_step(2.0 * 3.14159265358979323846 * t_frequency / AudioSampleRate)
+  , m_amplitude(std::clamp(t_amplitude, 0.0, 1.0) * 32767.0)
+  , m_left(t_samples)
+  , m_endless(t_samples == 0)
+{}
+
+size_t
+HNx::ToneSource::read(int16_t* t_dst, size_t t_count)
+{
+  size_t n = m_endless ? t_count : static_cast<size_t>(std::min<uint64_t>(t_count, m_left));
+  for(size_t i = 0; i < n; ++i)
+  {
+    t_dst[i] = static_cast<int16_t>(std::lround(m_amplitude * std::sin(m_phase)));
+    m_phase += m_step;
+    if(m_phase >= 2.0 * 3.14159265358979323846)
+      m_phase -= 2.0 * 3.14159265358979323846;
+  }
+  if(!m_endless)
+    m_left -= n;
+  return n;
+}
+
+//=========================================================================
+//  AudioPump
+//=========================================================================
+
+HNx::AudioPump::AudioPump(std::unique_ptr<PcmSource> t_source,
+                          std::shared_ptr<AudioRing> t_ring,
+                          bool t_realtime,
+                          bool t_block)
+  : m_source(std::move(t_source))
+  , m_ring(std::move(t_ring))
+  , m_realtime(t_realtime)
+  , m_block(t_block)
+{
+  if(!m_source || !m_ring)
+    throw std::invalid_argument("AudioPump needs a source and a ring");
+}
+
+HNx::AudioPump::~AudioPump()
+{
+  stop();
+}
+
+void
+HNx::AudioPump::start()
+{
+  if(m_thread.joinable())
+    return;
+  m_stop = false;
+  m_running = true;
+  m_thread = std::thread(&AudioPump::run, this);
+}
+
+// a source blocked reading a pipe only
+//  notices once the next read returns
+void
+HNx::AudioPump::stop()
+{
+  m_stop = true;
+  if(m_thread.joinable())
+    m_thread.join();
+  m_ring->close();
+}
+
+bool
+HNx::AudioPump::running() const
+{
+  return m_running;
+}
+
+void
+HNx::AudioPump::run()
+{
+  auto const frameTime = std::chrono::microseconds(1000000ull * AudioFrameSamples / AudioSampleRate);
+  auto next = std::chrono::steady_clock::now();
+  std::vector<int16_t> scratch(AudioFrameSamples);
+
+  bool more = true;
+  while(more && !m_stop.load(std::memory_order_relaxed))
+  {
+    if(m_block && !m_ring->writable())
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      continue;
+    }
+
+    // a full ring drops the frame, it is
+    //  still read so live sources keep time
+    int16_t* frame = m_ring->writeFrame();
+    int16_t* dst = frame ? frame : scratch.data();
+
+    size_t got = 0;
+    while(got < AudioFrameSamples)
+    {
+      size_t n = m_source->read(dst + got, AudioFrameSamples - got);
+      if(n == 0)
+      {
+        more = false;
+        break;
+      }
+      got += n;
+    }
+    if(got == 0)
+      break;
+
+    // the last frame is padded with silence
+    std::fill(dst + got, dst + AudioFrameSamples, int16_t {0});
+    if(frame)
+      m_ring->commitFrame();
+
+    if(m_realtime)
+    {
+      next += frameTime;
+      std::this_thread::sleep_until(next);
+    }
+  }
+
+  m_ring->close();
+  m_running = false;
+}
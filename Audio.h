@@ -0,0 +1,257 @@
+#pragma once
+#include "Resample.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+//   The audio front-end. A PcmSource is read
+//  by an AudioPump into an AudioRing of fixed
+//  size frames, the recognizer side reads the
+//  frames in place. One producer and one
+//  consumer, no locks
+//
+//  Plain C++ only, the SAPI side of it lives
+//  in RingStream.h
+
+namespace HNx
+{
+
+// everything past the sources is
+//  16kHz 16 bit mono
+constexpr unsigned AudioSampleRate {16000u};
+
+// 20ms
+constexpr size_t AudioFrameSamples {320u};
+
+class AudioRing
+{
+public:
+  // t_frames is rounded up to a power of two
+  explicit AudioRing(size_t t_frames = 256);
+
+  AudioRing(AudioRing const&) = delete;
+  AudioRing& operator=(AudioRing const&) = delete;
+
+  //========================================//
+  //   Producer                             //
+  //========================================//
+
+  // the next free frame to fill in place,
+  //  nullptr counts an overrun when full
+  int16_t*
+    writeFrame();
+
+  // room for another frame, never
+  //  counts an overrun
+  bool
+    writable() const;
+
+  // publishes the frame from writeFrame()
+  void
+    commitFrame();
+
+  // copies AudioFrameSamples samples,
+  //  false counts an overrun when full
+  bool
+    push(int16_t const* t_samples);
+
+  // no more frames will come, wakes
+  //  a waiting consumer
+  void
+    close();
+
+  //========================================//
+  //   Consumer                             //
+  //========================================//
+
+  // the oldest frame, valid until releaseFrame(),
+  //  nullptr when empty
+  int16_t const*
+    readFrame();
+
+  void
+    releaseFrame();
+
+  // blocks until a frame is ready or the
+  //  ring is closed, false once closed and
+  //  drained
+  bool
+    waitFrame();
+
+  //========================================//
+
+  size_t
+    available() const;
+
+  size_t
+    capacity() const;
+
+  bool
+    closed() const;
+
+  // frames dropped because the ring was full
+  uint64_t
+    overruns() const;
+
+  // times the consumer ran dry before the end
+  uint64_t
+    underruns() const;
+
+  uint64_t
+    framesWritten() const;
+
+private:
+  // keeps the two ends on separate
+  //  cache lines
+  static constexpr size_t CacheLine {64};
+
+  int16_t*
+    slot(uint64_t t_index);
+
+  std::vector<int16_t> m_buffer;
+  size_t m_mask;
+
+  alignas(CacheLine) std::atomic<uint64_t> m_head {0};  // consumer
+  bool m_dry {false};
+  std::atomic<uint64_t> m_underruns {0};
+
+  alignas(CacheLine) std::atomic<uint64_t> m_tail {0};  // producer
+  std::atomic<uint64_t> m_overruns {0};
+
+  // bumped on every commit and on close
+  //  for waitFrame()
+  alignas(CacheLine) std::atomic<uint32_t> m_signal {0};
+  std::atomic<bool> m_closed {false};
+};
+
+class PcmSource
+{
+public:
+  virtual ~PcmSource() = default;
+
+  // up to t_count samples, 0 at the end
+  virtual size_t
+    read(int16_t* t_dst, size_t t_count) = 0;
+};
+
+// a raw PCM file or a .wav, a FIFO, or
+//  standard input for "-", converted to
+//  16kHz 16 bit mono as it is read
+// throws std::runtime_error if it can't be
+//  opened or the format isn't 16 bit PCM or
+//  32 bit float
+class FileSource : public PcmSource
+{
+public:
+  // t_raw [optional]
+  //  the format of headerless input, .wav
+  //  files carry their own
+  explicit FileSource(std::wstring const& t_path,
+                      PcmFormat t_raw = {});
+  ~FileSource() override;
+
+  FileSource(FileSource const&) = delete;
+  FileSource& operator=(FileSource const&) = delete;
+
+  size_t
+    read(int16_t* t_dst, size_t t_count) override;
+
+private:
+  void
+    read_wav_header();
+
+  // up to t_frames whole frames of the
+  //  file's own format into m_raw
+  size_t
+    read_frames(size_t t_frames);
+
+  std::FILE* m_file {nullptr};
+  bool m_owned {false};
+  PcmFormat m_format;
+
+  // bytes of sample data left in a .wav,
+  //  raw input runs to the end of the file
+  uint64_t m_remaining {UINT64_MAX};
+
+  // none for 16kHz 16 bit mono
+  std::unique_ptr<PcmConverter> m_converter {};
+  std::vector<unsigned char> m_raw {};
+
+  // converted samples a short read had
+  //  no room for
+  std::vector<int16_t> m_spill {};
+  size_t m_spillAt {0};
+};
+
+// a sine tone, silence for a frequency of 0
+class ToneSource : public PcmSource
+{
+public:
+  // t_samples of 0 never ends
+  explicit ToneSource(double t_frequency = 0.0,
+                      double t_amplitude = 0.5,
+                      uint64_t t_samples = 0);
+
+  size_t
+    read(int16_t* t_dst, size_t t_count) override;
+
+private:
+  double m_step;
+  double m_amplitude;
+  double m_phase {0.0};
+  uint64_t m_left;
+  bool m_endless;
+};
+
+// moves frames from a source into a
+//  ring on a thread of its own
+class AudioPump
+{
+public:
+  // t_realtime paces the source to the
+  //  sample rate, files and generators
+  //  otherwise run as fast as they read
+  // t_block waits for room in a full ring
+  //  instead of dropping the frame, for
+  //  sources that aren't live
+  AudioPump(std::unique_ptr<PcmSource> t_source,
+            std::shared_ptr<AudioRing> t_ring,
+            bool t_realtime = false,
+            bool t_block = false);
+
+  // stops and closes the ring
+  ~AudioPump();
+
+  AudioPump(AudioPump const&) = delete;
+  AudioPump& operator=(AudioPump const&) = delete;
+
+  void
+    start();
+
+  void
+    stop();
+
+  // false once the source has ended
+  bool
+    running() const;
+
+private:
+  void
+    run();
+
+  std::unique_ptr<PcmSource> m_source;
+  std::shared_ptr<AudioRing> m_ring;
+  bool m_realtime;
+  bool m_block;
+
+  std::thread m_thread {};
+  std::atomic<bool> m_stop {false};
+  std::atomic<bool> m_running {false};
+};
+
+}
@@ -0,0 +1,613 @@
+#include "Batch.h"
+#include "Profile.h"
+#include "WorkStealing.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+
+//=================================//
+// HNx Voice Command Batch         //
+//=================================//
+// Transcribes recorded audio on   //
+//  every core                     //
+//=================================//
+
+using namespace HNx;
+
+double
+HNx::BatchReport::throughput() const
+{
+  if(wall.count() <= 0)
+    return 0.0;
+  return static_cast<double>(audio.count()) / static_cast<double>(wall.count());
+}
+
+HNx::BatchRunner::BatchRunner(Setup t_setup, std::wstring t_hotword, unsigned t_workers)
+  : m_setup(std::move(t_setup))
+  , m_hotword(std::move(t_hotword))
+  , m_workers(t_workers ? t_workers : std::max(1u, std::thread::hardware_concurrency()))
+{}
+
+BatchReport
+HNx::BatchRunner::run(std::vector<std::wstring> const& t_files) const
+{
+  BatchReport report;
+  report.files.resize(t_files.size());
+  for(size_t i = 0; i < t_files.size(); ++i)
+    report.files[i].path = t_files[i];
+  if(t_files.empty())
+    return report;
+
+  report.workers = static_cast<unsigned>(std::min<size_t>(m_workers, t_files.size()));
+
+  // biggest files first so the long ones
+  //  don't end up last on a single worker
+  std::vector<std::pair<uintmax_t, size_t>> bySize;
+  bySize.reserve(t_files.size());
+  for(size_t i = 0; i < t_files.size(); ++i)
+  {
+    std::error_code ec;
+    uintmax_t size = std::filesystem::file_size(std::filesystem::path(t_files[i]), ec);
+    bySize.emplace_back(ec ? 0 : size, i);
+  }
+  std::stable_sort(bySize.begin(), bySize.end(),
+                   [](auto const& a, auto const& b) { return a.first > b.first; });
+
+  WorkStealingQueues<size_t> queues(report.workers);
+  for(size_t i = 0; i < bySize.size(); ++i)
+    queues.push(i % report.workers, bySize[i].second);
+
+  std::vector<char> done(t_files.size(), 0);
+  std::atomic<size_t> stolen {0};
+
+  auto worker = [&](size_t t_id)
+  {
+    // held across the recognizer's lifetime so
+    //  its interfaces are released before COM
+    //  goes away on this thread
+    HRESULT hrCom = CoInitialize(nullptr);
+    {
+      Recog recog(m_hotword);
+      if(recog.initialize(false))
+      {
+        if(m_setup)
+          m_setup(recog);
+
+        size_t index = 0;
+        bool wasStolen = false;
+        while(queues.pop(t_id, index, wasStolen))
+        {
+          if(wasStolen)
+            ++stolen;
+
+          BatchFileResult& result = report.files[index];
+          std::wstring ext = std::filesystem::path(result.path).extension().wstring();
+          try
+          {
+            result.transcript = recog.transcribe(result.path, icase_equal(ext, L".pcm"));
+          }
+          catch(std::exception const& e)
+          {
+            result.error = e.what();
+          }
+          done[index] = 1;
+        }
+      }
+      else
+        DOUT("batch worker " << t_id << " failed: " << to_utf8(recog.lastError()));
+    }
+    if(SUCCEEDED(hrCom))
+      CoUninitialize();
+  };
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  threads.reserve(report.workers);
+  for(size_t i = 0; i < report.workers; ++i)
+    threads.emplace_back(worker, i);
+  for(auto& t : threads)
+    t.join();
+  report.wall = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+  report.stolen = stolen;
+  for(size_t i = 0; i < report.files.size(); ++i)
+  {
+    if(!done[i])
+      report.files[i].error = "no recognizer could be started";
+    report.audio += report.files[i].transcript.audio;
+  }
+  return report;
+}
+
+std::vector<std::wstring>
+HNx::BatchRunner::audioFiles(std::wstring const& t_dir)
+{
+  std::error_code ec;
+  std::filesystem::directory_iterator it(std::filesystem::path(t_dir), ec);
+  if(ec)
+    throw std::runtime_error("Failed to read audio directory...\nError: " + std::to_string(ec.value()));
+
+  std::vector<std::wstring> files;
+  for(auto const& entry : it)
+  {
+    if(!entry.is_regular_file(ec))
+      continue;
+    std::wstring ext = entry.path().extension().wstring();
+    if(icase_equal(ext, L".wav") || icase_equal(ext, L".pcm"))
+      files.push_back(entry.path().wstring());
+  }
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+void
+HNx::BatchRunner::write(BatchReport const& t_report,
+                        std::ostream& t_matches,
+                        std::ostream& t_summary)
+{
+  size_t matches = 0;
+  size_t failed = 0;
+  for(auto const& file : t_report.files)
+  {
+    std::string path = to_utf8(file.path);
+    if(!file.error.empty())
+    {
+      ++failed;
+      t_summary << path << ": " << file.error << "\n";
+      continue;
+    }
+
+    for(auto const& e : file.transcript.entries)
+    {
+      ++matches;
+      t_matches << path << '\t'
+                << e.offset.count() << '\t'
+                << to_utf8(e.heard) << '\t'
+                << to_utf8(e.cmd.phrase()) << '\t'
+                << to_utf8(e.cmd.exec()) << '\t'
+                << to_utf8(e.cmd.param()) << '\n';
+    }
+  }
+
+  t_summary << t_report.files.size() << " files (" << failed << " failed), "
+            << matches << " matches\n"
+            << static_cast<double>(t_report.audio.count()) / 1000.0 << " s of audio in "
+            << static_cast<double>(t_report.wall.count()) / 1000.0 << " s on "
+            << t_report.workers << " workers (" << t_report.stolen << " files stolen), "
+            << t_report.throughput() << "x realtime\n";
+}
+
+int
+HNx::runBatchCli(std::vector<std::wstring> const& t_args)
+{
+  std::wstring dir, profile, out, hotword = L"computer";
+  unsigned threads = 0;
+  for(size_t i = 0; i + 1 < t_args.size(); ++i)
+  {
+    std::wstring const& arg = t_args[i];
+    if(arg == L"--batch")
+      dir = t_args[++i];
+    else if(arg == L"--commands")
+      profile = t_args[++i];
+    else if(arg == L"--out")
+      out = t_args[++i];
+    else if(arg == L"--hotword")
+      hotword = t_args[++i];
+    else if(arg == L"--threads")
+      threads = static_cast<unsigned>(std::wcstoul(t_args[++i].c_str(), nullptr, 10));
+  }
+
+  if(dir.empty() || profile.empty())
+  {
+    std::cerr << "usage: --batch <dir> --commands <profile> [--out <file>] [--threads <n>] [--hotword <word>]\n";
+    return 1;
+  }
+
+  try
+  {
+    std::vector<ProfileEntry> commands = loadProfile(profile);
+    std::vector<std::wstring> files = BatchRunner::audioFiles(dir);
+
+    BatchRunner runner([&commands](Recog& r)
+                       {
+                         for(auto const& c : commands)
+                           r.addCommand(c.phrase, c.exec, c.param, c.context);
+                       },
+                       hotword,
+                       threads);
+    BatchReport report = runner.run(files);
+
+    if(out.empty())
+      BatchRunner::write(report, std::cout, std::cerr);
+    else
+    {
+      std::ofstream matches(std::filesystem::path(out), std::ios::binary | std::ios::trunc);
+      if(!matches)
+        throw std::runtime_error("Failed to open batch output file.");
+      BatchRunner::write(report, matches, std::cerr);
+    }
+  }
+  catch(std::exception const& e)
+  {
+    std::cerr << e.what() << "\n";
+    return 2;
+  }
+  return 0;
+}
+
+int
+HNx::runCompoundBenchCli(std::vector<std::wstring> const& t_args)
+{
+  std::wstring dir, profile, hotword = L"computer";
+  unsigned threads = 0;
+  for(size_t i = 0; i + 1 < t_args.size(); ++i)
+  {
+    std::wstring const& arg = t_args[i];
+    if(arg == L"--compound-bench")
+      dir = t_args[++i];
+    else if(arg == L"--commands")
+      profile = t_args[++i];
+    else if(arg == L"--hotword")
+      hotword = t_args[++i];
+    else if(arg == L"--threads")
+      threads = static_cast<unsigned>(std::wcstoul(t_args[++i].c_str(), nullptr, 10));
+  }
+
+  if(dir.empty() || profile.empty())
+  {
+    std::cerr << "usage: --compound-bench <dir> --commands <profile> [--threads <n>] [--hotword <word>]\n";
+    return 1;
+  }
+
+  try
+  {
+    std::vector<ProfileEntry> commands = loadProfile(profile);
+    BatchRunner runner([&commands](Recog& r)
+                       {
+                         for(auto const& c : commands)
+                           r.addCommand(c.phrase, c.exec, c.param, c.context);
+                       },
+                       hotword,
+                       threads);
+    BatchReport report = runner.run(BatchRunner::audioFiles(dir));
+
+    // the parts of one compound utterance are
+    //  consecutive and share where and what
+    //  was heard
+    std::vector<long long> cycles;
+    size_t compound = 0;
+    size_t avoided = 0;
+    size_t failed = 0;
+    for(auto const& file : report.files)
+    {
+      if(!file.error.empty())
+      {
+        ++failed;
+        continue;
+      }
+
+      auto const& entries = file.transcript.entries;
+      for(size_t i = 0; i < entries.size();)
+      {
+        size_t parts = 1;
+        while(i + parts < entries.size()
+              && entries[i + parts].offset == entries[i].offset
+              && entries[i + parts].heard == entries[i].heard)
+          ++parts;
+
+        cycles.push_back((entries[i].offset - entries[i].hotword).count());
+        if(parts > 1)
+        {
+          ++compound;
+          avoided += parts - 1;
+        }
+        i += parts;
+      }
+    }
+
+    if(cycles.empty())
+    {
+      std::cerr << "no commands were heard in " << report.files.size() << " files (" << failed << " failed)\n";
+      return 2;
+    }
+
+    std::sort(cycles.begin(), cycles.end());
+    double cycle = static_cast<double>(cycles[cycles.size() / 2]);
+    double saved = cycle * static_cast<double>(avoided);
+    std::cout << std::fixed << std::setprecision(1)
+              << report.files.size() << " files (" << failed << " failed), "
+              << cycles.size() << " interactions, " << compound << " compound\n"
+              << "hotword cycle ms\tp50 " << cycle << "\tp90 " << static_cast<double>(cycles[cycles.size() * 9 / 10]) << "\n"
+              << "hotword cycles avoided\t" << avoided << "\n"
+              << "saved s\t" << saved / 1000.0 << "\n"
+              << "saved ms per compound interaction\t" << (compound ? saved / static_cast<double>(compound) : 0.0) << "\n";
+  }
+  catch(std::exception const& e)
+  {
+    std::cerr << e.what() << "\n";
+    return 2;
+  }
+  return 0;
+}
+
+int
+HNx::runUsageBenchCli(std::vector<std::wstring> const& t_args)
+{
+  std::wstring profile;
+  size_t phrases = 5000;
+  size_t count = 200000;
+  double skew = 1.1;
+  for(size_t i = 0; i + 1 < t_args.size(); ++i)
+  {
+    std::wstring const& arg = t_args[i];
+    if(arg == L"--commands")
+      profile = t_args[++i];
+    else if(arg == L"--phrases")
+      phrases = std::max<size_t>(1, std::wcstoul(t_args[++i].c_str(), nullptr, 10));
+    else if(arg == L"--count")
+      count = std::max<size_t>(1, std::wcstoul(t_args[++i].c_str(), nullptr, 10));
+    else if(arg == L"--skew")
+      skew = std::wcstod(t_args[++i].c_str(), nullptr);
+  }
+
+  try
+  {
+    Recog recog;
+    if(!recog.initialize(false))
+      throw std::runtime_error(to_utf8(recog.lastError()));
+
+    // one grammar update for all of them,
+    //  numbered phrases all sound alike
+    std::vector<Command> commands;
+    if(!profile.empty())
+    {
+      for(auto const& c : loadProfile(profile))
+        if(c.context.empty())
+          commands.emplace_back(c.phrase, c.exec, c.param);
+    }
+    else
+    {
+      for(size_t i = 0; i < phrases; ++i)
+        commands.emplace_back(L"open item " + std::to_wstring(i), L"notepad.exe", L"");
+    }
+    if(commands.empty())
+      throw std::runtime_error("No context-free commands to replay");
+    recog.setConfusablePolicy(ConfusablePolicy::Ignore);
+    recog.editCommands({}, commands);
+
+    std::vector<std::wstring> said;
+    for(auto const& c : commands)
+      said.push_back(c.phrase());
+
+    // the popular phrases anywhere in the
+    //  order they were added, not first
+    std::mt19937 rng(42);
+    std::shuffle(said.begin(), said.end(), rng);
+    std::vector<double> cdf(said.size());
+    double total = 0.0;
+    for(size_t k = 0; k < said.size(); ++k)
+      cdf[k] = total += 1.0 / std::pow(static_cast<double>(k + 1), skew);
+    std::uniform_real_distribution<double> pick(0.0, total);
+    std::vector<size_t> sequence(count);
+    for(auto& s : sequence)
+      s = std::min<size_t>(std::lower_bound(cdf.begin(), cdf.end(), pick(rng)) - cdf.begin(), said.size() - 1);
+
+    auto replay = [&]
+    {
+      std::vector<uint64_t> ns;
+      ns.reserve(sequence.size());
+      size_t missed = 0;
+      for(size_t s : sequence)
+      {
+        auto start = std::chrono::steady_clock::now();
+        Command cmd = recog.command(said[s]);
+        ns.push_back(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()));
+        if(cmd.exec().empty())
+          ++missed;
+      }
+      std::sort(ns.begin(), ns.end());
+      uint64_t sum = 0;
+      for(uint64_t n : ns)
+        sum += n;
+      return std::array<double, 4> {static_cast<double>(sum) / static_cast<double>(ns.size()) / 1000.0,
+                                    static_cast<double>(ns[ns.size() / 2]) / 1000.0,
+                                    static_cast<double>(ns[ns.size() * 99 / 100]) / 1000.0,
+                                    static_cast<double>(missed)};
+    };
+
+    auto before = replay();
+
+    // through the usage file as a restart
+    //  would, which applies it right away
+    UsageStats usage;
+    for(size_t s : sequence)
+      usage.record(said[s]);
+    std::wstring file = (std::filesystem::temp_directory_path() / L"hnx-usage-bench.dat").wstring();
+    if(!usage.save(file))
+      throw std::runtime_error("Failed to write the usage file.");
+    recog.setUsageFile(file);
+    std::error_code ec;
+    std::filesystem::remove(std::filesystem::path(file), ec);
+
+    auto after = replay();
+
+    std::cout << std::fixed << std::setprecision(2)
+              << said.size() << " commands, " << count << " lookups, zipf " << skew << "\n"
+              << "us per lookup\tmean\tp50\tp99\tmissed\n"
+              << "insertion order\t" << before[0] << "\t" << before[1] << "\t" << before[2] << "\t" << before[3] << "\n"
+              << "usage order\t" << after[0] << "\t" << after[1] << "\t" << after[2] << "\t" << after[3] << "\n";
+  }
+  catch(std::exception const& e)
+  {
+    std::cerr << e.what() << "\n";
+    return 2;
+  }
+  return 0;
+}
+
+namespace
+{
+// no grammar holds more, a template that
+//  spells out to more is kept as one
+constexpr size_t MAX_SPELLED_OUT = 200000;
+
+// every phrase t_tpl matches with the slot
+//  values each was made from, none for a
+//  free text slot
+std::vector<std::pair<std::wstring, std::vector<std::wstring>>>
+spellOut(PhraseTemplate const& t_tpl)
+{
+  std::vector<std::pair<std::wstring, std::vector<std::wstring>>> phrases;
+  for(auto const& slot : t_tpl.slots())
+    if(slot.type == SlotType::FreeText)
+      return phrases;
+
+  phrases.emplace_back(std::wstring {}, std::vector<std::wstring>(t_tpl.slots().size()));
+  for(auto const& part : t_tpl.parts())
+  {
+    // what the part can be said as, and
+    //  the value it captures
+    std::vector<std::pair<std::wstring, std::wstring>> said;
+    if(part.slot < 0)
+      said.emplace_back(part.words, std::wstring {});
+    else
+    {
+      Slot const& slot = t_tpl.slots()[part.slot];
+      if(slot.type == SlotType::Number)
+        for(int v = slot.min; v <= slot.max; ++v)
+          said.emplace_back(numberToWords(v), std::to_wstring(v));
+      else
+        for(auto const& choice : slot.choices)
+          said.emplace_back(choice, choice);
+    }
+
+    std::vector<std::pair<std::wstring, std::vector<std::wstring>>> next;
+    next.reserve(phrases.size() * said.size());
+    for(auto const& p : phrases)
+      for(auto const& s : said)
+      {
+        next.push_back(p);
+        auto& phrase = next.back();
+        if(!phrase.first.empty())
+          phrase.first += L' ';
+        phrase.first += s.first;
+        if(part.slot >= 0)
+          phrase.second[part.slot] = s.second;
+      }
+    phrases.swap(next);
+  }
+  return phrases;
+}
+}
+
+int
+HNx::runTemplateBenchCli(std::vector<std::wstring> const& t_args)
+{
+  std::wstring profile;
+  for(size_t i = 0; i + 1 < t_args.size(); ++i)
+    if(t_args[i] == L"--commands")
+      profile = t_args[++i];
+
+  if(profile.empty())
+  {
+    std::cerr << "usage: --template-bench --commands <profile>\n";
+    return 1;
+  }
+
+  try
+  {
+    // a phrase that doesn't parse as a
+    //  template is an ordinary command
+    std::vector<Command> commands;
+    std::vector<std::pair<PhraseTemplate, ProfileEntry>> templates;
+    for(auto const& c : loadProfile(profile))
+    {
+      if(!c.context.empty())
+        continue;
+      if(c.phrase.find(L'{') != std::wstring::npos)
+      {
+        try
+        {
+          templates.emplace_back(PhraseTemplate {c.phrase}, c);
+          continue;
+        }
+        catch(std::invalid_argument const&)
+        {}
+      }
+      commands.emplace_back(c.phrase, c.exec, c.param);
+    }
+    if(templates.empty())
+      throw std::runtime_error("No context-free phrase templates in the profile");
+
+    // the same commands either way, only the
+    //  templates are built differently
+    std::vector<Command> expanded = commands;
+    std::vector<size_t> kept;
+    size_t spelled = 0;
+    for(size_t t = 0; t < templates.size(); ++t)
+    {
+      auto const& tpl = templates[t].first;
+      auto const& entry = templates[t].second;
+      if(tpl.expandedCount() > MAX_SPELLED_OUT)
+      {
+        kept.push_back(t);
+        continue;
+      }
+      auto phrases = spellOut(tpl);
+      if(phrases.empty())
+      {
+        kept.push_back(t);
+        continue;
+      }
+      ++spelled;
+      for(auto const& p : phrases)
+        expanded.emplace_back(p.first, tpl.substitute(entry.exec, p.second), tpl.substitute(entry.param, p.second));
+    }
+
+    auto build = [&](bool t_spellOut)
+    {
+      Recog recog;
+      if(!recog.initialize(false))
+        throw std::runtime_error(to_utf8(recog.lastError()));
+      recog.setConfusablePolicy(ConfusablePolicy::Ignore);
+
+      auto start = std::chrono::steady_clock::now();
+      recog.editCommands({}, t_spellOut ? expanded : commands);
+      for(size_t t = 0; t < templates.size(); ++t)
+        if(!t_spellOut || std::find(kept.begin(), kept.end(), t) != kept.end())
+          recog.addTemplate(templates[t].second.phrase, templates[t].second.exec, templates[t].second.param);
+      auto wall = std::chrono::steady_clock::now() - start;
+      return std::make_pair(recog.grammarStats(), wall);
+    };
+
+    auto templated = build(false);
+    auto spelledOut = build(true);
+
+    auto ms = [](std::chrono::steady_clock::duration t_d)
+    {
+      return std::chrono::duration<double, std::milli>(t_d).count();
+    };
+    std::cout << std::fixed << std::setprecision(1)
+              << commands.size() << " commands, " << templates.size() << " templates, "
+              << spelled << " spelled out as " << expanded.size() - commands.size() << " commands, "
+              << kept.size() << " kept as templates (free text or over " << MAX_SPELLED_OUT << ")\n"
+              << "grammar\trules\ttransitions\tlast commit ms\tbuild ms\n";
+    for(auto const& run : {std::make_pair("templated", templated), std::make_pair("spelled out", spelledOut)})
+      std::cout << run.first << '\t' << run.second.first.rules << '\t' << run.second.first.transitions << '\t'
+                << ms(run.second.first.lastCommit) << '\t' << ms(run.second.second) << "\n";
+  }
+  catch(std::exception const& e)
+  {
+    std::cerr << e.what() << "\n";
+    return 2;
+  }
+  return 0;
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include "Recog.hpp"
+
+#include <chrono>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+//   Offline transcription of recorded audio.
+//  Every worker thread owns a recognizer of
+//  its own, files are dealt out largest first
+//  and idle workers steal from busy ones
+//
+//  The replay benchmarks run recordings and
+//  made up workloads through it too
+
+namespace HNx
+{
+
+struct BatchFileResult
+{
+  std::wstring path {};
+  Transcript transcript {};
+
+  // empty unless the file failed
+  std::string error {};
+};
+
+struct BatchReport
+{
+  std::vector<BatchFileResult> files {};
+
+  // total audio transcribed and the
+  //  wall time it took
+  std::chrono::milliseconds audio {};
+  std::chrono::milliseconds wall {};
+
+  unsigned workers {0};
+
+  // files a worker took from another's queue
+  size_t stolen {0};
+
+  // seconds of audio per wall clock second
+  double
+    throughput() const;
+};
+
+class BatchRunner
+{
+public:
+  // loads the commands into each worker's
+  //  recognizer after initialize()
+  using Setup = std::function<void(Recog&)>;
+
+  // t_workers of 0 uses one per core
+  explicit BatchRunner(Setup t_setup,
+                       std::wstring t_hotword = L"computer",
+                       unsigned t_workers = 0);
+
+  // .pcm files are read as headerless
+  //  16kHz 16 bit mono
+  BatchReport
+    run(std::vector<std::wstring> const& t_files) const;
+
+  // .wav and .pcm files directly in t_dir,
+  //  throws std::runtime_error if it can't
+  //  be read
+  static std::vector<std::wstring>
+    audioFiles(std::wstring const& t_dir);
+
+  // matches as tab separated lines of
+  //  file, offset ms, heard, phrase, exec, param
+  static void
+    write(BatchReport const& t_report,
+          std::ostream& t_matches,
+          std::ostream& t_summary);
+
+private:
+  Setup m_setup;
+  std::wstring m_hotword;
+  unsigned m_workers;
+};
+
+// voicecommand --batch <dir> --commands <profile>
+//              [--out <file>] [--threads <n>]
+//              [--hotword <word>]
+// returns the process exit code
+int
+  runBatchCli(std::vector<std::wstring> const& t_args);
+
+// voicecommand --compound-bench <dir> --commands <profile>
+//              [--threads <n>] [--hotword <word>]
+// replays recordings and reports the audio
+//  time compound utterances saved: each
+//  command after the first would have taken
+//  another hotword cycle, hotword start to
+//  command start as measured in them
+int
+  runCompoundBenchCli(std::vector<std::wstring> const& t_args);
+
+// voicecommand --usage-bench [--commands <profile>]
+//              [--phrases <n>] [--count <n>]
+//              [--skew <s>]
+// looks up a Zipf distributed sequence of
+//  the context-free commands, or of <n>
+//  made up ones, in the order they were
+//  added then after the sequence's usage
+//  is applied as a restart would
+int
+  runUsageBenchCli(std::vector<std::wstring> const& t_args);
+
+// voicecommand --template-bench --commands <profile>
+// builds the context-free commands into a
+//  grammar twice, phrases with {slots} once
+//  as templates and once spelled out into a
+//  command per value, and prints the size
+//  and commit time of each
+int
+  runTemplateBenchCli(std::vector<std::wstring> const& t_args);
+
+}
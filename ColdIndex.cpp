@@ -0,0 +1,511 @@
+#include "ColdIndex.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <cwchar>
+#include <cwctype>
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
+
+//=================================//
+// HNx Voice Command Cold Index    //
+//=================================//
+// Compact on-disk tier for the    //
+//  least used commands            //
+//=================================//
+
+using namespace HNx;
+
+namespace
+{
+// don't bother compacting small files
+constexpr size_t MIN_DEAD_TO_COMPACT = 1024;
+
+uint64_t
+fnv1a(std::string_view t_bytes)
+{
+  uint64_t hash = 14695981039346656037ull;
+  for(unsigned char c : t_bytes)
+  {
+    hash ^= c;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+uint64_t
+keyHash(std::wstring const& t_key)
+{
+  return fnv1a(to_utf8(t_key));
+}
+
+void
+escapeInto(std::string& t_out, std::wstring_view t_field)
+{
+  for(char c : to_utf8(t_field))
+  {
+    switch(c)
+    {
+      case '\\': t_out.append("\\\\"); break;
+      case '\t': t_out.append("\\t"); break;
+      case '\n': t_out.append("\\n"); break;
+      case '\r': t_out.append("\\r"); break;
+      default:   t_out.push_back(c); break;
+    }
+  }
+}
+
+// splits a record back into its fields
+std::vector<std::wstring>
+split(std::string const& t_line)
+{
+  std::vector<std::wstring> fields;
+  std::string field;
+  for(size_t i = 0; i < t_line.size(); ++i)
+  {
+    char c = t_line[i];
+    if(c == '\t')
+    {
+      fields.push_back(from_utf8(field));
+      field.clear();
+    }
+    else if(c == '\\' && i + 1 < t_line.size())
+    {
+      char next = t_line[++i];
+      field.push_back(next == 't' ? '\t' : next == 'n' ? '\n' : next == 'r' ? '\r' : next);
+    }
+    else
+      field.push_back(c);
+  }
+  fields.push_back(from_utf8(field));
+  return fields;
+}
+}
+
+HNx::ColdIndex::ColdIndex(std::wstring t_path)
+  : m_path(std::move(t_path))
+{
+  std::filesystem::path path(m_path);
+  if(!std::filesystem::exists(path))
+    std::ofstream(path, std::ios::binary);
+
+  m_file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+  if(!m_file)
+    throw std::runtime_error("Failed to open cold command index.");
+
+  // every record first, sorted once below
+  struct Loaded
+  {
+    Slot slot {};
+    bool live {false};
+  };
+  std::vector<Loaded> records;
+  std::string line;
+  uint64_t offset = 0;
+  bool torn = false;
+  while(std::getline(m_file, line))
+  {
+    // a record always ends in a newline, one
+    //  without was cut short by a crash
+    if(m_file.eof())
+    {
+      torn = true;
+      break;
+    }
+
+    Record record = decode(line);
+    records.push_back({{keyHash(normalize(record.phrase)), offset}, !record.exec.empty()});
+    m_nextAction = std::max(m_nextAction, record.action + 1);
+    offset += line.size() + 1;
+  }
+  m_end = offset;
+  m_file.clear();
+
+  if(torn)
+  {
+    m_file.close();
+    std::error_code ec;
+    std::filesystem::resize_file(path, m_end, ec);
+    m_file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+    if(ec || !m_file)
+      throw std::runtime_error("Failed to repair cold command index.\nError: " + std::to_string(ec.value()));
+  }
+
+  // later records win; one hash is nearly
+  //  always one phrase, the records decide
+  //  only when it isn't
+  std::sort(records.begin(), records.end(),
+            [](Loaded const& a, Loaded const& b) { return a.slot < b.slot; });
+  m_slots.reserve(records.size());
+  for(size_t first = 0, last; first < records.size(); first = last)
+  {
+    last = first + 1;
+    while(last < records.size() && records[last].slot.hash == records[first].slot.hash)
+      ++last;
+
+    if(last - first == 1)
+    {
+      if(records[first].live)
+        m_slots.push_back(records[first].slot);
+      continue;
+    }
+
+    std::vector<std::wstring> seen;
+    for(size_t i = last; i-- > first;)
+    {
+      Record record;
+      if(!read(records[i].slot.offset, record))
+        continue;
+      std::wstring key = normalize(record.phrase);
+      if(std::find(seen.begin(), seen.end(), key) != seen.end())
+        continue;
+      seen.push_back(std::move(key));
+      if(records[i].live)
+        m_slots.push_back(records[i].slot);
+    }
+  }
+  std::sort(m_slots.begin(), m_slots.end());
+  m_dead = records.size() - m_slots.size();
+}
+
+std::wstring
+HNx::ColdIndex::normalize(std::wstring_view t_phrase)
+{
+  std::wstring key;
+  bool space = false;
+  for(auto c : t_phrase)
+  {
+    if(std::iswalnum(c) || c == L'\'')
+    {
+      if(space && !key.empty())
+        key.push_back(L' ');
+      key.push_back(c);
+      space = false;
+    }
+    else
+      space = true;
+  }
+  return lower_key(key);
+}
+
+std::string
+HNx::ColdIndex::encode(Record const& t_record)
+{
+  std::string record;
+  escapeInto(record, t_record.phrase);
+  record.push_back('\t');
+  escapeInto(record, t_record.exec);
+  record.push_back('\t');
+  escapeInto(record, t_record.param);
+  if(!t_record.exec.empty())
+  {
+    record.push_back('\t');
+    record.append(std::to_string(t_record.action));
+    record.push_back('\t');
+    record.append(std::to_string(t_record.uses));
+  }
+  return record;
+}
+
+ColdIndex::Record
+HNx::ColdIndex::decode(std::string const& t_line)
+{
+  auto fields = split(t_line);
+  fields.resize(5);
+
+  Record record;
+  record.phrase = std::move(fields[0]);
+  record.exec = std::move(fields[1]);
+  record.param = std::move(fields[2]);
+  record.action = std::wcstoull(fields[3].c_str(), nullptr, 10);
+  record.uses = std::wcstoull(fields[4].c_str(), nullptr, 10);
+  return record;
+}
+
+bool
+HNx::ColdIndex::read(uint64_t t_offset, Record& t_record)
+{
+  m_file.clear();
+  m_file.seekg(static_cast<std::streamoff>(t_offset));
+  std::string line;
+  if(!std::getline(m_file, line))
+  {
+    m_file.clear();
+    return false;
+  }
+
+  t_record = decode(line);
+  return true;
+}
+
+void
+HNx::ColdIndex::append(std::string const& t_record, uint64_t t_hash, bool t_live)
+{
+  m_file.clear();
+  m_file.seekp(static_cast<std::streamoff>(m_end));
+  m_file.write(t_record.data(), static_cast<std::streamsize>(t_record.size()));
+  m_file.put('\n');
+  m_file.flush();
+  if(!m_file)
+    throw std::runtime_error("Failed to write cold command index.");
+
+  if(t_live)
+  {
+    Slot slot {t_hash, m_end};
+    m_slots.insert(std::upper_bound(m_slots.begin(), m_slots.end(), slot), slot);
+  }
+  m_end += t_record.size() + 1;
+}
+
+std::vector<ColdIndex::Slot>::iterator
+HNx::ColdIndex::locate(std::wstring const& t_key, uint64_t t_hash, Record* t_out)
+{
+  auto range = std::equal_range(m_slots.begin(), m_slots.end(), Slot {t_hash, 0},
+                                [](Slot const& a, Slot const& b) { return a.hash < b.hash; });
+
+  // hashes can collide, the record decides
+  for(auto it = range.first; it != range.second; ++it)
+  {
+    Record record;
+    if(read(it->offset, record) && normalize(record.phrase) == t_key)
+    {
+      if(t_out)
+        *t_out = std::move(record);
+      return it;
+    }
+  }
+  return m_slots.end();
+}
+
+uint64_t
+HNx::ColdIndex::idOf(std::shared_ptr<Action> const& t_action)
+{
+  // an address is only the same action
+  //  while the old one is still alive
+  auto it = m_ids.find(t_action.get());
+  if(it != m_ids.end())
+  {
+    auto live = m_actions.find(it->second);
+    if(live != m_actions.end() && live->second.lock() == t_action)
+      return it->second;
+  }
+
+  uint64_t id = m_nextAction++;
+  m_ids[t_action.get()] = id;
+  m_actions[id] = t_action;
+  return id;
+}
+
+Command
+HNx::ColdIndex::restore(Record const& t_record)
+{
+  if(!t_record.action)
+    return Command {t_record.phrase, std::make_shared<Action>(t_record.exec, t_record.param)};
+
+  auto& weak = m_actions[t_record.action];
+  auto action = weak.lock();
+  if(!action)
+  {
+    action = std::make_shared<Action>(t_record.exec, t_record.param);
+    action->uses = t_record.uses;
+    weak = action;
+    m_ids[action.get()] = t_record.action;
+  }
+  return Command {t_record.phrase, action};
+}
+
+void
+HNx::ColdIndex::insert(Command const& t_cmd)
+{
+  std::wstring key = normalize(t_cmd.phrase());
+  if(key.empty() || t_cmd.exec().empty())
+    return;
+
+  uint64_t hash = keyHash(key);
+  std::lock_guard<std::mutex> lock(m_mtx);
+  auto it = locate(key, hash, nullptr);
+  if(it != m_slots.end())
+  {
+    m_slots.erase(it);
+    m_dead++;
+  }
+
+  auto action = t_cmd.action();
+  append(encode(Record {t_cmd.phrase(), t_cmd.exec(), t_cmd.param(), idOf(action), action->uses.load()}),
+         hash,
+         true);
+}
+
+void
+HNx::ColdIndex::remove(std::wstring_view t_phrase)
+{
+  std::wstring key = normalize(t_phrase);
+  uint64_t hash = keyHash(key);
+
+  std::lock_guard<std::mutex> lock(m_mtx);
+  auto it = locate(key, hash, nullptr);
+  if(it == m_slots.end())
+    return;
+
+  m_slots.erase(it);
+  m_dead += 2;
+  append(encode(Record {std::wstring(t_phrase)}), hash, false);
+}
+
+std::vector<std::wstring>
+HNx::ColdIndex::removeAction(std::shared_ptr<Action> const& t_action)
+{
+  std::lock_guard<std::mutex> lock(m_mtx);
+
+  // never evicted, none of its aliases is here
+  auto id = m_ids.find(t_action.get());
+  if(!t_action || id == m_ids.end())
+    return {};
+  auto live = m_actions.find(id->second);
+  if(live == m_actions.end() || live->second.lock() != t_action)
+    return {};
+
+  std::vector<Record> doomed;
+  std::vector<Slot> kept;
+  for(auto const& slot : m_slots)
+  {
+    Record record;
+    if(read(slot.offset, record) && record.action == id->second)
+      doomed.push_back(std::move(record));
+    else
+      kept.push_back(slot);
+  }
+  m_slots.swap(kept);
+
+  std::vector<std::wstring> phrases;
+  for(auto& record : doomed)
+  {
+    append(encode(Record {record.phrase}), keyHash(normalize(record.phrase)), false);
+    m_dead += 2;
+    phrases.push_back(std::move(record.phrase));
+  }
+  return phrases;
+}
+
+Command
+HNx::ColdIndex::find(std::wstring_view t_phrase)
+{
+  std::wstring key = normalize(t_phrase);
+  if(key.empty())
+    return {};
+
+  Record record;
+  std::lock_guard<std::mutex> lock(m_mtx);
+  if(locate(key, keyHash(key), &record) == m_slots.end())
+    return {};
+  return restore(record);
+}
+
+std::vector<std::wstring>
+HNx::ColdIndex::phrases()
+{
+  std::lock_guard<std::mutex> lock(m_mtx);
+
+  // in file order, the disk reads forward
+  std::vector<uint64_t> offsets;
+  offsets.reserve(m_slots.size());
+  for(auto const& slot : m_slots)
+    offsets.push_back(slot.offset);
+  std::sort(offsets.begin(), offsets.end());
+
+  std::vector<std::wstring> phrases;
+  phrases.reserve(offsets.size());
+  for(uint64_t offset : offsets)
+  {
+    Record record;
+    if(read(offset, record))
+      phrases.push_back(std::move(record.phrase));
+  }
+  return phrases;
+}
+
+size_t
+HNx::ColdIndex::size() const
+{
+  std::lock_guard<std::mutex> lock(m_mtx);
+  return m_slots.size();
+}
+
+size_t
+HNx::ColdIndex::memoryUsage() const
+{
+  std::lock_guard<std::mutex> lock(m_mtx);
+  return sizeof(*this) + m_slots.capacity() * sizeof(Slot)
+       + m_actions.size() * (sizeof(uint64_t) + sizeof(std::weak_ptr<Action>) + sizeof(void*))
+       + m_ids.size() * (sizeof(Action const*) + sizeof(uint64_t) + sizeof(void*));
+}
+
+void
+HNx::ColdIndex::compact()
+{
+  std::lock_guard<std::mutex> lock(m_mtx);
+
+  // ids of actions no one holds any more
+  //  stay in the records, only the lookups
+  //  for them go; a weak_ptr would keep
+  //  the action's memory
+  for(auto it = m_actions.begin(); it != m_actions.end();)
+  {
+    if(it->second.expired())
+      it = m_actions.erase(it);
+    else
+      ++it;
+  }
+  for(auto it = m_ids.begin(); it != m_ids.end();)
+  {
+    auto action = m_actions.find(it->second);
+    if(action == m_actions.end() || action->second.lock().get() != it->first)
+      it = m_ids.erase(it);
+    else
+      ++it;
+  }
+
+  if(m_dead < MIN_DEAD_TO_COMPACT || m_dead < m_slots.size())
+    return;
+
+  std::filesystem::path path(m_path);
+  std::filesystem::path tmp = path;
+  tmp += L".tmp";
+
+  std::vector<Slot> slots;
+  slots.reserve(m_slots.size());
+  uint64_t end = 0;
+  {
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    for(auto const& slot : m_slots)
+    {
+      Record live;
+      if(!read(slot.offset, live))
+        continue;
+      std::string record = encode(live);
+      out.write(record.data(), static_cast<std::streamsize>(record.size()));
+      out.put('\n');
+      slots.push_back({slot.hash, end});
+      end += record.size() + 1;
+    }
+    if(!out)
+      return;
+  }
+
+  m_file.close();
+  std::error_code ec;
+  std::filesystem::rename(tmp, path, ec);
+  m_file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+  if(!m_file)
+    throw std::runtime_error("Failed to reopen cold command index.");
+
+  // the old file is still in place if the
+  //  rename failed, keep its offsets
+  if(ec)
+    return;
+
+  m_slots.swap(slots);
+  m_end = end;
+  m_dead = 0;
+}
@@ -0,0 +1,154 @@
+#pragma once
+#include "Command.h"
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+//   On-disk store for rarely used commands.
+//  Only a hash and file offset per command
+//  stay in memory, the strings are read back
+//  when a phrase is looked up
+//
+//  The file is append-only, one record per
+//  line: phrase<TAB>exec<TAB>param<TAB>action
+//  <TAB>uses. A record with an empty exec
+//  removes the phrase
+//
+//  Aliases of one action share its id, they
+//  get the same Action back when found
+
+namespace HNx
+{
+
+class ColdIndex
+{
+public:
+  // opens or creates t_path and indexes
+  //  it, throws std::runtime_error if it
+  //  can't be opened
+  explicit ColdIndex(std::wstring t_path);
+
+  ColdIndex(ColdIndex const&) = delete;
+  ColdIndex& operator=(ColdIndex const&) = delete;
+
+  // replaces a command with the same phrase,
+  //  its action's uses are kept with it
+  void
+    insert(Command const& t_cmd);
+
+  void
+    remove(std::wstring_view t_phrase);
+
+  // removes every evicted alias of t_action,
+  //  reads the whole file
+  // returns the phrases removed
+  std::vector<std::wstring>
+    removeAction(std::shared_ptr<Action> const& t_action);
+
+  // phrases are matched loosely, case and
+  //  punctuation are ignored so text from
+  //  dictation still finds its command
+  // the action is the one its aliases still
+  //  in use have, or a new one with the
+  //  uses it had when evicted
+  // empty command if not found
+  Command
+    find(std::wstring_view t_phrase);
+
+  // every live phrase, reads the whole file
+  std::vector<std::wstring>
+    phrases();
+
+  size_t
+    size() const;
+
+  // bytes of memory used by the index itself
+  size_t
+    memoryUsage() const;
+
+  // rewrites the file with only live records
+  //  once dead ones take up most of it
+  void
+    compact();
+
+  // lower case words without punctuation
+  static std::wstring
+    normalize(std::wstring_view t_phrase);
+
+private:
+  struct Slot
+  {
+    uint64_t hash {0};
+    uint64_t offset {0};
+
+    friend bool operator<(Slot const& a, Slot const& b)
+    {
+      return a.hash < b.hash || (a.hash == b.hash && a.offset < b.offset);
+    }
+  };
+
+  struct Record
+  {
+    std::wstring phrase {};
+    std::wstring exec {};
+    std::wstring param {};
+
+    // 0 in files written before there
+    //  were ids, shared with nothing
+    uint64_t action {0};
+    uint64_t uses {0};
+  };
+
+  // records are escaped so tabs and
+  //  newlines can't split them
+  static std::string
+    encode(Record const& t_record);
+
+  static Record
+    decode(std::string const& t_line);
+
+  bool
+    read(uint64_t t_offset, Record& t_record);
+
+  void
+    append(std::string const& t_record, uint64_t t_hash, bool t_live);
+
+  // unlocked helpers
+  std::vector<Slot>::iterator
+    locate(std::wstring const& t_key, uint64_t t_hash, Record* t_out);
+
+  // assigns t_action an id on first use
+  uint64_t
+    idOf(std::shared_ptr<Action> const& t_action);
+
+  Command
+    restore(Record const& t_record);
+
+  std::wstring m_path {};
+  std::fstream m_file {};
+  uint64_t m_end {0};
+
+  // records in the file that were
+  //  replaced or removed since
+  size_t m_dead {0};
+
+  // sorted by hash
+  std::vector<Slot> m_slots {};
+
+  // actions with an id that are still
+  //  alive, hot or promoted; the dead
+  //  ones go on compact()
+  std::unordered_map<uint64_t, std::weak_ptr<Action>> m_actions {};
+  std::unordered_map<Action const*, uint64_t> m_ids {};
+  uint64_t m_nextAction {1};
+
+  mutable std::mutex m_mtx {};
+};
+
+}
@@ -1,6 +1,10 @@
 #pragma once
+#include "Action.h"
+#include "Macro.h"
 #include "Util.h"
 
+#include <memory>
+
 namespace HNx
 {
 class Command
@@ -8,16 +12,17 @@ class Command
 public:
   Command() = default;
 
+  // copies share the action
   Command(Command const& c)
     : m_phrase(c.m_phrase)
-    , m_exec(c.m_exec)
-    , m_param(c.m_param)
+    , m_action(c.m_action)
+    , m_weight(c.m_weight)
   {}
 
   Command(Command&& c)
     : m_phrase(std::move(c.m_phrase))
-    , m_exec(std::move(c.m_exec))
-    , m_param(std::move(c.m_param))
+    , m_action(std::move(c.m_action))
+    , m_weight(c.m_weight)
   {}
 
   Command& operator=(Command const& c)
@@ -25,8 +30,8 @@ public:
     if(this != &c)
     {
       m_phrase = c.m_phrase;
-      m_exec = c.m_exec;
-      m_param = c.m_param;
+      m_action = c.m_action;
+      m_weight = c.m_weight;
     }
     return *this;
   }
@@ -36,8 +41,8 @@ public:
     if(this != &c)
     {
       m_phrase.swap(c.m_phrase);
-      m_exec.swap(c.m_exec);
-      m_param.swap(c.m_param);
+      m_action.swap(c.m_action);
+      std::swap(m_weight, c.m_weight);
     }
     return *this;
   }
@@ -46,8 +51,22 @@ public:
           std::wstring_view prog,
           std::wstring_view param = L"")
     : m_phrase(phrase)
-    , m_exec(prog)
-    , m_param(param)
+    , m_action(std::make_shared<Action>(std::wstring(prog), std::wstring(param)))
+  {}
+
+  // a phrase that runs several steps, exec
+  //  is only a marker like the built-ins use
+  Command(std::wstring_view phrase,
+          std::shared_ptr<Macro const> macro)
+    : m_phrase(phrase)
+    , m_action(std::make_shared<Action>(L"**Macro**", L"", std::move(macro)))
+  {}
+
+  // another phrase for an existing action
+  Command(std::wstring_view phrase,
+          std::shared_ptr<Action> action)
+    : m_phrase(phrase)
+    , m_action(std::move(action))
   {}
 
   //Command(std::wstring const& cmdline)
@@ -152,12 +171,45 @@ public:
 
   std::wstring exec() const
   {
-    return m_exec;
+    return m_action ? m_action->exec : std::wstring {};
   }
 
   std::wstring param() const
   {
-    return m_param;
+    return m_action ? m_action->param : std::wstring {};
+  }
+
+  bool isMacro() const
+  {
+    return m_action && m_action->macro != nullptr;
+  }
+
+  // shared, macros are immutable once built
+  std::shared_ptr<Macro const> macro() const
+  {
+    return m_action ? m_action->macro : nullptr;
+  }
+
+  // shared with every alias of this command
+  std::shared_ptr<Action> action() const
+  {
+    return m_action;
+  }
+
+  bool isAliasOf(Command const& t) const
+  {
+    return m_action && m_action == t.m_action;
+  }
+
+  // relative grammar weight of the phrase
+  float weight() const
+  {
+    return m_weight;
+  }
+
+  void setWeight(float t)
+  {
+    m_weight = t;
   }
 
   void setPhrase(std::wstring_view t)
@@ -165,14 +217,16 @@ public:
     m_phrase = t;
   }
 
+  // the setters detach this command from
+  //  its aliases instead of changing them
   void setExec(std::wstring_view t)
   {
-    m_exec = t;
+    m_action = std::make_shared<Action>(std::wstring(t), param(), macro());
   }
 
   void setParam(std::wstring_view t)
   {
-    m_param = t;
+    m_action = std::make_shared<Action>(exec(), std::wstring(t), macro());
   }
 
   // combines the exec and optional param into 
@@ -180,13 +234,13 @@ public:
   std::wstring cmdline() const
   {
     std::wstring cmdline;
-    if(!m_exec.empty())
+    if(m_action && !m_action->exec.empty())
     {
-      cmdline = m_exec;
-      if(!m_param.empty())
+      cmdline = m_action->exec;
+      if(!m_action->param.empty())
       {
         cmdline.push_back(' ');
-        cmdline.append(m_param);
+        cmdline.append(m_action->param);
       }
     }
     return cmdline;
@@ -197,7 +251,8 @@ public:
   {
     return ((a.phrase() == b.phrase()) &&
             (a.exec()   == b.exec())   &&
-            (a.param()  == b.param()));
+            (a.param()  == b.param())  &&
+            (a.macro()  == b.macro()));
   }
 
   friend bool operator!=(Command const& a, Command const& b)
@@ -209,9 +264,12 @@ private:
   // phrase to listen for
   std::wstring m_phrase {};
 
-  // program to execute and
-  //  it's optional args
-  std::wstring m_exec {};
-  std::wstring m_param {};
+  // program to execute and it's
+  //  optional args, or the macro
+  std::shared_ptr<Action> m_action {};
+
+  // not part of equality, it only biases
+  //  the recognizer towards the phrase
+  float m_weight {1.0f};
 };
 }
\ No newline at end of file
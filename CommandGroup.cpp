@@ -1,9 +1,13 @@
 #include "CommandGroup.h"
+#include "Metrics.h"
 #include "Util.h"
 
 //#include <windows.h>
 #include <stdexcept>
 #include <algorithm>
+#include <cmath>
+#include <functional>
+#include <set>
 #include <string_view>
 #include <string>
 
@@ -18,6 +22,45 @@ using namespace HNx;
 
 constexpr short GRAMMAR_LANG_NO_RULES = 409;
 
+// weight of the most used phrases
+//  relative to unused ones
+constexpr float MAX_USAGE_WEIGHT = 4.0f;
+
+// rough heap and object size of a command,
+//  without the action aliases share
+static size_t
+phrase_bytes(Command const& t_cmd)
+{
+  return sizeof(Command) + t_cmd.phrase().capacity() * sizeof(wchar_t);
+}
+
+static size_t
+action_bytes(Action const& t_action)
+{
+  return sizeof(Action) + (t_action.exec.capacity() + t_action.param.capacity()) * sizeof(wchar_t);
+}
+
+// every group's commits, registered with
+//  the first group so scrapes see them at 0
+static Histogram&
+commit_seconds()
+{
+  static Histogram& seconds = Metrics::histogram("hnx_grammar_commit_seconds",
+                                                 "Time SAPI took to commit a grammar change");
+  return seconds;
+}
+
+static Counter&
+commit_failures()
+{
+  static Counter& failures = Metrics::counter("hnx_grammar_commit_failures_total",
+                                              "Grammar commits SAPI refused");
+  return failures;
+}
+
+constexpr auto CONNECTOR_AND {L"and"};
+constexpr auto CONNECTOR_THEN {L"then"};
+
 HNx::CommandGroup::CommandGroup()
 {}
 
@@ -53,6 +96,9 @@ HNx::CommandGroup::CommandGroup(ISpRecoContext* t_ctx,
   hr = m_cpGram->SetRuleIdState(m_gramID, SPRS_ACTIVE);
   if(FAILED(hr))
     throw std::runtime_error("Failed to activate rule.\nError: " + std::to_string(hr));
+
+  commit_seconds();
+  commit_failures();
 }
 
 HNx::CommandGroup::~CommandGroup()
@@ -73,11 +119,25 @@ HNx::CommandGroup::CommandGroup(CommandGroup&& t)
   : m_gramID(std::move(t.m_gramID))
   , m_grammarName(std::move(t.m_grammarName))
   , m_hState(std::move(t.m_hState))
+  , m_hCompound(t.m_hCompound)
+  , m_maxCompound(t.m_maxCompound)
   , currentState(t.currentState)
+  , m_lastCommit(t.m_lastCommit)
+  , m_phonetic(std::move(t.m_phonetic))
+  , m_confusablePolicy(t.m_confusablePolicy)
+  , m_cold(std::move(t.m_cold))
+  , m_hotBudget(t.m_hotBudget)
+  , m_promoted(t.m_promoted)
 {
   m_cpGram.Attach(t.m_cpGram.Detach());
   m_cmds.swap(t.m_cmds);
+  m_templates.swap(t.m_templates);
+  m_nextTemplate = t.m_nextTemplate;
+  m_boosted.swap(t.m_boosted);
+  m_boost = t.m_boost;
   t.m_hState = nullptr;
+  t.m_hCompound = nullptr;
+  t.m_maxCompound = 0;
 }
 
 CommandGroup&
@@ -90,8 +150,22 @@ HNx::CommandGroup::operator=(CommandGroup&& t)
     t.m_gramID = 0;
     m_grammarName.swap(t.m_grammarName);
     m_cmds.swap(t.m_cmds);
+    m_templates.swap(t.m_templates);
+    m_nextTemplate = t.m_nextTemplate;
+    m_lastCommit = t.m_lastCommit;
+    m_boosted.swap(t.m_boosted);
+    m_boost = t.m_boost;
+    m_phonetic = std::move(t.m_phonetic);
+    m_confusablePolicy = t.m_confusablePolicy;
+    m_cold.swap(t.m_cold);
+    m_hotBudget = t.m_hotBudget;
+    m_promoted = t.m_promoted;
     m_hState = std::move(t.m_hState);
     t.m_hState = nullptr;
+    m_hCompound = t.m_hCompound;
+    t.m_hCompound = nullptr;
+    m_maxCompound = t.m_maxCompound;
+    t.m_maxCompound = 0;
     currentState = t.currentState;
     t.currentState = CGState::Unknown;
   }
@@ -120,14 +194,15 @@ HNx::CommandGroup::deactivate()
   currentState = CGState::Inactive;
 }
 
-void
+std::vector<Confusable>
 HNx::CommandGroup::addCommand(Command const& t_cmd)
 {
   // check for duplicate phrase
-  for(auto cmd : m_cmds)
-    if(cmd.phrase().size() == t_cmd.phrase().size())
-      if(std::equal(cmd.phrase().begin(), cmd.phrase().end(), t_cmd.phrase().begin(), icase_cmp_wchar))
-        return;
+  for(auto const& cmd : m_cmds)
+    if(icase_equal(cmd.phrase(), t_cmd.phrase()))
+      return {};
+
+  auto confusable = check_confusable(t_cmd.phrase(), t_cmd.action());
 
   // deactivate grammar if active
   CGState lastState {CGState::Unknown};
@@ -153,12 +228,12 @@ HNx::CommandGroup::addCommand(Command const& t_cmd)
                                      t_cmd.phrase().c_str(),
                                      nullptr,
                                      SPWT_LEXICAL,
-                                     1,
+                                     weight_of(t_cmd),
                                      nullptr);
 
   // save our changes and activate grammar;
   if(SUCCEEDED(hr))
-    hr = m_cpGram->Commit(0);
+    hr = commit();
 
   if(SUCCEEDED(hr))
     hr = m_cpGram->SetRuleIdState(m_gramID, SPRS_ACTIVE);
@@ -169,9 +244,15 @@ HNx::CommandGroup::addCommand(Command const& t_cmd)
   // add our command to the vector
   m_cmds.emplace_back(t_cmd);
 
+  // the grammar copy wins over an evicted one
+  if(m_cold)
+    m_cold->remove(t_cmd.phrase());
+  m_phonetic.insert(t_cmd.phrase());
+
   // activate if we were active before
   if(lastState == CGState::Active)
     activate();
+  return confusable;
 }
 
 void
@@ -183,14 +264,251 @@ HNx::CommandGroup::removeCommand(std::wstring_view t_phrase)
     return;
   }
 
+  if(m_cold)
+    m_cold->remove(t_phrase);
+  m_phonetic.remove(t_phrase);
+
   for(auto it = m_cmds.begin(); it != m_cmds.end(); ++it)
-    if(it->phrase().size() == t_phrase.size())
-      if(std::equal(it->phrase().begin(), it->phrase().end(), t_phrase.begin(), icase_cmp_wchar))
+    if(icase_equal(it->phrase(), t_phrase))
+    {
+      m_cmds.erase(it);
+      update_grammar();
+      return;
+    }
+
+  // templates are removed by their pattern
+  for(auto it = m_templates.begin(); it != m_templates.end(); ++it)
+    if(icase_equal(it->tpl.pattern(), t_phrase))
+    {
+      HRESULT hr = m_cpGram->ClearRule(it->hRule);
+      if(FAILED(hr))
+        throw std::runtime_error("Failed to clear template rule.\nError: " + std::to_string(hr));
+      m_templates.erase(it);
+      update_grammar();
+      return;
+    }
+}
+
+std::vector<Confusable>
+HNx::CommandGroup::edit(std::vector<std::wstring> const& t_remove,
+                        std::vector<Command> const& t_add)
+{
+  // a phrase removed and added back as it
+  //  was spelled only runs something else,
+  //  the grammar is left as it is
+  std::vector<bool> replaced(t_add.size(), false);
+  auto readded = [&](std::wstring const& t_phrase) -> Command const*
+  {
+    for(size_t i = 0; i < t_add.size(); ++i)
+      if(!replaced[i] && t_add[i].phrase() == t_phrase && !t_add[i].exec().empty())
       {
-        m_cmds.erase(it);
-        update_grammar();
-        break;
+        replaced[i] = true;
+        return &t_add[i];
+      }
+    return nullptr;
+  };
+
+  bool changed = false;
+  for(auto const& phrase : t_remove)
+  {
+    if(phrase.empty())
+      continue;
+
+    if(m_cold)
+      m_cold->remove(phrase);
+
+    auto cmd = std::find_if(m_cmds.begin(), m_cmds.end(),
+                            [&](Command const& c) { return icase_equal(c.phrase(), phrase); });
+    if(cmd != m_cmds.end())
+    {
+      if(auto again = readded(cmd->phrase()))
+      {
+        *cmd = *again;
+        continue;
+      }
+      m_phonetic.remove(phrase);
+      m_cmds.erase(cmd);
+      changed = true;
+      continue;
+    }
+    m_phonetic.remove(phrase);
+
+    auto tc = std::find_if(m_templates.begin(), m_templates.end(),
+                           [&](TemplateCommand const& t) { return icase_equal(t.tpl.pattern(), phrase); });
+    if(tc != m_templates.end())
+    {
+      HRESULT hr = m_cpGram->ClearRule(tc->hRule);
+      if(FAILED(hr))
+        throw std::runtime_error("Failed to clear template rule.\nError: " + std::to_string(hr));
+      m_templates.erase(tc);
+      changed = true;
+    }
+  }
+
+  // checked against what is left and the
+  //  adds before them
+  std::vector<Command> fresh;
+  std::vector<Confusable> confusable;
+  try
+  {
+    for(size_t i = 0; i < t_add.size(); ++i)
+    {
+      Command const& cmd = t_add[i];
+      if(replaced[i])
+        continue;
+
+      auto same = [&](Command const& c) { return icase_equal(c.phrase(), cmd.phrase()); };
+      if(cmd.phrase().empty() || std::any_of(m_cmds.begin(), m_cmds.end(), same) ||
+         std::any_of(fresh.begin(), fresh.end(), same))
+        continue;
+
+      for(auto& c : check_confusable(cmd.phrase(), cmd.action()))
+        confusable.push_back(std::move(c));
+      m_phonetic.insert(cmd.phrase());
+      fresh.push_back(cmd);
+    }
+  }
+  catch(...)
+  {
+    for(auto const& cmd : fresh)
+      m_phonetic.remove(cmd.phrase());
+    if(changed)
+      update_grammar();
+    throw;
+  }
+
+  for(auto& cmd : fresh)
+  {
+    if(m_cold)
+      m_cold->remove(cmd.phrase());
+    m_cmds.push_back(std::move(cmd));
+  }
+
+  if(changed || !fresh.empty())
+    update_grammar();
+  return confusable;
+}
+
+std::vector<Confusable>
+HNx::CommandGroup::addAliases(std::wstring_view t_phrase,
+                              std::vector<std::wstring> const& t_aliases)
+{
+  auto target = std::find_if(m_cmds.begin(), m_cmds.end(),
+                             [&](Command const& c) { return icase_equal(c.phrase(), t_phrase); });
+  if(target == m_cmds.end())
+    throw std::invalid_argument("Alias target is not a command of this group");
+  auto action = target->action();
+
+  std::vector<std::wstring> fresh;
+  for(auto const& alias : t_aliases)
+    if(!alias.empty() && std::none_of(m_cmds.begin(), m_cmds.end(),
+                                      [&](Command const& c) { return icase_equal(c.phrase(), alias); }))
+      fresh.push_back(alias);
+
+  // all checked before any is added
+  std::vector<Confusable> confusable;
+  for(auto const& alias : fresh)
+    for(auto& c : check_confusable(alias, action))
+      confusable.push_back(std::move(c));
+
+  for(auto const& alias : fresh)
+  {
+    m_cmds.emplace_back(alias, action);
+    if(m_cold)
+      m_cold->remove(alias);
+    m_phonetic.insert(alias);
+  }
+
+  if(!fresh.empty())
+    update_grammar();
+  return confusable;
+}
+
+void
+HNx::CommandGroup::removeAction(std::wstring_view t_phrase)
+{
+  auto target = std::find_if(m_cmds.begin(), m_cmds.end(),
+                             [&](Command const& c) { return icase_equal(c.phrase(), t_phrase); });
+
+  // evicted aliases keep the action's id,
+  //  find() hands back the same action
+  if(m_cold)
+  {
+    Command action = target != m_cmds.end() ? *target : m_cold->find(t_phrase);
+    if(!action.exec().empty())
+    {
+      for(auto const& phrase : m_cold->removeAction(action.action()))
+        m_phonetic.remove(phrase);
+
+      // records from before there were ids
+      if(target == m_cmds.end())
+      {
+        m_cold->remove(action.phrase());
+        m_phonetic.remove(action.phrase());
       }
+    }
+  }
+
+  if(target == m_cmds.end())
+    return;
+
+  Command doomed = *target;
+  auto first = std::remove_if(m_cmds.begin(), m_cmds.end(),
+                              [&](Command const& c) { return c.isAliasOf(doomed); });
+  for(auto it = first; it != m_cmds.end(); ++it)
+    m_phonetic.remove(it->phrase());
+  m_cmds.erase(first, m_cmds.end());
+  update_grammar();
+}
+
+void
+HNx::CommandGroup::addTemplate(PhraseTemplate t_tpl,
+                               std::wstring_view t_exec,
+                               std::wstring_view t_param)
+{
+  for(auto const& tc : m_templates)
+    if(icase_equal(tc.tpl.pattern(), t_tpl.pattern()))
+      return;
+
+  CGState lastState {CGState::Unknown};
+  if(currentState != CGState::Inactive)
+  {
+    lastState = currentState;
+    deactivate();
+  }
+
+  TemplateCommand tc;
+  tc.tpl = std::move(t_tpl);
+  tc.exec = t_exec;
+  tc.param = t_param;
+
+  HRESULT hr = build_template(tc);
+
+  // reference it from our rule like a phrase
+  SPSTATEHANDLE hInit = nullptr;
+  if(SUCCEEDED(hr))
+    hr = m_cpGram->GetRule(m_grammarName.c_str(), m_gramID, 0, false, &hInit);
+
+  if(SUCCEEDED(hr))
+    if(!m_hState)
+      hr = m_cpGram->CreateNewState(hInit, &m_hState);
+
+  if(SUCCEEDED(hr))
+    hr = m_cpGram->AddRuleTransition(hInit, m_hState, tc.hRule, 1, nullptr);
+
+  if(SUCCEEDED(hr))
+    hr = commit();
+
+  if(SUCCEEDED(hr))
+    hr = m_cpGram->SetRuleIdState(m_gramID, SPRS_ACTIVE);
+
+  if(FAILED(hr))
+    throw std::runtime_error("Grammar Disabled!\nFailed to add template to grammar.\nError: " + std::to_string(hr));
+
+  m_templates.push_back(std::move(tc));
+
+  if(lastState == CGState::Active)
+    activate();
 }
 
 std::vector<std::wstring>
@@ -199,22 +517,345 @@ HNx::CommandGroup::getWords() const
   std::vector<std::wstring> words;
   for(auto cmd : m_cmds)
     words.push_back(cmd.phrase());
+  for(auto const& tc : m_templates)
+    words.push_back(tc.tpl.pattern());
   return words;
 }
 
+std::vector<Command>
+HNx::CommandGroup::commands() const
+{
+  std::vector<Command> cmds;
+  cmds.reserve(m_cmds.size() + m_templates.size());
+  cmds.insert(cmds.end(), m_cmds.begin(), m_cmds.end());
+  for(auto const& tc : m_templates)
+    cmds.emplace_back(tc.tpl.pattern(), tc.exec, tc.param);
+  return cmds;
+}
+
 Command 
 HNx::CommandGroup::getCommandByPhrase(std::wstring_view t_phrase)
 {
-  for(auto cmd : m_cmds)
-    if(t_phrase.size() == cmd.phrase().size())
-      if(std::equal(cmd.phrase().begin(), cmd.phrase().end(), t_phrase.begin(), icase_cmp_wchar))
-        return cmd;
+  for(auto const& cmd : m_cmds)
+    if(icase_equal(cmd.phrase(), t_phrase))
+      return cmd;
+
+  std::vector<std::wstring> values;
+  for(auto const& tc : m_templates)
+    if(tc.tpl.match(t_phrase, values))
+      return Command {t_phrase,
+                      tc.tpl.substitute(tc.exec, values),
+                      tc.tpl.substitute(tc.param, values)};
   return {};
 }
 
+bool
+HNx::CommandGroup::applyUsage(UsageStats const& t_usage)
+{
+  auto now = UsageStats::clock::now();
+
+  std::vector<std::pair<double, size_t>> ranked;
+  ranked.reserve(m_cmds.size());
+  for(size_t i = 0; i < m_cmds.size(); ++i)
+    ranked.emplace_back(t_usage.score(m_cmds[i].phrase(), now), i);
+
+  // stable so unused commands keep the
+  //  order they were added in
+  std::stable_sort(ranked.begin(), ranked.end(),
+                   [](auto const& a, auto const& b) { return a.first > b.first; });
+
+  bool reweight = false;
+  std::vector<Command> ordered;
+  ordered.reserve(m_cmds.size());
+  for(auto const& r : ranked)
+  {
+    Command& cmd = m_cmds[r.second];
+
+    // log scaled and in quarter steps so small
+    //  changes in usage don't rebuild the grammar
+    float weight = 1.0f + std::round(static_cast<float>(std::log2(1.0 + r.first)) * 4.0f) / 4.0f;
+    weight = std::min(weight, MAX_USAGE_WEIGHT);
+    if(weight != cmd.weight())
+    {
+      cmd.setWeight(weight);
+      reweight = true;
+    }
+    ordered.push_back(std::move(cmd));
+  }
+  m_cmds.swap(ordered);
+
+  // eviction rebuilds the grammar itself
+  size_t before = m_cmds.size();
+  if(m_cold && m_hotBudget)
+    enforce_budget();
+
+  if(reweight && before == m_cmds.size())
+    update_grammar();
+  return reweight;
+}
+
+void
+HNx::CommandGroup::boost(std::vector<std::wstring> t_phrases,
+                         float t_factor)
+{
+  // only phrases of this group matter
+  std::vector<std::wstring> boosted;
+  for(auto const& phrase : t_phrases)
+    for(auto const& cmd : m_cmds)
+      if(icase_equal(cmd.phrase(), phrase))
+      {
+        boosted.push_back(cmd.phrase());
+        break;
+      }
+  std::sort(boosted.begin(), boosted.end());
+
+  if(boosted == m_boosted && (boosted.empty() || t_factor == m_boost))
+    return;
+
+  m_boosted.swap(boosted);
+  m_boost = t_factor;
+  update_grammar();
+}
+
+GrammarStats
+HNx::CommandGroup::stats() const
+{
+  GrammarStats stats;
+  stats.rules = 1 + m_templates.size() + (m_hCompound ? 1 : 0);
+  stats.transitions = m_cmds.size() + m_templates.size();
+  for(auto const& tc : m_templates)
+    stats.transitions += tc.tpl.transitionCount();
+  stats.lastCommit = m_lastCommit;
+  std::set<Action const*> seen;
+  for(auto const& cmd : m_cmds)
+  {
+    stats.hotBytes += phrase_bytes(cmd);
+    if(auto action = cmd.action())
+    {
+      if(seen.insert(action.get()).second)
+        stats.hotBytes += action_bytes(*action);
+      else
+        stats.aliasBytesSaved += action_bytes(*action);
+    }
+  }
+  stats.actions = seen.size();
+  stats.coldCommands = m_cold ? m_cold->size() : 0;
+  return stats;
+}
+
+void
+HNx::CommandGroup::setConfusablePolicy(ConfusablePolicy t_policy)
+{
+  m_confusablePolicy = t_policy;
+}
+
+std::vector<std::pair<std::wstring, Confusable>>
+HNx::CommandGroup::findConfusables() const
+{
+  std::vector<std::wstring> phrases;
+  phrases.reserve(m_cmds.size());
+  for(auto const& cmd : m_cmds)
+    phrases.push_back(cmd.phrase());
+  return PhoneticIndex::validate(phrases);
+}
+
+void
+HNx::CommandGroup::setColdTier(std::shared_ptr<ColdIndex> t_cold,
+                               size_t t_hotBudget)
+{
+  // commands evicted in earlier runs are
+  //  still said and still confusable
+  if(m_cold != t_cold)
+  {
+    if(m_cold)
+      for(auto const& phrase : m_cold->phrases())
+        m_phonetic.remove(phrase);
+    if(t_cold)
+      for(auto const& phrase : t_cold->phrases())
+        m_phonetic.insert(phrase);
+  }
+
+  m_cold = std::move(t_cold);
+  m_hotBudget = t_hotBudget;
+  if(m_cold && m_hotBudget)
+    enforce_budget();
+}
+
+Command
+HNx::CommandGroup::promoteCold(std::wstring_view t_text)
+{
+  if(!m_cold)
+    return {};
+
+  Command cmd = m_cold->find(t_text);
+  if(cmd.exec().empty())
+    return cmd;
+
+  // said just now so it goes in as the
+  //  hottest, the next usage pass
+  //  decides where it really belongs
+  m_cold->remove(cmd.phrase());
+  m_cmds.insert(m_cmds.begin(), cmd);
+  m_promoted = true;
+  return cmd;
+}
+
+bool
+HNx::CommandGroup::flushPromoted()
+{
+  if(!m_promoted)
+    return false;
+  update_grammar();
+  return true;
+}
+
+void
+HNx::CommandGroup::enableCompound(unsigned t_maxParts)
+{
+  if(t_maxParts < 2)
+    t_maxParts = 0;
+  if(t_maxParts == m_maxCompound)
+    return;
+
+  CGState lastState {CGState::Unknown};
+  if(currentState != CGState::Inactive)
+  {
+    lastState = currentState;
+    deactivate();
+  }
+
+  std::wstring compoundName = m_grammarName + L".Compound";
+
+  // drop the old chain, if any
+  HRESULT hr = S_OK;
+  if(m_hCompound)
+    hr = m_cpGram->ClearRule(m_hCompound);
+  m_hCompound = nullptr;
+
+  // our rule is referenced by every part
+  SPSTATEHANDLE hCmds = nullptr;
+  if(SUCCEEDED(hr))
+    hr = m_cpGram->GetRule(m_grammarName.c_str(), m_gramID, 0, false, &hCmds);
+
+  if(SUCCEEDED(hr) && t_maxParts)
+    hr = m_cpGram->GetRule(compoundName.c_str(), 0, SPRAF_TopLevel | SPRAF_Active, true, &m_hCompound);
+
+  // part -> connector -> part -> ... with an
+  //  exit to the end after the second part
+  SPSTATEHANDLE hPart = m_hCompound;
+  for(unsigned i = 0; SUCCEEDED(hr) && i < t_maxParts; ++i)
+  {
+    SPSTATEHANDLE hAfter = nullptr;
+    hr = m_cpGram->CreateNewState(m_hCompound, &hAfter);
+
+    if(SUCCEEDED(hr))
+      hr = m_cpGram->AddRuleTransition(hPart, hAfter, hCmds, 1, nullptr);
+
+    if(SUCCEEDED(hr) && i > 0)
+      hr = m_cpGram->AddWordTransition(hAfter, nullptr, nullptr, nullptr, SPWT_LEXICAL, 1, nullptr);
+
+    if(SUCCEEDED(hr) && i + 1 < t_maxParts)
+    {
+      SPSTATEHANDLE hNext = nullptr;
+      hr = m_cpGram->CreateNewState(m_hCompound, &hNext);
+      if(SUCCEEDED(hr))
+        hr = m_cpGram->AddWordTransition(hAfter, hNext, CONNECTOR_AND, nullptr, SPWT_LEXICAL, 1, nullptr);
+      if(SUCCEEDED(hr))
+        hr = m_cpGram->AddWordTransition(hAfter, hNext, CONNECTOR_THEN, nullptr, SPWT_LEXICAL, 1, nullptr);
+      hPart = hNext;
+    }
+  }
+
+  if(SUCCEEDED(hr))
+    hr = commit();
+
+  if(SUCCEEDED(hr) && t_maxParts)
+    hr = m_cpGram->SetRuleState(compoundName.c_str(), nullptr, SPRS_ACTIVE);
+
+  if(FAILED(hr))
+    throw std::runtime_error("Failed to build compound rule.\nError: " + std::to_string(hr));
+
+  m_maxCompound = t_maxParts;
+
+  if(lastState == CGState::Active)
+    activate();
+}
+
+std::vector<CompoundPart>
+HNx::CommandGroup::splitCompound(std::wstring_view t_text)
+{
+  return HNx::splitCompound(t_text,
+                            [this](std::wstring const& t_phrase) { return getCommandByPhrase(t_phrase); },
+                            m_maxCompound);
+}
+
+std::vector<CompoundPart>
+HNx::splitCompound(std::wstring_view t_text,
+                   std::function<Command(std::wstring const&)> const& t_lookup,
+                   unsigned t_maxParts)
+{
+  std::vector<std::wstring> words;
+  for(size_t pos = 0; pos < t_text.size();)
+  {
+    size_t end = t_text.find(L' ', pos);
+    if(end == std::wstring_view::npos)
+      end = t_text.size();
+    if(end > pos)
+      words.emplace_back(t_text.substr(pos, end - pos));
+    pos = end + 1;
+  }
+
+  std::vector<CompoundPart> parts;
+
+  // phrases may contain the connector words
+  //  themselves so try the longest phrase
+  //  first and back off when the rest of
+  //  the utterance doesn't split
+  std::vector<bool> deadEnd(words.size(), false);
+  std::function<bool(size_t, Connector)> split = [&](size_t t_first, Connector t_joinedBy)
+  {
+    if(deadEnd[t_first])
+      return false;
+
+    for(size_t last = words.size(); last > t_first; --last)
+    {
+      std::wstring phrase = words[t_first];
+      for(size_t i = t_first + 1; i < last; ++i)
+        phrase.append(L" ").append(words[i]);
+
+      Command cmd = t_lookup(phrase);
+      if(cmd.exec().empty())
+        continue;
+
+      parts.push_back({std::move(cmd), t_joinedBy});
+      if(last == words.size())
+        return true;
+
+      if(last + 1 < words.size())
+      {
+        if(icase_equal(words[last], CONNECTOR_AND) && split(last + 1, Connector::And))
+          return true;
+        if(icase_equal(words[last], CONNECTOR_THEN) && split(last + 1, Connector::Then))
+          return true;
+      }
+      parts.pop_back();
+    }
+
+    deadEnd[t_first] = true;
+    return false;
+  };
+
+  if(words.empty() || !split(0, Connector::None) ||
+     parts.size() < 2 || parts.size() > t_maxParts)
+    parts.clear();
+  return parts;
+}
+
 void
 HNx::CommandGroup::update_grammar()
 {
+  m_promoted = false;
+
   // stop grammar so we don't have unwanted
   //   recognitions if active
   CGState lastState {CGState::Unknown};
@@ -251,8 +892,19 @@ HNx::CommandGroup::update_grammar()
                                          cmd.phrase().c_str(),
                                          nullptr,
                                          SPWT_LEXICAL,
-                                         1,
+                                         weight_of(cmd),
                                          nullptr);
+
+  // template sub-rules are kept, only
+  //  the references to them are re-added
+  if(SUCCEEDED(hr))
+    for(auto const& tc : m_templates)
+      if(SUCCEEDED(hr))
+        hr = m_cpGram->AddRuleTransition(hInit, m_hState, tc.hRule, 1, nullptr);
+  // save our changes
+  if(SUCCEEDED(hr))
+    hr = commit();
+
   // activate rule state
   if(SUCCEEDED(hr))
     hr = m_cpGram->SetRuleIdState(m_gramID, SPRS_ACTIVE);
@@ -265,6 +917,134 @@ HNx::CommandGroup::update_grammar()
     activate();
 }
 
+HRESULT
+HNx::CommandGroup::build_template(TemplateCommand& t_tc)
+{
+  std::wstring ruleName = m_grammarName + L".Template" + std::to_wstring(m_nextTemplate++);
+
+  SPSTATEHANDLE hRule = nullptr;
+  HRESULT hr = m_cpGram->GetRule(ruleName.c_str(), 0, SPRAF_Dynamic, true, &hRule);
+
+  // one state per part, the last
+  //  part goes to the end of the rule
+  auto const& parts = t_tc.tpl.parts();
+  SPSTATEHANDLE hFrom = hRule;
+  for(size_t i = 0; SUCCEEDED(hr) && i < parts.size(); ++i)
+  {
+    SPSTATEHANDLE hTo = nullptr;
+    if(i + 1 < parts.size())
+      hr = m_cpGram->CreateNewState(hRule, &hTo);
+
+    if(FAILED(hr))
+      break;
+
+    if(parts[i].slot < 0)
+    {
+      hr = m_cpGram->AddWordTransition(hFrom, hTo, parts[i].words.c_str(), L" ", SPWT_LEXICAL, 1, nullptr);
+    }
+    else
+    {
+      auto const& slot = t_tc.tpl.slots()[parts[i].slot];
+      switch(slot.type)
+      {
+        case SlotType::Number:
+        for(int v = slot.min; SUCCEEDED(hr) && v <= slot.max; ++v)
+          hr = m_cpGram->AddWordTransition(hFrom, hTo, numberToWords(v).c_str(), L" ", SPWT_LEXICAL, 1, nullptr);
+        break;
+
+        case SlotType::Choice:
+        for(auto const& choice : slot.choices)
+          if(SUCCEEDED(hr))
+            hr = m_cpGram->AddWordTransition(hFrom, hTo, choice.c_str(), L" ", SPWT_LEXICAL, 1, nullptr);
+        break;
+
+        case SlotType::FreeText:
+        hr = m_cpGram->AddRuleTransition(hFrom, hTo, SPRULETRANS_DICTATION, 1, nullptr);
+        break;
+      }
+    }
+    hFrom = hTo;
+  }
+
+  t_tc.hRule = hRule;
+  return hr;
+}
+
+HRESULT
+HNx::CommandGroup::commit()
+{
+  auto start = std::chrono::steady_clock::now();
+  HRESULT hr = m_cpGram->Commit(0);
+  m_lastCommit = std::chrono::steady_clock::now() - start;
+  commit_seconds().record(m_lastCommit);
+  if(FAILED(hr))
+    commit_failures().add();
+  return hr;
+}
 
+std::vector<Confusable>
+HNx::CommandGroup::check_confusable(std::wstring_view t_phrase,
+                                   std::shared_ptr<Action> const& t_action) const
+{
+  if(m_confusablePolicy == ConfusablePolicy::Ignore)
+    return {};
 
+  auto found = m_phonetic.nearest(t_phrase);
+  found.erase(std::remove_if(found.begin(), found.end(),
+                             [&](Confusable const& c)
+                             {
+                               return std::any_of(m_cmds.begin(), m_cmds.end(),
+                                                  [&](Command const& cmd)
+                                                  { return cmd.action() == t_action && icase_equal(cmd.phrase(), c.phrase); });
+                             }),
+              found.end());
 
+  if(!found.empty() && m_confusablePolicy == ConfusablePolicy::Reject)
+    throw std::invalid_argument("\"" + to_utf8(t_phrase) + "\" sounds like \"" + to_utf8(found.front().phrase) + "\"");
+  return found;
+}
+
+void
+HNx::CommandGroup::enforce_budget()
+{
+  std::vector<Command> kept;
+  std::vector<Command> evicted;
+  std::set<Action const*> seen;
+  size_t used = 0;
+  for(auto& cmd : m_cmds)
+  {
+    // an action is paid for by its first alias
+    used += phrase_bytes(cmd);
+    if(auto action = cmd.action())
+      if(seen.insert(action.get()).second)
+        used += action_bytes(*action);
+
+    // macros have no on-disk form
+    if(used <= m_hotBudget || cmd.isMacro())
+      kept.push_back(std::move(cmd));
+    else
+      evicted.push_back(std::move(cmd));
+  }
+  m_cmds.swap(kept);
+
+  if(evicted.empty())
+    return;
+
+  for(auto const& cmd : evicted)
+    m_cold->insert(cmd);
+
+  // lets compact() forget the actions
+  //  that were only held here
+  evicted.clear();
+  m_cold->compact();
+  update_grammar();
+}
+
+float
+HNx::CommandGroup::weight_of(Command const& t_cmd) const
+{
+  for(auto const& phrase : m_boosted)
+    if(phrase == t_cmd.phrase())
+      return t_cmd.weight() * m_boost;
+  return t_cmd.weight();
+}
@@ -1,10 +1,17 @@
 #pragma once
+#include "ColdIndex.h"
 #include "Command.h"
+#include "PhoneticIndex.h"
+#include "PhraseTemplate.h"
+#include "UsageStats.h"
 
 #include <Windows.h>
 #include <sapi.h>
 #include <atlcomcli.h>
 
+#include <chrono>
+#include <functional>
+#include <memory>
 #include <string_view>
 #include <vector>
 
@@ -21,6 +28,72 @@ enum class CmdGroupState
   Inactive
 };
 
+// how one command of a compound utterance
+//  is joined to the ones spoken before it
+enum class Connector
+{
+  None,   // first command of the utterance
+  And,    // runs alongside the previous command
+  Then    // runs after every earlier command
+};
+
+// what adding a phrase that sounds like
+//  one already in the group does
+enum class ConfusablePolicy
+{
+  Ignore,
+  Warn,     // added, the look-alikes are returned
+  Reject    // std::invalid_argument is thrown
+};
+
+struct CompoundPart
+{
+  Command cmd {};
+  Connector joinedBy {Connector::None};
+};
+
+// a templated phrase and the exec/param
+//  its slot values are substituted into
+struct TemplateCommand
+{
+  PhraseTemplate tpl {};
+  std::wstring exec {};
+  std::wstring param {};
+
+  // sub-rule referenced from our rule
+  SPSTATEHANDLE hRule {nullptr};
+};
+
+// size of the grammar and what the
+//  last commit of it cost
+struct GrammarStats
+{
+  size_t rules {0};
+  size_t transitions {0};
+  std::chrono::steady_clock::duration lastCommit {};
+
+  // memory held by the commands in the
+  //  grammar and how many were evicted
+  size_t hotBytes {0};
+  size_t coldCommands {0};
+
+  // distinct actions behind the commands and
+  //  the bytes sharing them between aliases
+  //  saves over a copy per phrase
+  size_t actions {0};
+  size_t aliasBytesSaved {0};
+};
+
+
+// splits a compound utterance into 2 to
+//  t_maxParts commands, each part found by
+//  t_lookup, a command without an exec for
+//  none; empty unless every part is one
+std::vector<CompoundPart>
+  splitCompound(std::wstring_view t_text,
+                std::function<Command(std::wstring const&)> const& t_lookup,
+                unsigned t_maxParts);
+
 
 class CommandGroup
 {
@@ -55,7 +128,9 @@ public:
   // Adds a command to the grammar
   //  and immediately starts recognizing
   //  it
-  void
+  // returns the phrases it may be confused
+  //  with, see setConfusablePolicy()
+  std::vector<Confusable>
     addCommand(Command const& t_cmd);
 
   //  Removes command from grammar
@@ -64,16 +139,131 @@ public:
   void
     removeCommand(std::wstring_view t_phrase);
 
+  // more phrases for the action of t_phrase,
+  //  one grammar update for all of them
+  // throws std::invalid_argument if t_phrase
+  //  isn't a command of this group
+  // aliases sounding like each other is fine,
+  //  sounding like another action is not
+  std::vector<Confusable>
+    addAliases(std::wstring_view t_phrase,
+               std::vector<std::wstring> const& t_aliases);
+
+  // removes t_remove's phrases then adds
+  //  t_add's commands, one grammar update
+  //  for all of them; phrases added that are
+  //  already in the group are skipped
+  // a phrase both removed and added, spelled
+  //  the same, only has what it runs replaced
+  //  and needs no grammar update
+  // under ConfusablePolicy::Reject the
+  //  removals are kept when an add throws
+  std::vector<Confusable>
+    edit(std::vector<std::wstring> const& t_remove,
+         std::vector<Command> const& t_add);
+
+  // removes t_phrase and every alias of
+  //  it with one grammar update
+  void
+    removeAction(std::wstring_view t_phrase);
+
   // returns vector of just the
   //  phrases in this group
   std::vector<std::wstring>
     getWords() const;
 
+  // the commands in the grammar, copies
+  //  sharing their actions, templates as
+  //  their pattern, evicted ones left out
+  std::vector<Command>
+    commands() const;
+
+  // Adds a phrase template as one sub-rule
+  //  of the grammar, {name} in exec and
+  //  param is replaced by what was said
+  // removed with removeCommand(pattern)
+  void
+    addTemplate(PhraseTemplate t_tpl,
+                std::wstring_view t_exec,
+                std::wstring_view t_param = L"");
+
   // for linking a recog event to
-  //  a command for execution
+  //  a command for execution, templates
+  //  give a command with slots filled in
   Command
     getCommandByPhrase(std::wstring_view t_phrase);
 
+  // puts the most used commands first for
+  //  lookups and weights their phrases in
+  //  the grammar by usage, returns true if
+  //  the weights changed and the grammar
+  //  was rebuilt
+  bool
+    applyUsage(UsageStats const& t_usage);
+
+  // multiplies the weight of just these
+  //  phrases by t_factor until the next
+  //  call, rebuilds the grammar if the
+  //  boosted set changed
+  void
+    boost(std::vector<std::wstring> t_phrases,
+          float t_factor);
+
+  GrammarStats
+    stats() const;
+
+  // checked against every phrase added
+  //  since, defaults to Warn
+  void
+    setConfusablePolicy(ConfusablePolicy t_policy);
+
+  // every pair of commands in the group
+  //  that sound alike
+  std::vector<std::pair<std::wstring, Confusable>>
+    findConfusables() const;
+
+  // keeps only as many of the most used
+  //  commands in the grammar as fit in
+  //  t_hotBudget bytes, the rest go to
+  //  t_cold until they are said again
+  // nullptr or a budget of 0 keeps
+  //  everything in the grammar
+  void
+    setColdTier(std::shared_ptr<ColdIndex> t_cold,
+                size_t t_hotBudget);
+
+  // second pass for text the grammar didn't
+  //  match, an evicted command is moved back
+  //  into the group and returned
+  // the grammar isn't rebuilt, that waits
+  //  for flushPromoted()
+  Command
+    promoteCold(std::wstring_view t_text);
+
+  // rebuilds the grammar for commands
+  //  promoteCold() moved back, meant for
+  //  when no one is speaking
+  // returns whether there were any
+  bool
+    flushPromoted();
+
+  // lets a single utterance hold up to
+  //  t_maxParts commands joined by "and"
+  //  or "then", below 2 removes the rule
+  // the rule only chains this group's own
+  //  phrases, SAPI can't reference another
+  //  grammar's rules; a context's commands
+  //  mixed with global ones are only heard
+  //  through dictation
+  void
+    enableCompound(unsigned t_maxParts);
+
+  // splits a compound utterance back into
+  //  its commands, empty unless every part
+  //  is a command in this group
+  std::vector<CompoundPart>
+    splitCompound(std::wstring_view t_text);
+
 private: // vars
   // recogrammar containin a single rule
   //   for all words in the group
@@ -86,14 +276,61 @@ private: // vars
 
   std::vector<Command> m_cmds {};
 
+  std::vector<TemplateCommand> m_templates {};
+  unsigned m_nextTemplate {0};
+
   // state for adding words to the rule
   SPSTATEHANDLE m_hState {nullptr};
 
+  // second top level rule chaining references
+  //  to our rule with connector words
+  SPSTATEHANDLE m_hCompound {nullptr};
+  unsigned m_maxCompound {0};
+
   CGState currentState {CGState::Unknown};
 
+  std::chrono::steady_clock::duration m_lastCommit {};
+
+  // temporarily favoured phrases
+  std::vector<std::wstring> m_boosted {};
+  float m_boost {1.0f};
+
+  // phonetic keys of every phrase, hot or cold
+  PhoneticIndex m_phonetic {};
+  ConfusablePolicy m_confusablePolicy {ConfusablePolicy::Warn};
+
+  // evicted commands and the budget
+  //  of the ones kept in the grammar
+  std::shared_ptr<ColdIndex> m_cold {};
+  size_t m_hotBudget {0};
+
+  // m_cmds holds commands the grammar
+  //  doesn't have yet
+  bool m_promoted {false};
+
 private: // functions
   // syncs the grammar and m_cmds
   void update_grammar();
+
+  // fills a template's sub-rule
+  HRESULT build_template(TemplateCommand& t_tc);
+
+  // timed Commit()
+  HRESULT commit();
+
+  // usage weight times any boost
+  float weight_of(Command const& t_cmd) const;
+
+  // look-alikes of t_phrase that aren't
+  //  aliases of t_action, throws under
+  //  the Reject policy
+  std::vector<Confusable> check_confusable(std::wstring_view t_phrase,
+                                           std::shared_ptr<Action> const& t_action) const;
+
+  // moves the commands past the hot budget
+  //  to the cold tier, m_cmds must already
+  //  be ordered most used first
+  void enforce_budget();
 };
 }
 
@@ -0,0 +1,665 @@
+#include "Daemon.h"
+#include "Keyword.h"
+#include "MetricsServer.h"
+#include "ProcessInfo.h"
+#include "Profile.h"
+#include "SingleInstance.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <stdexcept>
+
+//=================================//
+// HNx Voice Command Daemon        //
+//=================================//
+// One recognizer, many clients    //
+//  over shared memory             //
+//=================================//
+
+using namespace HNx;
+
+namespace
+{
+// off is 0, nothing if it is neither
+std::optional<uint16_t>
+metricsPort(std::wstring const& t_value)
+{
+  if(t_value == L"off")
+    return 0;
+  wchar_t* end = nullptr;
+  unsigned long port = std::wcstoul(t_value.c_str(), &end, 10);
+  if(t_value.empty() || *end || port > 65535)
+    return std::nullopt;
+  return static_cast<uint16_t>(port);
+}
+}
+
+DaemonConfig
+HNx::loadDaemonConfig(std::wstring const& t_path)
+{
+  std::filesystem::path path(t_path);
+  std::ifstream in(path, std::ios::binary);
+  if(!in)
+    throw std::runtime_error("Failed to open the daemon's config.");
+
+  auto relative = [&](std::wstring const& t_value)
+  {
+    std::filesystem::path value(t_value);
+    return t_value.empty() || value.is_absolute() ? t_value : (path.parent_path() / value).wstring();
+  };
+
+  DaemonConfig config;
+  std::string line;
+  for(size_t number = 1; std::getline(in, line); ++number)
+  {
+    if(!line.empty() && line.back() == '\r')
+      line.pop_back();
+    std::wstring text = trim_whitespace(from_utf8(line));
+    if(text.empty() || text[0] == L'#')
+      continue;
+
+    size_t eq = text.find(L'=');
+    std::wstring key = trim_whitespace(text.substr(0, eq));
+    std::wstring value = eq == std::wstring::npos ? std::wstring {} : trim_whitespace(text.substr(eq + 1));
+    auto bad = [&](char const* t_what)
+    {
+      return std::invalid_argument(std::string(t_what) + " on line " + std::to_string(number) + " of the daemon's config");
+    };
+    if(eq == std::wstring::npos)
+      throw bad("Missing =");
+
+    if(key == L"name")
+      config.name = value;
+    else if(key == L"hotword")
+      config.hotword = value;
+    else if(key == L"spotter")
+    {
+      if(value != L"on" && value != L"off")
+        throw bad("Spotter must be on or off");
+      config.spotter = value == L"on";
+    }
+    else if(key == L"hotword_examples")
+    {
+      // recordings are only worth naming
+      //  for the spotter
+      config.hotwordExamples = relative(value);
+      config.spotter = config.spotter || !value.empty();
+    }
+    else if(key == L"commands")
+      config.commands = relative(value);
+    else if(key == L"usage")
+      config.usage = relative(value);
+    else if(key == L"context")
+      config.context = value;
+    else if(key == L"confusables")
+    {
+      if(value == L"ignore")
+        config.confusables = ConfusablePolicy::Ignore;
+      else if(value == L"warn")
+        config.confusables = ConfusablePolicy::Warn;
+      else if(value == L"reject")
+        config.confusables = ConfusablePolicy::Reject;
+      else
+        throw bad("Confusables must be ignore, warn or reject");
+    }
+    else if(key == L"prediction")
+    {
+      if(value != L"on" && value != L"off")
+        throw bad("Prediction must be on or off");
+      config.prediction = value == L"on";
+    }
+    else if(key == L"watch")
+    {
+      if(value != L"on" && value != L"off")
+        throw bad("Watch must be on or off");
+      config.watch = value == L"on";
+    }
+    else if(key == L"metrics")
+    {
+      auto port = metricsPort(value);
+      if(!port)
+        throw bad("Metrics must be off or a port");
+      config.metrics = *port;
+    }
+    else
+      throw bad("Unknown key");
+  }
+
+  if(config.name.empty() || config.hotword.empty())
+    throw std::invalid_argument("The daemon's config needs a name and a hotword");
+  return config;
+}
+
+HNx::Daemon::Daemon(Recog& t_recog, std::wstring const& t_name)
+  : m_recog(t_recog)
+  , m_server(t_name)
+{
+  m_stopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+  if(!m_stopEvent)
+    throw std::runtime_error("Failed to create the daemon's stop event.\nError: " + std::to_string(GetLastError()));
+}
+
+HNx::Daemon::~Daemon()
+{
+  if(m_stopEvent)
+    CloseHandle(m_stopEvent);
+}
+
+void
+HNx::Daemon::watchCommands(std::wstring const& t_path,
+                           std::vector<ProfileEntry> t_loaded)
+{
+  m_watch = std::make_unique<FileWatch>(t_path);
+  m_commands = t_path;
+  m_loaded = std::move(t_loaded);
+}
+
+void
+HNx::Daemon::run()
+{
+  std::vector<HANDLE> handles {m_stopEvent, m_server.requestHandle()};
+  if(m_watch)
+    handles.push_back(m_watch->handle());
+  for(HANDLE h : m_recog.startEvents())
+    handles.push_back(h);
+
+  while(true)
+  {
+    // woken or not, poll() checks the
+    //  listening timeout
+    if(m_server.armWait())
+    {
+      DWORD timeout = m_watch ? std::min<DWORD>(1000, m_watch->timeout()) : 1000;
+      if(WaitForMultipleObjects(static_cast<DWORD>(handles.size()), handles.data(), FALSE, timeout) == WAIT_OBJECT_0)
+        break;
+    }
+    else if(WaitForSingleObject(m_stopEvent, 0) == WAIT_OBJECT_0)
+      break;
+
+    m_server.receive([this](IpcView const& t_request) { apply(t_request); });
+
+    if(m_watch)
+    {
+      if(WaitForSingleObject(m_watch->handle(), 0) == WAIT_OBJECT_0)
+        m_watch->changed();
+      if(m_watch->settled())
+        reload();
+    }
+
+    for(auto const& cmd : m_recog.poll())
+    {
+      m_recognized.fetch_add(1, std::memory_order_relaxed);
+      try
+      {
+        m_server.publish(IpcType::Recognized, {to_utf8(cmd.phrase()), to_utf8(cmd.exec()), to_utf8(cmd.param())});
+      }
+      catch(std::invalid_argument const& e)
+      {
+        m_server.publish(IpcType::Error, {e.what(), to_utf8(cmd.phrase())});
+      }
+    }
+  }
+}
+
+void
+HNx::Daemon::stop()
+{
+  SetEvent(m_stopEvent);
+}
+
+DaemonStats
+HNx::Daemon::stats() const
+{
+  return {m_requests.load(std::memory_order_relaxed),
+          m_failed.load(std::memory_order_relaxed),
+          m_recognized.load(std::memory_order_relaxed),
+          m_server.clients(),
+          m_reloads.load(std::memory_order_relaxed)};
+}
+
+void
+HNx::Daemon::apply(IpcView const& t_request)
+{
+  m_requests.fetch_add(1, std::memory_order_relaxed);
+  try
+  {
+    switch(t_request.type())
+    {
+      case IpcType::AddCommand:
+        if(t_request.field(0).empty() || t_request.field(1).empty())
+          throw std::invalid_argument("A command needs a phrase and an exec");
+        m_recog.addCommand(t_request.wfield(0), t_request.wfield(1), t_request.wfield(2), t_request.wfield(3));
+        break;
+
+      case IpcType::RemoveCommand:
+        m_recog.removeCommandByPhrase(t_request.wfield(0));
+        break;
+
+      case IpcType::SetContext:
+        m_recog.setContext(t_request.wfield(0));
+        break;
+
+      case IpcType::Ping:
+        m_server.publish(IpcType::Pong, {t_request.field(0)}, t_request.sender(), t_request.stamp());
+        break;
+
+      // the file is the daemon's to write,
+      //  relative to where it runs
+      case IpcType::Trace:
+        if(t_request.field(0) == "on" || t_request.field(0) == "off")
+          Trace::enable(t_request.field(0) == "on");
+        else if(t_request.field(0).empty())
+          throw std::invalid_argument("Trace needs on, off or a file");
+        else
+          Trace::dump(t_request.wfield(0));
+        break;
+
+      default:
+        throw std::invalid_argument("Unknown request " + std::to_string(static_cast<uint32_t>(t_request.type())));
+    }
+  }
+  catch(std::exception const& e)
+  {
+    m_failed.fetch_add(1, std::memory_order_relaxed);
+    m_server.publish(IpcType::Error, {e.what(), t_request.field(0)}, t_request.sender());
+  }
+}
+
+void
+HNx::Daemon::reload()
+{
+  auto start = std::chrono::steady_clock::now();
+  std::vector<ProfileEntry> next;
+  try
+  {
+    next = loadProfiles(m_commands);
+  }
+  catch(std::exception const& e)
+  {
+    // tried again on the next change
+    std::cerr << e.what() << " Keeping the commands loaded.\n";
+    return;
+  }
+  ProfileDiff diff = diffProfiles(m_loaded, next);
+
+  // per context, one grammar update each
+  struct Edit
+  {
+    std::vector<std::wstring> remove {};
+    std::vector<Command> add {};
+  };
+  std::map<std::wstring, Edit> edits;
+  auto contextOf = [](ProfileEntry const& t_entry)
+  {
+    return lower_key(t_entry.context);
+  };
+
+  // what a client replaced since isn't
+  //  the file's to remove
+  for(auto const& entry : diff.removed)
+  {
+    Command cmd = m_recog.command(entry.phrase, entry.context);
+    if(cmd.exec() == entry.exec && cmd.param() == entry.param)
+      edits[contextOf(entry)].remove.push_back(entry.phrase);
+  }
+  for(auto const& entry : diff.added)
+    edits[contextOf(entry)].add.emplace_back(entry.phrase, entry.exec, entry.param);
+
+  for(auto const& edit : edits)
+  {
+    try
+    {
+      m_recog.editContext(edit.first, edit.second.remove, edit.second.add);
+    }
+    catch(std::exception const& e)
+    {
+      m_failed.fetch_add(1, std::memory_order_relaxed);
+      m_server.publish(IpcType::Error, {e.what(), to_utf8(m_commands)});
+    }
+  }
+  m_loaded = std::move(next);
+  m_reloads.fetch_add(1, std::memory_order_relaxed);
+
+  auto took = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+  std::cerr << "reloaded " << to_utf8(m_commands) << ": " << diff.removed.size() << " removed, "
+            << diff.added.size() << " added in " << std::fixed << std::setprecision(1) << took.count() << " ms\n";
+}
+
+//=========================================================================
+//  Command line
+//=========================================================================
+
+namespace
+{
+
+std::wstring
+option(std::vector<std::wstring> const& t_args,
+       std::wstring_view t_name,
+       std::wstring t_default = {})
+{
+  for(size_t i = 0; i + 1 < t_args.size(); ++i)
+    if(t_args[i] == t_name)
+      return t_args[i + 1];
+  return t_default;
+}
+
+// the words after t_flag up to the next
+//  option
+std::vector<std::wstring>
+operands(std::vector<std::wstring> const& t_args, std::wstring_view t_flag)
+{
+  auto at = std::find(t_args.begin(), t_args.end(), t_flag);
+  std::vector<std::wstring> words;
+  if(at != t_args.end())
+    for(++at; at != t_args.end() && at->rfind(L"--", 0) != 0; ++at)
+      words.push_back(*at);
+  return words;
+}
+
+std::atomic<Daemon*> s_daemon {nullptr};
+
+BOOL WINAPI
+onConsoleCtrl(DWORD)
+{
+  if(Daemon* daemon = s_daemon.load())
+  {
+    daemon->stop();
+    return TRUE;
+  }
+  return FALSE;
+}
+
+char const*
+typeName(IpcType t_type)
+{
+  switch(t_type)
+  {
+    case IpcType::Recognized: return "recognized";
+    case IpcType::Pong:       return "pong";
+    case IpcType::Error:      return "error";
+    default:                  return "unknown";
+  }
+}
+
+}
+
+int
+HNx::runDaemonCli(std::vector<std::wstring> const& t_args)
+{
+  // the microphone is ours alone
+  if(!isSingleInstance())
+  {
+    std::cerr << "Voice Command is already running\n";
+    return 1;
+  }
+
+  try
+  {
+    DaemonConfig config;
+    std::wstring file = option(t_args, L"--config");
+    if(!file.empty())
+      config = loadDaemonConfig(file);
+    config.commands = option(t_args, L"--commands", config.commands);
+    config.hotword = option(t_args, L"--hotword", config.hotword);
+    config.name = option(t_args, L"--name", config.name);
+    config.hotwordExamples = option(t_args, L"--hotword-examples", config.hotwordExamples);
+    if(!config.hotwordExamples.empty() || std::find(t_args.begin(), t_args.end(), L"--spotter") != t_args.end())
+      config.spotter = true;
+    if(std::find(t_args.begin(), t_args.end(), L"--watch") != t_args.end())
+      config.watch = true;
+    if(std::find(t_args.begin(), t_args.end(), L"--trace") != t_args.end())
+      Trace::enable(true);
+    std::wstring port = option(t_args, L"--metrics");
+    if(!port.empty())
+    {
+      auto parsed = metricsPort(port);
+      if(!parsed)
+        throw std::invalid_argument("--metrics takes off or a port");
+      config.metrics = *parsed;
+    }
+
+    // nobody is there to close a message box
+    Recog recog(config.hotword);
+    if(!recog.initialize(true, true))
+    {
+      std::cerr << to_utf8(recog.lastError()) << "\n";
+      return 2;
+    }
+    recog.setConfusablePolicy(config.confusables);
+    recog.setPredictionBias(config.prediction);
+    std::vector<ProfileEntry> loaded;
+    if(!config.commands.empty())
+      loaded = loadProfiles(config.commands);
+    for(auto const& c : loaded)
+      recog.addCommand(c.phrase, c.exec, c.param, c.context);
+    if(!config.usage.empty())
+      recog.setUsageFile(config.usage);
+    recog.setContext(config.context);
+
+    // before the daemon starts the microphone
+    if(config.spotter)
+    {
+      std::vector<std::vector<int16_t>> examples;
+      if(!config.hotwordExamples.empty())
+        examples = readKeywordExamples(config.hotwordExamples);
+      if(examples.empty())
+        std::cerr << "no hotword recordings, enrolling the installed voices\n";
+      recog.enrollHotword(std::move(examples));
+    }
+
+    Daemon daemon(recog, config.name);
+    if(config.watch && !config.commands.empty())
+      daemon.watchCommands(config.commands, std::move(loaded));
+    if(std::find(t_args.begin(), t_args.end(), L"--startup-report") != t_args.end())
+    {
+      std::cout << std::fixed << std::setprecision(1) << processReport() << "\n";
+      return 0;
+    }
+
+    s_daemon = &daemon;
+    SetConsoleCtrlHandler(onConsoleCtrl, TRUE);
+    std::cerr << "serving " << to_utf8(config.name) << ", Ctrl+C stops\n";
+
+    std::unique_ptr<MetricsServer> metrics;
+    if(config.metrics)
+    {
+      metrics = std::make_unique<MetricsServer>(config.metrics);
+      std::cerr << "metrics on http://127.0.0.1:" << metrics->port() << "/metrics\n";
+    }
+
+    daemon.run();
+
+    SetConsoleCtrlHandler(onConsoleCtrl, FALSE);
+    s_daemon = nullptr;
+
+    DaemonStats stats = daemon.stats();
+    std::cerr << stats.requests << " requests, " << stats.failed << " failed, "
+              << stats.recognized << " commands recognized\n";
+    if(stats.reloads)
+      std::cerr << stats.reloads << " reloads of " << to_utf8(config.commands) << "\n";
+  }
+  catch(std::exception const& e)
+  {
+    s_daemon = nullptr;
+    std::cerr << e.what() << "\n";
+    return 2;
+  }
+  return 0;
+}
+
+int
+HNx::runSendCli(std::vector<std::wstring> const& t_args)
+{
+  std::vector<std::string> words;
+  for(auto const& w : operands(t_args, L"--send"))
+    words.push_back(to_utf8(w));
+
+  IpcType type {};
+  if(words.size() >= 3 && words.size() <= 5 && words[0] == "add")
+    type = IpcType::AddCommand;
+  else if(words.size() == 2 && words[0] == "remove")
+    type = IpcType::RemoveCommand;
+  else if(words.size() <= 2 && !words.empty() && words[0] == "context")
+    type = IpcType::SetContext;
+  else if(words.size() == 2 && words[0] == "trace")
+    type = IpcType::Trace;
+  else
+  {
+    std::cerr << "usage: --send add <phrase> <exec> [<param> [<context>]] | remove <phrase> | context [<context>] | trace on|off|<file> [--name <name>]\n";
+    return 1;
+  }
+
+  // fields past the ones given are empty
+  words.resize(5);
+
+  try
+  {
+    IpcClient client(option(t_args, L"--name", IpcDefaultName));
+
+    // requests are applied in order, the
+    //  ping's answer means ours was too
+    uint64_t stamp = ipcNow();
+    auto retry = [](auto&& t_send)
+    {
+      for(int tries = 0; !t_send(); ++tries)
+      {
+        if(tries == 100)
+          throw std::runtime_error("The daemon isn't taking requests");
+        Sleep(10);
+      }
+    };
+    retry([&] { return client.send(type, {words[1], words[2], words[3], words[4]}); });
+    retry([&] { return client.send(IpcType::Ping, {}, stamp); });
+
+    std::string error;
+    bool answered = false;
+    while(!answered)
+    {
+      if(!client.wait(std::chrono::seconds(5)) && !client.connected())
+        throw std::runtime_error("The daemon went away");
+      client.receive([&](IpcView const& t_event)
+      {
+        if(t_event.sender() != client.id())
+          return;
+        if(t_event.type() == IpcType::Error)
+          error = t_event.field(0);
+        else if(t_event.type() == IpcType::Pong && t_event.stamp() == stamp)
+          answered = true;
+      });
+    }
+
+    if(!error.empty())
+    {
+      std::cerr << error << "\n";
+      return 2;
+    }
+  }
+  catch(std::exception const& e)
+  {
+    std::cerr << e.what() << "\n";
+    return 2;
+  }
+  return 0;
+}
+
+int
+HNx::runListenCli(std::vector<std::wstring> const& t_args)
+{
+  try
+  {
+    IpcClient client(option(t_args, L"--name", IpcDefaultName));
+    uint64_t lost = 0;
+    while(client.connected())
+    {
+      client.wait(std::chrono::seconds(1));
+      client.receive([](IpcView const& t_event)
+      {
+        std::cout << typeName(t_event.type());
+        for(size_t i = 0; !t_event.field(i).empty(); ++i)
+          std::cout << '\t' << t_event.field(i);
+        std::cout << std::endl;
+      });
+      if(client.lost() != lost)
+      {
+        std::cerr << client.lost() - lost << " events lost\n";
+        lost = client.lost();
+      }
+    }
+  }
+  catch(std::exception const& e)
+  {
+    std::cerr << e.what() << "\n";
+    return 2;
+  }
+  return 0;
+}
+
+int
+HNx::runIpcBenchCli(std::vector<std::wstring> const& t_args)
+{
+  size_t count = std::max<size_t>(1, std::wcstoul(option(t_args, L"--count", L"100000").c_str(), nullptr, 10));
+
+  try
+  {
+    IpcClient client(option(t_args, L"--name", IpcDefaultName));
+    auto awaitPongs = [&](size_t t_pongs, std::vector<uint64_t>* t_latency)
+    {
+      size_t seen = 0;
+      client.receive([&](IpcView const& t_event)
+      {
+        if(t_event.type() != IpcType::Pong || t_event.sender() != client.id())
+          return;
+        ++seen;
+        if(t_latency)
+          t_latency->push_back(ipcNow() - t_event.stamp());
+      });
+      if(seen < t_pongs && !client.wait(std::chrono::seconds(5)) && !client.connected())
+        throw std::runtime_error("The daemon went away");
+      return seen;
+    };
+
+    // one at a time, the daemon and this
+    //  process both asleep in between
+    std::vector<uint64_t> latency;
+    latency.reserve(count);
+    for(size_t i = 0; i < count; ++i)
+    {
+      while(!client.send(IpcType::Ping, {"bench"}))
+        awaitPongs(0, nullptr);
+      for(size_t seen = 0; seen < 1; )
+        seen += awaitPongs(1 - seen, &latency);
+    }
+    std::sort(latency.begin(), latency.end());
+    auto at = [&](double t_q) { return latency[std::min(latency.size() - 1, static_cast<size_t>(t_q * latency.size()))] / 1000.0; };
+
+    // as many in flight as the rings hold
+    auto start = ipcNow();
+    size_t sent = 0;
+    size_t answered = 0;
+    while(answered < count)
+    {
+      while(sent < count && sent - answered < IpcSlots / 2 && client.send(IpcType::Ping, {"bench"}))
+        ++sent;
+      answered += awaitPongs(sent - answered, nullptr);
+    }
+    double seconds = static_cast<double>(ipcNow() - start) / 1e9;
+
+    std::cout << std::fixed << std::setprecision(1)
+              << "round trip us\tp50 " << at(0.5) << "\tp99 " << at(0.99) << "\tp99.9 " << at(0.999) << "\n"
+              << "pipelined\t" << std::setprecision(0) << count / seconds << " round trips/s\n"
+              << "lost events\t" << client.lost() << "\n";
+  }
+  catch(std::exception const& e)
+  {
+    std::cerr << e.what() << "\n";
+    return 2;
+  }
+  return 0;
+}
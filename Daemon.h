@@ -0,0 +1,199 @@
+#pragma once
+#include "Recog.hpp"
+#include "FileWatch.h"
+#include "Profile.h"
+#include "ipcsm.hpp"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+//   The recognizer as a service: one process
+//  owns the microphone and SAPI, any number
+//  of UIs and scripts add commands and
+//  follow what is heard over ipcsm.hpp's
+//  shared memory rings
+//
+//  Requests are applied between recognition
+//  events on the thread that initialized the
+//  recognizer, SAPI's objects belong to it.
+//  A client's request is applied before any
+//  it sends after it
+
+namespace HNx
+{
+
+// the daemon's settings, a UTF-8 file of
+//  key = value lines, # starts a comment:
+//
+//    name = HNxVoiceCommand
+//    hotword = computer
+//    spotter = on | off
+//    hotword_examples = hotword
+//    commands = commands.txt
+//    usage = usage.dat
+//    context = browser
+//    confusables = ignore | warn | reject
+//    prediction = on | off
+//    watch = on | off
+//    metrics = 9464 | off
+//
+//  relative paths are taken from the file's
+//  own directory
+struct DaemonConfig
+{
+  std::wstring name {IpcDefaultName};
+  std::wstring hotword {L"computer"};
+
+  // the hotword is spotted before SAPI hears
+  //  anything, enrolled from the recordings
+  //  in hotwordExamples or, without any, as
+  //  the installed voices say it
+  bool spotter {false};
+  std::wstring hotwordExamples {};
+
+  // a profile, see Profile.h, or a directory
+  //  of them
+  std::wstring commands {};
+
+  // usage counts kept across runs
+  std::wstring usage {};
+
+  std::wstring context {};
+  ConfusablePolicy confusables {ConfusablePolicy::Warn};
+  bool prediction {false};
+
+  // commands is reloaded when it changes
+  bool watch {false};
+
+  // the loopback port Prometheus scrapes,
+  //  0 for none
+  uint16_t metrics {0};
+};
+
+// throws std::runtime_error if the file
+//  can't be read, std::invalid_argument
+//  naming the line of an unknown key or a
+//  bad value
+DaemonConfig
+  loadDaemonConfig(std::wstring const& t_path);
+
+struct DaemonStats
+{
+  uint64_t requests {0};
+
+  // requests answered with an Error event
+  uint64_t failed {0};
+
+  uint64_t recognized {0};
+  size_t clients {0};
+
+  // of the watched commands
+  uint64_t reloads {0};
+};
+
+class Daemon
+{
+public:
+  // t_recog is initialized, with or without
+  //  commands of its own
+  // throws std::runtime_error if another
+  //  daemon serves t_name
+  explicit Daemon(Recog& t_recog,
+                  std::wstring const& t_name = IpcDefaultName);
+
+  ~Daemon();
+
+  Daemon(Daemon const&) = delete;
+  Daemon& operator=(Daemon const&) = delete;
+
+  // before run(): applies changes to t_path,
+  //  a profile or directory of them whose
+  //  t_loaded the recognizer has, once it has
+  //  been quiet a moment
+  // only what changed is removed or added,
+  //  between recognition events; a command a
+  //  client replaced since is left to it
+  // throws std::runtime_error if t_path
+  //  can't be watched
+  void
+    watchCommands(std::wstring const& t_path,
+                  std::vector<ProfileEntry> t_loaded);
+
+  // on the thread that initialized the
+  //  recognizer, returns after stop()
+  void
+    run();
+
+  // from any thread
+  void
+    stop();
+
+  DaemonStats
+    stats() const;
+
+private:
+  void
+    apply(IpcView const& t_request);
+
+  void
+    reload();
+
+  Recog& m_recog;
+  IpcServer m_server;
+
+  std::unique_ptr<FileWatch> m_watch {};
+  std::wstring m_commands {};
+
+  // the watched commands as last read
+  std::vector<ProfileEntry> m_loaded {};
+
+  // manual reset
+  HANDLE m_stopEvent {nullptr};
+
+  std::atomic<uint64_t> m_requests {0};
+  std::atomic<uint64_t> m_failed {0};
+  std::atomic<uint64_t> m_recognized {0};
+  std::atomic<uint64_t> m_reloads {0};
+};
+
+// voicecommand --daemon [--config <file>]
+//              [--commands <profile>]
+//              [--hotword <word>] [--name <name>]
+//              [--spotter] [--hotword-examples <dir>]
+//              [--watch] [--trace] [--metrics <port>]
+//              [--startup-report]
+// serves until Ctrl+C, the options win over
+//  the file's, takes the single instance
+// --trace records from the start, see
+//  --send trace
+// --startup-report prints what starting
+//  cost once serving and exits
+// returns the process exit code
+int
+  runDaemonCli(std::vector<std::wstring> const& t_args);
+
+// voicecommand --send add <phrase> <exec> [<param> [<context>]]
+//              --send remove <phrase>
+//              --send context <context>
+//              --send trace on | off | <file>
+//              [--name <name>]
+// returns once the daemon has applied it,
+//  2 if it refused
+int
+  runSendCli(std::vector<std::wstring> const& t_args);
+
+// voicecommand --listen [--name <name>]
+// prints every event as a tab separated
+//  line until the daemon goes away
+int
+  runListenCli(std::vector<std::wstring> const& t_args);
+
+// voicecommand --ipc-bench [--count <n>] [--name <name>]
+// round trips to a running daemon one at a
+//  time then as fast as the rings allow
+int
+  runIpcBenchCli(std::vector<std::wstring> const& t_args);
+
+}
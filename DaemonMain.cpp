@@ -0,0 +1,35 @@
+// The recognizer without a window: no Qt
+//  at all, configured from a file and
+//  serving its clients over shared memory
+//
+#include "Daemon.h"
+#include "Metrics.h"
+
+#include <shellapi.h>
+
+#include <algorithm>
+
+using namespace HNx;
+
+int main()
+{
+  int argcW = 0;
+  LPWSTR* argvW = CommandLineToArgvW(GetCommandLineW(), &argcW);
+  if(!argvW)
+    return 1;
+  std::vector<std::wstring> args(argvW, argvW + argcW);
+  LocalFree(argvW);
+
+  // the same binary talks to a daemon
+  //  already running
+  if(std::find(args.begin(), args.end(), L"--send") != args.end())
+    return runSendCli(args);
+  if(std::find(args.begin(), args.end(), L"--listen") != args.end())
+    return runListenCli(args);
+  if(std::find(args.begin(), args.end(), L"--ipc-bench") != args.end())
+    return runIpcBenchCli(args);
+  if(std::find(args.begin(), args.end(), L"--metrics-bench") != args.end())
+    return runMetricsBenchCli(args);
+
+  return runDaemonCli(args);
+}
@@ -0,0 +1,122 @@
+#include "DeviceSource.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+//=================================//
+// HNx Voice Command Device Source //
+//=================================//
+// Microphone capture for the      //
+//  audio front-end                //
+//=================================//
+
+using namespace HNx;
+
+namespace
+{
+// a device that delivers nothing this long
+//  has gone away
+constexpr DWORD DEVICE_TIMEOUT_MS = 2000;
+}
+
+HNx::DeviceSource::DeviceSource(UINT t_device)
+  : m_samples(BufferSamples * Buffers)
+{
+  m_done = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+  if(!m_done)
+    throw std::runtime_error("Failed to create the capture event.\nError: " + std::to_string(GetLastError()));
+
+  WAVEFORMATEX format = {};
+  format.wFormatTag = WAVE_FORMAT_PCM;
+  format.nChannels = 1;
+  format.nSamplesPerSec = AudioSampleRate;
+  format.wBitsPerSample = 16;
+  format.nBlockAlign = 2;
+  format.nAvgBytesPerSec = AudioSampleRate * 2;
+
+  MMRESULT mr = waveInOpen(&m_device, t_device, &format,
+                           reinterpret_cast<DWORD_PTR>(m_done), 0,
+                           CALLBACK_EVENT);
+  if(mr != MMSYSERR_NOERROR)
+  {
+    CloseHandle(m_done);
+    throw std::runtime_error("Failed to open the audio input device.\nError: " + std::to_string(mr));
+  }
+
+  for(size_t i = 0; i < Buffers; ++i)
+  {
+    WAVEHDR& header = m_headers[i];
+    header.lpData = reinterpret_cast<LPSTR>(m_samples.data() + i * BufferSamples);
+    header.dwBufferLength = static_cast<DWORD>(BufferSamples * sizeof(int16_t));
+    mr = waveInPrepareHeader(m_device, &header, sizeof(header));
+    if(mr == MMSYSERR_NOERROR)
+      mr = waveInAddBuffer(m_device, &header, sizeof(header));
+    if(mr != MMSYSERR_NOERROR)
+    {
+      waveInReset(m_device);
+      for(auto& h : m_headers)
+        if(h.dwFlags & WHDR_PREPARED)
+          waveInUnprepareHeader(m_device, &h, sizeof(h));
+      waveInClose(m_device);
+      CloseHandle(m_done);
+      throw std::runtime_error("Failed to queue capture buffers.\nError: " + std::to_string(mr));
+    }
+  }
+}
+
+HNx::DeviceSource::~DeviceSource()
+{
+  // hands back every queued buffer
+  waveInReset(m_device);
+  for(auto& header : m_headers)
+    if(header.dwFlags & WHDR_PREPARED)
+      waveInUnprepareHeader(m_device, &header, sizeof(header));
+  waveInClose(m_device);
+  CloseHandle(m_done);
+}
+
+size_t
+HNx::DeviceSource::read(int16_t* t_dst, size_t t_count)
+{
+  if(!m_started)
+  {
+    if(waveInStart(m_device) != MMSYSERR_NOERROR)
+      return 0;
+    m_started = true;
+  }
+
+  size_t done = 0;
+  while(done < t_count)
+  {
+    // buffers come back in the order
+    //  they were queued
+    WAVEHDR& header = m_headers[m_next];
+    if(!(header.dwFlags & WHDR_DONE))
+    {
+      if(done)
+        break;
+      if(WaitForSingleObject(m_done, DEVICE_TIMEOUT_MS) != WAIT_OBJECT_0)
+        return 0;
+      continue;
+    }
+
+    size_t recorded = header.dwBytesRecorded / sizeof(int16_t);
+    size_t n = std::min(t_count - done, recorded - std::min(m_at, recorded));
+    std::memcpy(t_dst + done, header.lpData + m_at * sizeof(int16_t), n * sizeof(int16_t));
+    done += n;
+    m_at += n;
+
+    // emptied, back in the queue
+    if(m_at >= recorded)
+    {
+      header.dwFlags &= ~WHDR_DONE;
+      if(waveInAddBuffer(m_device, &header, sizeof(header)) != MMSYSERR_NOERROR)
+        return done;
+      m_next = (m_next + 1) % Buffers;
+      m_at = 0;
+    }
+  }
+  return done;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "Audio.h"
+
+#include <windows.h>
+#include <mmsystem.h>
+
+#include <array>
+#include <vector>
+
+//   The default microphone as a PcmSource,
+//  through waveIn. The wave mapper converts
+//  whatever the device records to 16kHz 16 bit
+//  mono, so nothing past it resamples
+//
+//  Capture starts on the first read, reads
+//  block until the device fills a buffer
+
+namespace HNx
+{
+
+class DeviceSource : public PcmSource
+{
+public:
+  // t_device [optional]
+  //  a waveIn device id, the default one
+  //  otherwise
+  // throws std::runtime_error if the device
+  //  can't be opened
+  explicit DeviceSource(UINT t_device = WAVE_MAPPER);
+  ~DeviceSource() override;
+
+  DeviceSource(DeviceSource const&) = delete;
+  DeviceSource& operator=(DeviceSource const&) = delete;
+
+  // 0 once the device stops delivering,
+  //  unplugged usually
+  size_t
+    read(int16_t* t_dst, size_t t_count) override;
+
+private:
+  // 40ms a buffer, 320ms queued in all
+  static constexpr size_t BufferSamples {640};
+  static constexpr size_t Buffers {8};
+
+  HWAVEIN m_device {nullptr};
+  HANDLE m_done {nullptr};
+  bool m_started {false};
+
+  std::array<WAVEHDR, Buffers> m_headers {};
+  std::vector<int16_t> m_samples;
+
+  // the buffer being read and how far
+  size_t m_next {0};
+  size_t m_at {0};
+};
+
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include "Metrics.h"
+
+#include <windows.h>
+#include <shellapi.h>
+
+#include <chrono>
+#include <string>
+
+//   Launching of command lines shared by
+//  single commands and macro steps
+
+namespace HNx
+{
+
+// what launching costs and how often it
+//  fails, registered on first use
+struct LaunchMetrics
+{
+  // ShellExecuteEx alone, not the wait
+  Histogram& seconds {Metrics::histogram("hnx_launch_seconds",
+                                         "Time ShellExecuteEx took to start a command")};
+
+  // a stale cached path counts before the
+  //  retry with the command's own
+  Counter& failures {Metrics::counter("hnx_exec_failures_total",
+                                      "Launches that failed or, waited on, exited non-zero")};
+};
+
+inline
+LaunchMetrics&
+launchMetrics()
+{
+  static LaunchMetrics metrics;
+  return metrics;
+}
+
+// starts exec with its optional param through
+//  ShellExecuteEx, if t_wait is true blocks
+//  until the process exits
+// returns true if launched (and exited with 0
+//  when waiting)
+inline
+bool
+launch(std::wstring const& t_exec,
+       std::wstring const& t_param,
+       bool t_wait = false)
+{
+  if(t_exec.empty())
+  {
+    launchMetrics().failures.add();
+    return false;
+  }
+
+  SHELLEXECUTEINFOW shex = {0};
+  shex.cbSize = sizeof(SHELLEXECUTEINFOW);
+  shex.nShow = SW_SHOW;
+  shex.lpVerb = L"open";
+  shex.lpFile = t_exec.c_str();
+  if(!t_param.empty())
+    shex.lpParameters = t_param.c_str();
+
+  // we need the process handle to wait on it
+  if(t_wait)
+    shex.fMask = SEE_MASK_NOCLOSEPROCESS | SEE_MASK_NOASYNC;
+
+  auto start = std::chrono::steady_clock::now();
+  BOOL launched = ShellExecuteExW(&shex);
+  launchMetrics().seconds.record(std::chrono::steady_clock::now() - start);
+  if(launched == FALSE)
+  {
+    launchMetrics().failures.add();
+    return false;
+  }
+
+  if(!t_wait)
+    return true;
+
+  // documents opened by an already running
+  //  program have no process to wait on
+  if(!shex.hProcess)
+    return true;
+
+  DWORD exitCode = 0;
+  WaitForSingleObject(shex.hProcess, INFINITE);
+  GetExitCodeProcess(shex.hProcess, &exitCode);
+  CloseHandle(shex.hProcess);
+
+  if(exitCode != 0)
+    launchMetrics().failures.add();
+  return exitCode == 0;
+}
+
+}
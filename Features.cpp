@@ -0,0 +1,321 @@
+#include "Features.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+//=================================//
+// HNx Voice Command Features      //
+//=================================//
+// Log-mel and MFCC extraction     //
+//=================================//
+
+using namespace HNx;
+
+namespace
+{
+
+// vectors are at most this many floats
+constexpr size_t VectorWidth {8};
+
+size_t
+round_up(size_t t_n)
+{
+  return (t_n + VectorWidth - 1) / VectorWidth * VectorWidth;
+}
+
+float
+hz_to_mel(float t_hz)
+{
+  return 1127.0f * std::log(1.0f + t_hz / 700.0f);
+}
+
+//=========================================================================
+//  Kernels
+//=========================================================================
+
+// t_out[i] = t_window[i] * (x[i] - a * x[i - 1]),
+//  the first sample standing in for x[-1]
+void
+emphasize_scalar(int16_t const* t_x, size_t t_n, float t_a, float const* t_window, float* t_out)
+{
+  t_out[0] = t_window[0] * (1.0f - t_a) * static_cast<float>(t_x[0]);
+  for(size_t i = 1; i < t_n; ++i)
+    t_out[i] = t_window[i] * (static_cast<float>(t_x[i]) - t_a * static_cast<float>(t_x[i - 1]));
+}
+
+float
+dot_scalar(float const* t_a, float const* t_b, size_t t_n)
+{
+  float sum = 0.0f;
+  for(size_t i = 0; i < t_n; ++i)
+    sum += t_a[i] * t_b[i];
+  return sum;
+}
+
+#ifdef HNX_X86
+HNX_TARGET_SSE
+__m128
+load4_sse(int16_t const* t_x)
+{
+  __m128i v = _mm_loadl_epi64(reinterpret_cast<__m128i const*>(t_x));
+  return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+}
+
+HNX_TARGET_SSE
+void
+emphasize_sse(int16_t const* t_x, size_t t_n, float t_a, float const* t_window, float* t_out)
+{
+  t_out[0] = t_window[0] * (1.0f - t_a) * static_cast<float>(t_x[0]);
+  __m128 a = _mm_set1_ps(t_a);
+  size_t i = 1;
+  for(; i + 4 <= t_n; i += 4)
+  {
+    __m128 cur = load4_sse(t_x + i);
+    __m128 prev = load4_sse(t_x + i - 1);
+    __m128 y = _mm_sub_ps(cur, _mm_mul_ps(a, prev));
+    _mm_storeu_ps(t_out + i, _mm_mul_ps(y, _mm_loadu_ps(t_window + i)));
+  }
+  for(; i < t_n; ++i)
+    t_out[i] = t_window[i] * (static_cast<float>(t_x[i]) - t_a * static_cast<float>(t_x[i - 1]));
+}
+
+// t_n a multiple of 4
+HNX_TARGET_SSE
+float
+dot_sse(float const* t_a, float const* t_b, size_t t_n)
+{
+  __m128 acc = _mm_setzero_ps();
+  for(size_t i = 0; i < t_n; i += 4)
+    acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(t_a + i), _mm_loadu_ps(t_b + i)));
+  acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+  acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+  return _mm_cvtss_f32(acc);
+}
+
+HNX_TARGET_AVX2
+__m256
+load8_avx2(int16_t const* t_x)
+{
+  __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(t_x));
+  return _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(v));
+}
+
+HNX_TARGET_AVX2
+void
+emphasize_avx2(int16_t const* t_x, size_t t_n, float t_a, float const* t_window, float* t_out)
+{
+  t_out[0] = t_window[0] * (1.0f - t_a) * static_cast<float>(t_x[0]);
+  __m256 a = _mm256_set1_ps(t_a);
+  size_t i = 1;
+  for(; i + 8 <= t_n; i += 8)
+  {
+    __m256 cur = load8_avx2(t_x + i);
+    __m256 prev = load8_avx2(t_x + i - 1);
+    __m256 y = _mm256_fnmadd_ps(a, prev, cur);
+    _mm256_storeu_ps(t_out + i, _mm256_mul_ps(y, _mm256_loadu_ps(t_window + i)));
+  }
+  for(; i < t_n; ++i)
+    t_out[i] = t_window[i] * (static_cast<float>(t_x[i]) - t_a * static_cast<float>(t_x[i - 1]));
+}
+
+// t_n a multiple of 8
+HNX_TARGET_AVX2
+float
+dot_avx2(float const* t_a, float const* t_b, size_t t_n)
+{
+  __m256 acc = _mm256_setzero_ps();
+  for(size_t i = 0; i < t_n; i += 8)
+    acc = _mm256_fmadd_ps(_mm256_loadu_ps(t_a + i), _mm256_loadu_ps(t_b + i), acc);
+  __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+  return _mm_cvtss_f32(sum);
+}
+#endif
+
+}
+
+HNx::MfccExtractor::MfccExtractor(MfccConfig t_config, SimdLevel t_simd)
+  : m_config(t_config)
+  , m_simd(usableSimd(t_simd))
+  , m_fft(t_config.fftSize, t_simd)
+{
+  if(m_config.frameLength < 2 || m_config.frameLength > m_config.fftSize)
+    throw std::invalid_argument("MFCC frame length must fit the FFT");
+  if(m_config.frameShift == 0)
+    throw std::invalid_argument("MFCC frame shift must not be 0");
+  if(m_config.melBands == 0 || m_config.cepstra == 0 || m_config.cepstra > m_config.melBands)
+    throw std::invalid_argument("MFCC needs at least as many mel bands as cepstra");
+  if(!(m_config.lowHz >= 0.0f && m_config.lowHz < m_config.highHz && m_config.highHz <= m_config.sampleRate / 2))
+    throw std::invalid_argument("MFCC band edges must lie within the Nyquist frequency");
+
+  constexpr double Pi = 3.14159265358979323846;
+
+  m_window.resize(m_config.frameLength);
+  for(size_t i = 0; i < m_config.frameLength; ++i)
+    m_window[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * Pi * static_cast<double>(i) / static_cast<double>(m_config.frameLength - 1)));
+
+  // triangles evenly spaced in mel,
+  //  each from its neighbours' centres
+  size_t bins = m_config.fftSize / 2 + 1;
+  float melLow = hz_to_mel(m_config.lowHz);
+  float melHigh = hz_to_mel(m_config.highHz);
+  float melStep = (melHigh - melLow) / static_cast<float>(m_config.melBands + 1);
+  for(unsigned band = 0; band < m_config.melBands; ++band)
+  {
+    float left = melLow + melStep * static_cast<float>(band);
+    float centre = left + melStep;
+    float right = centre + melStep;
+
+    std::vector<float> weights(bins, 0.0f);
+    size_t first = bins;
+    size_t last = 0;
+    for(size_t k = 0; k < bins; ++k)
+    {
+      float mel = hz_to_mel(static_cast<float>(k) * m_config.sampleRate / static_cast<float>(m_config.fftSize));
+      if(mel <= left || mel >= right)
+        continue;
+      weights[k] = mel <= centre ? (mel - left) / melStep : (right - mel) / melStep;
+      first = std::min(first, k);
+      last = k;
+    }
+    if(first > last)
+      first = last = 0;
+
+    Filter filter;
+    filter.firstBin = first;
+    filter.offset = m_weights.size();
+    filter.length = round_up(last - first + 1);
+    m_weights.resize(m_weights.size() + filter.length, 0.0f);
+    for(size_t k = first; k <= last; ++k)
+      m_weights[filter.offset + k - first] = weights[k];
+    m_filters.push_back(filter);
+  }
+
+  // orthonormal DCT-II
+  m_bandStride = round_up(m_config.melBands);
+  m_dct.assign(m_config.cepstra * m_bandStride, 0.0f);
+  for(unsigned i = 0; i < m_config.cepstra; ++i)
+  {
+    double scale = std::sqrt((i == 0 ? 1.0 : 2.0) / m_config.melBands);
+    for(unsigned j = 0; j < m_config.melBands; ++j)
+      m_dct[i * m_bandStride + j] = static_cast<float>(scale * std::cos(Pi * i * (j + 0.5) / m_config.melBands));
+  }
+
+  // filters may run up to a vector past
+  //  the last bin, that part is zero
+  m_frame.assign(m_config.fftSize, 0.0f);
+  m_power.assign(bins + VectorWidth, 0.0f);
+  m_logMel.assign(BatchFrames * m_bandStride, 0.0f);
+}
+
+size_t
+HNx::MfccExtractor::frames(size_t t_count) const
+{
+  if(t_count < m_config.frameLength)
+    return 0;
+  return 1 + (t_count - m_config.frameLength) / m_config.frameShift;
+}
+
+void
+HNx::MfccExtractor::log_mel_batch(int16_t const* t_samples, size_t t_frames)
+{
+  for(size_t f = 0; f < t_frames; ++f)
+  {
+    int16_t const* x = t_samples + f * m_config.frameShift;
+    float* out = m_logMel.data() + f * m_bandStride;
+
+#ifdef HNX_X86
+    if(m_simd == SimdLevel::Avx2)
+      emphasize_avx2(x, m_config.frameLength, m_config.preemphasis, m_window.data(), m_frame.data());
+    else if(m_simd == SimdLevel::Sse)
+      emphasize_sse(x, m_config.frameLength, m_config.preemphasis, m_window.data(), m_frame.data());
+    else
+#endif
+      emphasize_scalar(x, m_config.frameLength, m_config.preemphasis, m_window.data(), m_frame.data());
+
+    m_fft.power(m_frame.data(), m_config.frameLength, m_power.data());
+
+    for(size_t band = 0; band < m_filters.size(); ++band)
+    {
+      Filter const& filter = m_filters[band];
+      float const* p = m_power.data() + filter.firstBin;
+      float const* w = m_weights.data() + filter.offset;
+
+      float energy;
+#ifdef HNX_X86
+      if(m_simd == SimdLevel::Avx2)
+        energy = dot_avx2(p, w, filter.length);
+      else if(m_simd == SimdLevel::Sse)
+        energy = dot_sse(p, w, filter.length);
+      else
+#endif
+        energy = dot_scalar(p, w, filter.length);
+
+      out[band] = std::log(std::max(energy, 1e-10f));
+    }
+  }
+}
+
+size_t
+HNx::MfccExtractor::logMel(int16_t const* t_samples, size_t t_count, float* t_out)
+{
+  size_t total = frames(t_count);
+  for(size_t done = 0; done < total; done += BatchFrames)
+  {
+    size_t batch = std::min(BatchFrames, total - done);
+    log_mel_batch(t_samples + done * m_config.frameShift, batch);
+    for(size_t f = 0; f < batch; ++f)
+      std::memcpy(t_out + (done + f) * m_config.melBands,
+                  m_logMel.data() + f * m_bandStride,
+                  m_config.melBands * sizeof(float));
+  }
+  return total;
+}
+
+size_t
+HNx::MfccExtractor::mfcc(int16_t const* t_samples, size_t t_count, float* t_out)
+{
+  size_t total = frames(t_count);
+  for(size_t done = 0; done < total; done += BatchFrames)
+  {
+    size_t batch = std::min(BatchFrames, total - done);
+    log_mel_batch(t_samples + done * m_config.frameShift, batch);
+
+    // the DCT over the whole batch, each
+    //  row stays in cache across frames
+    for(unsigned i = 0; i < m_config.cepstra; ++i)
+    {
+      float const* row = m_dct.data() + i * m_bandStride;
+      for(size_t f = 0; f < batch; ++f)
+      {
+        float const* mel = m_logMel.data() + f * m_bandStride;
+        float c;
+#ifdef HNX_X86
+        if(m_simd == SimdLevel::Avx2)
+          c = dot_avx2(row, mel, m_bandStride);
+        else if(m_simd == SimdLevel::Sse)
+          c = dot_sse(row, mel, m_bandStride);
+        else
+#endif
+          c = dot_scalar(row, mel, m_config.melBands);
+        t_out[(done + f) * m_config.cepstra + i] = c;
+      }
+    }
+  }
+  return total;
+}
+
+MfccConfig const&
+HNx::MfccExtractor::config() const
+{
+  return m_config;
+}
+
+SimdLevel
+HNx::MfccExtractor::simd() const
+{
+  return m_simd;
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include "Fft.h"
+#include "Simd.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//   Log-mel and MFCC features, the usual
+//  front of any acoustic model: pre-emphasis,
+//  Hann window, power spectrum, triangular
+//  mel filters, log and a DCT
+//
+//  Every buffer is allocated up front, frames
+//  are worked through in batches of
+//  MfccExtractor::BatchFrames
+
+namespace HNx
+{
+
+struct MfccConfig
+{
+  // 25ms every 10ms at 16kHz
+  size_t frameLength {400};
+  size_t frameShift {160};
+
+  // power of two, at least frameLength
+  size_t fftSize {512};
+
+  unsigned melBands {40};
+  unsigned cepstra {13};
+
+  float lowHz {20.0f};
+  float highHz {7600.0f};
+  float preemphasis {0.97f};
+  float sampleRate {16000.0f};
+};
+
+class MfccExtractor
+{
+public:
+  static constexpr size_t BatchFrames {32};
+
+  // throws std::invalid_argument for a
+  //  config that doesn't fit together
+  explicit MfccExtractor(MfccConfig t_config = {},
+                         SimdLevel t_simd = detectSimd());
+
+  // whole frames in t_count samples
+  size_t
+    frames(size_t t_count) const;
+
+  // melBands values per frame into t_out,
+  //  returns the frames written
+  size_t
+    logMel(int16_t const* t_samples, size_t t_count, float* t_out);
+
+  // cepstra values per frame into t_out,
+  //  returns the frames written
+  size_t
+    mfcc(int16_t const* t_samples, size_t t_count, float* t_out);
+
+  MfccConfig const&
+    config() const;
+
+  SimdLevel
+    simd() const;
+
+private:
+  // one batch of log mel energies into
+  //  m_logMel, rows m_bandStride apart
+  void
+    log_mel_batch(int16_t const* t_samples, size_t t_frames);
+
+  MfccConfig m_config;
+  SimdLevel m_simd;
+  Fft m_fft;
+
+  std::vector<float> m_window {};
+
+  // each filter's weights cover a run of
+  //  bins, padded to whole vectors
+  struct Filter
+  {
+    size_t firstBin {0};
+    size_t offset {0};
+    size_t length {0};
+  };
+  std::vector<Filter> m_filters {};
+  std::vector<float> m_weights {};
+
+  // DCT-II rows, m_bandStride apart
+  std::vector<float> m_dct {};
+  size_t m_bandStride {0};
+
+  std::vector<float> m_frame {};
+  std::vector<float> m_power {};
+  std::vector<float> m_logMel {};
+};
+
+}
@@ -0,0 +1,237 @@
+#include "Fft.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+//=================================//
+// HNx Voice Command FFT           //
+//=================================//
+// Spectra for the audio features  //
+//=================================//
+
+using namespace HNx;
+
+namespace
+{
+
+std::vector<size_t>
+bit_reversal(size_t t_n)
+{
+  size_t bits = 0;
+  while((size_t {1} << bits) < t_n)
+    ++bits;
+
+  std::vector<size_t> reverse(t_n);
+  for(size_t i = 0; i < t_n; ++i)
+  {
+    size_t r = 0;
+    for(size_t b = 0; b < bits; ++b)
+      r |= ((i >> b) & 1) << (bits - 1 - b);
+    reverse[i] = r;
+  }
+  return reverse;
+}
+
+// one stage, pairs half apart
+void
+butterflies_scalar(float* t_re, float* t_im, size_t t_n, size_t t_half, float const* t_wr, float const* t_wi)
+{
+  for(size_t start = 0; start < t_n; start += t_half * 2)
+  {
+    for(size_t k = 0; k < t_half; ++k)
+    {
+      size_t a = start + k;
+      size_t b = a + t_half;
+      float tr = t_re[b] * t_wr[k] - t_im[b] * t_wi[k];
+      float ti = t_re[b] * t_wi[k] + t_im[b] * t_wr[k];
+      t_re[b] = t_re[a] - tr;
+      t_im[b] = t_im[a] - ti;
+      t_re[a] += tr;
+      t_im[a] += ti;
+    }
+  }
+}
+
+#ifdef HNX_X86
+// t_half a multiple of 4
+HNX_TARGET_SSE
+void
+butterflies_sse(float* t_re, float* t_im, size_t t_n, size_t t_half, float const* t_wr, float const* t_wi)
+{
+  for(size_t start = 0; start < t_n; start += t_half * 2)
+  {
+    for(size_t k = 0; k < t_half; k += 4)
+    {
+      float* ra = t_re + start + k;
+      float* ia = t_im + start + k;
+      float* rb = ra + t_half;
+      float* ib = ia + t_half;
+
+      __m128 wr = _mm_loadu_ps(t_wr + k);
+      __m128 wi = _mm_loadu_ps(t_wi + k);
+      __m128 xr = _mm_loadu_ps(rb);
+      __m128 xi = _mm_loadu_ps(ib);
+      __m128 tr = _mm_sub_ps(_mm_mul_ps(xr, wr), _mm_mul_ps(xi, wi));
+      __m128 ti = _mm_add_ps(_mm_mul_ps(xr, wi), _mm_mul_ps(xi, wr));
+
+      __m128 ar = _mm_loadu_ps(ra);
+      __m128 ai = _mm_loadu_ps(ia);
+      _mm_storeu_ps(rb, _mm_sub_ps(ar, tr));
+      _mm_storeu_ps(ib, _mm_sub_ps(ai, ti));
+      _mm_storeu_ps(ra, _mm_add_ps(ar, tr));
+      _mm_storeu_ps(ia, _mm_add_ps(ai, ti));
+    }
+  }
+}
+
+// t_half a multiple of 8
+HNX_TARGET_AVX2
+void
+butterflies_avx2(float* t_re, float* t_im, size_t t_n, size_t t_half, float const* t_wr, float const* t_wi)
+{
+  for(size_t start = 0; start < t_n; start += t_half * 2)
+  {
+    for(size_t k = 0; k < t_half; k += 8)
+    {
+      float* ra = t_re + start + k;
+      float* ia = t_im + start + k;
+      float* rb = ra + t_half;
+      float* ib = ia + t_half;
+
+      __m256 wr = _mm256_loadu_ps(t_wr + k);
+      __m256 wi = _mm256_loadu_ps(t_wi + k);
+      __m256 xr = _mm256_loadu_ps(rb);
+      __m256 xi = _mm256_loadu_ps(ib);
+      __m256 tr = _mm256_fmsub_ps(xr, wr, _mm256_mul_ps(xi, wi));
+      __m256 ti = _mm256_fmadd_ps(xr, wi, _mm256_mul_ps(xi, wr));
+
+      __m256 ar = _mm256_loadu_ps(ra);
+      __m256 ai = _mm256_loadu_ps(ia);
+      _mm256_storeu_ps(rb, _mm256_sub_ps(ar, tr));
+      _mm256_storeu_ps(ib, _mm256_sub_ps(ai, ti));
+      _mm256_storeu_ps(ra, _mm256_add_ps(ar, tr));
+      _mm256_storeu_ps(ia, _mm256_add_ps(ai, ti));
+    }
+  }
+}
+#endif
+
+}
+
+HNx::Fft::Fft(size_t t_size, SimdLevel t_simd)
+  : m_size(t_size)
+  , m_simd(usableSimd(t_simd))
+{
+  if(t_size < 4 || (t_size & (t_size - 1)) != 0)
+    throw std::invalid_argument("Fft size must be a power of two of at least 4");
+
+  m_reverse = bit_reversal(t_size);
+  m_reverseHalf = bit_reversal(t_size / 2);
+
+  constexpr double Pi = 3.14159265358979323846;
+
+  m_twRe.resize(t_size - 1);
+  m_twIm.resize(t_size - 1);
+  for(size_t half = 1; half < t_size; half <<= 1)
+  {
+    for(size_t k = 0; k < half; ++k)
+    {
+      double angle = -Pi * static_cast<double>(k) / static_cast<double>(half);
+      m_twRe[half - 1 + k] = static_cast<float>(std::cos(angle));
+      m_twIm[half - 1 + k] = static_cast<float>(std::sin(angle));
+    }
+  }
+
+  m_splitRe.resize(t_size / 2 + 1);
+  m_splitIm.resize(t_size / 2 + 1);
+  for(size_t k = 0; k <= t_size / 2; ++k)
+  {
+    double angle = -2.0 * Pi * static_cast<double>(k) / static_cast<double>(t_size);
+    m_splitRe[k] = static_cast<float>(std::cos(angle));
+    m_splitIm[k] = static_cast<float>(std::sin(angle));
+  }
+
+  m_re.resize(t_size / 2);
+  m_im.resize(t_size / 2);
+}
+
+size_t
+HNx::Fft::size() const
+{
+  return m_size;
+}
+
+SimdLevel
+HNx::Fft::simd() const
+{
+  return m_simd;
+}
+
+void
+HNx::Fft::transform(float* t_re, float* t_im, size_t t_n, std::vector<size_t> const& t_reverse) const
+{
+  for(size_t i = 0; i < t_n; ++i)
+  {
+    size_t r = t_reverse[i];
+    if(r > i)
+    {
+      std::swap(t_re[i], t_re[r]);
+      std::swap(t_im[i], t_im[r]);
+    }
+  }
+
+  // the first stages are too narrow for
+  //  the vector kernels
+  for(size_t half = 1; half < t_n; half <<= 1)
+  {
+    float const* wr = m_twRe.data() + half - 1;
+    float const* wi = m_twIm.data() + half - 1;
+#ifdef HNX_X86
+    if(m_simd == SimdLevel::Avx2 && half >= 8)
+      butterflies_avx2(t_re, t_im, t_n, half, wr, wi);
+    else if(m_simd != SimdLevel::Scalar && half >= 4)
+      butterflies_sse(t_re, t_im, t_n, half, wr, wi);
+    else
+#endif
+      butterflies_scalar(t_re, t_im, t_n, half, wr, wi);
+  }
+}
+
+void
+HNx::Fft::forward(float* t_re, float* t_im) const
+{
+  transform(t_re, t_im, m_size, m_reverse);
+}
+
+void
+HNx::Fft::power(float const* t_signal, size_t t_count, float* t_power) const
+{
+  // even samples as the real part, odd
+  //  ones as the imaginary part
+  size_t half = m_size / 2;
+  size_t n = std::min(t_count, m_size);
+  for(size_t k = 0; k < half; ++k)
+  {
+    m_re[k] = 2 * k < n ? t_signal[2 * k] : 0.0f;
+    m_im[k] = 2 * k + 1 < n ? t_signal[2 * k + 1] : 0.0f;
+  }
+
+  transform(m_re.data(), m_im.data(), half, m_reverseHalf);
+
+  for(size_t k = 0; k <= half; ++k)
+  {
+    size_t a = k % half;
+    size_t b = (half - k) % half;
+
+    // spectra of the even and odd samples
+    float er = 0.5f * (m_re[a] + m_re[b]);
+    float ei = 0.5f * (m_im[a] - m_im[b]);
+    float odr = 0.5f * (m_im[a] + m_im[b]);
+    float odi = -0.5f * (m_re[a] - m_re[b]);
+
+    float xr = er + m_splitRe[k] * odr - m_splitIm[k] * odi;
+    float xi = ei + m_splitRe[k] * odi + m_splitIm[k] * odr;
+    t_power[k] = xr * xr + xi * xi;
+  }
+}
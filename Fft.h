@@ -0,0 +1,64 @@
+#pragma once
+#include "Simd.h"
+
+#include <cstddef>
+#include <vector>
+
+//   In-place radix-2 FFT for the audio
+//  features. Twiddles and the bit reversal
+//  are worked out once per size, real input
+//  goes through a transform of half the size
+
+namespace HNx
+{
+
+class Fft
+{
+public:
+  // t_size must be a power of two of at
+  //  least 4, throws std::invalid_argument
+  //  if not
+  explicit Fft(size_t t_size, SimdLevel t_simd = detectSimd());
+
+  size_t
+    size() const;
+
+  SimdLevel
+    simd() const;
+
+  // t_re and t_im hold size() values each
+  void
+    forward(float* t_re, float* t_im) const;
+
+  // |X[k]|^2 for k in [0, size() / 2] of a
+  //  real signal, zero padded to size(),
+  //  t_power holds size() / 2 + 1 values
+  void
+    power(float const* t_signal, size_t t_count, float* t_power) const;
+
+private:
+  void
+    transform(float* t_re, float* t_im, size_t t_n, std::vector<size_t> const& t_reverse) const;
+
+  size_t m_size;
+  SimdLevel m_simd;
+
+  std::vector<size_t> m_reverse {};
+  std::vector<size_t> m_reverseHalf {};
+
+  // e^(-i pi k / half) for every stage,
+  //  the stage of half h starting at h - 1
+  std::vector<float> m_twRe {};
+  std::vector<float> m_twIm {};
+
+  // e^(-2 i pi k / size()) to untangle
+  //  the half size transform
+  std::vector<float> m_splitRe {};
+  std::vector<float> m_splitIm {};
+
+  // scratch for power()
+  mutable std::vector<float> m_re {};
+  mutable std::vector<float> m_im {};
+};
+
+}
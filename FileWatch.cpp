@@ -0,0 +1,168 @@
+#include "FileWatch.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+
+//=================================//
+// HNx Voice Command File Watch    //
+//=================================//
+// Debounced change notifications  //
+//  for a file or directory        //
+//=================================//
+
+using namespace HNx;
+
+namespace
+{
+constexpr DWORD WATCHED_CHANGES = FILE_NOTIFY_CHANGE_FILE_NAME |
+                                  FILE_NOTIFY_CHANGE_LAST_WRITE |
+                                  FILE_NOTIFY_CHANGE_SIZE;
+
+// 64KB, the most a network share takes
+constexpr size_t BUFFER_DWORDS = 16 * 1024;
+}
+
+HNx::FileWatch::FileWatch(std::wstring const& t_path,
+                          std::chrono::milliseconds t_settle)
+  : m_settle(t_settle)
+  , m_buffer(BUFFER_DWORDS)
+{
+  std::filesystem::path path = std::filesystem::absolute(std::filesystem::path(t_path));
+  if(std::filesystem::is_directory(path))
+    m_dir = path.wstring();
+  else
+  {
+    m_dir = path.parent_path().wstring();
+    m_file = path.filename().wstring();
+  }
+
+  // the directory, the file may be
+  //  replaced rather than written
+  m_handle = CreateFileW(m_dir.c_str(),
+                         FILE_LIST_DIRECTORY,
+                         FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                         nullptr,
+                         OPEN_EXISTING,
+                         FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+                         nullptr);
+  if(m_handle == INVALID_HANDLE_VALUE)
+    throw std::runtime_error("Failed to watch the command file's directory.\nError: " + std::to_string(GetLastError()));
+
+  m_overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+  if(!m_overlapped.hEvent)
+  {
+    CloseHandle(m_handle);
+    throw std::runtime_error("Failed to create the file watch's event.\nError: " + std::to_string(GetLastError()));
+  }
+
+  try
+  {
+    arm();
+  }
+  catch(...)
+  {
+    CloseHandle(m_overlapped.hEvent);
+    CloseHandle(m_handle);
+    throw;
+  }
+}
+
+HNx::FileWatch::~FileWatch()
+{
+  // the buffer must outlive the read
+  DWORD bytes = 0;
+  if(CancelIoEx(m_handle, &m_overlapped))
+    GetOverlappedResult(m_handle, &m_overlapped, &bytes, TRUE);
+  CloseHandle(m_overlapped.hEvent);
+  CloseHandle(m_handle);
+}
+
+HANDLE
+HNx::FileWatch::handle() const
+{
+  return m_overlapped.hEvent;
+}
+
+void
+HNx::FileWatch::changed(clock::time_point t_now)
+{
+  DWORD bytes = 0;
+  if(!GetOverlappedResult(m_handle, &m_overlapped, &bytes, FALSE))
+  {
+    if(GetLastError() == ERROR_IO_INCOMPLETE)
+      return;
+
+    // the read failed, whatever it missed
+    //  may have been ours
+    m_pending = true;
+    m_last = t_now;
+    arm();
+    return;
+  }
+
+  // none when more changed than fit, any
+  //  of them may have been ours
+  bool ours = bytes == 0;
+  auto base = reinterpret_cast<char const*>(m_buffer.data());
+  for(size_t offset = 0; !ours && bytes;)
+  {
+    auto info = reinterpret_cast<FILE_NOTIFY_INFORMATION const*>(base + offset);
+    ours = relevant({info->FileName, info->FileNameLength / sizeof(wchar_t)});
+    if(!info->NextEntryOffset)
+      break;
+    offset += info->NextEntryOffset;
+  }
+
+  arm();
+  if(ours)
+  {
+    m_pending = true;
+    m_last = t_now;
+  }
+}
+
+bool
+HNx::FileWatch::settled(clock::time_point t_now)
+{
+  if(!m_pending || t_now - m_last < m_settle)
+    return false;
+  m_pending = false;
+  return true;
+}
+
+DWORD
+HNx::FileWatch::timeout(clock::time_point t_now) const
+{
+  if(!m_pending)
+    return INFINITE;
+  auto left = std::chrono::duration_cast<std::chrono::milliseconds>(m_last + m_settle - t_now);
+  return static_cast<DWORD>(std::max<long long>(left.count(), 0));
+}
+
+void
+HNx::FileWatch::arm()
+{
+  ResetEvent(m_overlapped.hEvent);
+  if(!ReadDirectoryChangesW(m_handle,
+                            m_buffer.data(),
+                            static_cast<DWORD>(m_buffer.size() * sizeof(DWORD)),
+                            FALSE,
+                            WATCHED_CHANGES,
+                            nullptr,
+                            &m_overlapped,
+                            nullptr))
+    throw std::runtime_error("ReadDirectoryChangesW() failed...\nError: " + std::to_string(GetLastError()));
+}
+
+bool
+HNx::FileWatch::relevant(std::wstring_view t_name) const
+{
+  if(!m_file.empty())
+    return icase_equal(t_name, m_file);
+
+  // editors' and installers' temporary
+  //  files don't count
+  return t_name.size() > 4 && icase_equal(t_name.substr(t_name.size() - 4), L".txt");
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <windows.h>
+
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//   Tells when a file, or the .txt files of
+//  a directory, changed and then stayed
+//  unchanged for a while. Whoever writes
+//  them may save several times, or write a
+//  temporary file and rename it over, only
+//  the quiet after the last change counts
+//
+//  Waits nowhere itself: handle() joins a
+//  WaitForMultipleObjects(), changed() is
+//  called when it is signaled
+
+namespace HNx
+{
+
+class FileWatch
+{
+public:
+  using clock = std::chrono::steady_clock;
+
+  // throws std::runtime_error if t_path's
+  //  directory can't be watched
+  explicit FileWatch(std::wstring const& t_path,
+                     std::chrono::milliseconds t_settle = std::chrono::milliseconds(200));
+
+  ~FileWatch();
+
+  FileWatch(FileWatch const&) = delete;
+  FileWatch& operator=(FileWatch const&) = delete;
+
+  // signaled when the directory changed,
+  //  maybe not what is watched in it
+  HANDLE
+    handle() const;
+
+  // takes what handle() signaled and
+  //  watches for the next change
+  void
+    changed(clock::time_point t_now = clock::now());
+
+  // true once per burst of changes, when
+  //  the last is t_settle ago
+  bool
+    settled(clock::time_point t_now = clock::now());
+
+  // milliseconds until settled() can be
+  //  true, INFINITE if nothing changed
+  DWORD
+    timeout(clock::time_point t_now = clock::now()) const;
+
+private:
+  void
+    arm();
+
+  bool
+    relevant(std::wstring_view t_name) const;
+
+  std::wstring m_dir {};
+
+  // empty when watching the directory
+  std::wstring m_file {};
+
+  std::chrono::milliseconds m_settle {};
+
+  bool m_pending {false};
+  clock::time_point m_last {};
+
+  HANDLE m_handle {INVALID_HANDLE_VALUE};
+  OVERLAPPED m_overlapped {};
+
+  // DWORD aligned as the notifications
+  //  need to be
+  std::vector<DWORD> m_buffer {};
+};
+
+}
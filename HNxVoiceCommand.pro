@@ -15,16 +15,76 @@ TEMPLATE = app
 SOURCES += main.cpp\
            dialog.cpp \
            dialog2.cpp \
-    dialog.cpp
+    dialog.cpp \
+           Macro.cpp \
+           PhraseTemplate.cpp \
+           UsageStats.cpp \
+           LaunchCache.cpp \
+           Predictor.cpp \
+           ColdIndex.cpp \
+           PhoneticIndex.cpp \
+           Batch.cpp \
+           Profile.cpp \
+           Audio.cpp \
+           Fft.cpp \
+           Vad.cpp \
+           Features.cpp \
+           Keyword.cpp \
+           Resample.cpp \
+           RecogPool.cpp \
+           Daemon.cpp \
+           commandmodel.cpp \
+           TrigramIndex.cpp \
+           editqueue.cpp \
+           Journal.cpp \
+           FileWatch.cpp \
+           Trace.cpp \
+           Metrics.cpp \
+           MetricsServer.cpp \
+           DeviceSource.cpp
 
 HEADERS  += dialog.hpp \
             Recog.hpp \
             ipcsm.hpp \
-            dialog2.hpp
+            dialog2.hpp \
+            Exec.h \
+            Macro.h \
+            PhraseTemplate.h \
+            UsageStats.h \
+            LaunchCache.h \
+            Predictor.h \
+            ColdIndex.h \
+            Action.h \
+            PhoneticIndex.h \
+            Batch.h \
+            Profile.h \
+            WorkStealing.h \
+            Audio.h \
+            RingStream.h \
+            Fft.h \
+            Vad.h \
+            Features.h \
+            Simd.h \
+            Keyword.h \
+            Resample.h \
+            RecogPool.h \
+            Daemon.h \
+            ProcessInfo.h \
+            commandmodel.hpp \
+            TrigramIndex.h \
+            editqueue.hpp \
+            Journal.h \
+            FileWatch.h \
+            Trace.h \
+            Metrics.h \
+            MetricsServer.h \
+            DeviceSource.h
 
 FORMS    += dialog.ui \
             dialog2.ui
 
+win32: LIBS += -lws2_32 -lwinmm
+
 win32: QMAKE_CXXFLAGS_RELEASE -= -Zc:strictStrings
 win32: QMAKE_CFLAGS_RELEASE -= -Zc:strictStrings
 win32: QMAKE_CFLAGS -= -Zc:strictStrings
@@ -0,0 +1,75 @@
+#-------------------------------------------------
+#
+# The recognizer as a console daemon, no Qt
+#  at all, see DaemonMain.cpp
+#
+#-------------------------------------------------
+
+CONFIG   -= qt
+CONFIG   += console c++latest
+
+TARGET = HNxVoiceCommandDaemon
+TEMPLATE = app
+
+
+SOURCES += DaemonMain.cpp \
+           Daemon.cpp \
+           CommandGroup.cpp \
+           Macro.cpp \
+           PhraseTemplate.cpp \
+           UsageStats.cpp \
+           LaunchCache.cpp \
+           Predictor.cpp \
+           ColdIndex.cpp \
+           PhoneticIndex.cpp \
+           Profile.cpp \
+           Audio.cpp \
+           Fft.cpp \
+           Vad.cpp \
+           Features.cpp \
+           Keyword.cpp \
+           Resample.cpp \
+           FileWatch.cpp \
+           Trace.cpp \
+           Metrics.cpp \
+           MetricsServer.cpp \
+           DeviceSource.cpp
+
+HEADERS  += Daemon.h \
+            ipcsm.hpp \
+            Recog.hpp \
+            SingleInstance.h \
+            ProcessInfo.h \
+            Command.h \
+            CommandGroup.h \
+            Util.h \
+            Exec.h \
+            Macro.h \
+            PhraseTemplate.h \
+            UsageStats.h \
+            LaunchCache.h \
+            Predictor.h \
+            ColdIndex.h \
+            Action.h \
+            PhoneticIndex.h \
+            Profile.h \
+            Audio.h \
+            RingStream.h \
+            Fft.h \
+            Vad.h \
+            Features.h \
+            Simd.h \
+            Keyword.h \
+            Resample.h \
+            FileWatch.h \
+            Trace.h \
+            Metrics.h \
+            MetricsServer.h \
+            DeviceSource.h
+
+win32: LIBS += -lshell32 -lole32 -luser32 -lws2_32 -lwinmm
+
+win32: QMAKE_CXXFLAGS_RELEASE -= -Zc:strictStrings
+win32: QMAKE_CFLAGS_RELEASE -= -Zc:strictStrings
+win32: QMAKE_CFLAGS -= -Zc:strictStrings
+win32: QMAKE_CXXFLAGS -= -Zc:strictStrings
@@ -0,0 +1,483 @@
+#include "Journal.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <system_error>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+//=================================//
+// HNx Voice Command Journal       //
+//=================================//
+// Append-only command changes     //
+//  with periodic snapshots        //
+//=================================//
+
+using namespace HNx;
+
+namespace
+{
+// a short journal isn't worth a snapshot
+constexpr size_t MIN_RECORDS_TO_COMPACT = 1024;
+
+uint32_t
+fnv1a32(std::string_view t_bytes)
+{
+  uint32_t hash = 2166136261u;
+  for(unsigned char c : t_bytes)
+  {
+    hash ^= c;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+void
+escapeInto(std::string& t_out, std::wstring_view t_field)
+{
+  for(char c : to_utf8(t_field))
+  {
+    switch(c)
+    {
+      case '\\': t_out.append("\\\\"); break;
+      case '\t': t_out.append("\\t"); break;
+      case '\n': t_out.append("\\n"); break;
+      case '\r': t_out.append("\\r"); break;
+      default:   t_out.push_back(c); break;
+    }
+  }
+}
+
+// the checksum covers the rest of the line
+std::string
+seal(std::string const& t_body)
+{
+  static char const digits[] = "0123456789abcdef";
+  uint32_t sum = fnv1a32(t_body);
+  std::string record(8, '0');
+  for(int i = 7; i >= 0; --i, sum >>= 4)
+    record[i] = digits[sum & 0xF];
+  record.push_back('\t');
+  record += t_body;
+  record.push_back('\n');
+  return record;
+}
+
+std::string
+putRecord(std::wstring_view t_phrase,
+          std::wstring_view t_exec,
+          std::wstring_view t_param)
+{
+  std::string body = "+\t";
+  escapeInto(body, t_phrase);
+  body.push_back('\t');
+  escapeInto(body, t_exec);
+  body.push_back('\t');
+  escapeInto(body, t_param);
+  return seal(body);
+}
+
+std::string
+removeRecord(std::wstring_view t_phrase)
+{
+  std::string body = "-\t";
+  escapeInto(body, t_phrase);
+  return seal(body);
+}
+
+// the fields after the checksum, none if
+//  it doesn't match
+std::vector<std::wstring>
+unseal(std::string_view t_line)
+{
+  std::vector<std::wstring> fields;
+  if(t_line.size() < 10 || t_line[8] != '\t')
+    return fields;
+
+  uint32_t sum = 0;
+  for(size_t i = 0; i < 8; ++i)
+  {
+    char c = t_line[i];
+    if(c >= '0' && c <= '9')
+      sum = (sum << 4) | static_cast<uint32_t>(c - '0');
+    else if(c >= 'a' && c <= 'f')
+      sum = (sum << 4) | static_cast<uint32_t>(c - 'a' + 10);
+    else
+      return fields;
+  }
+  std::string_view body = t_line.substr(9);
+  if(fnv1a32(body) != sum)
+    return fields;
+
+  std::string field;
+  for(size_t i = 0; i < body.size(); ++i)
+  {
+    char c = body[i];
+    if(c == '\t')
+    {
+      fields.push_back(from_utf8(field));
+      field.clear();
+    }
+    else if(c == '\\' && i + 1 < body.size())
+    {
+      char next = body[++i];
+      field.push_back(next == 't' ? '\t' : next == 'n' ? '\n' : next == 'r' ? '\r' : next);
+    }
+    else
+      field.push_back(c);
+  }
+  fields.push_back(from_utf8(field));
+  return fields;
+}
+
+std::FILE*
+openFile(std::filesystem::path const& t_path, char const* t_mode)
+{
+#ifdef _WIN32
+  std::wstring mode(t_mode, t_mode + std::char_traits<char>::length(t_mode));
+  return _wfopen(t_path.c_str(), mode.c_str());
+#else
+  return std::fopen(t_path.c_str(), t_mode);
+#endif
+}
+
+// returns once the bytes are on the disk,
+//  not just handed to the OS
+void
+writeDurably(std::FILE* t_file, std::string const& t_bytes)
+{
+  if(std::fwrite(t_bytes.data(), 1, t_bytes.size(), t_file) != t_bytes.size() ||
+     std::fflush(t_file) != 0)
+    throw std::runtime_error("Failed to write the command journal.");
+#ifdef _WIN32
+  int synced = _commit(_fileno(t_file));
+#else
+  int synced = fsync(fileno(t_file));
+#endif
+  if(synced != 0)
+    throw std::runtime_error("Failed to flush the command journal to disk.");
+}
+}
+
+HNx::Journal::Journal(std::wstring t_path,
+                      std::chrono::milliseconds t_syncEvery)
+  : m_path(std::move(t_path))
+  , m_logPath(m_path + L".log")
+  , m_syncEvery(t_syncEvery)
+{
+  replay(m_path);
+  m_stats.records = replay(m_logPath);
+  m_stats.recovered = m_entries.size();
+
+  // what a crash cut short is cut off
+  //  before anything is appended after it
+  if(m_stats.dropped)
+  {
+    std::vector<Entry> entries;
+    entries.reserve(m_entries.size());
+    for(auto const& e : m_entries)
+      entries.push_back(e.second);
+    compact(entries);
+    m_stats.records = 0;
+    ++m_stats.compactions;
+  }
+  else
+    open_log("ab");
+
+  m_writer = std::thread(&Journal::run, this);
+}
+
+HNx::Journal::~Journal()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_stopping = true;
+  }
+  m_wake.notify_all();
+  if(m_writer.joinable())
+    m_writer.join();
+  if(m_log)
+    std::fclose(m_log);
+}
+
+void
+HNx::Journal::put(Command const& t_cmd)
+{
+  if(t_cmd.phrase().empty() || t_cmd.exec().empty())
+    return;
+
+  std::wstring key = lower_key(t_cmd.phrase());
+  std::lock_guard<std::mutex> lock(m_mtx);
+  Entry& entry = m_entries[key];
+  if(entry.phrase == t_cmd.phrase() && entry.exec == t_cmd.exec() && entry.param == t_cmd.param())
+    return;
+
+  entry = {t_cmd.phrase(), t_cmd.exec(), t_cmd.param()};
+  append(putRecord(entry.phrase, entry.exec, entry.param));
+}
+
+void
+HNx::Journal::remove(std::wstring_view t_phrase)
+{
+  std::wstring key = lower_key(t_phrase);
+  std::lock_guard<std::mutex> lock(m_mtx);
+  auto it = m_entries.find(key);
+  if(it == m_entries.end())
+    return;
+
+  append(removeRecord(it->second.phrase));
+  m_entries.erase(it);
+}
+
+std::vector<Command>
+HNx::Journal::commands() const
+{
+  std::vector<std::pair<std::wstring, Command>> sorted;
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    sorted.reserve(m_entries.size());
+    for(auto const& e : m_entries)
+      sorted.emplace_back(e.first, Command(e.second.phrase, e.second.exec, e.second.param));
+  }
+  std::sort(sorted.begin(), sorted.end(),
+            [](auto const& a, auto const& b) { return a.first < b.first; });
+
+  std::vector<Command> cmds;
+  cmds.reserve(sorted.size());
+  for(auto& entry : sorted)
+    cmds.push_back(std::move(entry.second));
+  return cmds;
+}
+
+size_t
+HNx::Journal::size() const
+{
+  std::lock_guard<std::mutex> lock(m_mtx);
+  return m_entries.size();
+}
+
+void
+HNx::Journal::sync()
+{
+  std::unique_lock<std::mutex> lock(m_mtx);
+  uint64_t target = m_appended;
+  uint64_t failures = m_failures;
+  if(m_durable >= target)
+    return;
+
+  m_syncNow = true;
+  m_wake.notify_all();
+  m_written.wait(lock, [&] { return m_durable >= target || m_failures != failures; });
+  if(m_durable < target)
+    throw std::runtime_error(m_error);
+}
+
+JournalStats
+HNx::Journal::stats() const
+{
+  std::lock_guard<std::mutex> lock(m_mtx);
+  return m_stats;
+}
+
+size_t
+HNx::Journal::replay(std::wstring const& t_path)
+{
+  std::ifstream in(std::filesystem::path(t_path), std::ios::binary);
+  if(!in)
+    return 0;
+  std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+  size_t records = 0;
+  for(size_t begin = 0; begin < data.size();)
+  {
+    // a record without its newline was
+    //  being written when it stopped, as is
+    //  one that fails its checksum, nothing
+    //  after either can be trusted
+    size_t end = data.find('\n', begin);
+    auto fields = end == std::string::npos ? std::vector<std::wstring> {}
+                                           : unseal(std::string_view(data).substr(begin, end - begin));
+    bool put = fields.size() == 4 && fields[0] == L"+" && !fields[1].empty() && !fields[2].empty();
+    bool removed = fields.size() == 2 && fields[0] == L"-";
+    if(!put && !removed)
+    {
+      ++m_stats.dropped;
+      break;
+    }
+
+    std::wstring key = lower_key(fields[1]);
+    if(put)
+      m_entries[key] = {std::move(fields[1]), std::move(fields[2]), std::move(fields[3])};
+    else
+      m_entries.erase(key);
+    ++records;
+    begin = end + 1;
+  }
+  return records;
+}
+
+void
+HNx::Journal::append(std::string&& t_record)
+{
+  if(m_pending.empty())
+    m_pending = std::move(t_record);
+  else
+    m_pending += t_record;
+  ++m_pendingRecords;
+  ++m_appended;
+  ++m_stats.records;
+  m_wake.notify_one();
+}
+
+void
+HNx::Journal::run()
+{
+  std::unique_lock<std::mutex> lock(m_mtx);
+  while(true)
+  {
+    m_wake.wait(lock, [this] { return m_stopping || m_pendingRecords; });
+
+    // the rest of a burst joins the batch,
+    //  one flush to disk covers all of it
+    m_wake.wait_for(lock, m_syncEvery, [this] { return m_stopping || m_syncNow; });
+    m_syncNow = false;
+    if(!m_pendingRecords)
+    {
+      if(m_stopping)
+        break;
+      continue;
+    }
+
+    std::string batch;
+    batch.swap(m_pending);
+    size_t count = m_pendingRecords;
+    m_pendingRecords = 0;
+    uint64_t last = m_appended;
+
+    // the snapshot has the batch in it, the
+    //  journal it replaces is emptied once
+    //  it has the batch too
+    bool compacting = m_stats.records >= MIN_RECORDS_TO_COMPACT && m_stats.records > m_entries.size();
+    std::vector<Entry> entries;
+    if(compacting)
+    {
+      entries.reserve(m_entries.size());
+      for(auto const& e : m_entries)
+        entries.push_back(e.second);
+    }
+
+    lock.unlock();
+    std::string error;
+    try
+    {
+      // a failed compaction may have closed it
+      if(!m_log)
+        open_log("ab");
+      writeDurably(m_log, batch);
+    }
+    catch(std::exception const& e)
+    {
+      error = e.what();
+    }
+
+    // the batch is on disk either way, a
+    //  snapshot that fails is tried again
+    //  with the next batch
+    bool compacted = false;
+    if(error.empty() && compacting)
+    {
+      try
+      {
+        compact(entries);
+        compacted = true;
+      }
+      catch(std::exception const&)
+      {}
+    }
+    lock.lock();
+
+    if(error.empty())
+    {
+      m_durable = last;
+      ++m_stats.syncs;
+      if(compacted)
+      {
+        ++m_stats.compactions;
+        m_stats.records = m_pendingRecords;
+      }
+    }
+    else
+    {
+      // tried again with the next batch,
+      //  unless closing
+      m_error = std::move(error);
+      ++m_failures;
+      batch += m_pending;
+      m_pending.swap(batch);
+      m_pendingRecords += count;
+      if(m_stopping)
+      {
+        m_written.notify_all();
+        break;
+      }
+    }
+    m_written.notify_all();
+  }
+}
+
+void
+HNx::Journal::compact(std::vector<Entry> const& t_entries)
+{
+  std::string data;
+  for(auto const& e : t_entries)
+    data += putRecord(e.phrase, e.exec, e.param);
+
+  std::filesystem::path path(m_path);
+  std::filesystem::path tmp = path;
+  tmp += L".tmp";
+  std::FILE* out = openFile(tmp, "wb");
+  if(!out)
+    throw std::runtime_error("Failed to write the command snapshot.");
+  try
+  {
+    writeDurably(out, data);
+  }
+  catch(...)
+  {
+    std::fclose(out);
+    throw;
+  }
+  std::fclose(out);
+
+  std::error_code ec;
+  std::filesystem::rename(tmp, path, ec);
+  if(ec)
+    throw std::runtime_error("Failed to replace the command snapshot.");
+
+  // a crash before this replays the old
+  //  journal over the new snapshot; it
+  //  holds every change the snapshot does,
+  //  so every phrase it touches ends as the
+  //  snapshot has it
+  open_log("wb");
+  writeDurably(m_log, {});
+}
+
+void
+HNx::Journal::open_log(char const* t_mode)
+{
+  if(m_log)
+    std::fclose(m_log);
+  m_log = nullptr;
+  m_log = openFile(std::filesystem::path(m_logPath), t_mode);
+  if(!m_log)
+    throw std::runtime_error("Failed to open the command journal.");
+}
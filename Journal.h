@@ -0,0 +1,159 @@
+#pragma once
+#include "Command.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+//   The user's commands on disk. Every add,
+//  update and remove is appended to a
+//  journal, a thread of its own writes
+//  what piled up and flushes it to the disk
+//  once per batch, so a change costs the
+//  same however many commands there are.
+//  Once the journal outgrows the commands
+//  it describes they are written out as a
+//  snapshot and the journal starts over
+//
+//  <path> holds the snapshot, <path>.log the
+//  journal, both one record per line:
+//  <checksum><TAB>+<TAB>phrase<TAB>exec<TAB>param
+//  or <checksum><TAB>-<TAB>phrase. Opening
+//  replays the snapshot, then the journal up
+//  to the first record a crash cut short
+
+namespace HNx
+{
+
+struct JournalStats
+{
+  // what was recovered when opened
+  size_t recovered {0};
+
+  // records dropped as cut short or corrupt
+  size_t dropped {0};
+
+  // records in the journal since the last
+  //  snapshot, written or not
+  size_t records {0};
+
+  uint64_t syncs {0};
+  uint64_t compactions {0};
+};
+
+class Journal
+{
+public:
+  // opens or creates t_path and replays it,
+  //  throws std::runtime_error if it can't
+  //  be opened
+  // an append waits at most t_syncEvery
+  //  before it is on disk
+  explicit Journal(std::wstring t_path,
+                   std::chrono::milliseconds t_syncEvery = std::chrono::milliseconds(50));
+
+  // writes what is pending first
+  ~Journal();
+
+  Journal(Journal const&) = delete;
+  Journal& operator=(Journal const&) = delete;
+
+  // adds or replaces the command with the
+  //  same phrase (case insensitive), one
+  //  identical to it isn't journaled
+  void
+    put(Command const& t_cmd);
+
+  void
+    remove(std::wstring_view t_phrase);
+
+  // the commands as journaled so far,
+  //  ascending by phrase
+  std::vector<Command>
+    commands() const;
+
+  size_t
+    size() const;
+
+  // returns once everything appended before
+  //  it is on disk, throws std::runtime_error
+  //  if writing it failed
+  void
+    sync();
+
+  JournalStats
+    stats() const;
+
+private:
+  struct Entry
+  {
+    std::wstring phrase {};
+    std::wstring exec {};
+    std::wstring param {};
+  };
+
+  // replays one file into m_entries,
+  //  returns the records applied
+  size_t
+    replay(std::wstring const& t_path);
+
+  void
+    append(std::string&& t_record);
+
+  void
+    run();
+
+  // writes the snapshot, empties the journal
+  //  which must already hold every change
+  //  t_entries has
+  void
+    compact(std::vector<Entry> const& t_entries);
+
+  void
+    open_log(char const* t_mode);
+
+  std::wstring m_path {};
+  std::wstring m_logPath {};
+  std::chrono::milliseconds m_syncEvery {};
+
+  // keyed by the lower case phrase
+  std::unordered_map<std::wstring, Entry> m_entries {};
+
+  // only the writer touches it once
+  //  constructed
+  std::FILE* m_log {nullptr};
+
+  // appended, not yet written
+  std::string m_pending {};
+  size_t m_pendingRecords {0};
+
+  // records are numbered as appended,
+  //  the writer publishes the last one
+  //  on disk
+  uint64_t m_appended {0};
+  uint64_t m_durable {0};
+
+  // the last batch that failed to write,
+  //  and how many have
+  std::string m_error {};
+  uint64_t m_failures {0};
+
+  JournalStats m_stats {};
+  bool m_syncNow {false};
+  bool m_stopping {false};
+
+  mutable std::mutex m_mtx {};
+  std::condition_variable m_wake {};
+  std::condition_variable m_written {};
+
+  std::thread m_writer {};
+};
+
+}
@@ -0,0 +1,648 @@
+#include "Keyword.h"
+#include "Util.h"
+#include "Vad.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+//=================================//
+// HNx Voice Command Keyword       //
+//=================================//
+// Hears the hotword without the   //
+//  full recognizer                //
+//=================================//
+
+using namespace HNx;
+
+namespace
+{
+
+// cepstra used, c0 is left out so the
+//  loudness of the speaker doesn't matter
+constexpr size_t FirstCepstrum {1};
+constexpr size_t Cepstra {12};
+
+// one standard deviation in byte units
+constexpr float QuantStep {32.0f};
+
+// frames quieter than the loudest by more
+//  than this, or too close to the noise
+//  floor, are trimmed from examples
+constexpr float TrimDb {35.0f};
+constexpr float TrimAboveFloorDb {10.0f};
+
+// shortest example kept, 150ms
+constexpr size_t MinFrames {15};
+
+// how far the furthest example may be from
+//  its nearest neighbour and still be heard
+constexpr float ThresholdMargin {1.3f};
+
+// for a model of a single example
+constexpr float SingleExampleThreshold {0.45f * QuantStep * Cepstra};
+
+// frames after a detection it can't fire
+//  again, half a second
+constexpr size_t RefractoryFrames {50};
+
+constexpr float NoPath {1e30f};
+
+uint16_t
+sad_scalar(uint8_t const* a, uint8_t const* b)
+{
+  uint16_t sum = 0;
+  for(size_t i = 0; i < KwsDims; ++i)
+    sum += static_cast<uint16_t>(a[i] > b[i] ? a[i] - b[i] : b[i] - a[i]);
+  return sum;
+}
+
+#ifdef HNX_X86
+HNX_TARGET_SSE
+void
+distances_sse(uint8_t const* t_frame, uint8_t const* t_template, size_t t_frames, uint16_t* t_out)
+{
+  __m128i q = _mm_loadu_si128(reinterpret_cast<__m128i const*>(t_frame));
+  for(size_t j = 0; j < t_frames; ++j)
+  {
+    __m128i t = _mm_loadu_si128(reinterpret_cast<__m128i const*>(t_template + j * KwsDims));
+    __m128i s = _mm_sad_epu8(q, t);
+    t_out[j] = static_cast<uint16_t>(_mm_cvtsi128_si32(s) + _mm_extract_epi16(s, 4));
+  }
+}
+
+// two template frames per instruction
+HNX_TARGET_AVX2
+void
+distances_avx2(uint8_t const* t_frame, uint8_t const* t_template, size_t t_frames, uint16_t* t_out)
+{
+  __m256i q = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<__m128i const*>(t_frame)));
+  size_t j = 0;
+  for(; j + 2 <= t_frames; j += 2)
+  {
+    __m256i t = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(t_template + j * KwsDims));
+    __m256i s = _mm256_sad_epu8(q, t);
+    __m128i lo = _mm256_castsi256_si128(s);
+    __m128i hi = _mm256_extracti128_si256(s, 1);
+    t_out[j] = static_cast<uint16_t>(_mm_cvtsi128_si32(lo) + _mm_extract_epi16(lo, 4));
+    t_out[j + 1] = static_cast<uint16_t>(_mm_cvtsi128_si32(hi) + _mm_extract_epi16(hi, 4));
+  }
+  for(; j < t_frames; ++j)
+    t_out[j] = sad_scalar(t_frame, t_template + j * KwsDims);
+}
+#endif
+
+}
+
+//=========================================================================
+//  KeywordModel
+//=========================================================================
+
+std::vector<float>
+HNx::KeywordModel::features(std::vector<int16_t> const& t_samples, size_t& t_frames)
+{
+  MfccExtractor mfcc;
+  t_frames = mfcc.frames(t_samples.size());
+  std::vector<float> cepstra(t_frames * mfcc.config().cepstra);
+  mfcc.mfcc(t_samples.data(), t_samples.size(), cepstra.data());
+  return cepstra;
+}
+
+void
+HNx::KeywordModel::quantize(float const* t_cepstra, uint8_t* t_out) const
+{
+  for(size_t d = 0; d < KwsDims; ++d)
+  {
+    float v = d < Cepstra ? 128.0f + t_cepstra[FirstCepstrum + d] * m_scale[d] : 128.0f;
+    t_out[d] = static_cast<uint8_t>(std::clamp(std::lround(v), 0l, 255l));
+  }
+}
+
+KeywordModel
+HNx::KeywordModel::enroll(std::vector<std::vector<int16_t>> const& t_examples)
+{
+  MfccConfig config;
+  size_t width = config.cepstra;
+
+  // features of the loud part of each example
+  std::vector<std::vector<float>> kept;
+  for(auto const& example : t_examples)
+  {
+    size_t frames = 0;
+    std::vector<float> cepstra = features(example, frames);
+
+    if(frames == 0)
+      continue;
+
+    std::vector<float> energy(frames);
+    for(size_t f = 0; f < frames; ++f)
+      energy[f] = Vad::energyDb(example.data() + f * config.frameShift, config.frameLength);
+
+    // the quietest tenth of the example
+    //  is taken as its noise
+    std::vector<float> sorted = energy;
+    std::nth_element(sorted.begin(), sorted.begin() + frames / 10, sorted.end());
+    float floor = sorted[frames / 10];
+    float loudest = *std::max_element(energy.begin(), energy.end());
+    float cut = std::max({loudest - TrimDb, floor + TrimAboveFloorDb, -60.0f});
+
+    size_t first = frames;
+    size_t last = 0;
+    for(size_t f = 0; f < frames; ++f)
+    {
+      if(energy[f] > cut)
+      {
+        first = std::min(first, f);
+        last = f;
+      }
+    }
+    if(first > last || last - first + 1 < MinFrames)
+      continue;
+
+    kept.emplace_back(cepstra.begin() + first * width, cepstra.begin() + (last + 1) * width);
+  }
+  if(kept.empty())
+    throw std::invalid_argument("No keyword example holds enough audio");
+
+  // every dimension gets the same spread
+  //  in bytes
+  KeywordModel model;
+  for(size_t d = 0; d < Cepstra; ++d)
+  {
+    double sum = 0.0;
+    double sumSq = 0.0;
+    size_t n = 0;
+    for(auto const& cepstra : kept)
+    {
+      for(size_t f = 0; f < cepstra.size() / width; ++f)
+      {
+        double v = cepstra[f * width + FirstCepstrum + d];
+        sum += v;
+        sumSq += v * v;
+        ++n;
+      }
+    }
+    double mean = sum / static_cast<double>(n);
+    double deviation = std::sqrt(std::max(sumSq / static_cast<double>(n) - mean * mean, 1e-6));
+    model.m_scale[d] = static_cast<float>(QuantStep / deviation);
+  }
+
+  for(auto const& cepstra : kept)
+  {
+    size_t frames = cepstra.size() / width;
+    std::vector<uint8_t> bytes(frames * KwsDims);
+    for(size_t f = 0; f < frames; ++f)
+      model.quantize(cepstra.data() + f * width, bytes.data() + f * KwsDims);
+    model.m_templates.push_back(std::move(bytes));
+  }
+
+  if(model.m_templates.size() == 1)
+  {
+    model.m_threshold = SingleExampleThreshold;
+    return model;
+  }
+
+  // how well each example is found in the
+  //  others, against a model of just it
+  float furthest = 0.0f;
+  for(size_t t = 0; t < model.m_templates.size(); ++t)
+  {
+    auto single = std::make_shared<KeywordModel>(model);
+    single->m_templates = {model.m_templates[t]};
+    single->m_threshold = -1.0f;
+
+    float nearest = NoPath;
+    for(size_t other = 0; other < model.m_templates.size(); ++other)
+    {
+      if(other == t)
+        continue;
+
+      KeywordSpotter spotter(single);
+      auto const& query = model.m_templates[other];
+      for(size_t f = 0; f < query.size() / KwsDims; ++f)
+      {
+        spotter.step(query.data() + f * KwsDims);
+        nearest = std::min(nearest, spotter.lastScore());
+      }
+    }
+    furthest = std::max(furthest, nearest);
+  }
+  model.m_threshold = furthest * ThresholdMargin;
+  return model;
+}
+
+float
+HNx::KeywordModel::threshold() const
+{
+  return m_threshold;
+}
+
+void
+HNx::KeywordModel::setThreshold(float t_threshold)
+{
+  m_threshold = t_threshold;
+}
+
+size_t
+HNx::KeywordModel::templates() const
+{
+  return m_templates.size();
+}
+
+size_t
+HNx::KeywordModel::bytes() const
+{
+  size_t total = sizeof(*this);
+  for(auto const& t : m_templates)
+    total += t.size();
+  return total;
+}
+
+//=========================================================================
+//  KeywordSpotter
+//=========================================================================
+
+HNx::KeywordSpotter::KeywordSpotter(std::shared_ptr<KeywordModel const> t_model, SimdLevel t_simd)
+  : m_model(std::move(t_model))
+  , m_simd(usableSimd(t_simd))
+  , m_mfcc(MfccConfig {}, t_simd)
+{
+  if(!m_model)
+    throw std::invalid_argument("KeywordSpotter needs a model");
+
+  size_t longest = 0;
+  for(auto const& t : m_model->m_templates)
+  {
+    size_t frames = t.size() / KwsDims;
+    longest = std::max(longest, frames);
+
+    Path path;
+    path.cost.assign(frames, NoPath);
+    path.steps.assign(frames, 0);
+    path.held.assign(frames, 0);
+    m_paths.push_back(std::move(path));
+  }
+  m_next.cost.resize(longest);
+  m_next.steps.resize(longest);
+  m_next.held.resize(longest);
+  m_dist.resize(longest);
+  m_lastScore = NoPath;
+}
+
+void
+HNx::KeywordSpotter::distances(uint8_t const* t_frame, std::vector<uint8_t> const& t_template, uint16_t* t_out) const
+{
+  size_t frames = t_template.size() / KwsDims;
+#ifdef HNX_X86
+  if(m_simd == SimdLevel::Avx2)
+    return distances_avx2(t_frame, t_template.data(), frames, t_out);
+  if(m_simd == SimdLevel::Sse)
+    return distances_sse(t_frame, t_template.data(), frames, t_out);
+#endif
+  for(size_t j = 0; j < frames; ++j)
+    t_out[j] = sad_scalar(t_frame, t_template.data() + j * KwsDims);
+}
+
+bool
+HNx::KeywordSpotter::step(uint8_t const* t_frame)
+{
+  float best = NoPath;
+  for(size_t t = 0; t < m_paths.size(); ++t)
+  {
+    auto const& tmpl = m_model->m_templates[t];
+    Path& path = m_paths[t];
+    size_t frames = path.cost.size();
+    distances(t_frame, tmpl, m_dist.data());
+
+    // every input frame advances the path,
+    //  the template may hold a frame once or
+    //  skip one, so the keyword can be said
+    //  from half to twice as fast
+    for(size_t j = 0; j < frames; ++j)
+    {
+      float cost = 0.0f;
+      uint16_t steps = 0;
+      uint8_t held = 0;
+      if(j > 0)
+      {
+        cost = path.cost[j - 1];
+        steps = path.steps[j - 1];
+        if(j > 1 && path.cost[j - 2] < cost)
+        {
+          cost = path.cost[j - 2];
+          steps = path.steps[j - 2];
+        }
+        if(!path.held[j] && path.cost[j] < cost)
+        {
+          cost = path.cost[j];
+          steps = path.steps[j];
+          held = 1;
+        }
+      }
+      m_next.cost[j] = cost >= NoPath ? NoPath : cost + m_dist[j];
+      m_next.steps[j] = static_cast<uint16_t>(steps + 1);
+      m_next.held[j] = held;
+    }
+    std::copy_n(m_next.cost.begin(), frames, path.cost.begin());
+    std::copy_n(m_next.steps.begin(), frames, path.steps.begin());
+    std::copy_n(m_next.held.begin(), frames, path.held.begin());
+
+    if(path.cost[frames - 1] < NoPath)
+      best = std::min(best, path.cost[frames - 1] / path.steps[frames - 1]);
+  }
+  m_lastScore = best;
+
+  if(m_refractory)
+  {
+    --m_refractory;
+    return false;
+  }
+  if(best > m_model->m_threshold)
+    return false;
+
+  for(auto& path : m_paths)
+    std::fill(path.cost.begin(), path.cost.end(), NoPath);
+  m_refractory = RefractoryFrames;
+  return true;
+}
+
+bool
+HNx::KeywordSpotter::push(int16_t const* t_samples, size_t t_count)
+{
+  m_pending.insert(m_pending.end(), t_samples, t_samples + t_count);
+  size_t frames = m_mfcc.frames(m_pending.size());
+  if(frames == 0)
+    return false;
+
+  size_t width = m_mfcc.config().cepstra;
+  if(m_cepstra.size() < frames * width)
+    m_cepstra.resize(frames * width);
+  m_mfcc.mfcc(m_pending.data(), m_pending.size(), m_cepstra.data());
+  m_pending.erase(m_pending.begin(), m_pending.begin() + frames * m_mfcc.config().frameShift);
+
+  bool heard = false;
+  for(size_t f = 0; f < frames; ++f)
+  {
+    m_model->quantize(m_cepstra.data() + f * width, m_frame);
+    heard |= step(m_frame);
+  }
+  return heard;
+}
+
+void
+HNx::KeywordSpotter::reset()
+{
+  m_pending.clear();
+  for(auto& path : m_paths)
+  {
+    std::fill(path.cost.begin(), path.cost.end(), NoPath);
+    std::fill(path.held.begin(), path.held.end(), uint8_t {0});
+  }
+  m_lastScore = NoPath;
+  m_refractory = 0;
+}
+
+float
+HNx::KeywordSpotter::lastScore() const
+{
+  return m_lastScore;
+}
+
+std::shared_ptr<KeywordModel const>
+HNx::KeywordSpotter::model() const
+{
+  return m_model;
+}
+
+//=========================================================================
+//  Evaluation
+//=========================================================================
+
+KeywordRates
+HNx::evaluateKeyword(KeywordModel const& t_model,
+                     std::vector<std::vector<int16_t>> const& t_positives,
+                     std::vector<std::vector<int16_t>> const& t_negatives,
+                     float t_threshold)
+{
+  auto model = std::make_shared<KeywordModel>(t_model);
+  if(t_threshold > 0.0f)
+    model->setThreshold(t_threshold);
+
+  KeywordRates rates;
+  rates.threshold = model->threshold();
+
+  // a little silence after each recording
+  //  lets a keyword at its very end finish
+  std::vector<int16_t> silence(AudioSampleRate / 2, 0);
+
+  for(auto const& positive : t_positives)
+  {
+    KeywordSpotter spotter(model);
+    bool heard = spotter.push(positive.data(), positive.size());
+    heard |= spotter.push(silence.data(), silence.size());
+    ++rates.positives;
+    if(!heard)
+      ++rates.missed;
+  }
+
+  for(auto const& negative : t_negatives)
+  {
+    KeywordSpotter spotter(model);
+    for(size_t at = 0; at < negative.size(); at += AudioFrameSamples)
+    {
+      size_t n = std::min(AudioFrameSamples, negative.size() - at);
+      if(spotter.push(negative.data() + at, n))
+        ++rates.falseAccepts;
+    }
+    rates.negativeHours += static_cast<double>(negative.size()) / AudioSampleRate / 3600.0;
+  }
+  return rates;
+}
+
+//=========================================================================
+//  KeywordGate
+//=========================================================================
+
+HNx::KeywordGate::KeywordGate(std::shared_ptr<AudioRing> t_in,
+                              std::shared_ptr<AudioRing> t_out,
+                              std::shared_ptr<KeywordModel const> t_model,
+                              std::function<void()> t_onKeyword)
+  : m_in(std::move(t_in))
+  , m_out(std::move(t_out))
+  , m_spotter(std::move(t_model))
+  , m_onKeyword(std::move(t_onKeyword))
+{
+  if(!m_in || !m_out)
+    throw std::invalid_argument("KeywordGate needs an input and an output ring");
+}
+
+HNx::KeywordGate::~KeywordGate()
+{
+  stop();
+}
+
+void
+HNx::KeywordGate::start()
+{
+  if(m_thread.joinable())
+    return;
+  m_thread = std::thread(&KeywordGate::run, this);
+}
+
+void
+HNx::KeywordGate::stop()
+{
+  m_in->close();
+  if(m_thread.joinable())
+    m_thread.join();
+  m_out->close();
+}
+
+void
+HNx::KeywordGate::setOpen(bool t_open)
+{
+  m_open = t_open;
+}
+
+KeywordGateStats
+HNx::KeywordGate::stats() const
+{
+  return {m_framesSpotted.load(std::memory_order_relaxed),
+          m_framesForwarded.load(std::memory_order_relaxed),
+          m_detections.load(std::memory_order_relaxed)};
+}
+
+void
+HNx::KeywordGate::run()
+{
+  bool wasOpen = false;
+  while(m_in->waitFrame())
+  {
+    int16_t const* frame = m_in->readFrame();
+    bool open = m_open.load(std::memory_order_acquire);
+    if(open)
+    {
+      if(m_out->push(frame))
+        m_framesForwarded.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+      // what it heard before it was
+      //  opened is stale now
+      if(wasOpen)
+        m_spotter.reset();
+
+      m_framesSpotted.fetch_add(1, std::memory_order_relaxed);
+      if(m_spotter.push(frame, AudioFrameSamples))
+      {
+        m_detections.fetch_add(1, std::memory_order_relaxed);
+        m_open = true;
+        open = true;
+        if(m_onKeyword)
+          m_onKeyword();
+      }
+    }
+    wasOpen = open;
+    m_in->releaseFrame();
+  }
+  m_out->close();
+}
+
+//=========================================================================
+//  Command line
+//=========================================================================
+
+std::vector<std::vector<int16_t>>
+HNx::readKeywordExamples(std::wstring const& t_dir)
+{
+  std::error_code ec;
+  std::filesystem::directory_iterator it(std::filesystem::path(t_dir), ec);
+  if(ec)
+    throw std::runtime_error("Failed to read corpus directory: " + to_utf8(t_dir));
+
+  std::vector<std::wstring> paths;
+  for(auto const& entry : it)
+  {
+    std::wstring ext = entry.path().extension().wstring();
+    if(entry.is_regular_file(ec) && (icase_equal(ext, L".wav") || icase_equal(ext, L".pcm")))
+      paths.push_back(entry.path().wstring());
+  }
+  std::sort(paths.begin(), paths.end());
+
+  std::vector<std::vector<int16_t>> corpus;
+  for(auto const& path : paths)
+  {
+    FileSource source(path);
+    std::vector<int16_t> samples;
+    int16_t buffer[4096];
+    while(size_t n = source.read(buffer, std::size(buffer)))
+      samples.insert(samples.end(), buffer, buffer + n);
+    corpus.push_back(std::move(samples));
+  }
+  return corpus;
+}
+
+int
+HNx::runKeywordCli(std::vector<std::wstring> const& t_args)
+{
+  std::wstring enroll, positive, negative;
+  float threshold = 0.0f;
+  for(size_t i = 0; i + 1 < t_args.size(); ++i)
+  {
+    std::wstring const& arg = t_args[i];
+    if(arg == L"--enroll")
+      enroll = t_args[++i];
+    else if(arg == L"--positive")
+      positive = t_args[++i];
+    else if(arg == L"--negative")
+      negative = t_args[++i];
+    else if(arg == L"--threshold")
+      threshold = std::wcstof(t_args[++i].c_str(), nullptr);
+  }
+
+  if(enroll.empty() || positive.empty() || negative.empty())
+  {
+    std::cerr << "usage: --kws-eval --enroll <dir> --positive <dir> --negative <dir> [--threshold <t>]\n";
+    return 1;
+  }
+
+  try
+  {
+    KeywordModel model = KeywordModel::enroll(readKeywordExamples(enroll));
+    if(threshold > 0.0f)
+      model.setThreshold(threshold);
+    auto positives = readKeywordExamples(positive);
+    auto negatives = readKeywordExamples(negative);
+
+    std::cout << model.templates() << " examples, " << model.bytes() << " bytes, "
+              << "threshold " << model.threshold() << ", " << simdName(detectSimd()) << "\n";
+
+    // time taken on the negatives is what
+    //  it costs while waiting for the hotword
+    std::cout << "threshold\tFRR\tFA/h\tcpu\n";
+    for(float scale : {0.8f, 0.9f, 1.0f, 1.1f, 1.25f})
+    {
+      auto start = std::chrono::steady_clock::now();
+      KeywordRates rates = evaluateKeyword(model, positives, negatives, model.threshold() * scale);
+      double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      double audio = rates.negativeHours * 3600.0;
+      for(auto const& p : positives)
+        audio += static_cast<double>(p.size()) / AudioSampleRate + 0.5;
+
+      std::cout << std::fixed << std::setprecision(1) << rates.threshold << '\t'
+                << std::setprecision(3) << rates.falseRejectRate() << '\t'
+                << std::setprecision(2) << rates.falseAcceptsPerHour() << '\t'
+                << std::setprecision(2) << (audio > 0.0 ? 100.0 * seconds / audio : 0.0) << "%\n";
+    }
+  }
+  catch(std::exception const& e)
+  {
+    std::cerr << e.what() << "\n";
+    return 2;
+  }
+  return 0;
+}
@@ -0,0 +1,245 @@
+#pragma once
+#include "Audio.h"
+#include "Features.h"
+#include "Simd.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+//   A small keyword spotter for the hotword,
+//  so the full recognizer can sleep until
+//  it is said
+//
+//  The model is a handful of examples of the
+//  keyword as MFCC frames quantized to bytes.
+//  Incoming frames are matched against every
+//  example at once with a subsequence DTW,
+//  byte distances come from SAD instructions.
+//  New hotwords only need new examples, no
+//  training
+
+namespace HNx
+{
+
+// bytes per quantized frame, cepstra 1-12
+//  and zero padding
+constexpr size_t KwsDims {16};
+
+class KeywordModel
+{
+public:
+  // t_examples are recordings of the keyword,
+  //  16kHz 16 bit mono, silence around them
+  //  is trimmed off
+  // throws std::invalid_argument if none of
+  //  them holds enough audio
+  static KeywordModel
+    enroll(std::vector<std::vector<int16_t>> const& t_examples);
+
+  // mean distance per frame a match may have,
+  //  set by enroll() from how far apart the
+  //  examples are
+  float
+    threshold() const;
+
+  void
+    setThreshold(float t_threshold);
+
+  size_t
+    templates() const;
+
+  // memory the examples take
+  size_t
+    bytes() const;
+
+private:
+  friend class KeywordSpotter;
+
+  KeywordModel() = default;
+
+  // features of a whole recording, one
+  //  MfccConfig frame per row
+  static std::vector<float>
+    features(std::vector<int16_t> const& t_samples, size_t& t_frames);
+
+  void
+    quantize(float const* t_cepstra, uint8_t* t_out) const;
+
+  // per dimension, scales one standard
+  //  deviation to QuantStep
+  float m_scale[KwsDims] {};
+
+  // KwsDims bytes per frame
+  std::vector<std::vector<uint8_t>> m_templates {};
+  float m_threshold {0.0f};
+};
+
+class KeywordSpotter
+{
+public:
+  explicit KeywordSpotter(std::shared_ptr<KeywordModel const> t_model,
+                          SimdLevel t_simd = detectSimd());
+
+  // 16kHz 16 bit mono, true if the keyword
+  //  ended somewhere in t_samples
+  bool
+    push(int16_t const* t_samples, size_t t_count);
+
+  void
+    reset();
+
+  // best match of the last frame, lower
+  //  is closer
+  float
+    lastScore() const;
+
+  std::shared_ptr<KeywordModel const>
+    model() const;
+
+private:
+  friend class KeywordModel;
+
+  bool
+    step(uint8_t const* t_frame);
+
+  void
+    distances(uint8_t const* t_frame, std::vector<uint8_t> const& t_template, uint16_t* t_out) const;
+
+  std::shared_ptr<KeywordModel const> m_model;
+  SimdLevel m_simd;
+  MfccExtractor m_mfcc;
+
+  std::vector<int16_t> m_pending {};
+  std::vector<float> m_cepstra {};
+  uint8_t m_frame[KwsDims] {};
+
+  // DTW column per template: cost so far,
+  //  input frames on the path and whether
+  //  its last step held the template frame
+  struct Path
+  {
+    std::vector<float> cost {};
+    std::vector<uint16_t> steps {};
+    std::vector<uint8_t> held {};
+  };
+  std::vector<Path> m_paths {};
+  Path m_next {};
+  std::vector<uint16_t> m_dist {};
+
+  float m_lastScore {0.0f};
+  size_t m_refractory {0};
+};
+
+struct KeywordRates
+{
+  float threshold {0.0f};
+
+  // keyword recordings it missed
+  size_t positives {0};
+  size_t missed {0};
+
+  // fires on audio without the keyword
+  size_t falseAccepts {0};
+  double negativeHours {0.0};
+
+  double
+    falseRejectRate() const
+  {
+    return positives ? static_cast<double>(missed) / static_cast<double>(positives) : 0.0;
+  }
+
+  double
+    falseAcceptsPerHour() const
+  {
+    return negativeHours > 0.0 ? static_cast<double>(falseAccepts) / negativeHours : 0.0;
+  }
+};
+
+// runs the spotter over a test corpus at
+//  t_threshold, the model's own for 0
+KeywordRates
+  evaluateKeyword(KeywordModel const& t_model,
+                  std::vector<std::vector<int16_t>> const& t_positives,
+                  std::vector<std::vector<int16_t>> const& t_negatives,
+                  float t_threshold = 0.0f);
+
+struct KeywordGateStats
+{
+  uint64_t framesSpotted {0};
+  uint64_t framesForwarded {0};
+  uint64_t detections {0};
+};
+
+// spots the keyword in one ring and, while
+//  open, passes the audio on to another
+class KeywordGate
+{
+public:
+  // t_onKeyword runs on the gate's thread
+  KeywordGate(std::shared_ptr<AudioRing> t_in,
+              std::shared_ptr<AudioRing> t_out,
+              std::shared_ptr<KeywordModel const> t_model,
+              std::function<void()> t_onKeyword);
+
+  // stops and closes the output ring
+  ~KeywordGate();
+
+  KeywordGate(KeywordGate const&) = delete;
+  KeywordGate& operator=(KeywordGate const&) = delete;
+
+  void
+    start();
+
+  // closes the input ring too, to wake
+  //  the gate if it is waiting on it
+  void
+    stop();
+
+  // open passes audio on, closed listens
+  //  for the keyword, the gate opens itself
+  //  when it hears it
+  void
+    setOpen(bool t_open);
+
+  KeywordGateStats
+    stats() const;
+
+private:
+  void
+    run();
+
+  std::shared_ptr<AudioRing> m_in;
+  std::shared_ptr<AudioRing> m_out;
+  KeywordSpotter m_spotter;
+  std::function<void()> m_onKeyword;
+
+  std::atomic<bool> m_open {false};
+  std::thread m_thread {};
+  std::atomic<uint64_t> m_framesSpotted {0};
+  std::atomic<uint64_t> m_framesForwarded {0};
+  std::atomic<uint64_t> m_detections {0};
+};
+
+// every .wav, in any rate, and .pcm, at
+//  16kHz 16 bit mono, in t_dir by name
+// throws std::runtime_error if t_dir can't
+//  be read
+std::vector<std::vector<int16_t>>
+  readKeywordExamples(std::wstring const& t_dir);
+
+// voicecommand --kws-eval --enroll <dir>
+//              --positive <dir> --negative <dir>
+//              [--threshold <t>]
+// .wav in any rate, .pcm at 16kHz 16 bit
+//  mono, prints the rates around the
+//  threshold
+// returns the process exit code
+int
+  runKeywordCli(std::vector<std::wstring> const& t_args);
+
+}
@@ -0,0 +1,288 @@
+#include "LaunchCache.h"
+#include "Predictor.h"
+#include "Util.h"
+
+#include <windows.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+//=================================//
+// HNx Voice Command Launch Cache  //
+//=================================//
+// Warms executables of commands   //
+//  that are likely to run next    //
+//=================================//
+
+using namespace HNx;
+
+namespace
+{
+// enough to cover the headers and
+//  startup code of most programs
+constexpr DWORD READ_AHEAD_BYTES = 1u << 20;
+
+// forget everything past this many
+//  programs, predictions only ever
+//  need a handful
+constexpr size_t MAX_ENTRIES = 256;
+}
+
+HNx::LaunchCache::LaunchCache()
+  : m_thread(&LaunchCache::worker, this)
+{}
+
+HNx::LaunchCache::~LaunchCache()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_stop = true;
+  }
+  m_cv.notify_all();
+  m_thread.join();
+}
+
+void
+HNx::LaunchCache::warm(std::wstring const& t_exec)
+{
+  if(t_exec.empty())
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if(m_entries.count(t_exec))
+      return;
+    m_queue.push_back(t_exec);
+  }
+  m_cv.notify_all();
+}
+
+std::wstring
+HNx::LaunchCache::resolve(std::wstring const& t_exec)
+{
+  std::lock_guard<std::mutex> lock(m_mtx);
+  auto it = m_entries.find(t_exec);
+  if(it == m_entries.end())
+  {
+    m_stats.misses++;
+    return t_exec;
+  }
+
+  // one not found may be installed since
+  //  and one found moved or uninstalled,
+  //  either is looked up again next time
+  if(!it->second.found || GetFileAttributesW(it->second.path.c_str()) == INVALID_FILE_ATTRIBUTES)
+  {
+    m_entries.erase(it);
+    m_stats.misses++;
+    return t_exec;
+  }
+  m_stats.hits++;
+  if(!it->second.credited)
+  {
+    m_stats.saved += it->second.search;
+    it->second.credited = true;
+  }
+  return it->second.path;
+}
+
+void
+HNx::LaunchCache::forget(std::wstring const& t_exec)
+{
+  std::lock_guard<std::mutex> lock(m_mtx);
+  m_entries.erase(t_exec);
+}
+
+LaunchCacheStats
+HNx::LaunchCache::stats() const
+{
+  std::lock_guard<std::mutex> lock(m_mtx);
+  return m_stats;
+}
+
+void
+HNx::LaunchCache::waitIdle()
+{
+  std::unique_lock<std::mutex> lock(m_mtx);
+  m_cv.wait(lock, [this]() { return m_queue.empty() && !m_busy; });
+}
+
+LaunchCache::Entry
+HNx::LaunchCache::lookup(std::wstring const& t_exec)
+{
+  auto start = std::chrono::steady_clock::now();
+  Entry entry;
+  entry.path = t_exec;
+
+  // urls and the like are left to ShellExecute
+  if(t_exec.find(L"://") == std::wstring::npos)
+  {
+    std::vector<wchar_t> path(MAX_PATH);
+    DWORD len = SearchPathW(nullptr, t_exec.c_str(), L".exe", static_cast<DWORD>(path.size()), path.data(), nullptr);
+    if(len > path.size())
+    {
+      path.resize(len);
+      len = SearchPathW(nullptr, t_exec.c_str(), L".exe", static_cast<DWORD>(path.size()), path.data(), nullptr);
+    }
+
+    entry.search = std::chrono::steady_clock::now() - start;
+    if(len > 0 && len < path.size())
+    {
+      entry.path.assign(path.data(), len);
+      entry.found = true;
+
+      // pull the start of the image into
+      //  the file cache
+      HANDLE hFile = CreateFileW(entry.path.c_str(),
+                                 GENERIC_READ,
+                                 FILE_SHARE_READ | FILE_SHARE_DELETE,
+                                 nullptr,
+                                 OPEN_EXISTING,
+                                 FILE_FLAG_SEQUENTIAL_SCAN,
+                                 nullptr);
+      if(hFile != INVALID_HANDLE_VALUE)
+      {
+        std::vector<char> buffer(64 * 1024);
+        DWORD total = 0;
+        DWORD got = 0;
+        while(total < READ_AHEAD_BYTES &&
+              ReadFile(hFile, buffer.data(), static_cast<DWORD>(buffer.size()), &got, nullptr) &&
+              got > 0)
+          total += got;
+        CloseHandle(hFile);
+      }
+    }
+  }
+  return entry;
+}
+
+void
+HNx::LaunchCache::worker()
+{
+  std::unique_lock<std::mutex> lock(m_mtx);
+  while(true)
+  {
+    m_cv.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+    if(m_stop)
+      return;
+
+    std::wstring exec = std::move(m_queue.front());
+    m_queue.pop_front();
+    if(!m_entries.count(exec))
+    {
+      m_busy = true;
+      lock.unlock();
+      Entry entry = lookup(exec);
+      lock.lock();
+      m_busy = false;
+
+      if(m_entries.size() >= MAX_ENTRIES)
+        m_entries.clear();
+      m_entries.emplace(std::move(exec), std::move(entry));
+      m_stats.warmed++;
+    }
+
+    // waitIdle() shares the condition
+    if(m_queue.empty())
+      m_cv.notify_all();
+  }
+}
+
+int
+HNx::runPrefetchBenchCli(std::vector<std::wstring> const& t_args)
+{
+  std::wstring history;
+  size_t order = 2;
+  size_t count = 3;
+  for(size_t i = 0; i + 1 < t_args.size(); ++i)
+  {
+    std::wstring const& arg = t_args[i];
+    if(arg == L"--prefetch-bench")
+      history = t_args[++i];
+    else if(arg == L"--order")
+      order = std::max<size_t>(1, std::wcstoul(t_args[++i].c_str(), nullptr, 10));
+    else if(arg == L"--count")
+      count = std::max<size_t>(1, std::wcstoul(t_args[++i].c_str(), nullptr, 10));
+  }
+
+  if(history.empty())
+  {
+    std::cerr << "usage: --prefetch-bench <history> [--order <n>] [--count <k>]\n";
+    return 1;
+  }
+
+  try
+  {
+    std::ifstream in(std::filesystem::path(history), std::ios::binary);
+    if(!in)
+      throw std::runtime_error("Failed to open the history.");
+
+    // phrase and exec, --listen's lines
+    //  start with the event's type
+    std::vector<std::pair<std::wstring, std::wstring>> dispatched;
+    std::string line;
+    while(std::getline(in, line))
+    {
+      if(!line.empty() && line.back() == '\r')
+        line.pop_back();
+      std::vector<std::string> fields;
+      for(size_t start = 0, tab; start <= line.size(); start = tab + 1)
+      {
+        tab = std::min(line.find('\t', start), line.size());
+        fields.push_back(line.substr(start, tab - start));
+      }
+      if(fields[0] == "recognized")
+        fields.erase(fields.begin());
+      if(fields.size() >= 2 && !fields[0].empty() && !fields[1].empty())
+        dispatched.emplace_back(from_utf8(fields[0]), from_utf8(fields[1]));
+    }
+    if(dispatched.empty())
+      throw std::runtime_error("No commands in the history.");
+
+    Predictor predictor(order);
+    LaunchCache cache;
+    std::map<std::wstring, std::wstring> execOf;
+    for(auto const& d : dispatched)
+    {
+      predictor.observe(d.first);
+      cache.resolve(d.second);
+      execOf[lower_key(d.first)] = d.second;
+      for(auto const& next : predictor.predict(count))
+      {
+        auto it = execOf.find(next.first);
+        if(it != execOf.end())
+          cache.warm(it->second);
+      }
+
+      // people take longer than a warm-up
+      //  between commands
+      cache.waitIdle();
+    }
+
+    PredictorStats predicted = predictor.stats();
+    LaunchCacheStats launches = cache.stats();
+    auto percent = [](size_t t_part, size_t t_whole)
+    {
+      return t_whole ? 100.0 * static_cast<double>(t_part) / static_cast<double>(t_whole) : 0.0;
+    };
+    double saved = std::chrono::duration<double, std::milli>(launches.saved).count();
+    std::cout << std::fixed << std::setprecision(1)
+              << dispatched.size() << " commands, order " << order << ", " << count << " predicted\n"
+              << "next command predicted\t" << percent(predicted.hits, predicted.predicted) << "%\n"
+              << "launches warmed\t" << percent(launches.hits, launches.hits + launches.misses) << "%\t"
+              << launches.warmed << " warm-ups\n"
+              << "PATH search saved ms\t" << saved << "\t"
+              << std::setprecision(3) << saved / static_cast<double>(dispatched.size()) << " per command\n";
+  }
+  catch(std::exception const& e)
+  {
+    std::cerr << e.what() << "\n";
+    return 2;
+  }
+  return 0;
+}
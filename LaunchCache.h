@@ -0,0 +1,113 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//   Resolves executables to full paths and
+//  reads their image ahead on a background
+//  thread, so a predicted command launches
+//  without searching PATH or cold disk reads
+
+namespace HNx
+{
+
+struct LaunchCacheStats
+{
+  size_t warmed {0};
+  size_t hits {0};
+  size_t misses {0};
+
+  // PATH searches hits didn't have to do
+  //  at launch, each warm-up credited once;
+  //  the read ahead isn't, its gain is the
+  //  file cache's
+  std::chrono::steady_clock::duration saved {};
+};
+
+class LaunchCache
+{
+public:
+  LaunchCache();
+  ~LaunchCache();
+
+  LaunchCache(LaunchCache const&) = delete;
+  LaunchCache& operator=(LaunchCache const&) = delete;
+
+  // queues t_exec to be warmed, returns
+  //  right away
+  void
+    warm(std::wstring const& t_exec);
+
+  // the full path if t_exec was warmed and
+  //  is still there, otherwise t_exec
+  //  unchanged; only a path found counts
+  //  as a hit
+  std::wstring
+    resolve(std::wstring const& t_exec);
+
+  // drops what t_exec was warmed to, for a
+  //  launch of it that failed
+  void
+    forget(std::wstring const& t_exec);
+
+  LaunchCacheStats
+    stats() const;
+
+  // blocks until every queued warm-up is
+  //  done, for replays
+  void
+    waitIdle();
+
+private:
+  struct Entry
+  {
+    std::wstring path {};
+
+    // SearchPath alone
+    std::chrono::steady_clock::duration search {};
+
+    // false leaves the search to the launch,
+    //  nothing was saved
+    bool found {false};
+
+    // a hit took its search into saved
+    bool credited {false};
+  };
+
+  // SearchPath and read ahead, slow
+  static Entry
+    lookup(std::wstring const& t_exec);
+
+  void
+    worker();
+
+  std::map<std::wstring, Entry> m_entries {};
+  std::deque<std::wstring> m_queue {};
+  LaunchCacheStats m_stats {};
+  bool m_stop {false};
+
+  // the worker is looking one up
+  bool m_busy {false};
+
+  mutable std::mutex m_mtx {};
+  std::condition_variable m_cv {};
+  std::thread m_thread {};
+};
+
+// voicecommand --prefetch-bench <history>
+//              [--order <n>] [--count <k>]
+// replays a recorded history, lines of
+//  phrase<TAB>exec[<TAB>param] as --listen
+//  prints them, predicting and warming
+//  after each command like the recognizer
+//  does; reports the hit rates and the
+//  PATH searches saved
+int
+  runPrefetchBenchCli(std::vector<std::wstring> const& t_args);
+
+}
@@ -0,0 +1,186 @@
+#include "Macro.h"
+#include "Exec.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+//=================================//
+// HNx Voice Command Macro class   //
+//=================================//
+// Runs the steps of a macro as a  //
+//  dependency graph               //
+//=================================//
+
+using namespace HNx;
+
+HNx::Macro::Macro(std::vector<MacroStep> t_steps)
+  : m_steps(std::move(t_steps))
+  , m_dependents(m_steps.size())
+  , m_depCount(m_steps.size(), 0)
+{
+  std::map<std::wstring, size_t> index;
+  for(size_t i = 0; i < m_steps.size(); ++i)
+  {
+    if(m_steps[i].name.empty())
+      throw std::invalid_argument("Macro step name cant be empty");
+    if(!index.emplace(m_steps[i].name, i).second)
+      throw std::invalid_argument("Macro step names must be unique");
+  }
+
+  for(size_t i = 0; i < m_steps.size(); ++i)
+    for(auto const& dep : m_steps[i].deps)
+    {
+      auto it = index.find(dep);
+      if(it == index.end())
+        throw std::invalid_argument("Macro step depends on an unknown step");
+      m_dependents[it->second].push_back(i);
+      m_depCount[i]++;
+    }
+
+  // Kahn's algorithm, anything left
+  //  over is part of a cycle
+  std::vector<size_t> waiting(m_depCount);
+  for(size_t i = 0; i < m_steps.size(); ++i)
+    if(waiting[i] == 0)
+      m_order.push_back(i);
+
+  for(size_t next = 0; next < m_order.size(); ++next)
+    for(auto d : m_dependents[m_order[next]])
+      if(--waiting[d] == 0)
+        m_order.push_back(d);
+
+  if(m_order.size() != m_steps.size())
+    throw std::invalid_argument("Macro steps contain a dependency cycle");
+}
+
+HNx::MacroExecutor::MacroExecutor()
+  : m_launch([](MacroStep const& t_step)
+             {
+               return launch(t_step.exec, t_step.param, t_step.wait);
+             })
+{}
+
+HNx::MacroExecutor::MacroExecutor(Launcher t_launch)
+  : m_launch(std::move(t_launch))
+{
+  if(!m_launch)
+    throw std::invalid_argument("MacroExecutor launcher cant be empty");
+}
+
+MacroRunResult
+HNx::MacroExecutor::run(Macro const& t_macro) const
+{
+  using clock = std::chrono::steady_clock;
+
+  auto const& steps = t_macro.steps();
+  size_t const count = steps.size();
+
+  MacroRunResult result;
+  result.steps.resize(count);
+  for(size_t i = 0; i < count; ++i)
+    result.steps[i].name = steps[i].name;
+
+  std::mutex mtx;
+  std::condition_variable cv;
+
+  // indices handed back by the step threads
+  std::vector<size_t> finished;
+
+  std::vector<size_t> waiting(count);
+  std::vector<std::thread> threads;
+  threads.reserve(count);
+  size_t done = 0;
+
+  auto const runStart = clock::now();
+
+  auto start = [&](size_t t_idx)
+  {
+    result.steps[t_idx].start = clock::now() - runStart;
+    threads.emplace_back([&, t_idx]()
+                         {
+                           auto begin = clock::now();
+                           bool ok = false;
+                           try
+                           {
+                             ok = m_launch(steps[t_idx]);
+                           } catch(...)
+                           {
+                             ok = false;
+                           }
+                           auto end = clock::now();
+
+                           std::lock_guard<std::mutex> lock(mtx);
+                           result.steps[t_idx].ok = ok;
+                           result.steps[t_idx].elapsed = end - begin;
+                           finished.push_back(t_idx);
+                           cv.notify_one();
+                         });
+  };
+
+  // a failed step takes everything
+  //  downstream of it with it
+  std::function<void(size_t)> skip = [&](size_t t_idx)
+  {
+    if(result.steps[t_idx].skipped)
+      return;
+    result.steps[t_idx].skipped = true;
+    ++done;
+    for(auto d : t_macro.dependents(t_idx))
+      skip(d);
+  };
+
+  for(size_t i = 0; i < count; ++i)
+  {
+    waiting[i] = t_macro.dependencyCount(i);
+    if(waiting[i] == 0)
+      start(i);
+  }
+
+  std::unique_lock<std::mutex> lock(mtx);
+  while(done < count)
+  {
+    cv.wait(lock, [&]() { return !finished.empty(); });
+    std::vector<size_t> batch;
+    batch.swap(finished);
+    lock.unlock();
+
+    for(auto idx : batch)
+    {
+      ++done;
+      for(auto d : t_macro.dependents(idx))
+      {
+        if(!result.steps[idx].ok)
+          skip(d);
+        else if(--waiting[d] == 0 && !result.steps[d].skipped)
+          start(d);
+      }
+    }
+
+    lock.lock();
+  }
+  lock.unlock();
+
+  for(auto& t : threads)
+    t.join();
+
+  result.wall = clock::now() - runStart;
+
+  // longest chain of measured times
+  std::vector<clock::duration> reach(count, clock::duration::zero());
+  for(auto idx : t_macro.order())
+  {
+    auto end = reach[idx] + result.steps[idx].elapsed;
+    result.criticalPath = std::max(result.criticalPath, end);
+    for(auto d : t_macro.dependents(idx))
+      reach[d] = std::max(reach[d], end);
+  }
+
+  result.ok = std::all_of(result.steps.begin(),
+                          result.steps.end(),
+                          [](MacroStepResult const& r) { return r.ok; });
+  return result;
+}
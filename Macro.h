@@ -0,0 +1,140 @@
+#pragma once
+#include <chrono>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//   A macro is a small DAG of actions run
+//  by a single phrase. Steps without a
+//  dependency between them are launched
+//  concurrently, so a macro takes roughly
+//  as long as its slowest chain of steps
+
+namespace HNx
+{
+
+// one action inside of a macro
+struct MacroStep
+{
+  // unique within the macro, used by deps
+  std::wstring name {};
+
+  // program to execute and
+  //  it's optional args
+  std::wstring exec {};
+  std::wstring param {};
+
+  // names of the steps that must finish
+  //  successfully before this one starts
+  std::vector<std::wstring> deps {};
+
+  // false if dependents only need the
+  //  program started, not exited
+  bool wait {true};
+};
+
+// timing of a single step from one run
+struct MacroStepResult
+{
+  std::wstring name {};
+
+  // false if it failed or was skipped
+  //  because a dependency failed
+  bool ok {false};
+  bool skipped {false};
+
+  // offset of launch from start of run
+  std::chrono::steady_clock::duration start {};
+  std::chrono::steady_clock::duration elapsed {};
+};
+
+struct MacroRunResult
+{
+  // same order as Macro::steps()
+  std::vector<MacroStepResult> steps {};
+
+  std::chrono::steady_clock::duration wall {};
+
+  // longest chain of measured step times,
+  //  what wall would be with no overhead
+  std::chrono::steady_clock::duration criticalPath {};
+
+  bool ok {false};
+};
+
+class Macro
+{
+public:
+  Macro() = default;
+
+  // throws std::invalid_argument if a name is
+  //  empty or repeated, a dependency is unknown
+  //  or the steps contain a cycle
+  explicit Macro(std::vector<MacroStep> t_steps);
+
+  std::vector<MacroStep> const&
+    steps() const
+  {
+    return m_steps;
+  }
+
+  // indices of the steps waiting on step t_idx
+  std::vector<size_t> const&
+    dependents(size_t t_idx) const
+  {
+    return m_dependents[t_idx];
+  }
+
+  // number of steps step t_idx waits on
+  size_t
+    dependencyCount(size_t t_idx) const
+  {
+    return m_depCount[t_idx];
+  }
+
+  // step indices with every dependency
+  //  ahead of its dependents
+  std::vector<size_t> const&
+    order() const
+  {
+    return m_order;
+  }
+
+  bool
+    empty() const
+  {
+    return m_steps.empty();
+  }
+
+private:
+  std::vector<MacroStep> m_steps {};
+
+  // edges resolved to indices at construction
+  //  so running needs no name lookups
+  std::vector<std::vector<size_t>> m_dependents {};
+  std::vector<size_t> m_depCount {};
+  std::vector<size_t> m_order {};
+};
+
+class MacroExecutor
+{
+public:
+  // runs one step to completion, returns success
+  using Launcher = std::function<bool(MacroStep const&)>;
+
+  // default launcher waits on the process
+  //  so dependent steps see its results
+  MacroExecutor();
+  explicit MacroExecutor(Launcher t_launch);
+
+  // blocks until every step has finished
+  //  or been skipped
+  MacroRunResult
+    run(Macro const& t_macro) const;
+
+private:
+  Launcher m_launch {};
+};
+
+}
@@ -0,0 +1,289 @@
+#include "Metrics.h"
+
+#include <cctype>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+//=================================//
+// HNx Voice Command Metrics       //
+//=================================//
+// Lock free counters, gauges and  //
+//  histograms, rendered for       //
+//  Prometheus                     //
+//=================================//
+
+using namespace HNx;
+
+namespace
+{
+enum class Kind
+{
+  Counter,
+  Gauge,
+  Histogram,
+};
+
+struct Entry
+{
+  std::string name {};
+  std::string help {};
+  Kind kind {Kind::Counter};
+  void* metric {nullptr};
+};
+
+// registering is rare and locks, the
+//  metrics themselves never move
+std::mutex s_mtx;
+std::vector<Entry> s_entries;
+std::vector<std::unique_ptr<Counter>> s_counters;
+std::vector<std::unique_ptr<Gauge>> s_gauges;
+std::vector<std::unique_ptr<Histogram>> s_histograms;
+
+// what a scraper gets, 10us to 10s; each
+//  holds the buckets starting at or below
+//  it so is off by 1/16 at most
+constexpr double EXPORTED_BOUNDS[] {
+  0.00001, 0.000025, 0.00005,
+  0.0001, 0.00025, 0.0005,
+  0.001, 0.0025, 0.005,
+  0.01, 0.025, 0.05,
+  0.1, 0.25, 0.5,
+  1.0, 2.5, 5.0,
+  10.0,
+};
+
+bool
+validName(std::string const& t_name)
+{
+  if(t_name.empty() || std::isdigit(static_cast<unsigned char>(t_name[0])))
+    return false;
+  return std::all_of(t_name.begin(), t_name.end(), [](char c)
+  {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == ':';
+  });
+}
+
+template<typename T>
+T&
+registered(std::string const& t_name,
+           std::string const& t_help,
+           Kind t_kind,
+           std::vector<std::unique_ptr<T>>& t_store)
+{
+  if(!validName(t_name))
+    throw std::invalid_argument("Not a metric name: " + t_name);
+
+  std::lock_guard<std::mutex> lock(s_mtx);
+  for(auto const& e : s_entries)
+  {
+    if(e.name != t_name)
+      continue;
+    if(e.kind != t_kind)
+      throw std::invalid_argument("The metric " + t_name + " is of another kind");
+    return *static_cast<T*>(e.metric);
+  }
+
+  t_store.push_back(std::make_unique<T>());
+  s_entries.push_back({t_name, t_help, t_kind, t_store.back().get()});
+  return *t_store.back();
+}
+
+void
+writeHelp(std::ostringstream& t_out, std::string const& t_help)
+{
+  for(char c : t_help)
+  {
+    if(c == '\\')
+      t_out << "\\\\";
+    else if(c == '\n')
+      t_out << "\\n";
+    else
+      t_out << c;
+  }
+}
+}
+
+uint64_t
+HNx::Histogram::count() const
+{
+  uint64_t n = 0;
+  for(auto const& b : m_buckets)
+    n += b.load(std::memory_order_relaxed);
+  return n;
+}
+
+uint64_t
+HNx::Histogram::quantile(double t_q) const
+{
+  auto counts = snapshot();
+  uint64_t total = 0;
+  for(uint64_t c : counts)
+    total += c;
+  if(!total)
+    return 0;
+
+  uint64_t rank = static_cast<uint64_t>(std::clamp(t_q, 0.0, 1.0) * static_cast<double>(total - 1)) + 1;
+  uint64_t seen = 0;
+  for(size_t i = 0; i < Buckets; ++i)
+  {
+    seen += counts[i];
+    if(seen >= rank)
+      return upperBound(i);
+  }
+  return upperBound(Buckets - 1);
+}
+
+std::array<uint64_t, HNx::Histogram::Buckets>
+HNx::Histogram::snapshot() const
+{
+  std::array<uint64_t, Buckets> counts;
+  for(size_t i = 0; i < Buckets; ++i)
+    counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+  return counts;
+}
+
+uint64_t
+HNx::Histogram::upperBound(size_t t_index)
+{
+  if(t_index < SubBuckets)
+    return t_index + 1;
+  unsigned shift = static_cast<unsigned>(t_index / SubBuckets) - 1;
+  return (SubBuckets + t_index % SubBuckets + 1) << shift;
+}
+
+Counter&
+HNx::Metrics::counter(std::string const& t_name, std::string const& t_help)
+{
+  return registered(t_name, t_help, Kind::Counter, s_counters);
+}
+
+Gauge&
+HNx::Metrics::gauge(std::string const& t_name, std::string const& t_help)
+{
+  return registered(t_name, t_help, Kind::Gauge, s_gauges);
+}
+
+Histogram&
+HNx::Metrics::histogram(std::string const& t_name, std::string const& t_help)
+{
+  return registered(t_name, t_help, Kind::Histogram, s_histograms);
+}
+
+std::string
+HNx::Metrics::render()
+{
+  std::ostringstream out;
+  out << std::setprecision(9);
+
+  std::lock_guard<std::mutex> lock(s_mtx);
+  for(auto const& e : s_entries)
+  {
+    out << "# HELP " << e.name << ' ';
+    writeHelp(out, e.help);
+    out << "\n# TYPE " << e.name << ' ';
+    switch(e.kind)
+    {
+      case Kind::Counter:
+        out << "counter\n" << e.name << ' ' << static_cast<Counter*>(e.metric)->value() << '\n';
+        break;
+
+      case Kind::Gauge:
+        out << "gauge\n" << e.name << ' ' << static_cast<Gauge*>(e.metric)->value() << '\n';
+        break;
+
+      case Kind::Histogram:
+      {
+        auto const& h = *static_cast<Histogram*>(e.metric);
+        auto counts = h.snapshot();
+
+        // cumulative, a bucket counts toward
+        //  the first bound it starts under
+        out << "histogram\n";
+        uint64_t cumulative = 0;
+        size_t next = 0;
+        for(double bound : EXPORTED_BOUNDS)
+        {
+          uint64_t ns = static_cast<uint64_t>(bound * 1e9);
+          for(; next < Histogram::Buckets && (next ? Histogram::upperBound(next - 1) : 0) <= ns; ++next)
+            cumulative += counts[next];
+          out << e.name << "_bucket{le=\"" << bound << "\"} " << cumulative << '\n';
+        }
+        for(; next < Histogram::Buckets; ++next)
+          cumulative += counts[next];
+        out << e.name << "_bucket{le=\"+Inf\"} " << cumulative << '\n'
+            << e.name << "_sum " << static_cast<double>(h.sum()) / 1e9 << '\n'
+            << e.name << "_count " << cumulative << '\n';
+        break;
+      }
+    }
+  }
+  return out.str();
+}
+
+int
+HNx::runMetricsBenchCli(std::vector<std::wstring> const& t_args)
+{
+  uint64_t count = 10000000;
+  for(size_t i = 0; i + 1 < t_args.size(); ++i)
+    if(t_args[i] == L"--count")
+      count = std::max<uint64_t>(1, std::wcstoull(t_args[++i].c_str(), nullptr, 10));
+
+  // its own names, not the recognizer's
+  Counter& counter = Metrics::counter("hnx_bench_total", "Metrics benchmark counter");
+  Gauge& gauge = Metrics::gauge("hnx_bench_gauge", "Metrics benchmark gauge");
+  Histogram& histogram = Metrics::histogram("hnx_bench_seconds", "Metrics benchmark histogram");
+
+  using clock = std::chrono::steady_clock;
+  auto perOp = [&](clock::duration t_elapsed)
+  {
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(t_elapsed).count()) / static_cast<double>(count);
+  };
+
+  // what the loop itself costs, the values
+  //  spread over every magnitude recorded
+  auto run = [&](auto t_record)
+  {
+    auto start = clock::now();
+    for(uint64_t i = 0; i < count; ++i)
+      t_record((i * 0x9E3779B97F4A7C15ull) >> (24 + i % 40));
+    return clock::now() - start;
+  };
+  volatile uint64_t sink = 0;
+  auto loop = run([&](uint64_t t_v) { sink = t_v; });
+
+  std::cout << std::fixed << std::setprecision(1)
+            << "ns per op\t1 thread\n"
+            << "loop\t" << perOp(loop) << "\n"
+            << "counter\t" << perOp(run([&](uint64_t) { counter.add(); })) << "\n"
+            << "gauge\t" << perOp(run([&](uint64_t t_v) { gauge.set(static_cast<int64_t>(t_v)); })) << "\n"
+            << "histogram\t" << perOp(run([&](uint64_t t_v) { histogram.record(t_v); })) << "\n";
+
+  // the worst case, every thread on the
+  //  same cache lines
+  unsigned threads = std::max(2u, std::thread::hardware_concurrency());
+  auto contended = [&](auto t_record)
+  {
+    std::vector<std::thread> pool;
+    auto start = clock::now();
+    for(unsigned t = 0; t < threads; ++t)
+      pool.emplace_back([&] { run(t_record); });
+    for(auto& t : pool)
+      t.join();
+    return clock::now() - start;
+  };
+  std::cout << "ns per op\t" << threads << " threads, wall / ops per thread\n"
+            << "counter\t" << perOp(contended([&](uint64_t) { counter.add(); })) << "\n"
+            << "histogram\t" << perOp(contended([&](uint64_t t_v) { histogram.record(t_v); })) << "\n";
+
+  auto start = clock::now();
+  size_t bytes = Metrics::render().size();
+  std::cout << "render\t" << std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start).count()
+            << " us\t" << bytes << " bytes\n";
+  return 0;
+}
@@ -0,0 +1,176 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//   Counts and latencies of what the
+//  recognizer does, for a scraper to poll.
+//  Metrics are registered once by name and
+//  kept for the life of the process, so
+//  callers hold on to the references;
+//  recording is then a relaxed atomic add
+//  or two, no locks
+//
+//  render() writes them all in Prometheus'
+//  text format, MetricsServer.h serves it
+
+namespace HNx
+{
+
+// on a cache line of its own, threads
+//  counting different things don't share
+class alignas(64) Counter
+{
+public:
+  void
+    add(uint64_t t_n = 1)
+  {
+    m_value.fetch_add(t_n, std::memory_order_relaxed);
+  }
+
+  uint64_t
+    value() const
+  {
+    return m_value.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<uint64_t> m_value {0};
+};
+
+class alignas(64) Gauge
+{
+public:
+  void
+    set(int64_t t_value)
+  {
+    m_value.store(t_value, std::memory_order_relaxed);
+  }
+
+  void
+    add(int64_t t_n)
+  {
+    m_value.fetch_add(t_n, std::memory_order_relaxed);
+  }
+
+  int64_t
+    value() const
+  {
+    return m_value.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<int64_t> m_value {0};
+};
+
+// nanoseconds in log-linear buckets like
+//  HdrHistogram's: exact below 16, above
+//  that 16 buckets per power of two, each
+//  within 1/16 of what it holds, up to
+//  about 18 minutes
+class Histogram
+{
+public:
+  static constexpr unsigned SubBits = 4;
+  static constexpr uint64_t SubBuckets = 1ull << SubBits;
+  static constexpr uint64_t Max = (1ull << 40) - 1;
+  static constexpr size_t Buckets = SubBuckets * (40 - SubBits + 1);
+
+  void
+    record(uint64_t t_ns)
+  {
+    m_buckets[index(t_ns)].fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(t_ns, std::memory_order_relaxed);
+  }
+
+  void
+    record(std::chrono::nanoseconds t_elapsed)
+  {
+    record(static_cast<uint64_t>(std::max<int64_t>(t_elapsed.count(), 0)));
+  }
+
+  uint64_t
+    count() const;
+
+  // nanoseconds, of values clamped to Max
+  uint64_t
+    sum() const
+  {
+    return m_sum.load(std::memory_order_relaxed);
+  }
+
+  // the bucket t_q of the values fall in,
+  //  its upper bound in nanoseconds, 0 if
+  //  nothing was recorded
+  uint64_t
+    quantile(double t_q) const;
+
+  // a copy, not one instant's but each
+  //  bucket's count as it was read
+  std::array<uint64_t, Buckets>
+    snapshot() const;
+
+  static size_t
+    index(uint64_t t_ns)
+  {
+    if(t_ns < SubBuckets)
+      return static_cast<size_t>(t_ns);
+    if(t_ns > Max)
+      t_ns = Max;
+
+    // the top SubBits + 1 bits pick it
+    unsigned shift = static_cast<unsigned>(std::bit_width(t_ns)) - SubBits - 1;
+    return static_cast<size_t>(SubBuckets * (shift + 1) + ((t_ns >> shift) - SubBuckets));
+  }
+
+  // the values bucket t_index holds are
+  //  below this
+  static uint64_t
+    upperBound(size_t t_index);
+
+private:
+  std::array<std::atomic<uint64_t>, Buckets> m_buckets {};
+  std::atomic<uint64_t> m_sum {0};
+};
+
+class Metrics
+{
+public:
+  // registers t_name, or returns what already
+  //  has it; names and help are Prometheus',
+  //  counters end in _total and histograms
+  //  are exported in seconds
+  // throws std::invalid_argument if t_name
+  //  isn't a valid metric name or is taken
+  //  by another kind
+  static Counter&
+    counter(std::string const& t_name,
+            std::string const& t_help);
+
+  static Gauge&
+    gauge(std::string const& t_name,
+          std::string const& t_help);
+
+  static Histogram&
+    histogram(std::string const& t_name,
+              std::string const& t_help);
+
+  // every metric in the text exposition
+  //  format, in the order registered
+  static std::string
+    render();
+};
+
+// voicecommand --metrics-bench [--count <n>]
+// what recording costs, one thread then
+//  several on the same metrics
+int
+  runMetricsBenchCli(std::vector<std::wstring> const& t_args);
+
+}
@@ -0,0 +1,146 @@
+#include "MetricsServer.h"
+#include "Metrics.h"
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#include <stdexcept>
+#include <string>
+
+//=================================//
+// HNx Voice Metrics Server        //
+//=================================//
+// Prometheus scrapes on loopback  //
+//=================================//
+
+using namespace HNx;
+
+namespace
+{
+// a request line and headers, anything
+//  longer isn't a scraper's
+constexpr size_t MAX_REQUEST = 8192;
+
+// a client that connects and says nothing
+//  is dropped after this
+constexpr DWORD RECEIVE_TIMEOUT_MS = 2000;
+
+void
+sendAll(SOCKET t_socket, std::string const& t_data)
+{
+  for(size_t sent = 0; sent < t_data.size();)
+  {
+    int n = send(t_socket, t_data.data() + sent, static_cast<int>(t_data.size() - sent), 0);
+    if(n <= 0)
+      return;
+    sent += static_cast<size_t>(n);
+  }
+}
+
+void
+respond(SOCKET t_socket, char const* t_status, char const* t_type, std::string const& t_body)
+{
+  sendAll(t_socket, std::string("HTTP/1.1 ") + t_status +
+                    "\r\nContent-Type: " + t_type +
+                    "\r\nContent-Length: " + std::to_string(t_body.size()) +
+                    "\r\nConnection: close\r\n\r\n" + t_body);
+}
+}
+
+HNx::MetricsServer::MetricsServer(uint16_t t_port)
+{
+  WSADATA wsa = {};
+  if(int err = WSAStartup(MAKEWORD(2, 2), &wsa))
+    throw std::runtime_error("WSAStartup() failed...\nError: " + std::to_string(err));
+
+  SOCKET listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if(listener == INVALID_SOCKET)
+  {
+    int err = WSAGetLastError();
+    WSACleanup();
+    throw std::runtime_error("Failed to create the metrics socket.\nError: " + std::to_string(err));
+  }
+
+  // no one else takes the port over
+  BOOL exclusive = TRUE;
+  setsockopt(listener, SOL_SOCKET, SO_EXCLUSIVEADDRUSE, reinterpret_cast<char const*>(&exclusive), sizeof(exclusive));
+
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(t_port);
+  int len = sizeof(addr);
+  if(bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == SOCKET_ERROR
+     || listen(listener, SOMAXCONN) == SOCKET_ERROR
+     || getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &len) == SOCKET_ERROR)
+  {
+    int err = WSAGetLastError();
+    closesocket(listener);
+    WSACleanup();
+    throw std::runtime_error("Failed to listen for metrics on port " + std::to_string(t_port) + ".\nError: " + std::to_string(err));
+  }
+
+  m_listen = static_cast<uintptr_t>(listener);
+  m_port = ntohs(addr.sin_port);
+  m_thread = std::thread([this] { serve(); });
+}
+
+HNx::MetricsServer::~MetricsServer()
+{
+  // the blocked accept() fails and the
+  //  thread sees it is stopping
+  m_stopping.store(true, std::memory_order_relaxed);
+  closesocket(static_cast<SOCKET>(m_listen));
+  if(m_thread.joinable())
+    m_thread.join();
+  WSACleanup();
+}
+
+uint16_t
+HNx::MetricsServer::port() const
+{
+  return m_port;
+}
+
+void
+HNx::MetricsServer::serve()
+{
+  SOCKET listener = static_cast<SOCKET>(m_listen);
+  while(!m_stopping.load(std::memory_order_relaxed))
+  {
+    // fails for good once the listener is
+    //  closed, a client giving up is retried
+    SOCKET client = accept(listener, nullptr, nullptr);
+    if(client == INVALID_SOCKET)
+    {
+      if(WSAGetLastError() == WSAECONNRESET)
+        continue;
+      return;
+    }
+
+    DWORD timeout = RECEIVE_TIMEOUT_MS;
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<char const*>(&timeout), sizeof(timeout));
+
+    // only the request line matters, the
+    //  headers are read to be polite
+    std::string request;
+    char buffer[1024];
+    while(request.find("\r\n\r\n") == std::string::npos && request.size() < MAX_REQUEST)
+    {
+      int n = recv(client, buffer, sizeof(buffer), 0);
+      if(n <= 0)
+        break;
+      request.append(buffer, static_cast<size_t>(n));
+    }
+
+    if(request.rfind("GET /metrics ", 0) == 0 || request.rfind("GET / ", 0) == 0)
+      respond(client, "200 OK", "text/plain; version=0.0.4; charset=utf-8", Metrics::render());
+    else if(request.rfind("GET ", 0) == 0)
+      respond(client, "404 Not Found", "text/plain", "Not found\n");
+    else if(!request.empty())
+      respond(client, "405 Method Not Allowed", "text/plain", "GET only\n");
+
+    shutdown(client, SD_SEND);
+    closesocket(client);
+  }
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+//   Metrics::render() over HTTP for a
+//  Prometheus scraper, on 127.0.0.1 only:
+//  GET /metrics, one request a connection
+//
+//  Serves from a thread of its own, a slow
+//  scraper never holds up recognition
+
+namespace HNx
+{
+
+class MetricsServer
+{
+public:
+  // t_port 0 takes any free one
+  // throws std::runtime_error if it can't
+  //  be listened on
+  explicit MetricsServer(uint16_t t_port);
+
+  ~MetricsServer();
+
+  MetricsServer(MetricsServer const&) = delete;
+  MetricsServer& operator=(MetricsServer const&) = delete;
+
+  uint16_t
+    port() const;
+
+private:
+  void
+    serve();
+
+  // a SOCKET, winsock2.h stays out of
+  //  whoever includes windows.h first
+  uintptr_t m_listen {0};
+  uint16_t m_port {0};
+
+  std::atomic<bool> m_stopping {false};
+  std::thread m_thread {};
+};
+
+}
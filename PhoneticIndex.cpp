@@ -0,0 +1,543 @@
+#include "PhoneticIndex.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <bit>
+#include <cwctype>
+
+//=================================//
+// HNx Voice Command Phonetic Index//
+//=================================//
+// Index of Metaphone-style keys   //
+//  for finding confusable phrases //
+//=================================//
+
+using namespace HNx;
+
+namespace
+{
+// edits allowed between the longest keys
+//  when no limit is given
+constexpr unsigned DEFAULT_MAX_DISTANCE = 2;
+
+bool
+isVowel(wchar_t c)
+{
+  return c == L'A' || c == L'E' || c == L'I' || c == L'O' || c == L'U';
+}
+
+bool
+isFront(wchar_t c)
+{
+  return c == L'I' || c == L'E' || c == L'Y';
+}
+
+// simplified Metaphone, t_word is upper case
+//  letters and digits only
+void
+appendWordKey(std::wstring& t_out, std::wstring const& t_word)
+{
+  // a vowel only counts at the start of
+  //  the phrase, not of every word
+  bool first = t_out.empty();
+
+  size_t n = t_word.size();
+  auto at = [&](size_t i) { return i < n ? t_word[i] : L'\0'; };
+
+  size_t i = 0;
+  std::wstring_view start(t_word.data(), std::min<size_t>(n, 2));
+  if(start == L"KN" || start == L"GN" || start == L"PN" || start == L"AE" || start == L"WR")
+    i = 1;
+  else if(at(0) == L'X')
+  {
+    t_out.push_back(L'S');
+    i = 1;
+  }
+  else if(at(0) == L'W' && at(1) == L'H')
+  {
+    t_out.push_back(L'W');
+    i = 2;
+  }
+
+  for(; i < n; ++i)
+  {
+    wchar_t c = t_word[i];
+    wchar_t prev = i ? t_word[i - 1] : L'\0';
+    wchar_t next = at(i + 1);
+    wchar_t next2 = at(i + 2);
+
+    if(c == prev && c != L'C')
+      continue;
+
+    if(std::iswdigit(c))
+    {
+      t_out.push_back(c);
+      continue;
+    }
+
+    switch(c)
+    {
+      case L'A': case L'E': case L'I': case L'O': case L'U':
+      if(i == 0 && first)
+        t_out.push_back(L'A');
+      break;
+
+      case L'B':
+      if(!(prev == L'M' && i + 1 == n))
+        t_out.push_back(L'B');
+      break;
+
+      case L'C':
+      if((next == L'I' && next2 == L'A') || next == L'H')
+        t_out.push_back(prev == L'S' ? L'K' : L'X');
+      else if(isFront(next))
+      {
+        if(prev != L'S')
+          t_out.push_back(L'S');
+      }
+      else
+        t_out.push_back(L'K');
+      break;
+
+      case L'D':
+      t_out.push_back(next == L'G' && isFront(next2) ? L'J' : L'T');
+      break;
+
+      case L'G':
+      if(next == L'H' && !isVowel(next2))
+        break;
+      if(next == L'N' && (i + 2 == n || (next2 == L'E' && at(i + 3) == L'D' && i + 4 == n)))
+        break;
+      t_out.push_back(isFront(next) ? L'J' : L'K');
+      break;
+
+      case L'H':
+      if(prev == L'C' || prev == L'S' || prev == L'P' || prev == L'T' || prev == L'G')
+        break;
+      if(isVowel(prev) && !isVowel(next))
+        break;
+      t_out.push_back(L'H');
+      break;
+
+      case L'K':
+      if(prev != L'C')
+        t_out.push_back(L'K');
+      break;
+
+      case L'P':
+      t_out.push_back(next == L'H' ? L'F' : L'P');
+      break;
+
+      case L'Q':
+      t_out.push_back(L'K');
+      break;
+
+      case L'S':
+      t_out.push_back(next == L'H' || (next == L'I' && (next2 == L'O' || next2 == L'A')) ? L'X' : L'S');
+      break;
+
+      case L'T':
+      if(next == L'I' && (next2 == L'O' || next2 == L'A'))
+        t_out.push_back(L'X');
+      else if(next == L'H')
+        t_out.push_back(L'0');
+      else if(!(next == L'C' && next2 == L'H'))
+        t_out.push_back(L'T');
+      break;
+
+      case L'V':
+      t_out.push_back(L'F');
+      break;
+
+      case L'W': case L'Y':
+      if(isVowel(next))
+        t_out.push_back(c);
+      break;
+
+      case L'X':
+      t_out.append(L"KS");
+      break;
+
+      case L'Z':
+      t_out.push_back(L'S');
+      break;
+
+      default:
+      t_out.push_back(c);
+      break;
+    }
+  }
+}
+}
+
+HNx::PhoneticIndex::PhoneticIndex(unsigned t_maxDistance)
+  : m_maxDistance(t_maxDistance)
+  , m_minPieces((t_maxDistance ? t_maxDistance : 1) + 1)
+  , m_maxPieces((t_maxDistance ? t_maxDistance : DEFAULT_MAX_DISTANCE) + 1)
+{}
+
+std::wstring
+HNx::PhoneticIndex::key(std::wstring_view t_phrase)
+{
+  std::wstring key;
+  std::wstring word;
+  for(size_t i = 0; i <= t_phrase.size(); ++i)
+  {
+    wchar_t c = i < t_phrase.size() ? t_phrase[i] : L' ';
+    if(std::iswalnum(c))
+    {
+      word.push_back(static_cast<wchar_t>(std::towupper(c)));
+      continue;
+    }
+
+    // apostrophes don't split words
+    if(c == L'\'')
+      continue;
+
+    if(!word.empty())
+    {
+      appendWordKey(key, word);
+      word.clear();
+    }
+  }
+  return key;
+}
+
+unsigned
+HNx::PhoneticIndex::distance(std::wstring_view a, std::wstring_view b)
+{
+  return bounded_distance(a, b, static_cast<unsigned>(std::max(a.size(), b.size())));
+}
+
+unsigned
+HNx::PhoneticIndex::bounded_distance(std::wstring_view a, std::wstring_view b, unsigned t_cap)
+{
+  if(a.size() < b.size())
+    std::swap(a, b);
+  if(a.size() - b.size() > t_cap)
+    return t_cap + 1;
+
+  // keys are short, only long ones
+  //  need the heap
+  unsigned stackRow[64];
+  std::vector<unsigned> heapRow;
+  unsigned* row = stackRow;
+  if(b.size() + 1 > std::size(stackRow))
+  {
+    heapRow.resize(b.size() + 1);
+    row = heapRow.data();
+  }
+
+  for(size_t j = 0; j <= b.size(); ++j)
+    row[j] = static_cast<unsigned>(j);
+
+  // only cells within t_cap of the diagonal
+  //  can be t_cap or less
+  for(size_t i = 1; i <= a.size(); ++i)
+  {
+    size_t lo = i > t_cap ? i - t_cap : 1;
+    size_t hi = std::min(b.size(), i + t_cap);
+    unsigned diag = row[lo - 1];
+    row[lo - 1] = lo == 1 ? static_cast<unsigned>(i) : t_cap + 1;
+    unsigned best = row[lo - 1];
+    for(size_t j = lo; j <= hi; ++j)
+    {
+      unsigned up = row[j];
+      row[j] = std::min({row[j] + 1, row[j - 1] + 1, diag + (a[i - 1] == b[j - 1] ? 0u : 1u)});
+      diag = up;
+      best = std::min(best, row[j]);
+    }
+
+    // rows never get smaller
+    if(best > t_cap)
+      return t_cap + 1;
+  }
+  return std::min(row[b.size()], t_cap + 1);
+}
+
+bool
+HNx::PhoneticIndex::positions_of(std::wstring_view t_key, Positions& t_out)
+{
+  if(t_key.empty() || t_key.size() > 64)
+    return false;
+
+  t_out.fill(0);
+  for(size_t i = 0; i < t_key.size(); ++i)
+  {
+    if(static_cast<size_t>(t_key[i]) >= t_out.size())
+      return false;
+    t_out[t_key[i]] |= uint64_t {1} << i;
+  }
+  return true;
+}
+
+unsigned
+HNx::PhoneticIndex::bit_distance(Positions const& t_key, size_t t_length, std::wstring_view t_text, unsigned t_cap)
+{
+  size_t longer = std::max(t_length, t_text.size());
+  if(longer - std::min(t_length, t_text.size()) > t_cap)
+    return t_cap + 1;
+
+  // bits of the vertical deltas, +1 and -1,
+  //  of the key's column; the last row
+  //  is the distance so far
+  uint64_t plus = ~uint64_t {0};
+  uint64_t minus = 0;
+  uint64_t last = uint64_t {1} << (t_length - 1);
+  unsigned score = static_cast<unsigned>(t_length);
+  for(auto c : t_text)
+  {
+    // anything else matches nowhere in it
+    uint64_t eq = static_cast<size_t>(c) < t_key.size() ? t_key[c] : 0;
+    uint64_t xv = eq | minus;
+    uint64_t xh = (((eq & plus) + plus) ^ plus) | eq;
+    uint64_t hPlus = minus | ~(xh | plus);
+    uint64_t hMinus = plus & xh;
+    if(hPlus & last)
+      score++;
+    else if(hMinus & last)
+      score--;
+
+    // the top row counts up, each column
+    //  starts one more than the last
+    hPlus = (hPlus << 1) | 1;
+    hMinus <<= 1;
+    plus = hMinus | ~(xv | hPlus);
+    minus = hPlus & xv;
+  }
+  return std::min(score, t_cap + 1);
+}
+
+unsigned
+HNx::PhoneticIndex::limit_for(std::wstring const& t_key) const
+{
+  if(m_maxDistance)
+    return m_maxDistance;
+  return std::clamp<unsigned>(static_cast<unsigned>(t_key.size() / 4), 1, DEFAULT_MAX_DISTANCE);
+}
+
+bool
+HNx::PhoneticIndex::close_enough(unsigned t_distance, size_t t_lengthA, size_t t_lengthB)
+{
+  // an edit in a short key changes most of
+  //  it, allow one per three letters
+  return t_distance * 3 <= std::max(t_lengthA, t_lengthB);
+}
+
+std::pair<size_t, size_t>
+HNx::PhoneticIndex::segment(size_t t_length, size_t t_pieces, size_t t_index)
+{
+  // the first pieces take the remainder
+  size_t base = t_length / t_pieces;
+  size_t extra = t_length % t_pieces;
+  size_t start = t_index * base + std::min(t_index, extra);
+  return {start, base + (t_index < extra ? 1 : 0)};
+}
+
+uint32_t
+HNx::PhoneticIndex::symbols_of(std::wstring_view t_key)
+{
+  uint32_t symbols = 0;
+  for(auto c : t_key)
+    symbols |= 1u << (c % 32);
+  return symbols;
+}
+
+uint64_t
+HNx::PhoneticIndex::segment_key(size_t t_length, size_t t_pieces, size_t t_index, std::wstring_view t_text)
+{
+  // FNV-1a, keys are too short for
+  //  anything more to pay off
+  uint64_t hash = 14695981039346656037ull;
+  auto mix = [&](uint64_t t_v)
+  {
+    hash ^= t_v;
+    hash *= 1099511628211ull;
+  };
+  mix(t_length);
+  mix(t_pieces);
+  mix(t_index);
+  for(auto c : t_text)
+    mix(static_cast<uint64_t>(c));
+  return hash;
+}
+
+void
+HNx::PhoneticIndex::insert(std::wstring_view t_phrase)
+{
+  std::wstring k = key(t_phrase);
+  if(k.empty())
+    return;
+
+  auto known = m_byKey.find(k);
+  if(known != m_byKey.end())
+  {
+    auto& phrases = m_phrases[known->second];
+    if(std::none_of(phrases.begin(), phrases.end(),
+                    [&](std::wstring const& p) { return icase_equal(p, t_phrase); }))
+    {
+      phrases.emplace_back(t_phrase);
+      m_entries[known->second].live++;
+      m_size++;
+    }
+    return;
+  }
+
+  uint32_t id = static_cast<uint32_t>(m_entries.size());
+  m_entries.push_back({static_cast<uint32_t>(m_keys.size()), static_cast<uint32_t>(k.size()), symbols_of(k), 1});
+  m_phrases.push_back({std::wstring(t_phrase)});
+  m_keys.append(k);
+  m_byKey.emplace(k, id);
+  m_size++;
+
+  if(k.size() < m_maxPieces)
+  {
+    if(m_short.size() <= k.size())
+      m_short.resize(k.size() + 1);
+    m_short[k.size()].push_back(id);
+  }
+
+  for(size_t pieces = m_minPieces; pieces <= m_maxPieces && pieces <= k.size(); ++pieces)
+    for(size_t s = 0; s < pieces; ++s)
+    {
+      auto seg = segment(k.size(), pieces, s);
+      m_segments[segment_key(k.size(), pieces, s, std::wstring_view(k).substr(seg.first, seg.second))].push_back(id);
+    }
+}
+
+void
+HNx::PhoneticIndex::remove(std::wstring_view t_phrase)
+{
+  // the key stays indexed, entries without
+  //  phrases are skipped by nearest()
+  auto known = m_byKey.find(key(t_phrase));
+  if(known == m_byKey.end())
+    return;
+
+  auto& phrases = m_phrases[known->second];
+  auto it = std::find_if(phrases.begin(), phrases.end(),
+                         [&](std::wstring const& p) { return icase_equal(p, t_phrase); });
+  if(it != phrases.end())
+  {
+    phrases.erase(it);
+    m_entries[known->second].live--;
+    m_size--;
+  }
+}
+
+std::vector<Confusable>
+HNx::PhoneticIndex::nearest(std::wstring_view t_phrase) const
+{
+  std::vector<Confusable> found;
+  std::wstring k = key(t_phrase);
+  if(k.empty())
+    return found;
+
+  unsigned limit = limit_for(k);
+  size_t pieces = limit + 1;
+
+  // keys more than limit apart in
+  //  length can't be close enough
+  std::vector<uint32_t> candidates;
+  size_t shortest = k.size() > limit ? k.size() - limit : 1;
+  for(size_t length = shortest; length <= k.size() + limit; ++length)
+  {
+    if(length < pieces)
+    {
+      if(length < m_short.size())
+        candidates.insert(candidates.end(), m_short[length].begin(), m_short[length].end());
+      continue;
+    }
+
+    // within limit edits one piece of the
+    //  other key is left whole; taking the
+    //  first such piece s, the pieces before
+    //  it hold s edits or more, so it moved
+    //  by no more than s and the ones after
+    //  it change the length by no more
+    //  than limit - s (Pass-Join's bound)
+    long long shift = static_cast<long long>(k.size()) - static_cast<long long>(length);
+    for(size_t s = 0; s < pieces; ++s)
+    {
+      auto seg = segment(length, pieces, s);
+      if(k.size() < seg.second)
+        continue;
+
+      long long at = static_cast<long long>(seg.first);
+      long long left = static_cast<long long>(s);
+      long long right = static_cast<long long>(limit - s);
+      long long from = std::max({at - left, at + shift - right, 0ll});
+      long long to = std::min({at + left, at + shift + right, static_cast<long long>(k.size() - seg.second)});
+      for(long long start = from; start <= to; ++start)
+      {
+        auto it = m_segments.find(segment_key(length, pieces, s, std::wstring_view(k).substr(start, seg.second)));
+        if(it != m_segments.end())
+          candidates.insert(candidates.end(), it->second.begin(), it->second.end());
+      }
+    }
+  }
+
+  std::sort(candidates.begin(), candidates.end());
+  candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+  // most keys fit the bit-parallel distance
+  Positions positions;
+  bool bits = positions_of(k, positions);
+
+  uint32_t symbols = symbols_of(k);
+  for(uint32_t id : candidates)
+  {
+    Entry const& entry = m_entries[id];
+    if(!entry.live)
+      continue;
+
+    // cheap lower bound before the real distance
+    if(static_cast<unsigned>(std::popcount(entry.symbols ^ symbols)) > 2 * limit)
+      continue;
+
+    std::wstring_view other(m_keys.data() + entry.offset, entry.length);
+    unsigned d = bits ? bit_distance(positions, k.size(), other, limit)
+                      : bounded_distance(other, k, limit);
+    if(d <= limit && close_enough(d, other.size(), k.size()))
+      for(auto const& phrase : m_phrases[id])
+        if(!icase_equal(phrase, t_phrase))
+          found.push_back({phrase, d});
+  }
+
+  std::sort(found.begin(), found.end(),
+            [](Confusable const& a, Confusable const& b)
+            { return a.distance < b.distance || (a.distance == b.distance && a.phrase < b.phrase); });
+  return found;
+}
+
+size_t
+HNx::PhoneticIndex::size() const
+{
+  return m_size;
+}
+
+std::vector<std::pair<std::wstring, Confusable>>
+HNx::PhoneticIndex::validate(std::vector<std::wstring> const& t_phrases,
+                             unsigned t_maxDistance)
+{
+  std::vector<std::pair<std::wstring, Confusable>> pairs;
+  PhoneticIndex index(t_maxDistance);
+
+  // each key is cut into every count of
+  //  pieces it may be searched with
+  size_t pieces = 0;
+  for(size_t p = index.m_minPieces; p <= index.m_maxPieces; ++p)
+    pieces += p;
+  index.m_entries.reserve(t_phrases.size());
+  index.m_phrases.reserve(t_phrases.size());
+  index.m_byKey.reserve(t_phrases.size());
+  index.m_segments.reserve(t_phrases.size() * pieces);
+
+  for(auto const& phrase : t_phrases)
+  {
+    for(auto& hit : index.nearest(phrase))
+      pairs.emplace_back(phrase, std::move(hit));
+    index.insert(phrase);
+  }
+  return pairs;
+}
@@ -0,0 +1,150 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+//   Finds phrases that sound alike. Phrases
+//  are reduced to a Metaphone-style key and
+//  each key is indexed by the pieces it is
+//  cut into. A key within k edits of another
+//  shares at least one of k + 1 pieces with
+//  it, so only keys sharing a piece are ever
+//  compared
+//
+//  Words are keyed separately and joined
+//  without spaces, so "mute" and "mute all"
+//  are a single edit apart
+
+namespace HNx
+{
+
+struct Confusable
+{
+  std::wstring phrase {};
+
+  // edits between the two phonetic keys
+  unsigned distance {0};
+};
+
+class PhoneticIndex
+{
+public:
+  // t_maxDistance of 0 scales the allowed
+  //  edits with the length of the key
+  explicit PhoneticIndex(unsigned t_maxDistance = 0);
+
+  void
+    insert(std::wstring_view t_phrase);
+
+  // the key stays indexed, only the
+  //  phrase is dropped from its entry
+  void
+    remove(std::wstring_view t_phrase);
+
+  // phrases that sound like t_phrase,
+  //  closest first, never t_phrase itself
+  std::vector<Confusable>
+    nearest(std::wstring_view t_phrase) const;
+
+  size_t
+    size() const;
+
+  // every confusable pair in t_phrases, each
+  //  phrase paired with an earlier one
+  static std::vector<std::pair<std::wstring, Confusable>>
+    validate(std::vector<std::wstring> const& t_phrases,
+             unsigned t_maxDistance = 0);
+
+  // upper case consonant skeleton, digits kept
+  static std::wstring
+    key(std::wstring_view t_phrase);
+
+  static unsigned
+    distance(std::wstring_view a, std::wstring_view b);
+
+private:
+  // all nearest() reads of a candidate, the
+  //  phrases are kept apart so a lookup
+  //  touches as little memory as it can
+  struct Entry
+  {
+    // the key in m_keys
+    uint32_t offset {0};
+    uint32_t length {0};
+
+    // which symbols the key uses, one edit
+    //  changes at most two bits of it
+    uint32_t symbols {0};
+
+    // phrases left in m_phrases
+    uint32_t live {0};
+  };
+
+  unsigned
+    limit_for(std::wstring const& t_key) const;
+
+  static bool
+    close_enough(unsigned t_distance, size_t t_lengthA, size_t t_lengthB);
+
+  // t_cap + 1 for anything further apart
+  static unsigned
+    bounded_distance(std::wstring_view a, std::wstring_view b, unsigned t_cap);
+
+  // where each ASCII symbol is in a key of
+  //  64 or fewer, for bit_distance()
+  using Positions = std::array<uint64_t, 128>;
+
+  // false if t_key is too long or
+  //  not ASCII
+  static bool
+    positions_of(std::wstring_view t_key, Positions& t_out);
+
+  // bounded_distance() a column of the
+  //  table at a time, one word per column
+  //  (Myers)
+  static unsigned
+    bit_distance(Positions const& t_key, size_t t_length, std::wstring_view t_text, unsigned t_cap);
+
+  // start and length of piece t_index
+  //  when a key of t_length is cut into
+  //  t_pieces
+  static std::pair<size_t, size_t>
+    segment(size_t t_length, size_t t_pieces, size_t t_index);
+
+  static uint32_t
+    symbols_of(std::wstring_view t_key);
+
+  // hashed, a collision only adds a
+  //  candidate that fails the distance
+  static uint64_t
+    segment_key(size_t t_length, size_t t_pieces, size_t t_index, std::wstring_view t_text);
+
+  unsigned m_maxDistance {0};
+
+  // keys are cut once for every limit
+  //  they may be searched with, longer
+  //  pieces find fewer candidates
+  size_t m_minPieces {0};
+  size_t m_maxPieces {0};
+
+  std::vector<Entry> m_entries {};
+  std::vector<std::vector<std::wstring>> m_phrases {};
+  std::unordered_map<std::wstring, uint32_t> m_byKey {};
+
+  // every key, one after another
+  std::wstring m_keys {};
+
+  // entries by (key length, pieces, piece, text)
+  std::unordered_map<uint64_t, std::vector<uint32_t>> m_segments {};
+
+  // keys too short to cut, by length
+  std::vector<std::vector<uint32_t>> m_short {};
+
+  size_t m_size {0};
+};
+
+}
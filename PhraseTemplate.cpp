@@ -0,0 +1,450 @@
+#include "PhraseTemplate.h"
+#include "Util.h"
+
+#include <array>
+#include <cwctype>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+
+//====================================//
+// HNx Voice Command Phrase Templates //
+//====================================//
+// Parses, matches and fills in the   //
+//  slots of templated phrases        //
+//====================================//
+
+using namespace HNx;
+
+namespace
+{
+constexpr std::array<wchar_t const*, 20> ONES {
+  L"zero", L"one", L"two", L"three", L"four",
+  L"five", L"six", L"seven", L"eight", L"nine",
+  L"ten", L"eleven", L"twelve", L"thirteen", L"fourteen",
+  L"fifteen", L"sixteen", L"seventeen", L"eighteen", L"nineteen"};
+
+constexpr std::array<wchar_t const*, 10> TENS {
+  L"", L"", L"twenty", L"thirty", L"forty",
+  L"fifty", L"sixty", L"seventy", L"eighty", L"ninety"};
+
+// longest spoken number we try to match,
+//  "minus nine hundred ninety nine thousand..."
+constexpr size_t MaxNumberWords {10};
+
+std::vector<std::wstring>
+splitWords(std::wstring_view t_text)
+{
+  std::vector<std::wstring> words;
+  for(size_t pos = 0; pos < t_text.size();)
+  {
+    size_t end = t_text.find(L' ', pos);
+    if(end == std::wstring_view::npos)
+      end = t_text.size();
+    if(end > pos)
+      words.emplace_back(t_text.substr(pos, end - pos));
+    pos = end + 1;
+  }
+  return words;
+}
+
+std::wstring
+joinWords(std::vector<std::wstring> const& t_words,
+          size_t t_first,
+          size_t t_last)
+{
+  std::wstring joined;
+  for(size_t i = t_first; i < t_last; ++i)
+  {
+    if(i != t_first)
+      joined.push_back(L' ');
+    joined.append(t_words[i]);
+  }
+  return joined;
+}
+
+bool
+isInteger(std::wstring_view t_str)
+{
+  if(!t_str.empty() && t_str.front() == L'-')
+    t_str.remove_prefix(1);
+  if(t_str.empty() || t_str.size() > 9)
+    return false;
+  for(auto c : t_str)
+    if(!std::iswdigit(c))
+      return false;
+  return true;
+}
+
+int
+indexOf(wchar_t const* const* t_first,
+        size_t t_count,
+        std::wstring const& t_word)
+{
+  for(size_t i = 0; i < t_count; ++i)
+    if(*t_first[i] && icase_equal(t_first[i], t_word))
+      return static_cast<int>(i);
+  return -1;
+}
+}
+
+HNx::PhraseTemplate::PhraseTemplate(std::wstring_view t_pattern)
+  : m_pattern(t_pattern)
+{
+  bool hasLiteral = false;
+
+  auto addLiteral = [&](std::wstring_view t_text)
+  {
+    auto words = splitWords(t_text);
+    if(words.empty())
+      return;
+    hasLiteral = true;
+    // merge with a literal run before it
+    if(!m_parts.empty() && m_parts.back().slot < 0)
+      words.insert(words.begin(), m_parts.back().words);
+    else
+      m_parts.emplace_back();
+    m_parts.back().words = joinWords(words, 0, words.size());
+  };
+
+  size_t pos = 0;
+  while(pos < t_pattern.size())
+  {
+    size_t open = t_pattern.find(L'{', pos);
+    addLiteral(t_pattern.substr(pos, open == std::wstring_view::npos ? std::wstring_view::npos : open - pos));
+    if(open == std::wstring_view::npos)
+      break;
+
+    size_t close = t_pattern.find(L'}', open);
+    if(close == std::wstring_view::npos)
+      throw std::invalid_argument("Phrase template slot is missing '}'");
+
+    std::wstring_view spec = t_pattern.substr(open + 1, close - open - 1);
+    size_t colon = spec.find(L':');
+    if(colon == std::wstring_view::npos || colon == 0 || colon + 1 == spec.size())
+      throw std::invalid_argument("Phrase template slot must look like {name:type}");
+
+    Slot slot;
+    slot.name = spec.substr(0, colon);
+    for(auto const& s : m_slots)
+      if(icase_equal(s.name, slot.name))
+        throw std::invalid_argument("Phrase template slot names must be unique");
+
+    std::wstring_view type = spec.substr(colon + 1);
+    size_t dash = type.find(L'-', 1);
+    if(type == L"*")
+    {
+      slot.type = SlotType::FreeText;
+    }
+    else if(dash != std::wstring_view::npos &&
+            isInteger(type.substr(0, dash)) &&
+            isInteger(type.substr(dash + 1)))
+    {
+      slot.type = SlotType::Number;
+      slot.min = std::stoi(std::wstring(type.substr(0, dash)));
+      slot.max = std::stoi(std::wstring(type.substr(dash + 1)));
+      if(slot.min > slot.max)
+        throw std::invalid_argument("Phrase template number range is reversed");
+      if(static_cast<long long>(slot.max) - slot.min >= MaxNumberSlotValues)
+        throw std::invalid_argument("Phrase template number range is too large");
+    }
+    else
+    {
+      slot.type = SlotType::Choice;
+      for(size_t first = 0; first <= type.size();)
+      {
+        size_t bar = type.find(L'|', first);
+        if(bar == std::wstring_view::npos)
+          bar = type.size();
+        auto words = splitWords(type.substr(first, bar - first));
+        if(words.empty())
+          throw std::invalid_argument("Phrase template choices cant be empty");
+        slot.choices.push_back(joinWords(words, 0, words.size()));
+        first = bar + 1;
+      }
+    }
+
+    TemplatePart part;
+    part.slot = static_cast<int>(m_slots.size());
+    m_parts.push_back(part);
+    m_slots.push_back(std::move(slot));
+    pos = close + 1;
+  }
+
+  for(size_t i = 0; i + 1 < m_parts.size(); ++i)
+    if(m_parts[i].slot >= 0 && m_slots[m_parts[i].slot].type == SlotType::FreeText)
+      throw std::invalid_argument("Phrase template free text slot must be last");
+
+  // a template made only of slots would
+  //  swallow half of everything said
+  if(!hasLiteral)
+    throw std::invalid_argument("Phrase template needs at least one literal word");
+}
+
+bool
+HNx::PhraseTemplate::match(std::wstring_view t_text,
+                           std::vector<std::wstring>& t_values) const
+{
+  auto words = splitWords(t_text);
+  std::vector<std::wstring> values(m_slots.size());
+
+  std::function<bool(size_t, size_t)> matchFrom = [&](size_t t_part, size_t t_word)
+  {
+    if(t_part == m_parts.size())
+      return t_word == words.size();
+
+    auto const& part = m_parts[t_part];
+    if(part.slot < 0)
+    {
+      auto literal = splitWords(part.words);
+      if(t_word + literal.size() > words.size())
+        return false;
+      for(size_t i = 0; i < literal.size(); ++i)
+        if(!icase_equal(literal[i], words[t_word + i]))
+          return false;
+      return matchFrom(t_part + 1, t_word + literal.size());
+    }
+
+    auto const& slot = m_slots[part.slot];
+    switch(slot.type)
+    {
+      case SlotType::FreeText:
+      if(t_word == words.size())
+        return false;
+      values[part.slot] = joinWords(words, t_word, words.size());
+      return true;
+
+      case SlotType::Number:
+      for(size_t last = t_word + 1; last <= words.size() && last - t_word <= MaxNumberWords; ++last)
+      {
+        int value = 0;
+        if(wordsToNumber(words, t_word, last, value) &&
+           value >= slot.min && value <= slot.max)
+        {
+          values[part.slot] = std::to_wstring(value);
+          if(matchFrom(t_part + 1, last))
+            return true;
+        }
+      }
+      return false;
+
+      case SlotType::Choice:
+      for(auto const& choice : slot.choices)
+      {
+        auto choiceWords = splitWords(choice);
+        if(t_word + choiceWords.size() > words.size())
+          continue;
+        bool same = true;
+        for(size_t i = 0; same && i < choiceWords.size(); ++i)
+          same = icase_equal(choiceWords[i], words[t_word + i]);
+        if(same)
+        {
+          values[part.slot] = choice;
+          if(matchFrom(t_part + 1, t_word + choiceWords.size()))
+            return true;
+        }
+      }
+      return false;
+    }
+    return false;
+  };
+
+  if(!matchFrom(0, 0))
+    return false;
+
+  t_values.swap(values);
+  return true;
+}
+
+std::wstring
+HNx::PhraseTemplate::substitute(std::wstring_view t_str,
+                                std::vector<std::wstring> const& t_values) const
+{
+  std::wstring out;
+  out.reserve(t_str.size());
+
+  size_t pos = 0;
+  while(pos < t_str.size())
+  {
+    size_t open = t_str.find(L'{', pos);
+    size_t close = open == std::wstring_view::npos ? open : t_str.find(L'}', open);
+    if(close == std::wstring_view::npos)
+    {
+      out.append(t_str.substr(pos));
+      break;
+    }
+
+    out.append(t_str.substr(pos, open - pos));
+    std::wstring_view name = t_str.substr(open + 1, close - open - 1);
+
+    // unknown names are left as they are
+    bool replaced = false;
+    for(size_t i = 0; i < m_slots.size() && i < t_values.size(); ++i)
+      if(icase_equal(m_slots[i].name, name))
+      {
+        out.append(t_values[i]);
+        replaced = true;
+        break;
+      }
+    if(!replaced)
+      out.append(t_str.substr(open, close - open + 1));
+
+    pos = close + 1;
+  }
+  return out;
+}
+
+size_t
+HNx::PhraseTemplate::transitionCount() const
+{
+  size_t count = 0;
+  for(auto const& part : m_parts)
+  {
+    if(part.slot < 0)
+    {
+      count++;
+      continue;
+    }
+    auto const& slot = m_slots[part.slot];
+    switch(slot.type)
+    {
+      case SlotType::Number:   count += static_cast<size_t>(slot.max - slot.min) + 1; break;
+      case SlotType::Choice:   count += slot.choices.size(); break;
+      case SlotType::FreeText: count++; break;
+    }
+  }
+  return count;
+}
+
+size_t
+HNx::PhraseTemplate::expandedCount() const
+{
+  size_t count = 1;
+  for(auto const& slot : m_slots)
+  {
+    size_t values = 1;
+    if(slot.type == SlotType::Number)
+      values = static_cast<size_t>(slot.max - slot.min) + 1;
+    else if(slot.type == SlotType::Choice)
+      values = slot.choices.size();
+
+    if(count > std::numeric_limits<size_t>::max() / values)
+      return std::numeric_limits<size_t>::max();
+    count *= values;
+  }
+  return count;
+}
+
+std::wstring
+HNx::numberToWords(int t_value)
+{
+  if(t_value < 0)
+    return L"minus " + numberToWords(-t_value);
+  if(t_value < 20)
+    return ONES[t_value];
+  if(t_value < 100)
+    return std::wstring(TENS[t_value / 10]) +
+      (t_value % 10 ? L" " + std::wstring(ONES[t_value % 10]) : L"");
+  if(t_value < 1000)
+    return std::wstring(ONES[t_value / 100]) + L" hundred" +
+      (t_value % 100 ? L" " + numberToWords(t_value % 100) : L"");
+  return numberToWords(t_value / 1000) + L" thousand" +
+    (t_value % 1000 ? L" " + numberToWords(t_value % 1000) : L"");
+}
+
+bool
+HNx::wordsToNumber(std::vector<std::wstring> const& t_words,
+                   size_t t_first,
+                   size_t t_last,
+                   int& t_value)
+{
+  if(t_first >= t_last || t_last > t_words.size())
+    return false;
+
+  // recognizers may hand back digits
+  if(t_last - t_first == 1 && isInteger(t_words[t_first]))
+  {
+    t_value = std::stoi(t_words[t_first]);
+    return true;
+  }
+
+  bool negative = false;
+  if(icase_equal(t_words[t_first], L"minus") || icase_equal(t_words[t_first], L"negative"))
+  {
+    negative = true;
+    t_first++;
+  }
+
+  int total = 0;
+  int current = 0;
+  bool any = false;
+  bool zero = false;
+  bool canAnd = false;
+
+  for(size_t i = t_first; i < t_last; ++i)
+  {
+    auto const& word = t_words[i];
+    int small = current % 100;
+    int unit = indexOf(ONES.data(), ONES.size(), word);
+    int tens = indexOf(TENS.data(), TENS.size(), word);
+
+    if(zero)
+      return false;
+
+    if(unit >= 0)
+    {
+      bool fresh = small == 0;
+      bool afterTens = small >= 20 && small % 10 == 0 && unit > 0 && unit < 10;
+      if(!fresh && !afterTens)
+        return false;
+      if(unit == 0)
+      {
+        if(any)
+          return false;
+        zero = true;
+      }
+      current += unit;
+      canAnd = false;
+    }
+    else if(tens >= 0)
+    {
+      if(small != 0)
+        return false;
+      current += tens * 10;
+      canAnd = false;
+    }
+    else if(icase_equal(word, L"hundred"))
+    {
+      if(current < 1 || current > 9)
+        return false;
+      current *= 100;
+      canAnd = true;
+    }
+    else if(icase_equal(word, L"thousand"))
+    {
+      if(current < 1 || total != 0)
+        return false;
+      total = current * 1000;
+      current = 0;
+      canAnd = true;
+    }
+    else if(icase_equal(word, L"and"))
+    {
+      if(!canAnd || i + 1 == t_last)
+        return false;
+      canAnd = false;
+      continue;
+    }
+    else
+    {
+      return false;
+    }
+    any = true;
+  }
+
+  if(!any)
+    return false;
+
+  t_value = negative ? -(total + current) : total + current;
+  return true;
+}
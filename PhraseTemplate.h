@@ -0,0 +1,117 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+
+//   A phrase with typed slots that is compiled
+//  into a single grammar rule instead of one
+//  command per value
+//
+//  "set volume to {level:0-100}"      number range
+//  "open {app:mail|web browser}"      choice of words
+//  "search for {query:*}"             free text tail
+//
+//  The captured values replace {level}, {app}
+//  and {query} in the exec and param strings
+
+namespace HNx
+{
+
+enum class SlotType
+{
+  Number,
+  Choice,
+  FreeText
+};
+
+struct Slot
+{
+  std::wstring name {};
+  SlotType type {SlotType::Choice};
+
+  // Number only, inclusive
+  int min {0};
+  int max {0};
+
+  // Choice only, may be several words each
+  std::vector<std::wstring> choices {};
+};
+
+// a run of literal words, or a slot
+struct TemplatePart
+{
+  std::wstring words {};
+  int slot {-1};
+};
+
+// most values a number slot may span
+constexpr int MaxNumberSlotValues {10000};
+
+class PhraseTemplate
+{
+public:
+  PhraseTemplate() = default;
+
+  // throws std::invalid_argument for bad
+  //  slot syntax, repeated slot names, a
+  //  free text slot that isn't last or a
+  //  template without any literal words
+  explicit PhraseTemplate(std::wstring_view t_pattern);
+
+  std::wstring const&
+    pattern() const
+  {
+    return m_pattern;
+  }
+
+  std::vector<TemplatePart> const&
+    parts() const
+  {
+    return m_parts;
+  }
+
+  std::vector<Slot> const&
+    slots() const
+  {
+    return m_slots;
+  }
+
+  // on a match t_values holds one value
+  //  per slot, numbers as digits
+  bool
+    match(std::wstring_view t_text,
+          std::vector<std::wstring>& t_values) const;
+
+  // replaces {name} with the captured values
+  std::wstring
+    substitute(std::wstring_view t_str,
+               std::vector<std::wstring> const& t_values) const;
+
+  // word transitions the compiled rule holds
+  size_t
+    transitionCount() const;
+
+  // commands needed to spell every value out,
+  //  a free text slot counts as one
+  size_t
+    expandedCount() const;
+
+private:
+  std::wstring m_pattern {};
+  std::vector<TemplatePart> m_parts {};
+  std::vector<Slot> m_slots {};
+};
+
+// "forty two" for 42, handles +-999999
+std::wstring
+  numberToWords(int t_value);
+
+// parses words like "one hundred five" or
+//  digits, every word must be used
+bool
+  wordsToNumber(std::vector<std::wstring> const& t_words,
+                size_t t_first,
+                size_t t_last,
+                int& t_value);
+
+}
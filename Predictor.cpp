@@ -0,0 +1,105 @@
+#include "Predictor.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+//=================================//
+// HNx Voice Command Predictor     //
+//=================================//
+// n-gram model over the history   //
+//  of dispatched commands         //
+//=================================//
+
+using namespace HNx;
+
+HNx::Predictor::Predictor(size_t t_order)
+  : m_order(t_order)
+{
+  if(m_order == 0)
+    throw std::invalid_argument("Predictor order cant be 0");
+}
+
+std::wstring
+HNx::Predictor::contextKey(std::deque<std::wstring> const& t_history,
+                           size_t t_length)
+{
+  std::wstring key;
+  for(size_t i = t_history.size() - t_length; i < t_history.size(); ++i)
+    key.append(t_history[i]).push_back(L'\n');
+  return key;
+}
+
+bool
+HNx::Predictor::observe(std::wstring_view t_phrase)
+{
+  std::wstring phrase = lower_key(t_phrase);
+  if(phrase.empty())
+    return false;
+
+  std::lock_guard<std::mutex> lock(m_mtx);
+
+  bool hit = std::find(m_lastPrediction.begin(), m_lastPrediction.end(), phrase) != m_lastPrediction.end();
+  m_stats.observed++;
+  if(!m_lastPrediction.empty())
+  {
+    m_stats.predicted++;
+    if(hit)
+      m_stats.hits++;
+  }
+  m_lastPrediction.clear();
+
+  // every history length up to our order
+  //  so shorter ones can be backed off to
+  for(size_t length = 1; length <= std::min(m_order, m_history.size()); ++length)
+    m_counts[contextKey(m_history, length)][phrase]++;
+
+  m_history.push_back(std::move(phrase));
+  if(m_history.size() > m_order)
+    m_history.pop_front();
+
+  return hit;
+}
+
+std::vector<std::pair<std::wstring, double>>
+HNx::Predictor::predict(size_t t_count)
+{
+  std::lock_guard<std::mutex> lock(m_mtx);
+
+  std::vector<std::pair<std::wstring, double>> next;
+  m_lastPrediction.clear();
+  if(t_count == 0)
+    return next;
+
+  // longest history that has been seen before
+  for(size_t length = std::min(m_order, m_history.size()); length > 0; --length)
+  {
+    auto it = m_counts.find(contextKey(m_history, length));
+    if(it == m_counts.end())
+      continue;
+
+    unsigned total = 0;
+    for(auto const& c : it->second)
+      total += c.second;
+
+    for(auto const& c : it->second)
+      next.emplace_back(c.first, static_cast<double>(c.second) / total);
+    break;
+  }
+
+  std::sort(next.begin(), next.end(),
+            [](auto const& a, auto const& b) { return a.second > b.second; });
+  if(next.size() > t_count)
+    next.resize(t_count);
+
+  for(auto const& n : next)
+    m_lastPrediction.push_back(n.first);
+  return next;
+}
+
+PredictorStats
+HNx::Predictor::stats() const
+{
+  std::lock_guard<std::mutex> lock(m_mtx);
+  return m_stats;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+//   Guesses the next command from the last
+//  few dispatched ones with an n-gram model,
+//  falling back to shorter histories when a
+//  longer one hasn't been seen yet
+
+namespace HNx
+{
+
+struct PredictorStats
+{
+  // commands observed
+  size_t observed {0};
+
+  // observations that had a prediction
+  //  made for them, and those that were
+  //  among the predicted commands
+  size_t predicted {0};
+  size_t hits {0};
+};
+
+class Predictor
+{
+public:
+  // t_order is how many earlier commands
+  //  are used, 1 is a plain Markov chain
+  explicit Predictor(size_t t_order = 2);
+
+  // adds a dispatched command to the model
+  //  and the history, returns true if it
+  //  was among the last predictions
+  bool
+    observe(std::wstring_view t_phrase);
+
+  // most likely next commands with their
+  //  probability, most likely first,
+  //  remembered for the next observe()
+  std::vector<std::pair<std::wstring, double>>
+    predict(size_t t_count);
+
+  PredictorStats
+    stats() const;
+
+private:
+  // history joined by '\n', oldest first
+  static std::wstring
+    contextKey(std::deque<std::wstring> const& t_history,
+               size_t t_length);
+
+  size_t m_order {2};
+
+  // context -> next phrase -> count
+  std::map<std::wstring, std::map<std::wstring, unsigned>> m_counts {};
+
+  std::deque<std::wstring> m_history {};
+  std::vector<std::wstring> m_lastPrediction {};
+
+  PredictorStats m_stats {};
+
+  mutable std::mutex m_mtx {};
+};
+
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <windows.h>
+#include <psapi.h>
+
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+
+//   What this process has cost so far, for
+//  the benchmarks and the startup reports
+//  that compare the window with the daemon
+
+namespace HNx
+{
+
+struct ProcessReport
+{
+  // since the process was created
+  std::chrono::milliseconds uptime {};
+
+  // user and kernel time
+  std::chrono::milliseconds cpu {};
+
+  size_t workingSet {0};
+  size_t peakWorkingSet {0};
+  size_t privateBytes {0};
+};
+
+inline
+unsigned long long
+filetimeTicks(FILETIME const& t_time)
+{
+  return (static_cast<unsigned long long>(t_time.dwHighDateTime) << 32) | t_time.dwLowDateTime;
+}
+
+// user and kernel time of the whole process
+inline
+std::chrono::milliseconds
+processCpu()
+{
+  FILETIME created, exited, kernel, user;
+  if(!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user))
+    return {};
+  return std::chrono::milliseconds((filetimeTicks(kernel) + filetimeTicks(user)) / 10000);
+}
+
+inline
+ProcessReport
+processReport()
+{
+  ProcessReport report;
+
+  FILETIME created, exited, kernel, user, now;
+  if(GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user))
+  {
+    GetSystemTimePreciseAsFileTime(&now);
+    report.uptime = std::chrono::milliseconds((filetimeTicks(now) - filetimeTicks(created)) / 10000);
+    report.cpu = std::chrono::milliseconds((filetimeTicks(kernel) + filetimeTicks(user)) / 10000);
+  }
+
+  PROCESS_MEMORY_COUNTERS_EX memory {};
+  memory.cb = sizeof(memory);
+  if(GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&memory), sizeof(memory)))
+  {
+    report.workingSet = memory.WorkingSetSize;
+    report.peakWorkingSet = memory.PeakWorkingSetSize;
+    report.privateBytes = memory.PrivateUsage;
+  }
+  return report;
+}
+
+// one line, tab separated
+inline
+std::ostream&
+operator<<(std::ostream& t_out, ProcessReport const& t_report)
+{
+  auto mb = [](size_t t_bytes) { return static_cast<double>(t_bytes) / (1024.0 * 1024.0); };
+  return t_out << "startup " << t_report.uptime.count() << " ms\tcpu " << t_report.cpu.count()
+               << " ms\tworking set " << mb(t_report.workingSet) << " MB\tpeak " << mb(t_report.peakWorkingSet)
+               << " MB\tprivate " << mb(t_report.privateBytes) << " MB";
+}
+
+}
@@ -0,0 +1,215 @@
+#include "Profile.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+
+//=================================//
+// HNx Voice Command Profile       //
+//=================================//
+// Loads command sets from text    //
+//  files                          //
+//=================================//
+
+using namespace HNx;
+
+namespace
+{
+// past this many entries edited every
+//  entry is hashed instead of scanning
+//  both sets once per edited key
+constexpr size_t MAX_EDITED_TO_SCAN = 64;
+
+// context and phrase, lower case
+std::wstring
+entryKey(ProfileEntry const& t_entry)
+{
+  return lower_key(t_entry.context) + L'\t' + lower_key(t_entry.phrase);
+}
+
+// the first entry of every key
+std::unordered_map<std::wstring, ProfileEntry const*>
+byKey(std::vector<ProfileEntry> const& t_entries)
+{
+  std::unordered_map<std::wstring, ProfileEntry const*> keyed;
+  keyed.reserve(t_entries.size());
+  for(auto const& entry : t_entries)
+    keyed.try_emplace(entryKey(entry), &entry);
+  return keyed;
+}
+
+bool
+sameKey(ProfileEntry const& a, ProfileEntry const& b)
+{
+  return lower_key(a.phrase) == lower_key(b.phrase) &&
+    lower_key(a.context) == lower_key(b.context);
+}
+
+// what the recognizer would hold the same
+bool
+sameCommand(ProfileEntry const& a, ProfileEntry const& b)
+{
+  return a.phrase == b.phrase && a.exec == b.exec && a.param == b.param;
+}
+
+bool
+identical(ProfileEntry const& a, ProfileEntry const& b)
+{
+  return sameCommand(a, b) && a.context == b.context;
+}
+
+ProfileEntry const*
+firstOf(std::vector<ProfileEntry> const& t_entries, ProfileEntry const& t_key)
+{
+  for(auto const& entry : t_entries)
+    if(sameKey(entry, t_key))
+      return &entry;
+  return nullptr;
+}
+
+// hashes every entry of both sets
+ProfileDiff
+keyedDiff(std::vector<ProfileEntry> const& t_old,
+          std::vector<ProfileEntry> const& t_new)
+{
+  auto before = byKey(t_old);
+  auto after = byKey(t_new);
+
+  ProfileDiff diff;
+  for(auto const& entry : before)
+  {
+    auto it = after.find(entry.first);
+    if(it == after.end() || !sameCommand(*it->second, *entry.second))
+      diff.removed.push_back(*entry.second);
+  }
+
+  // in file order, so adds go in as they
+  //  would have at startup
+  for(auto const& entry : t_new)
+  {
+    auto key = entryKey(entry);
+    auto it = after.find(key);
+    if(it == after.end() || it->second != &entry)
+      continue;
+
+    auto was = before.find(key);
+    if(was == before.end() || !sameCommand(*was->second, entry))
+      diff.added.push_back(entry);
+  }
+  return diff;
+}
+}
+
+std::vector<ProfileEntry>
+HNx::loadProfile(std::wstring const& t_path)
+{
+  std::ifstream in(std::filesystem::path(t_path), std::ios::binary);
+  if(!in)
+    throw std::runtime_error("Failed to open command profile.");
+
+  std::vector<ProfileEntry> entries;
+  std::string line;
+  while(std::getline(in, line))
+  {
+    if(!line.empty() && line.back() == '\r')
+      line.pop_back();
+    if(line.empty() || line[0] == '#')
+      continue;
+
+    std::vector<std::wstring> fields;
+    size_t start = 0;
+    while(true)
+    {
+      size_t tab = line.find('\t', start);
+      fields.push_back(trim_whitespace(from_utf8(std::string_view(line).substr(start, tab - start))));
+      if(tab == std::string::npos)
+        break;
+      start = tab + 1;
+    }
+    fields.resize(4);
+
+    if(fields[0].empty() || fields[1].empty())
+      continue;
+    entries.push_back({fields[0], fields[1], fields[2], fields[3]});
+  }
+  return entries;
+}
+
+std::vector<ProfileEntry>
+HNx::loadProfiles(std::wstring const& t_path)
+{
+  std::filesystem::path path(t_path);
+  std::error_code ec;
+  if(!std::filesystem::is_directory(path, ec))
+    return loadProfile(t_path);
+
+  std::vector<std::filesystem::path> files;
+  for(auto const& item : std::filesystem::directory_iterator(path, ec))
+    if(item.is_regular_file(ec) && icase_equal(item.path().extension().wstring(), L".txt"))
+      files.push_back(item.path());
+  if(ec)
+    throw std::runtime_error("Failed to list command profiles.");
+  std::sort(files.begin(), files.end());
+
+  std::vector<ProfileEntry> entries;
+  for(auto const& file : files)
+  {
+    auto more = loadProfile(file.wstring());
+    entries.insert(entries.end(),
+                   std::make_move_iterator(more.begin()),
+                   std::make_move_iterator(more.end()));
+  }
+  return entries;
+}
+
+ProfileDiff
+HNx::diffProfiles(std::vector<ProfileEntry> const& t_old,
+                  std::vector<ProfileEntry> const& t_new)
+{
+  // files are mostly edited in place, the
+  //  entries before and after the edit
+  //  match line for line
+  size_t common = std::min(t_old.size(), t_new.size());
+  size_t front = 0;
+  while(front < common && identical(t_old[front], t_new[front]))
+    ++front;
+  size_t back = 0;
+  while(back < common - front &&
+        identical(t_old[t_old.size() - 1 - back], t_new[t_new.size() - 1 - back]))
+    ++back;
+
+  size_t edited = t_old.size() + t_new.size() - 2 * (front + back);
+  if(edited > MAX_EDITED_TO_SCAN)
+    return keyedDiff(t_old, t_new);
+
+  // only the keys of the edited entries can
+  //  differ, an earlier or later entry with
+  //  the same key may be the one that counts
+  std::vector<ProfileEntry const*> keys;
+  auto note = [&](ProfileEntry const& t_entry)
+  {
+    for(auto key : keys)
+      if(sameKey(*key, t_entry))
+        return;
+    keys.push_back(&t_entry);
+  };
+  for(size_t i = front; i < t_old.size() - back; ++i)
+    note(t_old[i]);
+  for(size_t i = front; i < t_new.size() - back; ++i)
+    note(t_new[i]);
+
+  ProfileDiff diff;
+  for(auto key : keys)
+  {
+    auto was = firstOf(t_old, *key);
+    auto now = firstOf(t_new, *key);
+    if(was && (!now || !sameCommand(*was, *now)))
+      diff.removed.push_back(*was);
+    if(now && (!was || !sameCommand(*was, *now)))
+      diff.added.push_back(*now);
+  }
+  return diff;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <string>
+#include <vector>
+
+//   A command set kept in a plain text file,
+//  one command per line, fields separated by
+//  tabs:
+//
+//    phrase<TAB>exec[<TAB>param[<TAB>context]]
+//
+//  UTF-8, blank lines and lines starting
+//  with # are skipped
+
+namespace HNx
+{
+
+struct ProfileEntry
+{
+  std::wstring phrase {};
+  std::wstring exec {};
+  std::wstring param {};
+  std::wstring context {};
+};
+
+// throws std::runtime_error if the file
+//  can't be read, lines without an exec
+//  are skipped
+std::vector<ProfileEntry>
+  loadProfile(std::wstring const& t_path);
+
+// t_path's profile, or if it is a directory
+//  the profiles of its .txt files in name
+//  order; throws like loadProfile()
+std::vector<ProfileEntry>
+  loadProfiles(std::wstring const& t_path);
+
+// what turns one command set into another,
+//  an entry changed is in both
+struct ProfileDiff
+{
+  std::vector<ProfileEntry> removed {};
+  std::vector<ProfileEntry> added {};
+};
+
+// entries are keyed by context and phrase,
+//  both case insensitive, the first of the
+//  same key wins like it does when adding
+//  them; a few lines edited in place cost a
+//  scan, more hash both sets
+ProfileDiff
+  diffProfiles(std::vector<ProfileEntry> const& t_old,
+               std::vector<ProfileEntry> const& t_new);
+
+}
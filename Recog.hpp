@@ -34,8 +34,20 @@
 //     and exits the process
 // 
 /////////////////////////////////////////////////////////////////////
+#include "ColdIndex.h"
 #include "Command.h"
 #include "CommandGroup.h"
+#include "DeviceSource.h"
+#include "Exec.h"
+#include "Keyword.h"
+#include "LaunchCache.h"
+#include "Macro.h"
+#include "Metrics.h"
+#include "Predictor.h"
+#include "RingStream.h"
+#include "Trace.h"
+#include "UsageStats.h"
+#include "Vad.h"
 #include "Util.h"
 
 #include <windows.h>
@@ -55,7 +67,11 @@
 #include <stdexcept>
 
 #include <vector>
+#include <map>
+#include <memory>
+#include <cwctype>
 
+#include <atomic>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
@@ -90,6 +106,55 @@ constexpr unsigned long long HotwordGramID {1ull};
 constexpr unsigned long long BuiltInGramID {2ull};
 constexpr unsigned long long CommandsGramID {3ull};
 
+// free dictation, only loaded for the
+//  second pass over evicted commands
+constexpr unsigned long long DictationGramID {4ull};
+
+// context shards take grammar ids from here up
+constexpr unsigned long long FirstShardGramID {16ull};
+
+// how often usage is fed back into the
+//  grammars, only while idle
+constexpr auto UsageReweightInterval {std::chrono::minutes(10)};
+
+// likely next commands warmed after each dispatch
+constexpr size_t PrefetchCount {3};
+
+// weight multiplier for predicted phrases
+//  when prediction bias is on
+constexpr float PredictionBoost {2.0f};
+
+// how long commands are listened for
+//  after the hotword
+constexpr auto ListenTimeout {std::chrono::seconds(5)};
+
+// most commands one utterance can chain
+//  with "and" / "then"
+constexpr unsigned MaxCompoundParts {4u};
+
+// a command matched in recorded audio
+struct TranscriptEntry
+{
+  // start of the phrase in the audio
+  std::chrono::milliseconds offset {};
+
+  // start of the hotword it followed
+  std::chrono::milliseconds hotword {};
+
+  // what was said, the whole utterance
+  //  for each part of a compound one
+  std::wstring heard {};
+  Command cmd {};
+};
+
+struct Transcript
+{
+  std::vector<TranscriptEntry> entries {};
+
+  // length of the audio
+  std::chrono::milliseconds audio {};
+};
+
 enum class RecoState
 {
   Unknown,    // Uninitialized
@@ -111,65 +176,112 @@ public: // Functions
   //========================================//
   Recog(const std::wstring t_hotword = L"computer")
     : hotword(t_hotword)
-  {}
+  {
+    // registered before the first scrape
+    metrics();
+    launchMetrics();
+  }
 
   ~Recog()
   {
+    if(!usageFile.empty() && usage.pending())
+      usage.save(usageFile);
+    countListening(false);
+
+    // the microphone first, nothing feeds
+    //  the gates after it
+    micPump.reset();
+
+    // its callback sets the event
+    keywordGate.reset();
+    if(hotwordEvent)
+      CloseHandle(hotwordEvent);
     CoUninitialize();
   }
 
   // sets up the recognizer
-  bool initialize()
+  // t_microphone [optional]
+  //  false leaves the input unbound for
+  //  transcribe() and reports failures
+  //  through lastError() only, no message
+  //  boxes for headless use
+  // t_quiet [optional]
+  //  no message boxes with the microphone
+  //  either, for a service nobody watches
+  bool initialize(bool t_microphone = true, bool t_quiet = false)
   {
+    headless = !t_microphone;
+    quiet = t_quiet;
 
     HRESULT hr = CoInitialize(nullptr);
     if(FAILED(hr))
     {
-      ErrMsg(L"Failed to intialize COM...\n Error: " + std::to_wstring(hr));
+      fail(L"Failed to intialize COM...\n Error: " + std::to_wstring(hr));
       return false;
     }
 
     // this is our reco interface
-    hr = spRecogognizer.CoCreateInstance(IID_ISpRecognizer,
+    hr = spRecogognizer.CoCreateInstance(CLSID_SpInprocRecognizer,
                                          nullptr,
                                          CLSCTX_ALL);
     if(FAILED(hr))
     {
-      ErrMsg(L"Failed to create InProc Recognizer instance\n Error: " + std::to_wstring(hr));
+      fail(L"Failed to create InProc Recognizer instance\n Error: " + std::to_wstring(hr));
       return false;
     }
 
-    // this is the interface we use to select input device
-    hr = spAudioInToken.CoCreateInstance(IID_ISpObjectTokenInit,
-                                         nullptr,
-                                         CLSCTX_ALL);
-    if(FAILED(hr))
+    // the default microphone goes through our
+    //  own front-end so the VAD, and the spotter
+    //  once enrolled, sit in front of SAPI; it
+    //  is bound by startEvents()
+    if(t_microphone)
     {
-      ErrMsg(L"Failed creating object token.\nError: " + std::to_wstring(hr));
-      return false;
+      try
+      {
+        micSource = std::make_unique<DeviceSource>();
+      }
+      catch(std::exception const& e)
+      {
+        DOUT("no capture device, SAPI reads the microphone itself: " << e.what());
+      }
     }
 
-    // we just want the default input device
-    hr = SpGetDefaultTokenFromCategoryId(SPCAT_AUDIOIN, &spAudioInToken);
-    if(FAILED(hr))
+    // offline recognizers get their input
+    //  from transcribe() instead
+    if(t_microphone && !micSource)
     {
-      ErrMsg(L"Failed to get default audio input token.\nError: " + std::to_wstring(hr));
-      return false;
-    }
+      // this is the interface we use to select input device
+      hr = spAudioInToken.CoCreateInstance(IID_ISpObjectTokenInit,
+                                           nullptr,
+                                           CLSCTX_ALL);
+      if(FAILED(hr))
+      {
+        fail(L"Failed creating object token.\nError: " + std::to_wstring(hr));
+        return false;
+      }
 
-    // tell recognizer to use the input device
-    hr = spRecogognizer->SetInput(spAudioInToken, TRUE);
-    if(FAILED(hr))
-    {
-      ErrMsg(L"Failed setting recognizer audio input token.\nError: " + std::to_wstring(hr));
-      return false;
+      // we just want the default input device
+      hr = SpGetDefaultTokenFromCategoryId(SPCAT_AUDIOIN, &spAudioInToken);
+      if(FAILED(hr))
+      {
+        fail(L"Failed to get default audio input token.\nError: " + std::to_wstring(hr));
+        return false;
+      }
+
+      // tell recognizer to use the input device
+      hr = spRecogognizer->SetInput(spAudioInToken, TRUE);
+      if(FAILED(hr))
+      {
+        fail(L"Failed setting recognizer audio input token.\nError: " + std::to_wstring(hr));
+        return false;
+      }
     }
 
     // shortcut to get the english recognizer token
     hr = SpFindBestToken(SPCAT_RECOGNIZERS, ENGLISH_LANG_ID, NULL, &cpRecognizerToken);
     if(FAILED(hr))
     {
-      ErrMsg(L"Failed finding best recognizer token.\nError: " + std::to_wstring(hr));
+      fail(L"Failed finding best recognizer token.\nError: " + std::to_wstring(hr));
       return false;
     }
 
@@ -177,7 +289,7 @@ public: // Functions
     hr = spRecogognizer->SetRecognizer(cpRecognizerToken);
     if(FAILED(hr))
     {
-      ErrMsg(L"Failed setting recognizer by token.\nError: " + std::to_wstring(hr));
+      fail(L"Failed setting recognizer by token.\nError: " + std::to_wstring(hr));
       return false;
     }
 
@@ -185,24 +297,25 @@ public: // Functions
     hr = spRecogognizer->CreateRecoContext(&sprContext);
     if(FAILED(hr))
     {
-      ErrMsg(L"Failed creating recognizer context.\nError: " + std::to_wstring(hr));
+      fail(L"Failed creating recognizer context.\nError: " + std::to_wstring(hr));
       return false;
     }
 
     hr = sprContext->Pause(0ul);
     if(FAILED(hr))
     {
-      ErrMsg(L"Failed pausing the context... \nError: " + std::to_wstring(hr));
+      fail(L"Failed pausing the context... \nError: " + std::to_wstring(hr));
       return false;
     }
 
     //========================================================================
-    upHotwordGrp = std::make_unique<CommandGroup>(new CommandGroup(sprContext.p, L"Hotword", HotwordGramID));
+    upHotwordGrp = std::make_unique<CommandGroup>(sprContext.p, L"Hotword", HotwordGramID);
     upHotwordGrp->deactivate();
-    upBuiltInGrp = std::make_unique<CommandGroup>(new CommandGroup(sprContext.p, L"BuiltIn", BuiltInGramID));
+    upBuiltInGrp = std::make_unique<CommandGroup>(sprContext.p, L"BuiltIn", BuiltInGramID);
     upBuiltInGrp->deactivate();
-    upUserCmdGrp = std::make_unique<CommandGroup>(new CommandGroup(sprContext.p, L"Commands", CommandsGramID));
+    upUserCmdGrp = std::make_unique<CommandGroup>(sprContext.p, L"Commands", CommandsGramID);
     upUserCmdGrp->deactivate();
+    upUserCmdGrp->enableCompound(MaxCompoundParts);
     //========================================================================
 
     Command hotwordCmd(hotword, L"**Hotword**");
@@ -218,6 +331,357 @@ public: // Functions
   }
 
 
+  // why initialize() last returned false
+  std::wstring
+    lastError() const
+  {
+    return lastErr;
+  }
+
+  // runs a recording through the same hotword
+  //  and command state machine as live input,
+  //  matched commands are returned instead
+  //  of being run
+  // needs initialize(false), throws
+  //  std::runtime_error if the file can't be
+  //  read
+  // t_rawPcm [optional]
+  //  headerless 16kHz 16 bit mono, .wav
+  //  files carry their own format
+  Transcript
+    transcribe(std::wstring const& t_path,
+               bool t_rawPcm = false)
+  {
+    if(!initialized || !headless)
+      throw std::runtime_error("transcribe() needs a recognizer from initialize(false)");
+
+    CComPtr<ISpStream> cpStream;
+    HRESULT hr = S_OK;
+    if(t_rawPcm)
+    {
+      CSpStreamFormat format(SPSF_16kHz16BitMono, &hr);
+      if(SUCCEEDED(hr))
+        hr = SPBindToFile(t_path.c_str(), SPFM_OPEN_READONLY, &cpStream, &format.FormatId(), format.WaveFormatExPtr());
+    }
+    else
+      hr = SPBindToFile(t_path.c_str(), SPFM_OPEN_READONLY, &cpStream);
+
+    // to turn stream offsets into time
+    GUID formatId;
+    WAVEFORMATEX* pFormat = nullptr;
+    unsigned long long bytesPerSec = 0;
+    if(SUCCEEDED(hr))
+      hr = cpStream->GetFormat(&formatId, &pFormat);
+    if(SUCCEEDED(hr) && pFormat)
+    {
+      bytesPerSec = pFormat->nAvgBytesPerSec;
+      CoTaskMemFree(pFormat);
+    }
+
+    if(SUCCEEDED(hr))
+      hr = spRecogognizer->SetInput(cpStream, TRUE);
+    if(SUCCEEDED(hr))
+      hr = sprContext->SetInterest(SPFEI(SPEI_RECOGNITION) | SPFEI(SPEI_END_SR_STREAM),
+                                   SPFEI(SPEI_RECOGNITION) | SPFEI(SPEI_END_SR_STREAM));
+    if(SUCCEEDED(hr))
+      hr = sprContext->SetNotifyWin32Event();
+    if(FAILED(hr))
+      throw std::runtime_error("Failed to open audio for transcription.\nError: " + std::to_string(hr));
+
+    HANDLE hEvent = sprContext->GetNotifyEventHandle();
+
+    // every recording starts out
+    //  waiting for the hotword
+    upHotwordGrp->activate();
+    upBuiltInGrp->activate();
+    deactivateUserGroups();
+    countListening(false);
+    currentState = RecoState::Active;
+    sprContext->Resume(0);
+    hr = spRecogognizer->SetRecoState(SPRST_ACTIVE);
+    if(FAILED(hr))
+      throw std::runtime_error("Failed to start transcription.\nError: " + std::to_string(hr));
+
+    Transcript transcript;
+    std::chrono::milliseconds hotwordAt {};
+    bool streaming = true;
+    while(streaming)
+    {
+      // decoding runs faster than real time,
+      //  this long without an event is stuck
+      if(WaitForMultipleObjects(1ul, &hEvent, FALSE, 30000) == WAIT_TIMEOUT)
+        break;
+
+      SPEVENT spEvent = {0};
+      ULONG fetched = 0;
+      while(SUCCEEDED(sprContext->GetEvents(1ul, &spEvent, &fetched)) && fetched)
+      {
+        if(spEvent.eEventId == SPEI_END_SR_STREAM)
+        {
+          streaming = false;
+          if(bytesPerSec)
+            transcript.audio = std::chrono::milliseconds(spEvent.ullAudioStreamOffset * 1000 / bytesPerSec);
+        }
+        else if(spEvent.eEventId == SPEI_RECOGNITION)
+        {
+          auto sprResult = reinterpret_cast<ISpRecoResult*>(spEvent.lParam);
+
+          // 100ns units from the start of the stream
+          SPRECORESULTTIMES times = {};
+          sprResult->GetResultTimes(&times);
+          std::chrono::milliseconds at(times.ullStart / 10000);
+
+          wchar_t* text = nullptr;
+          if(SUCCEEDED(sprResult->GetText(SP_GETWHOLEPHRASE, SP_GETWHOLEPHRASE, FALSE, &text, NULL)))
+          {
+            std::wstring heard(text);
+            CoTaskMemFree(text);
+
+            // the listening timeout runs on audio
+            //  time, not on how fast we decode
+            if(currentState == RecoState::Listening && at - hotwordAt >= ListenTimeout)
+              endListening();
+
+            Resolution res = resolvePhrase(heard);
+            if(res.hotword)
+              hotwordAt = at;
+            else if(!res.cmd.exec().empty())
+            {
+              transcript.entries.push_back({at, hotwordAt, heard, res.cmd});
+              endListening();
+            }
+            else if(!res.parts.empty())
+            {
+              for(auto const& part : res.parts)
+                transcript.entries.push_back({at, hotwordAt, heard, part.cmd});
+              endListening();
+            }
+          }
+        }
+        SpClearEvent(&spEvent);
+      }
+    }
+
+    spRecogognizer->SetRecoState(SPRST_INACTIVE);
+    spRecogognizer->SetInput(nullptr, TRUE);
+    endListening();
+    return transcript;
+  }
+
+  // live recognition from our own audio
+  //  front-end instead of a device, start()
+  //  as usual afterwards
+  // needs initialize(false), the ring's
+  //  frames are read on SAPI's audio thread
+  // t_vad [optional]
+  //  only speech reaches the recognizer,
+  //  which sits idle through the silence
+  void
+    useInput(std::shared_ptr<AudioRing> t_ring,
+             bool t_vad = true,
+             VadConfig t_vadConfig = {})
+  {
+    if(!initialized || !headless)
+      throw std::runtime_error("useInput() needs a recognizer from initialize(false)");
+    if(!t_ring)
+      throw std::invalid_argument("useInput() needs a ring");
+
+    bindInput(std::move(t_ring), t_vad, t_vadConfig);
+  }
+
+  // how much audio the VAD kept from the
+  //  recognizer, zeros without one
+  VadStats
+    vadStats() const
+  {
+    return vadGate ? vadGate->stats() : VadStats {};
+  }
+
+  // lets the recognizer spot the hotword
+  //  itself, it stays idle until it is said;
+  //  call before useInput(), or before
+  //  startEvents() with the microphone
+  // t_examples [optional]
+  //  recordings of the hotword, 16kHz 16 bit
+  //  mono, without any it is spoken by each
+  //  installed voice
+  // throws std::runtime_error if no examples
+  //  could be had
+  void
+    enrollHotword(std::vector<std::vector<int16_t>> t_examples = {})
+  {
+    if(t_examples.empty())
+      t_examples = speakHotword();
+    if(t_examples.empty())
+      throw std::runtime_error("No voice could speak the hotword");
+
+    keywordModel = std::make_shared<KeywordModel const>(KeywordModel::enroll(t_examples));
+    if(!hotwordEvent)
+    {
+      hotwordEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+      if(!hotwordEvent)
+        throw std::runtime_error("Failed to create the hotword event.\nError: " + std::to_string(GetLastError()));
+    }
+  }
+
+  // zeros without enrollHotword()
+  KeywordGateStats
+    keywordStats() const
+  {
+    return keywordGate ? keywordGate->stats() : KeywordGateStats {};
+  }
+
+  // for a caller serving several recognizers
+  //  from one thread: starts recognition and
+  //  returns the handles to wait on, any of
+  //  them signalled calls for poll()
+  std::vector<HANDLE>
+    startEvents()
+  {
+    if(micSource)
+    {
+      auto ring = std::make_shared<AudioRing>();
+      micPump = std::make_unique<AudioPump>(std::move(micSource), ring);
+      bindInput(ring, true, {});
+      micPump->start();
+    }
+
+    HRESULT hr = sprContext->SetNotifyWin32Event();
+    HANDLE hEvent = sprContext->GetNotifyEventHandle();
+    if(FAILED(hr) || hEvent == INVALID_HANDLE_VALUE)
+      throw std::runtime_error("iSPRecoContext::GetNotifyEventHandle returned invalid handle.\nError: " + std::to_string(hr));
+
+    activateRecognition();
+    countListening(false);
+    currentState = RecoState::Active;
+    hotwordDetectTime = std::chrono::system_clock::now();
+
+    // the spotter's event first, so the
+    //  command after it finds us listening
+    std::vector<HANDLE> handles;
+    if(hotwordEvent)
+      handles.push_back(hotwordEvent);
+    handles.push_back(hEvent);
+    return handles;
+  }
+
+  // one turn of the event loop without the
+  //  wait: the spotter, every queued
+  //  recognition, the listening timeout and
+  //  grammar upkeep while idle
+  // returns the commands matched, run here
+  //  unless t_run is false
+  std::vector<Command>
+    poll(bool t_run = true)
+  {
+    std::vector<Command> matched;
+    bool idle = true;
+
+    if(hotwordEvent && WaitForSingleObject(hotwordEvent, 0) == WAIT_OBJECT_0)
+    {
+      idle = false;
+      if(currentState == RecoState::Active)
+      {
+        metrics().hotwords.add();
+        beginListening();
+        hotwordDetectTime = std::chrono::system_clock::now();
+      }
+    }
+
+    SPEVENT spEvent = {0};
+    ULONG fetched = 0;
+    while(SUCCEEDED(sprContext->GetEvents(1ul, &spEvent, &fetched)) && fetched)
+    {
+      idle = false;
+      auto sprResult = reinterpret_cast<ISpRecoResult*>(spEvent.lParam);
+      wchar_t* text = nullptr;
+      bool recognized = spEvent.eEventId == SPEI_RECOGNITION;
+      auto fetchedAt = std::chrono::steady_clock::now();
+      if(recognized)
+      {
+        if(Trace::enabled())
+          traceHeard(sprResult);
+        TRACE_SCOPE("GetText");
+        recognized = SUCCEEDED(sprResult->GetText(SP_GETWHOLEPHRASE, SP_GETWHOLEPHRASE, FALSE, &text, NULL));
+      }
+      if(recognized)
+      {
+        std::wstring recognizedPhrase(text);
+        CoTaskMemFree(text);
+        metrics().recognitions.add();
+
+        Resolution res;
+        {
+          TRACE_SCOPE("resolve");
+          res = resolvePhrase(recognizedPhrase);
+        }
+        if(res.hotword)
+        {
+          metrics().hotwords.add();
+          hotwordDetectTime = std::chrono::system_clock::now();
+        }
+        else if(!res.cmd.exec().empty())
+        {
+          if(t_run)
+          {
+            TRACE_SCOPE("exec");
+            execCommand(res.cmd);
+          }
+          metrics().dispatch.record(std::chrono::steady_clock::now() - fetchedAt);
+          recordDispatch(res.cmd);
+          matched.push_back(res.cmd);
+          endListening();
+          prefetchNext();
+        }
+        else if(!res.parts.empty())
+        {
+          if(t_run)
+          {
+            TRACE_SCOPE("exec", "compound");
+            runMacro(compoundMacro(res.parts));
+          }
+          metrics().dispatch.record(std::chrono::steady_clock::now() - fetchedAt);
+          for(auto const& part : res.parts)
+          {
+            recordDispatch(part.cmd);
+            matched.push_back(part.cmd);
+          }
+          endListening();
+          prefetchNext();
+        }
+      }
+      SpClearEvent(&spEvent);
+    }
+
+    // we listen for 5 seconds for a command
+    //   before timeing out and going back
+    //  to listening only for builtIn and hotword
+    auto now = std::chrono::system_clock::now();
+    if(currentState == RecoState::Listening)
+    {
+      if(now - hotwordDetectTime >= ListenTimeout)
+      {
+        metrics().timeouts.add();
+        endListening();
+      }
+    }
+    // rebuilding grammars while idle keeps
+    //  it away from anyone speaking
+    else if(idle && currentState == RecoState::Active)
+    {
+      // commands promoted from the cold tier
+      //  first, usage can wait a turn
+      if(!flushPromoted() && usage.pending()
+         && now - lastUsageApplied >= UsageReweightInterval)
+      {
+        applyUsage();
+        if(!usageFile.empty())
+          usage.save(usageFile);
+      }
+    }
+    return matched;
+  }
+
   // pauses events queue processing but continues to listen and queue events
   // if still_listen is false, will not queue events
   // returns pause depth
@@ -273,7 +737,8 @@ public: // Functions
       {
         upHotwordGrp->deactivate();
         upBuiltInGrp->deactivate();
-        upUserCmdGrp->deactivate();
+        deactivateUserGroups();
+        countListening(false);
         currentState = RecoState::Inactive;
         hr = spRecogognizer->SetRecoState(SPRST_INACTIVE);
       }
@@ -293,8 +758,9 @@ public: // Functions
       {
         upHotwordGrp->activate();
         upBuiltInGrp->activate();
-        upUserCmdGrp->deactivate();
+        deactivateUserGroups();
         sprContext->Resume(0);
+        countListening(false);
         currentState = RecoState::Active;
         hr = spRecogognizer->SetRecoState(SPRST_ACTIVE);
       }
@@ -303,124 +769,802 @@ public: // Functions
       throw std::runtime_error("activateRecognition() failed...\nError: " + std::to_string(hr));
   }
 
-  void
+  // t_context [optional]
+  //  commands with a context are only heard
+  //  while setContext() has selected it,
+  //  the rest are heard everywhere
+  // returns the phrases of the same context
+  //  it sounds like, throws std::invalid_argument
+  //  instead under ConfusablePolicy::Reject
+  std::vector<Confusable>
     addCommand(std::wstring_view t_phrase,
                std::wstring_view t_exe,
-               std::wstring_view t_args = L"")
+               std::wstring_view t_args = L"",
+               std::wstring_view t_context = L"")
   {
     if(t_phrase.empty() || t_exe.empty())
+      return {};
+
+    std::lock_guard<std::mutex> lock(shardMtx);
+    auto confusable = userGroup(t_context).addCommand(Command {t_phrase, t_exe, t_args});
+    for(auto const& c : confusable)
+      DOUT("\"" << to_utf8(t_phrase) << "\" sounds like \"" << to_utf8(c.phrase) << "\"");
+    return confusable;
+  }
+
+  // one phrase running several steps,
+  //  throws std::invalid_argument if the
+  //  steps don't form a valid DAG
+  void
+    addMacro(std::wstring_view t_phrase,
+             std::vector<MacroStep> t_steps,
+             std::wstring_view t_context = L"")
+  {
+    if(t_phrase.empty() || t_steps.empty())
+      return;
+
+    auto macro = std::make_shared<Macro const>(std::move(t_steps));
+    std::lock_guard<std::mutex> lock(shardMtx);
+    userGroup(t_context).addCommand(Command {t_phrase, std::move(macro)});
+  }
+
+
+  // phrases with slots such as
+  //  "set volume to {level:0-100}", see
+  //  PhraseTemplate.h for the syntax
+  // throws std::invalid_argument for a bad pattern
+  void
+    addTemplate(std::wstring_view t_pattern,
+                std::wstring_view t_exe,
+                std::wstring_view t_args = L"",
+                std::wstring_view t_context = L"")
+  {
+    if(t_pattern.empty() || t_exe.empty())
       return;
 
-    upUserCmdGrp->addCommand(Command {t_phrase, t_exe, t_args});
+    PhraseTemplate tpl {t_pattern};
+    std::lock_guard<std::mutex> lock(shardMtx);
+    userGroup(t_context).addTemplate(std::move(tpl), t_exe, t_args);
+  }
+
+  // other phrases for the command t_phrase
+  //  of the same context, they share its
+  //  exec and param and its use count
+  // throws std::invalid_argument if there
+  //  is no such command
+  std::vector<Confusable>
+    addAliases(std::wstring_view t_phrase,
+               std::vector<std::wstring> const& t_aliases,
+               std::wstring_view t_context = L"")
+  {
+    std::lock_guard<std::mutex> lock(shardMtx);
+    return userGroup(t_context).addAliases(t_phrase, t_aliases);
+  }
+
+  // applies to every context, including
+  //  ones created later
+  void
+    setConfusablePolicy(ConfusablePolicy t_policy)
+  {
+    std::lock_guard<std::mutex> lock(shardMtx);
+    confusablePolicy = t_policy;
+    upUserCmdGrp->setConfusablePolicy(t_policy);
+    for(auto& shard : userShards)
+      shard.second->setConfusablePolicy(t_policy);
+  }
+
+  // look-alike pairs within each context,
+  //  for checking a whole profile at once
+  std::vector<std::pair<std::wstring, Confusable>>
+    findConfusables()
+  {
+    std::lock_guard<std::mutex> lock(shardMtx);
+    auto pairs = upUserCmdGrp->findConfusables();
+    for(auto& shard : userShards)
+      for(auto& pair : shard.second->findConfusables())
+        pairs.push_back(std::move(pair));
+    return pairs;
+  }
+
+  // removes the phrase and all of its
+  //  aliases from every context
+  void
+    removeAction(std::wstring_view t_phrase)
+  {
+    std::lock_guard<std::mutex> lock(shardMtx);
+    upUserCmdGrp->removeAction(t_phrase);
+    for(auto& shard : userShards)
+      shard.second->removeAction(t_phrase);
+  }
+
+  // dispatches of t_phrase and all its
+  //  aliases since they were added
+  uint64_t
+    actionUses(std::wstring_view t_phrase)
+  {
+    std::lock_guard<std::mutex> lock(shardMtx);
+    std::vector<CommandGroup*> groups {upUserCmdGrp.get()};
+    for(auto& shard : userShards)
+      groups.push_back(shard.second.get());
+
+    for(auto group : groups)
+    {
+      Command cmd = group->getCommandByPhrase(t_phrase);
+      if(auto action = cmd.action())
+        if(!cmd.exec().empty())
+          return action->uses.load();
+    }
+    return 0;
+  }
+
+  // every user command of every context,
+  //  copies sharing the actions they run
+  //  so their use counts stay live
+  std::vector<Command>
+    commands()
+  {
+    std::lock_guard<std::mutex> lock(shardMtx);
+    auto cmds = upUserCmdGrp->commands();
+    for(auto& shard : userShards)
+    {
+      auto more = shard.second->commands();
+      cmds.insert(cmds.end(),
+                  std::make_move_iterator(more.begin()),
+                  std::make_move_iterator(more.end()));
+    }
+    return cmds;
   }
 
+  // the command t_phrase of t_context as
+  //  the recognizer holds it, a default
+  //  Command if there is none
+  Command
+    command(std::wstring_view t_phrase,
+            std::wstring_view t_context = L"")
+  {
+    std::lock_guard<std::mutex> lock(shardMtx);
+    std::wstring key = contextKey(t_context);
+    CommandGroup* group = key.empty() ? upUserCmdGrp.get() : findShard(key);
+    return group ? group->getCommandByPhrase(t_phrase) : Command {};
+  }
 
+  // removes the phrase from every context
   void
     removeCommandByPhrase(std::wstring_view t_phrase)
   {
+    std::lock_guard<std::mutex> lock(shardMtx);
     upUserCmdGrp->removeCommand(t_phrase);
+    for(auto& shard : userShards)
+      shard.second->removeCommand(t_phrase);
   }
 
+  // t_remove's phrases from every context
+  //  then t_add as context-free commands,
+  //  one grammar update per context changed
+  //  instead of one per phrase
+  // returns and throws like addCommand()
+  std::vector<Confusable>
+    editCommands(std::vector<std::wstring> const& t_remove,
+                 std::vector<Command> const& t_add)
+  {
+    std::lock_guard<std::mutex> lock(shardMtx);
+    for(auto& shard : userShards)
+      shard.second->edit(t_remove, {});
+    return upUserCmdGrp->edit(t_remove, t_add);
+  }
 
-private: // Functions
+  // t_remove's phrases then t_add's commands
+  //  in t_context alone, one grammar update
+  //  at most, none when only what phrases
+  //  run changed
+  // returns and throws like addCommand()
+  std::vector<Confusable>
+    editContext(std::wstring_view t_context,
+                std::vector<std::wstring> const& t_remove,
+                std::vector<Command> const& t_add)
+  {
+    std::lock_guard<std::mutex> lock(shardMtx);
+    std::wstring key = contextKey(t_context);
+    if(!key.empty() && !findShard(key) && t_add.empty())
+      return {};
+    return userGroup(key).edit(t_remove, t_add);
+  }
 
-  bool execCommand(Command const& cmd)
+  // selects which context's commands are
+  //  heard besides the context-free ones,
+  //  empty selects none
+  // only enables and disables grammars,
+  //  nothing is rebuilt
+  void
+    setContext(std::wstring_view t_context)
+  {
+    std::lock_guard<std::mutex> lock(shardMtx);
+    std::wstring key = contextKey(t_context);
+    if(key == currentContext)
+      return;
+
+    if(currentState == RecoState::Listening)
+    {
+      if(auto old = findShard(currentContext))
+        old->deactivate();
+      if(auto now = findShard(key))
+        now->activate();
+    }
+    currentContext = std::move(key);
+  }
+
+  std::wstring
+    context()
+  {
+    std::lock_guard<std::mutex> lock(shardMtx);
+    return currentContext;
+  }
+
+  // favours the predicted next commands
+  //  in the grammar, costs a rebuild of
+  //  the user grammars per dispatch
+  void
+    setPredictionBias(bool t_enable)
+  {
+    predictionBias = t_enable;
+  }
+
+  PredictorStats
+    predictionStats() const
+  {
+    return predictor.stats();
+  }
+
+  LaunchCacheStats
+    prefetchStats() const
+  {
+    return launchCache.stats();
+  }
+
+  // caps the memory of the context-free
+  //  commands kept in the grammar, the least
+  //  used ones past t_bytes are moved to an
+  //  index at t_coldPath and still heard
+  //  through dictation
+  // throws std::runtime_error if the index
+  //  or dictation can't be loaded
+  void
+    setHotBudget(size_t t_bytes,
+                 std::wstring_view t_coldPath)
   {
-    SHELLEXECUTEINFOW shex = {0};
-    shex.cbSize = sizeof(SHELLEXECUTEINFOW);
-    shex.nShow = SW_SHOW;
-    std::wstring exec = cmd.exec();
-    if(!exec.empty())
+    if(!initialized)
+      throw std::runtime_error("setHotBudget() called before initialize()");
+
+    auto cold = std::make_shared<ColdIndex>(std::wstring(t_coldPath));
+
+    if(!cpDictationGram)
     {
-      shex.lpFile = exec.c_str();
-      std::wstring param = cmd.param();
-      if(!param.empty())
+      HRESULT hr = sprContext->CreateGrammar(DictationGramID, &cpDictationGram);
+      if(SUCCEEDED(hr))
+        hr = cpDictationGram->LoadDictation(nullptr, SPLO_STATIC);
+      if(SUCCEEDED(hr))
+        hr = cpDictationGram->SetDictationState(SPRS_INACTIVE);
+      if(FAILED(hr))
       {
-        shex.lpParameters = param.c_str();
+        cpDictationGram.Release();
+        throw std::runtime_error("Failed to load dictation for cold commands.\nError: " + std::to_string(hr));
       }
-      shex.lpVerb = L"open";
-      return (ShellExecuteExW(&shex) == FALSE);
     }
-    return false;
+
+    std::lock_guard<std::mutex> lock(shardMtx);
+    coldIndex = std::move(cold);
+    upUserCmdGrp->setColdTier(coldIndex, t_bytes);
   }
 
-  void eventLoop()
+  GrammarStats
+    grammarStats()
   {
+    std::lock_guard<std::mutex> lock(shardMtx);
+    return upUserCmdGrp->stats();
+  }
 
-    HRESULT hr = sprContext->SetNotifyWin32Event();
-    HANDLE hEvent = INVALID_HANDLE_VALUE;
+  // where usage counts are kept between
+  //  runs, loads them and applies them
+  //  to the grammars right away
+  void
+    setUsageFile(std::wstring_view t_path)
+  {
+    usageFile = t_path;
+    if(!usageFile.empty() && usage.load(usageFile))
+      applyUsage();
+  }
 
-    hEvent = sprContext->GetNotifyEventHandle();
-    if(hEvent == INVALID_HANDLE_VALUE)
-      throw std::runtime_error("iSPRecoContext::GetNotifyEventHandle returned invalid handle.\nError: " + std::to_string(hr));
 
-    SPEVENT spEvent = {0};
-    ISpRecoResult* sprResult = nullptr;
+private: // Functions
 
-    activateRecognition();
-    thread_continue = true;
-    currentState = RecoState::Active;
+  bool execCommand(Command const& cmd)
+  {
+    if(cmd.isMacro())
+    {
+      runMacro(cmd.macro());
+      return true;
+    }
 
-    auto hotword_detect_time = std::chrono::system_clock::now();
+    // a warmed path may have gone stale
+    std::wstring exec = launchCache.resolve(cmd.exec());
+    if(launch(exec, cmd.param()))
+      return true;
+    if(exec == cmd.exec())
+      return false;
+    launchCache.forget(cmd.exec());
+    return launch(cmd.exec(), cmd.param());
+  }
 
-    while(thread_continue)
+  void recordDispatch(Command const& t_cmd)
+  {
+    metrics().commands.add();
+    usage.record(t_cmd.phrase());
+    predictor.observe(t_cmd.phrase());
+    if(auto action = t_cmd.action())
+      action->uses++;
+  }
+
+  // resolves and reads ahead the programs
+  //  of the likely next commands
+  void prefetchNext()
+  {
+    auto next = predictor.predict(PrefetchCount);
+
+    std::vector<std::wstring> phrases;
+    for(auto const& n : next)
+      phrases.push_back(n.first);
+
+    std::lock_guard<std::mutex> lock(shardMtx);
+    std::vector<CommandGroup*> groups {upUserCmdGrp.get()};
+    for(auto& shard : userShards)
+      groups.push_back(shard.second.get());
+
+    for(auto group : groups)
     {
-      if(currentState == RecoState::Paused ||
-         currentState == RecoState::Inactive)
+      for(auto const& phrase : phrases)
       {
-
+        Command cmd = group->getCommandByPhrase(phrase);
+        if(cmd.isMacro())
+          for(auto const& step : cmd.macro()->steps())
+            launchCache.warm(step.exec);
+        else if(!cmd.exec().empty())
+          launchCache.warm(cmd.exec());
       }
 
-      if(WaitForMultipleObjects(1ul, &hEvent, FALSE, 1000) == WAIT_TIMEOUT)
+      if(predictionBias)
+        group->boost(phrases, PredictionBoost);
+    }
+  }
+
+  // macros wait on their steps so they
+  //  get a thread of their own instead
+  //  of blocking the event loop
+  void runMacro(std::shared_ptr<Macro const> t_macro)
+  {
+    std::thread([macro = std::move(t_macro)]()
+                {
+                  Trace::nameThread("macro");
+                  TRACE_SCOPE("macro");
+                  MacroRunResult result = MacroExecutor().run(*macro);
+                  for(auto const& step : result.steps)
+                    DOUT("macro step " << std::string(step.name.begin(), step.name.end())
+                         << (step.skipped ? " skipped" : (step.ok ? " ok " : " failed "))
+                         << std::chrono::duration_cast<std::chrono::milliseconds>(step.elapsed).count() << "ms");
+                  DOUT("macro wall " << std::chrono::duration_cast<std::chrono::milliseconds>(result.wall).count()
+                       << "ms critical path " << std::chrono::duration_cast<std::chrono::milliseconds>(result.criticalPath).count() << "ms");
+                }).detach();
+  }
+
+  // one DAG for a whole compound utterance,
+  //  "and" shares the deps of the part before
+  //  it and "then" waits for every earlier part
+  static std::shared_ptr<Macro const>
+    compoundMacro(std::vector<CompoundPart> const& t_parts)
+  {
+    std::vector<MacroStep> steps;
+    std::vector<std::wstring> stageDeps;
+    std::vector<std::wstring> earlier;
+
+    for(size_t i = 0; i < t_parts.size(); ++i)
+    {
+      auto const& part = t_parts[i];
+      if(part.joinedBy == Connector::Then)
+        stageDeps = earlier;
+
+      std::wstring prefix = std::to_wstring(i) + L".";
+      size_t first = steps.size();
+
+      if(part.cmd.isMacro())
       {
-        // check for exit signal
-        if(!thread_continue)
+        // inlined, its roots take the part's deps
+        for(auto step : part.cmd.macro()->steps())
         {
-          break;
+          step.name = prefix + step.name;
+          for(auto& dep : step.deps)
+            dep = prefix + dep;
+          if(step.deps.empty())
+            step.deps = stageDeps;
+          steps.push_back(std::move(step));
         }
+      }
+      else
+      {
+        MacroStep step;
+        step.name = prefix + part.cmd.phrase();
+        step.exec = part.cmd.exec();
+        step.param = part.cmd.param();
+        step.deps = stageDeps;
+        // "then" orders launches, it doesn't
+        //  wait for the program to be closed
+        step.wait = false;
+        steps.push_back(std::move(step));
+      }
 
-        // we listen for 5 seconds for a command
-        //   before timeing out and going back
-        //  to listening only for builtIn and hotword
-        if(currentState == RecoState::Listening)
-        {
-          auto now = std::chrono::system_clock::now();
+      for(size_t s = first; s < steps.size(); ++s)
+        earlier.push_back(steps[s].name);
+    }
+    return std::make_shared<Macro const>(std::move(steps));
+  }
 
-          if(now - hotword_detect_time >= 5s)
-          {
-            upUserCmdGrp->deactivate();
-            upHotwordGrp->activate();
-            lastState = currentState;
-            currentState = RecoState::Active;
-          }
-        }
-        // we timed out so restart loop
+  // contexts are matched case insensatively
+  static std::wstring contextKey(std::wstring_view t_context)
+  {
+    return lower_key(t_context);
+  }
+
+  // nullptr for no context or one
+  //  without any commands yet
+  CommandGroup* findShard(std::wstring const& t_key)
+  {
+    if(t_key.empty())
+      return nullptr;
+    auto it = userShards.find(t_key);
+    return it == userShards.end() ? nullptr : it->second.get();
+  }
+
+  // shard for a context, created on first use
+  //  with a grammar of its own
+  CommandGroup& userGroup(std::wstring_view t_context)
+  {
+    std::wstring key = contextKey(t_context);
+    if(key.empty())
+      return *upUserCmdGrp;
+
+    if(auto shard = findShard(key))
+      return *shard;
+
+    auto shard = std::make_unique<CommandGroup>(sprContext.p,
+                                                L"Commands." + key,
+                                                nextShardGramID++);
+    shard->deactivate();
+    shard->enableCompound(MaxCompoundParts);
+    shard->setConfusablePolicy(confusablePolicy);
+    if(currentState == RecoState::Listening && key == currentContext)
+      shard->activate();
+    return *userShards.emplace(key, std::move(shard)).first->second;
+  }
+
+  // the context-free commands and
+  //  those of the current context
+  std::vector<CommandGroup*> activeUserGroups()
+  {
+    std::vector<CommandGroup*> groups;
+    if(auto shard = findShard(currentContext))
+      groups.push_back(shard);
+    groups.push_back(upUserCmdGrp.get());
+    return groups;
+  }
+
+  void activateUserGroups()
+  {
+    std::lock_guard<std::mutex> lock(shardMtx);
+    for(auto group : activeUserGroups())
+      group->activate();
+
+    // dictation costs decode time, only
+    //  run it when something was evicted
+    if(cpDictationGram && coldIndex && coldIndex->size())
+      cpDictationGram->SetDictationState(SPRS_ACTIVE);
+  }
+
+  void deactivateUserGroups()
+  {
+    std::lock_guard<std::mutex> lock(shardMtx);
+    upUserCmdGrp->deactivate();
+    for(auto& shard : userShards)
+      shard.second->deactivate();
+    if(cpDictationGram)
+      cpDictationGram->SetDictationState(SPRS_INACTIVE);
+  }
+
+  // hot commands first and weighted up
+  void applyUsage()
+  {
+    std::lock_guard<std::mutex> lock(shardMtx);
+    upUserCmdGrp->applyUsage(usage);
+    for(auto& shard : userShards)
+      shard.second->applyUsage(usage);
+    lastUsageApplied = std::chrono::system_clock::now();
+  }
+
+  // t_ring through the VAD and the spotter,
+  //  whichever are wanted, into SAPI
+  void bindInput(std::shared_ptr<AudioRing> t_ring,
+                 bool t_vad,
+                 VadConfig t_vadConfig)
+  {
+    keywordGate.reset();
+    vadGate.reset();
+    if(t_vad)
+    {
+      auto speech = std::make_shared<AudioRing>(t_ring->capacity());
+      vadGate = std::make_unique<VadGate>(std::move(t_ring), speech, t_vadConfig);
+      vadGate->start();
+      t_ring = std::move(speech);
+    }
+
+    // the recognizer only hears what
+    //  follows the hotword
+    if(keywordModel)
+    {
+      auto heard = std::make_shared<AudioRing>(t_ring->capacity());
+      HANDLE event = hotwordEvent;
+      keywordGate = std::make_unique<KeywordGate>(std::move(t_ring), heard, keywordModel,
+                                                  [event]() { SetEvent(event); });
+      keywordGate->start();
+      t_ring = std::move(heard);
+    }
+
+    CComPtr<IStream> cpBase;
+    cpBase.Attach(new RingStream(std::move(t_ring)));
+
+    HRESULT hr = S_OK;
+    CSpStreamFormat format(SPSF_16kHz16BitMono, &hr);
+
+    CComPtr<ISpStream> cpStream;
+    if(SUCCEEDED(hr))
+      hr = cpStream.CoCreateInstance(CLSID_SpStream);
+    if(SUCCEEDED(hr))
+      hr = cpStream->SetBaseStream(cpBase, format.FormatId(), format.WaveFormatExPtr());
+    if(SUCCEEDED(hr))
+      hr = spRecogognizer->SetInput(cpStream, TRUE);
+
+    if(FAILED(hr))
+      throw std::runtime_error("Failed to bind the audio ring...\nError: " + std::to_string(hr));
+  }
+
+  // returns whether the grammar was rebuilt
+  bool flushPromoted()
+  {
+    std::lock_guard<std::mutex> lock(shardMtx);
+    return upUserCmdGrp->flushPromoted();
+  }
+
+  // back to listening for only the
+  //  hotword and built-in commands
+  void endListening()
+  {
+    TRACE_INSTANT("state", "active");
+    countListening(false);
+    if(keywordGate)
+      keywordGate->setOpen(false);
+    deactivateUserGroups();
+    upHotwordGrp->activate();
+    lastState = currentState;
+    currentState = RecoState::Active;
+  }
+
+  void eventLoop()
+  {
+    std::vector<HANDLE> handles = startEvents();
+    thread_continue = true;
+
+    while(thread_continue)
+    {
+      // woken or not, poll() checks the
+      //  listening timeout
+      WaitForMultipleObjects(static_cast<DWORD>(handles.size()), handles.data(), FALSE, 1000);
+
+      // check for exit signal
+      if(!thread_continue)
+        break;
+
+      poll();
+    }
+    thread_finished = true;
+  }
+
+  // the hotword as said by every installed
+  //  voice, slow, normal and fast
+  std::vector<std::vector<int16_t>> speakHotword()
+  {
+    std::vector<std::vector<int16_t>> examples;
+
+    CComPtr<ISpVoice> cpVoice;
+    HRESULT hr = cpVoice.CoCreateInstance(CLSID_SpVoice);
+    CComPtr<IEnumSpObjectTokens> cpVoices;
+    if(SUCCEEDED(hr))
+      hr = SpEnumTokens(SPCAT_VOICES, nullptr, nullptr, &cpVoices);
+    ULONG voices = 0;
+    if(SUCCEEDED(hr))
+      hr = cpVoices->GetCount(&voices);
+    if(FAILED(hr))
+      return examples;
+
+    CSpStreamFormat format(SPSF_16kHz16BitMono, &hr);
+    for(ULONG v = 0; v < voices && SUCCEEDED(hr); ++v)
+    {
+      CComPtr<ISpObjectToken> cpToken;
+      if(FAILED(cpVoices->Next(1ul, &cpToken, nullptr)) || FAILED(cpVoice->SetVoice(cpToken)))
         continue;
+
+      for(long rate : {-3l, 0l, 3l})
+      {
+        // rendered into memory at the
+        //  recognizer's format
+        CComPtr<IStream> cpMemory;
+        CComPtr<ISpStream> cpStream;
+        HRESULT said = CreateStreamOnHGlobal(nullptr, TRUE, &cpMemory);
+        if(SUCCEEDED(said))
+          said = cpStream.CoCreateInstance(CLSID_SpStream);
+        if(SUCCEEDED(said))
+          said = cpStream->SetBaseStream(cpMemory, format.FormatId(), format.WaveFormatExPtr());
+        if(SUCCEEDED(said))
+          said = cpVoice->SetOutput(cpStream, TRUE);
+        if(SUCCEEDED(said))
+          said = cpVoice->SetRate(rate);
+        if(SUCCEEDED(said))
+          said = cpVoice->Speak(hotword.c_str(), SPF_DEFAULT, nullptr);
+        cpVoice->SetOutput(nullptr, TRUE);
+
+        STATSTG stat = {};
+        LARGE_INTEGER start = {};
+        if(SUCCEEDED(said))
+          said = cpMemory->Stat(&stat, STATFLAG_NONAME);
+        if(SUCCEEDED(said))
+          said = cpMemory->Seek(start, STREAM_SEEK_SET, nullptr);
+        if(FAILED(said) || stat.cbSize.QuadPart < sizeof(int16_t))
+          continue;
+
+        std::vector<int16_t> samples(static_cast<size_t>(stat.cbSize.QuadPart / sizeof(int16_t)));
+        ULONG read = 0;
+        if(SUCCEEDED(cpMemory->Read(samples.data(), static_cast<ULONG>(samples.size() * sizeof(int16_t)), &read)))
+        {
+          samples.resize(read / sizeof(int16_t));
+          examples.push_back(std::move(samples));
+        }
       }
+    }
+    return examples;
+  }
 
-      std::wstring recognizedPhrase;
+  // the gauge is shared by every recognizer
+  //  in the process, each only moves it on
+  //  its own way in and out of a window
+  void countListening(bool t_listening)
+  {
+    if(listeningCounted == t_listening)
+      return;
+    listeningCounted = t_listening;
+    metrics().listening.add(t_listening ? 1 : -1);
+  }
 
-      hr = sprContext->GetEvents(1ul, &spEvent, nullptr);
-      if(SUCCEEDED(hr))
-        sprResult = reinterpret_cast<ISpRecoResult*>(spEvent.lParam);
-      wchar_t* text = nullptr;
+  // from the hotword to the user's commands
+  void beginListening()
+  {
+    TRACE_INSTANT("state", "listening");
+    countListening(true);
+    lastState = currentState;
+    upHotwordGrp->deactivate();
+    activateUserGroups();
+    currentState = RecoState::Listening;
+  }
 
-      hr = sprResult->GetText(SP_GETWHOLEPHRASE, SP_GETWHOLEPHRASE, FALSE, &text, NULL);
-      if(SUCCEEDED(hr))
+  // what one recognized phrase did to the
+  //  hotword / command state machine
+  struct Resolution
+  {
+    bool hotword {false};
+    Command cmd {};
+    std::vector<CompoundPart> parts {};
+  };
+
+  // moves the state machine along, leaves
+  //  running what was matched to the caller
+  Resolution resolvePhrase(std::wstring const& t_phrase)
+  {
+    Resolution res;
+    if(currentState == RecoState::Active)
+    {
+      if(icase_equal(t_phrase, hotword))
       {
-        recognizedPhrase = std::wstring(text);
-        if(currentState == RecoState::Active)
-          if(recognizedPhrase.size() == hotword.size())
-            if(std::equal(recognizedPhrase.begin(), recognizedPhrase.end(), hotword.begin(), icase_cmp_wchar))
-            {
-              lastState = currentState;
-              upHotwordGrp->deactivate();
-              upUserCmdGrp->activate();
-              currentState = RecoState::Listening;
-            }
+        beginListening();
+        res.hotword = true;
       }
     }
-    thread_finished = true;
+    else if(currentState == RecoState::Listening)
+    {
+      // one command per hotword, the
+      //  context's own commands first
+      std::lock_guard<std::mutex> lock(shardMtx);
+      auto groups = activeUserGroups();
+      for(auto group : groups)
+        if(res.cmd.exec().empty())
+          res.cmd = group->getCommandByPhrase(t_phrase);
+
+      // several commands in one utterance,
+      //  each part looked up like a command on
+      //  its own so context and global ones
+      //  can be mixed
+      if(res.cmd.exec().empty())
+        res.parts = splitCompound(t_phrase,
+                                  [&groups](std::wstring const& t_part)
+                                  {
+                                    Command cmd;
+                                    for(auto group : groups)
+                                      if(cmd.exec().empty())
+                                        cmd = group->getCommandByPhrase(t_part);
+                                    return cmd;
+                                  },
+                                  MaxCompoundParts);
+
+      // nothing live matched, likely dictation
+      //  of a command that was evicted
+      if(res.cmd.exec().empty() && res.parts.empty())
+        res.cmd = upUserCmdGrp->promoteCold(t_phrase);
+    }
+    return res;
+  }
+
+  // when the engine says speech ended and
+  //  when we got its event, SAPI times the
+  //  phrase by the tick count
+  static void traceHeard(ISpRecoResult* t_result)
+  {
+    uint64_t now = Trace::now();
+    SPRECORESULTTIMES times = {};
+    if(SUCCEEDED(t_result->GetResultTimes(&times)))
+    {
+      DWORD endTick = times.dwTickCount + static_cast<DWORD>(times.ullLength / 10000);
+      DWORD ago = GetTickCount() - endTick;
+      if(ago < 60000)
+        Trace::instant("audio end", nullptr, now - uint64_t {ago} * 1000000);
+    }
+    Trace::instant("engine event", nullptr, now);
+  }
+
+  // every recognizer's, one set a process
+  struct RecogMetrics
+  {
+    Counter& recognitions {Metrics::counter("hnx_recognitions_total",
+                                            "Phrases SAPI recognized")};
+    Counter& hotwords {Metrics::counter("hnx_hotword_hits_total",
+                                        "Hotwords heard by SAPI or the spotter")};
+    Counter& commands {Metrics::counter("hnx_commands_total",
+                                        "Commands dispatched, each part of a compound one")};
+    Counter& timeouts {Metrics::counter("hnx_listening_timeouts_total",
+                                        "Times listening for a command ran out")};
+    Gauge& listening {Metrics::gauge("hnx_listening",
+                                     "Recognizers listening for a command after the hotword")};
+
+    // with t_run, the launch is in it
+    Histogram& dispatch {Metrics::histogram("hnx_dispatch_seconds",
+                                            "From SAPI's recognition event to its command started")};
+  };
+
+  static RecogMetrics& metrics()
+  {
+    static RecogMetrics recogMetrics;
+    return recogMetrics;
+  }
+
+  // errors go to a message box unless
+  //  there is no one to click it
+  void fail(std::wstring const& t_msg)
+  {
+    lastErr = t_msg;
+    if(!headless && !quiet)
+      ErrMsg(t_msg);
   }
 
 private: // Variables
@@ -442,6 +1586,28 @@ private: // Variables
   std::unique_ptr<CommandGroup> upBuiltInGrp {nullptr};
   std::unique_ptr<CommandGroup> upUserCmdGrp {nullptr};
 
+  // commands only heard in one context,
+  //  keyed by contextKey()
+  std::map<std::wstring, std::unique_ptr<CommandGroup>> userShards {};
+  std::wstring currentContext {};
+  unsigned long long nextShardGramID {FirstShardGramID};
+  std::mutex shardMtx {};
+  ConfusablePolicy confusablePolicy {ConfusablePolicy::Warn};
+
+  // second tier for the context-free commands
+  std::shared_ptr<ColdIndex> coldIndex {};
+  CComPtr<ISpRecoGrammar> cpDictationGram {nullptr};
+
+  // decaying use counts of dispatched phrases
+  UsageStats usage {};
+  std::wstring usageFile {};
+  std::chrono::system_clock::time_point lastUsageApplied {};
+
+  // what usually follows what
+  Predictor predictor {};
+  LaunchCache launchCache {};
+  bool predictionBias {false};
+
   //
   CComPtr<ISpObjectToken> cpRecognizerToken {nullptr};
   CComPtr<ISpObjectToken> spAudioInToken {nullptr};
@@ -457,6 +1623,32 @@ private: // Variables
 
 
   bool initialized {false};
+  bool headless {false};
+
+  // failures only reach lastError()
+  bool quiet {false};
+  std::wstring lastErr {};
+
+  // the default microphone, opened by
+  //  initialize() and pumped into the
+  //  front-end from startEvents() on
+  std::unique_ptr<DeviceSource> micSource {nullptr};
+  std::unique_ptr<AudioPump> micPump {nullptr};
+
+  // between the input ring and SAPI,
+  //  destroyed ahead of the recognizer so
+  //  SAPI's reads end first
+  std::unique_ptr<VadGate> vadGate {nullptr};
+
+  // spots the hotword after the VAD, opened
+  //  by it and closed by endListening()
+  std::shared_ptr<KeywordModel const> keywordModel {nullptr};
+  std::unique_ptr<KeywordGate> keywordGate {nullptr};
+  HANDLE hotwordEvent {nullptr};
+
+  // when the hotword was last heard, the
+  //  listening window runs from it
+  std::chrono::system_clock::time_point hotwordDetectTime {};
   bool thread_continue {false};
   bool thread_finished {false};
 
@@ -465,6 +1657,11 @@ private: // Variables
   // for resuming from a Paused state
   RecoState lastState {RecoState::Unknown};
 
+  // whether this recognizer is in the
+  //  listening gauge, a window paused
+  //  midway stays in it
+  bool listeningCounted {false};
+
   std::atomic<unsigned> pauseCounter;
 
   std::mutex exit_wait_mtx {};
@@ -0,0 +1,360 @@
+#include "RecogPool.h"
+#include "Keyword.h"
+#include "ProcessInfo.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+//=================================//
+// HNx Voice Command Rooms         //
+//=================================//
+// One recognizer per room, the    //
+//  rooms spread over the cores    //
+//=================================//
+
+using namespace HNx;
+
+HNx::RecogPool::RecogPool(std::shared_ptr<CommandTable const> t_commands,
+                          unsigned t_workers,
+                          OnCommand t_onCommand)
+  : m_commands(std::move(t_commands))
+  , m_workers(t_workers ? t_workers : std::max(1u, std::thread::hardware_concurrency()))
+  , m_onCommand(std::move(t_onCommand))
+{
+  if(!m_commands)
+    throw std::invalid_argument("RecogPool needs a command table");
+}
+
+HNx::RecogPool::~RecogPool()
+{
+  stop();
+}
+
+size_t
+HNx::RecogPool::addRoom(RoomConfig t_room)
+{
+  if(!t_room.input)
+    throw std::invalid_argument("A room needs an audio input");
+  if(!m_threads.empty())
+    throw std::invalid_argument("Rooms can't be added to a running pool");
+
+  auto room = std::make_unique<Room>();
+  room->config = std::move(t_room);
+  m_rooms.push_back(std::move(room));
+  return m_rooms.size() - 1;
+}
+
+void
+HNx::RecogPool::start()
+{
+  if(!m_threads.empty() || m_rooms.empty())
+    return;
+
+  unsigned workers = static_cast<unsigned>(std::min<size_t>(m_workers, m_rooms.size()));
+  if(m_rooms.size() > workers * MaxRoomsPerWorker)
+    throw std::invalid_argument("Too many rooms for the pool's workers");
+
+  m_stopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+  if(!m_stopEvent)
+    throw std::runtime_error("Failed to create the pool's stop event.\nError: " + std::to_string(GetLastError()));
+
+  // the same room always lands on the
+  //  same core
+  for(size_t i = 0; i < m_rooms.size(); ++i)
+    m_rooms[i]->worker = static_cast<unsigned>(i % workers);
+
+  m_starting = workers;
+  for(unsigned w = 0; w < workers; ++w)
+    m_threads.emplace_back(&RecogPool::run, this, w);
+
+  for(unsigned left = m_starting.load(); left; left = m_starting.load())
+    m_starting.wait(left);
+}
+
+void
+HNx::RecogPool::stop()
+{
+  if(m_stopEvent)
+    SetEvent(m_stopEvent);
+  for(auto& t : m_threads)
+    if(t.joinable())
+      t.join();
+  m_threads.clear();
+
+  if(m_stopEvent)
+  {
+    CloseHandle(m_stopEvent);
+    m_stopEvent = nullptr;
+  }
+}
+
+size_t
+HNx::RecogPool::rooms() const
+{
+  return m_rooms.size();
+}
+
+unsigned
+HNx::RecogPool::workers() const
+{
+  return m_workers;
+}
+
+std::vector<RoomStats>
+HNx::RecogPool::stats() const
+{
+  std::vector<RoomStats> stats;
+  stats.reserve(m_rooms.size());
+  for(auto const& room : m_rooms)
+  {
+    stats.push_back({room->config.name,
+                     room->worker,
+                     room->commands.load(std::memory_order_relaxed),
+                     room->config.input->overruns(),
+                     room->error});
+  }
+  return stats;
+}
+
+void
+HNx::RecogPool::run(unsigned t_worker)
+{
+  unsigned cores = std::clamp(std::thread::hardware_concurrency(), 1u, 64u);
+  SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR {1} << (t_worker % cores));
+
+  // held across the recognizers' lifetime so
+  //  their interfaces are released before COM
+  //  goes away on this thread
+  HRESULT hrCom = CoInitialize(nullptr);
+  {
+    std::vector<size_t> mine;
+    std::vector<std::unique_ptr<Recog>> recogs;
+
+    // which recognizer each handle wakes
+    std::vector<HANDLE> handles {m_stopEvent};
+    std::vector<size_t> owner {0};
+
+    for(size_t i = 0; i < m_rooms.size(); ++i)
+    {
+      Room& room = *m_rooms[i];
+      if(room.worker != t_worker)
+        continue;
+
+      try
+      {
+        auto recog = std::make_unique<Recog>(room.config.hotword);
+        if(!recog->initialize(false))
+          throw std::runtime_error(to_utf8(recog->lastError()));
+        for(auto const& c : *m_commands)
+          recog->addCommand(c.phrase, c.exec, c.param, c.context);
+        if(room.config.spotter)
+        {
+          std::vector<std::vector<int16_t>> examples;
+          if(room.config.hotwordExamples)
+            examples = *room.config.hotwordExamples;
+          recog->enrollHotword(std::move(examples));
+        }
+        recog->useInput(room.config.input, room.config.vad);
+
+        for(HANDLE h : recog->startEvents())
+        {
+          handles.push_back(h);
+          owner.push_back(recogs.size());
+        }
+        mine.push_back(i);
+        recogs.push_back(std::move(recog));
+      }
+      catch(std::exception const& e)
+      {
+        room.error = e.what();
+        DOUT("room " << i << " failed: " << e.what());
+      }
+    }
+
+    if(m_starting.fetch_sub(1) == 1)
+      m_starting.notify_all();
+
+    auto poll = [&](size_t t_recog)
+    {
+      Room& room = *m_rooms[mine[t_recog]];
+      for(auto const& cmd : recogs[t_recog]->poll(!m_onCommand))
+      {
+        room.commands.fetch_add(1, std::memory_order_relaxed);
+        if(m_onCommand)
+          m_onCommand(mine[t_recog], cmd);
+      }
+    };
+
+    // every room's listening timeout is checked
+    //  at least once a second, however busy
+    //  the others keep the worker
+    auto swept = std::chrono::steady_clock::now();
+    while(true)
+    {
+      DWORD waited = WaitForMultipleObjects(static_cast<DWORD>(handles.size()), handles.data(), FALSE, 1000);
+      if(waited == WAIT_OBJECT_0)
+        break;
+      if(waited > WAIT_OBJECT_0 && waited < WAIT_OBJECT_0 + handles.size())
+        poll(owner[waited - WAIT_OBJECT_0]);
+
+      auto now = std::chrono::steady_clock::now();
+      if(now - swept >= std::chrono::seconds(1))
+      {
+        for(size_t r = 0; r < recogs.size(); ++r)
+          poll(r);
+        swept = now;
+      }
+    }
+  }
+  if(SUCCEEDED(hrCom))
+    CoUninitialize();
+}
+
+//=========================================================================
+//  Benchmark
+//=========================================================================
+
+namespace
+{
+
+// one recording over and over, every room
+//  starting at a different point in it
+class LoopSource : public PcmSource
+{
+public:
+  LoopSource(std::shared_ptr<std::vector<int16_t> const> t_samples, size_t t_offset)
+    : m_samples(std::move(t_samples))
+    , m_at(m_samples->empty() ? 0 : t_offset % m_samples->size())
+  {}
+
+  size_t
+    read(int16_t* t_dst, size_t t_count) override
+  {
+    if(m_samples->empty())
+    {
+      std::fill(t_dst, t_dst + t_count, int16_t {0});
+      return t_count;
+    }
+
+    size_t n = std::min(t_count, m_samples->size() - m_at);
+    std::copy_n(m_samples->data() + m_at, n, t_dst);
+    m_at = (m_at + n) % m_samples->size();
+    return n;
+  }
+
+private:
+  std::shared_ptr<std::vector<int16_t> const> m_samples;
+  size_t m_at;
+};
+
+}
+
+int
+HNx::runRoomsBenchCli(std::vector<std::wstring> const& t_args)
+{
+  std::wstring profile, audio;
+  unsigned rooms = std::max(1u, std::thread::hardware_concurrency());
+  unsigned seconds = 10;
+  unsigned threads = 0;
+  std::wstring examples;
+  for(size_t i = 0; i + 1 < t_args.size(); ++i)
+  {
+    std::wstring const& arg = t_args[i];
+    if(arg == L"--commands")
+      profile = t_args[++i];
+    else if(arg == L"--audio")
+      audio = t_args[++i];
+    else if(arg == L"--rooms")
+      rooms = std::max(1u, static_cast<unsigned>(std::wcstoul(t_args[++i].c_str(), nullptr, 10)));
+    else if(arg == L"--seconds")
+      seconds = std::max(1u, static_cast<unsigned>(std::wcstoul(t_args[++i].c_str(), nullptr, 10)));
+    else if(arg == L"--threads")
+      threads = static_cast<unsigned>(std::wcstoul(t_args[++i].c_str(), nullptr, 10));
+    else if(arg == L"--hotword-examples")
+      examples = t_args[++i];
+  }
+  bool spotter = !examples.empty() || std::find(t_args.begin(), t_args.end(), L"--spotter") != t_args.end();
+
+  if(profile.empty())
+  {
+    std::cerr << "usage: --rooms-bench --commands <profile> [--audio <file>] [--rooms <n>] [--seconds <s>] [--threads <n>] [--spotter] [--hotword-examples <dir>]\n";
+    return 1;
+  }
+
+  try
+  {
+    auto commands = std::make_shared<CommandTable const>(loadProfile(profile));
+
+    auto samples = std::make_shared<std::vector<int16_t>>();
+    if(!audio.empty())
+    {
+      FileSource source(audio);
+      int16_t buffer[4096];
+      while(size_t n = source.read(buffer, std::size(buffer)))
+        samples->insert(samples->end(), buffer, buffer + n);
+    }
+    std::shared_ptr<std::vector<int16_t> const> recording = std::move(samples);
+
+    // read once, every room enrolls from them
+    std::shared_ptr<std::vector<std::vector<int16_t>> const> hotwordExamples;
+    if(!examples.empty())
+      hotwordExamples = std::make_shared<std::vector<std::vector<int16_t>> const>(readKeywordExamples(examples));
+
+    std::cout << "rooms\tworkers\tcpu/room\tcommands\toverruns\tfailed\n";
+    for(unsigned n = 1; ; n = std::min(n * 2, rooms))
+    {
+      // commands are only counted, nothing
+      //  is launched
+      RecogPool pool(commands, threads, [](size_t, Command const&) {});
+      std::vector<std::unique_ptr<AudioPump>> pumps;
+      for(unsigned i = 0; i < n; ++i)
+      {
+        auto ring = std::make_shared<AudioRing>();
+        RoomConfig room {L"room " + std::to_wstring(i), ring};
+        room.spotter = spotter;
+        room.hotwordExamples = hotwordExamples;
+        pool.addRoom(std::move(room));
+        size_t offset = recording->size() * i / n;
+        pumps.push_back(std::make_unique<AudioPump>(std::make_unique<LoopSource>(recording, offset), ring, true));
+      }
+      pool.start();
+
+      auto cpu = processCpu();
+      for(auto& pump : pumps)
+        pump->start();
+      std::this_thread::sleep_for(std::chrono::seconds(seconds));
+      cpu = processCpu() - cpu;
+      for(auto& pump : pumps)
+        pump->stop();
+      pool.stop();
+
+      uint64_t matched = 0;
+      uint64_t overruns = 0;
+      size_t failed = 0;
+      for(auto const& room : pool.stats())
+      {
+        matched += room.commands;
+        overruns += room.overruns;
+        if(!room.error.empty())
+          ++failed;
+      }
+
+      double perRoom = 100.0 * static_cast<double>(cpu.count()) / (1000.0 * seconds * n);
+      std::cout << n << '\t' << std::min(pool.workers(), n) << '\t'
+                << std::fixed << std::setprecision(1) << perRoom << "%\t"
+                << matched << '\t' << overruns << '\t' << failed << "\n";
+
+      if(n == rooms)
+        break;
+    }
+  }
+  catch(std::exception const& e)
+  {
+    std::cerr << e.what() << "\n";
+    return 2;
+  }
+  return 0;
+}
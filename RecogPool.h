@@ -0,0 +1,145 @@
+#pragma once
+#include "Audio.h"
+#include "Profile.h"
+#include "Recog.hpp"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+//   Several rooms on one host. Every room is
+//  an audio input with a recognizer and a
+//  hotword / command state machine of its
+//  own, the rooms are dealt out over a few
+//  worker threads, one per core and pinned
+//  to it
+//
+//  A room stays on the worker that made its
+//  recognizer, SAPI's objects belong to the
+//  thread that created them. All rooms build
+//  their grammars from one command table
+//  that is never changed once shared
+
+namespace HNx
+{
+
+using CommandTable = std::vector<ProfileEntry>;
+
+struct RoomConfig
+{
+  std::wstring name {};
+
+  // 16kHz 16 bit mono frames, from an
+  //  AudioPump usually
+  std::shared_ptr<AudioRing> input {};
+
+  std::wstring hotword {L"computer"};
+  bool vad {true};
+
+  // the room spots the hotword before its
+  //  recognizer hears anything, enrolled from
+  //  hotwordExamples or, without any, as the
+  //  installed voices say it
+  bool spotter {false};
+  std::shared_ptr<std::vector<std::vector<int16_t>> const> hotwordExamples {};
+};
+
+struct RoomStats
+{
+  std::wstring name {};
+  unsigned worker {0};
+  uint64_t commands {0};
+
+  // frames the room's ring had to drop,
+  //  its worker fell behind
+  uint64_t overruns {0};
+
+  // empty unless the room failed to start
+  std::string error {};
+};
+
+class RecogPool
+{
+public:
+  // runs on the room's worker thread,
+  //  without one commands are run as usual
+  using OnCommand = std::function<void(size_t t_room, Command const& t_cmd)>;
+
+  // t_workers of 0 uses one per core
+  explicit RecogPool(std::shared_ptr<CommandTable const> t_commands,
+                     unsigned t_workers = 0,
+                     OnCommand t_onCommand = {});
+
+  // stops the workers
+  ~RecogPool();
+
+  RecogPool(RecogPool const&) = delete;
+  RecogPool& operator=(RecogPool const&) = delete;
+
+  // before start(), returns the room's index
+  // throws std::invalid_argument without
+  //  an input
+  size_t
+    addRoom(RoomConfig t_room);
+
+  // returns once every room is listening or
+  //  has failed, see stats()
+  void
+    start();
+
+  void
+    stop();
+
+  size_t
+    rooms() const;
+
+  unsigned
+    workers() const;
+
+  std::vector<RoomStats>
+    stats() const;
+
+private:
+  // every room owns two wait handles and a
+  //  worker waits on one more to stop
+  static constexpr size_t MaxRoomsPerWorker {31};
+
+  struct Room
+  {
+    RoomConfig config {};
+    unsigned worker {0};
+    std::atomic<uint64_t> commands {0};
+    std::string error {};
+  };
+
+  void
+    run(unsigned t_worker);
+
+  std::shared_ptr<CommandTable const> m_commands;
+  unsigned m_workers;
+  OnCommand m_onCommand;
+
+  std::vector<std::unique_ptr<Room>> m_rooms {};
+  std::vector<std::thread> m_threads {};
+
+  // manual reset, wakes every worker
+  HANDLE m_stopEvent {nullptr};
+
+  std::atomic<unsigned> m_starting {0};
+};
+
+// voicecommand --rooms-bench --commands <profile>
+//              [--audio <file>] [--rooms <n>]
+//              [--seconds <s>] [--threads <n>]
+//              [--spotter] [--hotword-examples <dir>]
+// runs 1, 2, 4 .. n rooms on looped audio,
+//  silence without a file, and prints what
+//  each count costs
+// returns the process exit code
+int
+  runRoomsBenchCli(std::vector<std::wstring> const& t_args);
+
+}
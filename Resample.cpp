@@ -0,0 +1,508 @@
+#include "Resample.h"
+#include "Audio.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+//=================================//
+// HNx Voice Command Resample      //
+//=================================//
+// Any PCM to 16kHz 16 bit mono    //
+//=================================//
+
+using namespace HNx;
+
+namespace
+{
+
+// input frames converted per pass, bounds
+//  the history and output buffers
+constexpr size_t ChunkFrames {2048u};
+
+// stopband attenuation of the filter
+constexpr double AttenuationDb {80.0};
+
+// the transition band is this part of the
+//  lower Nyquist frequency, 7-8kHz at 16kHz
+constexpr double TransitionPart {1.0 / 8.0};
+
+constexpr double Pi = 3.14159265358979323846;
+
+// modified Bessel function of the first
+//  kind, order zero, for the Kaiser window
+double
+bessel_i0(double t_x)
+{
+  double sum = 1.0;
+  double term = 1.0;
+  for(int k = 1; k < 50 && term > sum * 1e-12; ++k)
+  {
+    term *= (t_x / (2.0 * k)) * (t_x / (2.0 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+int16_t
+saturate(float t_v)
+{
+  return static_cast<int16_t>(std::lround(std::clamp(t_v, -32768.0f, 32767.0f)));
+}
+
+void
+to_int16_scalar(float const* t_in, size_t t_count, int16_t* t_out)
+{
+  for(size_t i = 0; i < t_count; ++i)
+    t_out[i] = saturate(t_in[i]);
+}
+
+void
+mono_int16_scalar(int16_t const* t_in, size_t t_frames, unsigned t_channels, float* t_out)
+{
+  float scale = 1.0f / static_cast<float>(t_channels);
+  for(size_t f = 0; f < t_frames; ++f)
+  {
+    int32_t sum = 0;
+    for(unsigned c = 0; c < t_channels; ++c)
+      sum += t_in[f * t_channels + c];
+    t_out[f] = static_cast<float>(sum) * scale;
+  }
+}
+
+void
+mono_float_scalar(float const* t_in, size_t t_frames, unsigned t_channels, float* t_out)
+{
+  float scale = 32768.0f / static_cast<float>(t_channels);
+  for(size_t f = 0; f < t_frames; ++f)
+  {
+    float sum = 0.0f;
+    for(unsigned c = 0; c < t_channels; ++c)
+      sum += t_in[f * t_channels + c];
+    t_out[f] = sum * scale;
+  }
+}
+
+float
+dot_scalar(float const* t_a, float const* t_b, size_t t_n)
+{
+  float sum = 0.0f;
+  for(size_t i = 0; i < t_n; ++i)
+    sum += t_a[i] * t_b[i];
+  return sum;
+}
+
+#ifdef HNX_X86
+// out of range floats convert to INT_MIN,
+//  so they are clamped first
+HNX_TARGET_SSE
+size_t
+to_int16_sse(float const* t_in, size_t t_count, int16_t* t_out)
+{
+  __m128 lo = _mm_set1_ps(-32768.0f);
+  __m128 hi = _mm_set1_ps(32767.0f);
+  size_t i = 0;
+  for(; i + 8 <= t_count; i += 8)
+  {
+    __m128i a = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(t_in + i), lo), hi));
+    __m128i b = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(t_in + i + 4), lo), hi));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(t_out + i), _mm_packs_epi32(a, b));
+  }
+  return i;
+}
+
+// packs works within lanes, the permute
+//  puts the halves back in order
+HNX_TARGET_AVX2
+size_t
+to_int16_avx2(float const* t_in, size_t t_count, int16_t* t_out)
+{
+  __m256 lo = _mm256_set1_ps(-32768.0f);
+  __m256 hi = _mm256_set1_ps(32767.0f);
+  size_t i = 0;
+  for(; i + 16 <= t_count; i += 16)
+  {
+    __m256i a = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(t_in + i), lo), hi));
+    __m256i b = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(t_in + i + 8), lo), hi));
+    __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(t_out + i), packed);
+  }
+  return i;
+}
+
+// mono and stereo, the rest is scalar
+HNX_TARGET_SSE
+size_t
+mono_int16_sse(int16_t const* t_in, size_t t_frames, unsigned t_channels, float* t_out)
+{
+  size_t f = 0;
+  if(t_channels == 1)
+  {
+    for(; f + 8 <= t_frames; f += 8)
+    {
+      __m128i x = _mm_loadu_si128(reinterpret_cast<__m128i const*>(t_in + f));
+      __m128i a = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+      __m128i b = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+      _mm_storeu_ps(t_out + f, _mm_cvtepi32_ps(a));
+      _mm_storeu_ps(t_out + f + 4, _mm_cvtepi32_ps(b));
+    }
+  }
+  else if(t_channels == 2)
+  {
+    // left plus right in one multiply-add
+    __m128i ones = _mm_set1_epi16(1);
+    __m128 half = _mm_set1_ps(0.5f);
+    for(; f + 4 <= t_frames; f += 4)
+    {
+      __m128i x = _mm_loadu_si128(reinterpret_cast<__m128i const*>(t_in + f * 2));
+      __m128i sum = _mm_madd_epi16(x, ones);
+      _mm_storeu_ps(t_out + f, _mm_mul_ps(_mm_cvtepi32_ps(sum), half));
+    }
+  }
+  return f;
+}
+
+HNX_TARGET_AVX2
+size_t
+mono_int16_avx2(int16_t const* t_in, size_t t_frames, unsigned t_channels, float* t_out)
+{
+  size_t f = 0;
+  if(t_channels == 1)
+  {
+    for(; f + 8 <= t_frames; f += 8)
+    {
+      __m128i x = _mm_loadu_si128(reinterpret_cast<__m128i const*>(t_in + f));
+      _mm256_storeu_ps(t_out + f, _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(x)));
+    }
+  }
+  else if(t_channels == 2)
+  {
+    __m256i ones = _mm256_set1_epi16(1);
+    __m256 half = _mm256_set1_ps(0.5f);
+    for(; f + 8 <= t_frames; f += 8)
+    {
+      __m256i x = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(t_in + f * 2));
+      __m256i sum = _mm256_madd_epi16(x, ones);
+      _mm256_storeu_ps(t_out + f, _mm256_mul_ps(_mm256_cvtepi32_ps(sum), half));
+    }
+  }
+  return f;
+}
+
+HNX_TARGET_SSE
+size_t
+mono_float_sse(float const* t_in, size_t t_frames, unsigned t_channels, float* t_out)
+{
+  size_t f = 0;
+  if(t_channels == 1)
+  {
+    __m128 scale = _mm_set1_ps(32768.0f);
+    for(; f + 4 <= t_frames; f += 4)
+      _mm_storeu_ps(t_out + f, _mm_mul_ps(_mm_loadu_ps(t_in + f), scale));
+  }
+  else if(t_channels == 2)
+  {
+    // lefts and rights apart, then added
+    __m128 scale = _mm_set1_ps(16384.0f);
+    for(; f + 4 <= t_frames; f += 4)
+    {
+      __m128 a = _mm_loadu_ps(t_in + f * 2);
+      __m128 b = _mm_loadu_ps(t_in + f * 2 + 4);
+      __m128 left = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+      __m128 right = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+      _mm_storeu_ps(t_out + f, _mm_mul_ps(_mm_add_ps(left, right), scale));
+    }
+  }
+  return f;
+}
+
+HNX_TARGET_AVX2
+size_t
+mono_float_avx2(float const* t_in, size_t t_frames, unsigned t_channels, float* t_out)
+{
+  if(t_channels != 1)
+    return mono_float_sse(t_in, t_frames, t_channels, t_out);
+
+  __m256 scale = _mm256_set1_ps(32768.0f);
+  size_t f = 0;
+  for(; f + 8 <= t_frames; f += 8)
+    _mm256_storeu_ps(t_out + f, _mm256_mul_ps(_mm256_loadu_ps(t_in + f), scale));
+  return f;
+}
+
+// t_n a multiple of 8
+HNX_TARGET_SSE
+float
+dot_sse(float const* t_a, float const* t_b, size_t t_n)
+{
+  __m128 s0 = _mm_setzero_ps();
+  __m128 s1 = _mm_setzero_ps();
+  for(size_t i = 0; i < t_n; i += 8)
+  {
+    s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(t_a + i), _mm_loadu_ps(t_b + i)));
+    s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(t_a + i + 4), _mm_loadu_ps(t_b + i + 4)));
+  }
+  __m128 s = _mm_add_ps(s0, s1);
+  s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+  s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+  return _mm_cvtss_f32(s);
+}
+
+// t_n a multiple of 8, two accumulators
+//  keep the FMA latency hidden
+HNX_TARGET_AVX2
+float
+dot_avx2(float const* t_a, float const* t_b, size_t t_n)
+{
+  __m256 s0 = _mm256_setzero_ps();
+  __m256 s1 = _mm256_setzero_ps();
+  size_t i = 0;
+  for(; i + 16 <= t_n; i += 16)
+  {
+    s0 = _mm256_fmadd_ps(_mm256_loadu_ps(t_a + i), _mm256_loadu_ps(t_b + i), s0);
+    s1 = _mm256_fmadd_ps(_mm256_loadu_ps(t_a + i + 8), _mm256_loadu_ps(t_b + i + 8), s1);
+  }
+  if(i < t_n)
+    s0 = _mm256_fmadd_ps(_mm256_loadu_ps(t_a + i), _mm256_loadu_ps(t_b + i), s0);
+
+  __m256 s8 = _mm256_add_ps(s0, s1);
+  __m128 s = _mm_add_ps(_mm256_castps256_ps128(s8), _mm256_extractf128_ps(s8, 1));
+  s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+  s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+  return _mm_cvtss_f32(s);
+}
+#endif
+
+}
+
+HNx::PcmConverter::PcmConverter(PcmFormat t_in, SimdLevel t_simd)
+  : m_format(t_in)
+  , m_simd(usableSimd(t_simd))
+{
+  if(t_in.rate < 4000u || t_in.rate > 192000u)
+    throw std::invalid_argument("PcmConverter takes rates from 4kHz to 192kHz");
+  if(t_in.channels == 0)
+    throw std::invalid_argument("PcmConverter needs at least one channel");
+
+  unsigned common = std::gcd(AudioSampleRate, t_in.rate);
+  m_up = AudioSampleRate / common;
+  m_down = t_in.rate / common;
+  m_output.resize(maxOutput(ChunkFrames));
+
+  if(m_up == 1 && m_down == 1)
+  {
+    m_history.resize(ChunkFrames);
+    return;
+  }
+
+  // windowed sinc low-pass at the prototype
+  //  rate, the input rate times m_up
+  double prototype = static_cast<double>(t_in.rate) * m_up;
+  double nyquist = std::min(t_in.rate, AudioSampleRate) / 2.0;
+  double transition = nyquist * TransitionPart;
+  double cutoff = (nyquist - transition / 2.0) / prototype;
+  double beta = 0.1102 * (AttenuationDb - 8.7);
+  double length = (AttenuationDb - 8.0) / (2.285 * 2.0 * Pi * transition / prototype) + 1.0;
+
+  m_tapsPerPhase = static_cast<size_t>(std::ceil(length / m_up));
+  m_tapsPerPhase = (m_tapsPerPhase + 7) / 8 * 8;
+  size_t taps = m_tapsPerPhase * m_up;
+
+  std::vector<double> h(taps);
+  double centre = (static_cast<double>(taps) - 1.0) / 2.0;
+  double norm = bessel_i0(beta);
+  for(size_t n = 0; n < taps; ++n)
+  {
+    double x = static_cast<double>(n) - centre;
+    double sinc = x == 0.0 ? 2.0 * cutoff : std::sin(2.0 * Pi * cutoff * x) / (Pi * x);
+    double r = x / centre;
+    h[n] = m_up * sinc * bessel_i0(beta * std::sqrt(std::max(0.0, 1.0 - r * r))) / norm;
+  }
+
+  m_taps.resize(taps);
+  for(unsigned p = 0; p < m_up; ++p)
+    for(size_t k = 0; k < m_tapsPerPhase; ++k)
+      m_taps[p * m_tapsPerPhase + k] = static_cast<float>(h[p + (m_tapsPerPhase - 1 - k) * m_up]);
+
+  m_history.resize(m_tapsPerPhase - 1 + ChunkFrames + m_down);
+  reset();
+}
+
+size_t
+HNx::PcmConverter::maxOutput(size_t t_frames) const
+{
+  return t_frames * m_up / m_down + 1;
+}
+
+size_t
+HNx::PcmConverter::inputFor(size_t t_samples) const
+{
+  return t_samples ? (t_samples - 1) * m_down / m_up : 0;
+}
+
+size_t
+HNx::PcmConverter::latency() const
+{
+  return m_taps.empty() ? 0 : (m_taps.size() - 1) / (2 * m_down);
+}
+
+void
+HNx::PcmConverter::reset()
+{
+  if(m_taps.empty())
+    return;
+
+  // starts out on silence
+  std::fill(m_history.begin(), m_history.end(), 0.0f);
+  m_filled = m_tapsPerPhase - 1;
+  m_at = m_tapsPerPhase - 1;
+  m_phase = 0;
+}
+
+bool
+HNx::PcmConverter::passthrough() const
+{
+  return m_taps.empty() && m_format.channels == 1 && m_format.sample == SampleFormat::Int16;
+}
+
+PcmFormat const&
+HNx::PcmConverter::format() const
+{
+  return m_format;
+}
+
+SimdLevel
+HNx::PcmConverter::simd() const
+{
+  return m_simd;
+}
+
+unsigned
+HNx::PcmConverter::up() const
+{
+  return m_up;
+}
+
+unsigned
+HNx::PcmConverter::down() const
+{
+  return m_down;
+}
+
+void
+HNx::PcmConverter::append_mono(void const* t_in, size_t t_frames)
+{
+  float* out = m_history.data() + m_filled;
+  unsigned channels = m_format.channels;
+  size_t done = 0;
+  if(m_format.sample == SampleFormat::Int16)
+  {
+    auto in = static_cast<int16_t const*>(t_in);
+#ifdef HNX_X86
+    if(m_simd == SimdLevel::Avx2)
+      done = mono_int16_avx2(in, t_frames, channels, out);
+    else if(m_simd == SimdLevel::Sse)
+      done = mono_int16_sse(in, t_frames, channels, out);
+#endif
+    mono_int16_scalar(in + done * channels, t_frames - done, channels, out + done);
+  }
+  else
+  {
+    auto in = static_cast<float const*>(t_in);
+#ifdef HNX_X86
+    if(m_simd == SimdLevel::Avx2)
+      done = mono_float_avx2(in, t_frames, channels, out);
+    else if(m_simd == SimdLevel::Sse)
+      done = mono_float_sse(in, t_frames, channels, out);
+#endif
+    mono_float_scalar(in + done * channels, t_frames - done, channels, out + done);
+  }
+  m_filled += t_frames;
+}
+
+float
+HNx::PcmConverter::dot(float const* t_history, float const* t_taps) const
+{
+#ifdef HNX_X86
+  if(m_simd == SimdLevel::Avx2)
+    return dot_avx2(t_history, t_taps, m_tapsPerPhase);
+  if(m_simd == SimdLevel::Sse)
+    return dot_sse(t_history, t_taps, m_tapsPerPhase);
+#endif
+  return dot_scalar(t_history, t_taps, m_tapsPerPhase);
+}
+
+size_t
+HNx::PcmConverter::process(void const* t_in, size_t t_frames, int16_t* t_out)
+{
+  if(passthrough())
+  {
+    std::memcpy(t_out, t_in, t_frames * sizeof(int16_t));
+    return t_frames;
+  }
+
+  auto in = static_cast<unsigned char const*>(t_in);
+  size_t frameBytes = m_format.frameBytes();
+  size_t written = 0;
+
+  // only downmix and format
+  if(m_taps.empty())
+  {
+    for(size_t start = 0; start < t_frames; start += ChunkFrames)
+    {
+      size_t n = std::min(ChunkFrames, t_frames - start);
+      m_filled = 0;
+      append_mono(in + start * frameBytes, n);
+      std::copy_n(m_history.data(), n, m_output.data());
+
+      size_t done = 0;
+#ifdef HNX_X86
+      if(m_simd == SimdLevel::Avx2)
+        done = to_int16_avx2(m_output.data(), n, t_out + written);
+      else if(m_simd == SimdLevel::Sse)
+        done = to_int16_sse(m_output.data(), n, t_out + written);
+#endif
+      to_int16_scalar(m_output.data() + done, n - done, t_out + written + done);
+      written += n;
+    }
+    return written;
+  }
+
+  for(size_t start = 0; start < t_frames; start += ChunkFrames)
+  {
+    size_t n = std::min(ChunkFrames, t_frames - start);
+    append_mono(in + start * frameBytes, n);
+
+    // the window of each output ends on the
+    //  input it falls on, its phase picks
+    //  the taps
+    size_t count = 0;
+    while(m_at < m_filled)
+    {
+      float const* window = m_history.data() + m_at + 1 - m_tapsPerPhase;
+      m_output[count++] = dot(window, m_taps.data() + m_phase * m_tapsPerPhase);
+      m_phase += m_down;
+      m_at += m_phase / m_up;
+      m_phase %= m_up;
+    }
+
+    size_t done = 0;
+#ifdef HNX_X86
+    if(m_simd == SimdLevel::Avx2)
+      done = to_int16_avx2(m_output.data(), count, t_out + written);
+    else if(m_simd == SimdLevel::Sse)
+      done = to_int16_sse(m_output.data(), count, t_out + written);
+#endif
+    to_int16_scalar(m_output.data() + done, count - done, t_out + written + done);
+    written += count;
+
+    // keep only what the next window needs
+    size_t drop = std::min(m_at + 1 - m_tapsPerPhase, m_filled);
+    std::copy(m_history.begin() + drop, m_history.begin() + m_filled, m_history.begin());
+    m_filled -= drop;
+    m_at -= drop;
+  }
+  return written;
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include "Simd.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//   Turns whatever an audio source delivers
+//  into the 16kHz 16 bit mono the rest of
+//  the front-end runs on: downmix, sample
+//  format and a polyphase resampler
+//
+//  Streaming, the input can be cut anywhere
+//  and the converter keeps only the filter's
+//  history between calls. Output goes
+//  straight into the caller's buffer, a
+//  ring frame for AudioPump
+
+namespace HNx
+{
+
+enum class SampleFormat
+{
+  Int16,
+  Float32,  // -1 to 1
+};
+
+struct PcmFormat
+{
+  unsigned rate {16000u};
+  unsigned channels {1u};
+  SampleFormat sample {SampleFormat::Int16};
+
+  // one sample of every channel
+  size_t
+    frameBytes() const
+  {
+    return channels * (sample == SampleFormat::Float32 ? sizeof(float) : sizeof(int16_t));
+  }
+};
+
+class PcmConverter
+{
+public:
+  // throws std::invalid_argument for rates
+  //  outside 4kHz to 192kHz or no channels
+  explicit PcmConverter(PcmFormat t_in,
+                        SimdLevel t_simd = detectSimd());
+
+  // t_frames frames of interleaved t_in
+  //  format, returns the 16kHz mono samples
+  //  written to t_out, at most maxOutput()
+  size_t
+    process(void const* t_in, size_t t_frames, int16_t* t_out);
+
+  // most samples process() writes for
+  //  t_frames input frames
+  size_t
+    maxOutput(size_t t_frames) const;
+
+  // input frames that make about t_samples
+  //  output samples
+  size_t
+    inputFor(size_t t_samples) const;
+
+  // delay of the resampling filter, in
+  //  output samples
+  size_t
+    latency() const;
+
+  // forgets the filter's history
+  void
+    reset();
+
+  // no conversion at all, process() copies
+  bool
+    passthrough() const;
+
+  PcmFormat const&
+    format() const;
+
+  SimdLevel
+    simd() const;
+
+  // the up and down factors, 16000/rate
+  //  reduced
+  unsigned
+    up() const;
+
+  unsigned
+    down() const;
+
+private:
+  // downmix and format into m_history
+  //  after m_filled
+  void
+    append_mono(void const* t_in, size_t t_frames);
+
+  float
+    dot(float const* t_history, float const* t_taps) const;
+
+  PcmFormat m_format;
+  SimdLevel m_simd;
+  unsigned m_up {1};
+  unsigned m_down {1};
+
+  // one row of m_taps per phase, reversed
+  //  so each is a plain dot product with
+  //  the history, padded to whole vectors
+  size_t m_tapsPerPhase {0};
+  std::vector<float> m_taps {};
+
+  // mono input not yet fully used, the
+  //  newest filter window ends at m_at
+  std::vector<float> m_history {};
+  size_t m_filled {0};
+  size_t m_at {0};
+  unsigned m_phase {0};
+
+  std::vector<float> m_output {};
+};
+
+}
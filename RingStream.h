@@ -0,0 +1,162 @@
+#pragma once
+#include "Audio.h"
+
+#include <windows.h>
+#include <objidl.h>
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstring>
+#include <memory>
+
+//   Lets SAPI read an AudioRing as its input
+//  stream. Reads block until the ring has
+//  audio and end once it is closed, each
+//  frame is copied straight out of the ring
+
+namespace HNx
+{
+
+class RingStream : public IStream
+{
+public:
+  explicit RingStream(std::shared_ptr<AudioRing> t_ring)
+    : m_ring(std::move(t_ring))
+  {}
+
+  RingStream(RingStream const&) = delete;
+  RingStream& operator=(RingStream const&) = delete;
+
+  //========================================//
+  //   IUnknown                             //
+  //========================================//
+
+  HRESULT STDMETHODCALLTYPE
+    QueryInterface(REFIID t_riid, void** t_ppv) override
+  {
+    if(!t_ppv)
+      return E_POINTER;
+
+    if(t_riid == IID_IUnknown || t_riid == IID_ISequentialStream || t_riid == IID_IStream)
+    {
+      *t_ppv = static_cast<IStream*>(this);
+      AddRef();
+      return S_OK;
+    }
+    *t_ppv = nullptr;
+    return E_NOINTERFACE;
+  }
+
+  ULONG STDMETHODCALLTYPE
+    AddRef() override
+  {
+    return ++m_refs;
+  }
+
+  ULONG STDMETHODCALLTYPE
+    Release() override
+  {
+    ULONG refs = --m_refs;
+    if(refs == 0)
+      delete this;
+    return refs;
+  }
+
+  //========================================//
+  //   ISequentialStream                    //
+  //========================================//
+
+  // called from SAPI's audio thread only,
+  //  the ring's single consumer
+  HRESULT STDMETHODCALLTYPE
+    Read(void* t_pv, ULONG t_cb, ULONG* t_pcbRead) override
+  {
+    constexpr size_t FrameBytes = AudioFrameSamples * sizeof(int16_t);
+
+    auto* dst = static_cast<unsigned char*>(t_pv);
+    ULONG copied = 0;
+    while(copied < t_cb)
+    {
+      if(!m_frame)
+      {
+        if(!m_ring->waitFrame())
+          break;
+        m_frame = reinterpret_cast<unsigned char const*>(m_ring->readFrame());
+        m_offset = 0;
+      }
+
+      size_t n = std::min<size_t>(FrameBytes - m_offset, t_cb - copied);
+      std::memcpy(dst + copied, m_frame + m_offset, n);
+      copied += static_cast<ULONG>(n);
+      m_offset += n;
+
+      if(m_offset == FrameBytes)
+      {
+        m_ring->releaseFrame();
+        m_frame = nullptr;
+      }
+    }
+
+    m_position += copied;
+    if(t_pcbRead)
+      *t_pcbRead = copied;
+    return copied == t_cb ? S_OK : S_FALSE;
+  }
+
+  HRESULT STDMETHODCALLTYPE
+    Write(void const*, ULONG, ULONG*) override
+  {
+    return STG_E_ACCESSDENIED;
+  }
+
+  //========================================//
+  //   IStream                              //
+  //========================================//
+
+  // only tells the position, the
+  //  ring can't go back
+  HRESULT STDMETHODCALLTYPE
+    Seek(LARGE_INTEGER t_move, DWORD t_origin, ULARGE_INTEGER* t_newPosition) override
+  {
+    if(t_move.QuadPart != 0 || t_origin != STREAM_SEEK_CUR)
+      return STG_E_INVALIDFUNCTION;
+    if(t_newPosition)
+      t_newPosition->QuadPart = m_position;
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE
+    Stat(STATSTG* t_stat, DWORD) override
+  {
+    if(!t_stat)
+      return STG_E_INVALIDPOINTER;
+    std::memset(t_stat, 0, sizeof(*t_stat));
+    t_stat->type = STGTY_STREAM;
+    t_stat->cbSize.QuadPart = ULLONG_MAX;
+    t_stat->grfMode = STGM_READ;
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE SetSize(ULARGE_INTEGER) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE CopyTo(IStream*, ULARGE_INTEGER, ULARGE_INTEGER*, ULARGE_INTEGER*) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE Commit(DWORD) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE Revert() override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE LockRegion(ULARGE_INTEGER, ULARGE_INTEGER, DWORD) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE UnlockRegion(ULARGE_INTEGER, ULARGE_INTEGER, DWORD) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE Clone(IStream**) override { return E_NOTIMPL; }
+
+private:
+  // through Release() only
+  virtual ~RingStream() = default;
+
+  std::shared_ptr<AudioRing> m_ring;
+  std::atomic<ULONG> m_refs {1};
+
+  // the frame being read and how far
+  unsigned char const* m_frame {nullptr};
+  size_t m_offset {0};
+  ULONGLONG m_position {0};
+};
+
+}
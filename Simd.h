@@ -0,0 +1,93 @@
+#pragma once
+
+//   Picks the widest vector instructions the
+//  CPU running us supports. Kernels for AVX2
+//  are compiled in regardless of the build
+//  flags and only called when the check
+//  passes
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#define HNX_X86 1
+#endif
+
+#ifdef HNX_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#include <immintrin.h>
+#define HNX_TARGET_SSE
+#define HNX_TARGET_AVX2
+#else
+#include <immintrin.h>
+#define HNX_TARGET_SSE __attribute__((target("sse2")))
+#define HNX_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+namespace HNx
+{
+
+enum class SimdLevel
+{
+  Scalar,
+  Sse,   // SSE2, 4 floats
+  Avx2,  // AVX2 with FMA, 8 floats
+};
+
+inline
+const char*
+simdName(SimdLevel t_level)
+{
+  switch(t_level)
+  {
+    case SimdLevel::Avx2: return "AVX2";
+    case SimdLevel::Sse:  return "SSE2";
+    default:              return "scalar";
+  }
+}
+
+// checked once, the answer can't change
+inline
+SimdLevel
+detectSimd()
+{
+  static SimdLevel const level = []
+  {
+#ifdef HNX_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+    int regs[4] {};
+    __cpuid(regs, 1);
+    bool sse2 = (regs[3] & (1 << 26)) != 0;
+    bool fma = (regs[2] & (1 << 12)) != 0;
+
+    // AVX state has to be saved by the OS too
+    bool avx = (regs[2] & (1 << 28)) != 0
+            && (regs[2] & (1 << 27)) != 0
+            && (_xgetbv(0) & 0x6) == 0x6;
+
+    __cpuidex(regs, 7, 0);
+    bool avx2 = avx && fma && (regs[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    bool sse2 = __builtin_cpu_supports("sse2");
+    bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+    if(avx2)
+      return SimdLevel::Avx2;
+    if(sse2)
+      return SimdLevel::Sse;
+#endif
+    return SimdLevel::Scalar;
+  }();
+  return level;
+}
+
+// the requested level, or the best one
+//  below it this CPU has
+inline
+SimdLevel
+usableSimd(SimdLevel t_wanted)
+{
+  return static_cast<int>(t_wanted) < static_cast<int>(detectSimd()) ? t_wanted : detectSimd();
+}
+
+}
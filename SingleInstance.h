@@ -14,16 +14,11 @@ inline
 bool
 isSingleInstance()
 {
-  static bool exists = true;
-  if (!exists)
-    return false;
-
-  if (!CreateMutexW(nullptr, TRUE, SINGLE_INSTANCE_GUID) ||
-      GetLastError() == ERROR_ACCESS_DENIED)
-  {
-    // cache result
-    exists = false;
-  }
-  return false;
+  // the mutex is held until we exit, a
+  //  second copy finds it already there
+  static bool const first = CreateMutexW(nullptr, TRUE, SINGLE_INSTANCE_GUID)
+                            && GetLastError() != ERROR_ALREADY_EXISTS
+                            && GetLastError() != ERROR_ACCESS_DENIED;
+  return first;
 };
 }
\ No newline at end of file
@@ -0,0 +1,273 @@
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+//=================================//
+// HNx Voice Command Trace         //
+//=================================//
+// Per-thread event rings dumped   //
+//  as Chrome trace JSON           //
+//=================================//
+
+using namespace HNx;
+
+std::atomic<bool> HNx::Trace::s_enabled {false};
+
+namespace
+{
+// the fields are atomic so a dump reading
+//  a slot being overwritten isn't a race,
+//  what it read is dropped instead
+struct Event
+{
+  std::atomic<char const*> name {nullptr};
+  std::atomic<char const*> detail {nullptr};
+  std::atomic<uint64_t> begin {0};
+
+  // 0 for an instant
+  std::atomic<uint64_t> end {0};
+};
+
+struct Ring
+{
+  std::unique_ptr<Event[]> events {new Event[Trace::Capacity]};
+
+  // events written, only its thread
+  //  stores it
+  std::atomic<uint64_t> head {0};
+
+  // events below are cleared
+  std::atomic<uint64_t> floor {0};
+
+  std::atomic<char const*> name {nullptr};
+  uint32_t tid {0};
+
+  // its thread exited, the next new
+  //  thread takes it over
+  std::atomic<bool> free {false};
+};
+
+std::mutex s_mtx;
+std::vector<std::unique_ptr<Ring>> s_rings;
+
+thread_local char const* s_threadName {nullptr};
+
+// hands the ring back when its thread exits
+struct RingHolder
+{
+  Ring* ring {nullptr};
+
+  ~RingHolder()
+  {
+    if(ring)
+      ring->free.store(true, std::memory_order_release);
+  }
+};
+thread_local RingHolder s_holder;
+
+Ring&
+ring()
+{
+  if(s_holder.ring)
+    return *s_holder.ring;
+
+  std::lock_guard<std::mutex> lock(s_mtx);
+  Ring* mine = nullptr;
+  for(auto& r : s_rings)
+  {
+    bool exited = true;
+    if(r->free.compare_exchange_strong(exited, false, std::memory_order_acquire))
+    {
+      mine = r.get();
+      break;
+    }
+  }
+  if(!mine)
+  {
+    s_rings.push_back(std::make_unique<Ring>());
+    mine = s_rings.back().get();
+    mine->tid = static_cast<uint32_t>(s_rings.size());
+  }
+  mine->name.store(s_threadName, std::memory_order_relaxed);
+  s_holder.ring = mine;
+  return *mine;
+}
+
+void
+record(char const* t_name, char const* t_detail, uint64_t t_begin, uint64_t t_end)
+{
+  Ring& r = ring();
+  uint64_t h = r.head.load(std::memory_order_relaxed);
+  Event& e = r.events[h % Trace::Capacity];
+
+  // release, so a dump that saw any of
+  //  these also sees the head before them
+  e.name.store(t_name, std::memory_order_release);
+  e.detail.store(t_detail, std::memory_order_release);
+  e.begin.store(t_begin, std::memory_order_release);
+  e.end.store(t_end, std::memory_order_release);
+  r.head.store(h + 1, std::memory_order_release);
+}
+
+void
+writeString(std::ofstream& t_out, char const* t_text)
+{
+  t_out << '"';
+  for(char const* c = t_text; *c; ++c)
+  {
+    if(*c == '"' || *c == '\\')
+      t_out << '\\';
+    t_out << *c;
+  }
+  t_out << '"';
+}
+
+struct Copied
+{
+  char const* name;
+  char const* detail;
+  uint64_t begin;
+  uint64_t end;
+  uint32_t tid;
+};
+}
+
+void
+HNx::Trace::enable(bool t_on)
+{
+  s_enabled.store(t_on, std::memory_order_relaxed);
+}
+
+uint64_t
+HNx::Trace::now()
+{
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void
+HNx::Trace::instant(char const* t_name, char const* t_detail, uint64_t t_at)
+{
+  record(t_name, t_detail, t_at, 0);
+}
+
+void
+HNx::Trace::span(char const* t_name, uint64_t t_begin, uint64_t t_end, char const* t_detail)
+{
+  // an end of 0 would read as an instant
+  record(t_name, t_detail, t_begin, std::max<uint64_t>(t_end, 1));
+}
+
+void
+HNx::Trace::nameThread(char const* t_name)
+{
+  s_threadName = t_name;
+  if(s_holder.ring)
+    s_holder.ring->name.store(t_name, std::memory_order_relaxed);
+}
+
+size_t
+HNx::Trace::dump(std::wstring const& t_path)
+{
+  std::vector<Copied> events;
+  std::vector<std::pair<uint32_t, char const*>> names;
+  {
+    std::lock_guard<std::mutex> lock(s_mtx);
+    for(auto const& r : s_rings)
+    {
+      uint64_t head = r->head.load(std::memory_order_acquire);
+      uint64_t first = std::max(r->floor.load(std::memory_order_relaxed),
+                                head > Capacity ? head - Capacity : 0);
+      size_t copied = events.size();
+      for(uint64_t i = first; i < head; ++i)
+      {
+        Event const& e = r->events[i % Capacity];
+        events.push_back({e.name.load(std::memory_order_relaxed),
+                          e.detail.load(std::memory_order_relaxed),
+                          e.begin.load(std::memory_order_relaxed),
+                          e.end.load(std::memory_order_relaxed),
+                          r->tid});
+      }
+
+      // its thread kept going, the slots it
+      //  wrote meanwhile and the one it may
+      //  be writing hold newer events
+      std::atomic_thread_fence(std::memory_order_acquire);
+      uint64_t after = r->head.load(std::memory_order_relaxed);
+      uint64_t overwritten = after + 1 > Capacity ? after + 1 - Capacity : 0;
+      if(overwritten > first)
+      {
+        size_t stale = static_cast<size_t>(std::min(overwritten, head) - first);
+        events.erase(events.begin() + copied, events.begin() + copied + stale);
+      }
+
+      if(auto name = r->name.load(std::memory_order_relaxed))
+        names.emplace_back(r->tid, name);
+    }
+  }
+
+  // microseconds from the first event, what
+  //  the format takes
+  uint64_t base = UINT64_MAX;
+  for(auto const& e : events)
+    base = std::min(base, e.begin);
+  auto micros = [&](uint64_t t_ns) { return static_cast<double>(t_ns - base) / 1000.0; };
+
+  std::ofstream out(std::filesystem::path(t_path), std::ios::binary | std::ios::trunc);
+  if(!out)
+    throw std::runtime_error("Failed to open the trace file.");
+
+  out.setf(std::ios::fixed);
+  out.precision(3);
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  bool first = true;
+  for(auto const& n : names)
+  {
+    out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << n.first
+        << ",\"args\":{\"name\":";
+    writeString(out, n.second);
+    out << "}}";
+    first = false;
+  }
+  for(auto const& e : events)
+  {
+    if(!e.name)
+      continue;
+    out << (first ? "" : ",\n") << "{\"name\":";
+    writeString(out, e.name);
+    out << ",\"cat\":\"hnx\",\"pid\":1,\"tid\":" << e.tid << ",\"ts\":" << micros(e.begin);
+    if(e.end)
+      out << ",\"ph\":\"X\",\"dur\":" << static_cast<double>(e.end > e.begin ? e.end - e.begin : 0) / 1000.0;
+    else
+      out << ",\"ph\":\"i\",\"s\":\"t\"";
+    if(e.detail)
+    {
+      out << ",\"args\":{\"detail\":";
+      writeString(out, e.detail);
+      out << "}";
+    }
+    out << "}";
+    first = false;
+  }
+  out << "\n]}\n";
+
+  if(!out)
+    throw std::runtime_error("Failed to write the trace file.");
+  return static_cast<size_t>(std::count_if(events.begin(), events.end(),
+                                           [](Copied const& e) { return e.name != nullptr; }));
+}
+
+void
+HNx::Trace::clear()
+{
+  std::lock_guard<std::mutex> lock(s_mtx);
+  for(auto& r : s_rings)
+    r->floor.store(r->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+//   Where the time goes between the end of
+//  speech and the program it started. Trace
+//  points record spans and instants into a
+//  ring of their thread's own, no locks and
+//  no allocation once the thread has one,
+//  and dump() writes every ring out as
+//  Chrome trace JSON for chrome://tracing
+//  or ui.perfetto.dev
+//
+//  Off until enabled, a trace point is then
+//  one relaxed load; built with HNX_TRACE
+//  defined as 0 they compile to nothing
+
+#ifndef HNX_TRACE
+#define HNX_TRACE 1
+#endif
+
+namespace HNx
+{
+
+class Trace
+{
+public:
+  // events kept per thread, the oldest
+  //  are overwritten
+  static constexpr size_t Capacity = 4096;
+
+  static void
+    enable(bool t_on);
+
+  static bool
+    enabled()
+  {
+    return HNX_TRACE && s_enabled.load(std::memory_order_relaxed);
+  }
+
+  // nanoseconds on the steady clock
+  static uint64_t
+    now();
+
+  // names and details must be string
+  //  literals, only the pointers are kept
+  static void
+    instant(char const* t_name,
+            char const* t_detail = nullptr,
+            uint64_t t_at = now());
+
+  static void
+    span(char const* t_name,
+         uint64_t t_begin,
+         uint64_t t_end,
+         char const* t_detail = nullptr);
+
+  // the calling thread's track in the dump
+  static void
+    nameThread(char const* t_name);
+
+  // every thread's events, recorded since the
+  //  last clear(), returns how many
+  // throws std::runtime_error if t_path
+  //  can't be written
+  static size_t
+    dump(std::wstring const& t_path);
+
+  static void
+    clear();
+
+private:
+  static std::atomic<bool> s_enabled;
+};
+
+// a span from construction to destruction,
+//  if tracing was on when it began
+class TraceScope
+{
+public:
+  explicit TraceScope(char const* t_name,
+                      char const* t_detail = nullptr)
+    : m_name(Trace::enabled() ? t_name : nullptr)
+    , m_detail(t_detail)
+    , m_begin(m_name ? Trace::now() : 0)
+  {}
+
+  ~TraceScope()
+  {
+    if(m_name)
+      Trace::span(m_name, m_begin, Trace::now(), m_detail);
+  }
+
+  TraceScope(TraceScope const&) = delete;
+  TraceScope& operator=(TraceScope const&) = delete;
+
+private:
+  char const* m_name {nullptr};
+  char const* m_detail {nullptr};
+  uint64_t m_begin {0};
+};
+
+}
+
+#define HNX_TRACE_CAT2(a, b) a##b
+#define HNX_TRACE_CAT(a, b) HNX_TRACE_CAT2(a, b)
+
+// TRACE_SCOPE("name" [, "detail"])
+#define TRACE_SCOPE(...) ::HNx::TraceScope HNX_TRACE_CAT(traceScope, __LINE__) {__VA_ARGS__}
+
+// TRACE_INSTANT("name" [, "detail" [, at]])
+#define TRACE_INSTANT(...) do { if(::HNx::Trace::enabled()) ::HNx::Trace::instant(__VA_ARGS__); } while(0)
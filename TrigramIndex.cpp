@@ -0,0 +1,270 @@
+#include "TrigramIndex.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+//=================================//
+// HNx Voice Command Search        //
+//=================================//
+// Trigram lists for finding text  //
+//  as it is typed                 //
+//=================================//
+
+using namespace HNx;
+
+namespace
+{
+// the index is rebuilt once this many ids
+//  are removed and more than are left
+constexpr size_t COMPACT_AFTER = 1024;
+}
+
+void
+HNx::TrigramIndex::insert(Id t_id, std::wstring_view t_text)
+{
+  if(contains(t_id))
+    throw std::invalid_argument("Id " + std::to_string(t_id) + " is already in the search index");
+
+  // a reused id may still be listed
+  //  under its old parts
+  if(t_id < m_ofId.size() && m_dead)
+    compact();
+
+  if(t_id >= m_ofId.size())
+  {
+    m_ofId.resize(size_t {t_id} + 1);
+    m_live.resize(size_t {t_id} + 1, false);
+  }
+
+  std::wstring text = normalize(t_text);
+  auto& parts = m_ofId[t_id];
+  for(size_t begin = 0; begin <= text.size();)
+  {
+    size_t end = std::min(text.find(Separator, begin), text.size());
+    if(end > begin)
+    {
+      uint32_t part = intern(text.substr(begin, end - begin));
+      if(std::find(parts.begin(), parts.end(), part) == parts.end())
+      {
+        parts.push_back(part);
+        m_parts[part].ids.push_back(t_id);
+      }
+    }
+    begin = end + 1;
+  }
+
+  m_live[t_id] = true;
+  ++m_size;
+}
+
+void
+HNx::TrigramIndex::remove(Id t_id)
+{
+  if(!contains(t_id))
+    return;
+
+  m_live[t_id] = false;
+  m_ofId[t_id].clear();
+  m_ofId[t_id].shrink_to_fit();
+  --m_size;
+  ++m_dead;
+
+  if(m_dead >= COMPACT_AFTER && m_dead > m_size)
+    compact();
+}
+
+std::vector<TrigramIndex::Id>
+HNx::TrigramIndex::find(std::wstring_view t_query) const
+{
+  std::wstring query = normalize(t_query);
+  std::vector<Id> found;
+  if(query.empty())
+  {
+    for(size_t id = 0; id < m_live.size(); ++id)
+      if(m_live[id])
+        found.push_back(static_cast<Id>(id));
+    return found;
+  }
+
+  // a text with several matching parts is
+  //  reached more than once, marks keep it
+  //  to one and the ids ascending
+  std::vector<bool> marks(m_live.size(), false);
+  for(uint32_t part : find_parts(query))
+    for(Id id : m_parts[part].ids)
+      if(m_live[id])
+        marks[id] = true;
+
+  for(size_t id = 0; id < marks.size(); ++id)
+    if(marks[id])
+      found.push_back(static_cast<Id>(id));
+  return found;
+}
+
+std::vector<TrigramIndex::Id>
+HNx::TrigramIndex::refine(std::wstring_view t_query,
+                         std::vector<Id> const& t_within) const
+{
+  std::wstring query = normalize(t_query);
+  std::vector<Id> found;
+  for(Id id : t_within)
+  {
+    if(!contains(id))
+      continue;
+    for(uint32_t part : m_ofId[id])
+    {
+      if(m_parts[part].text->find(query) != std::wstring::npos)
+      {
+        found.push_back(id);
+        break;
+      }
+    }
+  }
+  return found;
+}
+
+bool
+HNx::TrigramIndex::contains(Id t_id) const
+{
+  return t_id < m_live.size() && m_live[t_id];
+}
+
+size_t
+HNx::TrigramIndex::size() const
+{
+  return m_size;
+}
+
+void
+HNx::TrigramIndex::clear()
+{
+  m_byText.clear();
+  m_parts.clear();
+  m_lists.clear();
+  m_ofId.clear();
+  m_live.clear();
+  m_size = 0;
+  m_dead = 0;
+}
+
+void
+HNx::TrigramIndex::reserve(size_t t_ids)
+{
+  m_ofId.reserve(t_ids);
+  m_live.reserve(t_ids);
+
+  // mostly phrases, programs and parameters
+  //  are shared
+  m_byText.reserve(t_ids + t_ids / 4);
+  m_parts.reserve(t_ids + t_ids / 4);
+}
+
+std::wstring
+HNx::TrigramIndex::normalize(std::wstring_view t_text)
+{
+  return lower_key(t_text);
+}
+
+TrigramIndex::Key
+HNx::TrigramIndex::key_of(wchar_t a, wchar_t b, wchar_t c)
+{
+  // 21 bits hold any code point
+  auto bits = [](wchar_t t_c) { return static_cast<Key>(t_c) & 0x1FFFFF; };
+  return (bits(a) << 42) | (bits(b) << 21) | bits(c);
+}
+
+uint32_t
+HNx::TrigramIndex::intern(std::wstring&& t_part)
+{
+  auto found = m_byText.try_emplace(std::move(t_part), static_cast<uint32_t>(m_parts.size()));
+  if(!found.second)
+    return found.first->second;
+
+  uint32_t part = found.first->second;
+  std::wstring const& text = found.first->first;
+  m_parts.push_back({&text, {}});
+
+  std::vector<Key> keys;
+  for(size_t i = 2; i < text.size(); ++i)
+    keys.push_back(key_of(text[i - 2], text[i - 1], text[i]));
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+  // parts are only ever appended, every
+  //  list stays ascending
+  for(Key k : keys)
+    m_lists[k].push_back(part);
+  return part;
+}
+
+std::vector<uint32_t>
+HNx::TrigramIndex::find_parts(std::wstring const& t_query) const
+{
+  std::vector<uint32_t> found;
+
+  // too short to have a key, every part
+  //  is checked
+  if(t_query.size() < 3)
+  {
+    for(size_t part = 0; part < m_parts.size(); ++part)
+      if(m_parts[part].text->find(t_query) != std::wstring::npos)
+        found.push_back(static_cast<uint32_t>(part));
+    return found;
+  }
+
+  std::vector<std::vector<uint32_t> const*> lists;
+  for(size_t i = 2; i < t_query.size(); ++i)
+  {
+    auto it = m_lists.find(key_of(t_query[i - 2], t_query[i - 1], t_query[i]));
+    if(it == m_lists.end())
+      return found;
+    lists.push_back(&it->second);
+  }
+  std::sort(lists.begin(), lists.end(),
+            [](auto a, auto b) { return a->size() < b->size(); });
+
+  // the two rarest keys narrow it down the
+  //  most, the parts left are checked whole
+  std::vector<uint32_t> both;
+  std::vector<uint32_t> const* candidates = lists[0];
+  if(lists.size() > 1)
+  {
+    std::set_intersection(lists[0]->begin(), lists[0]->end(),
+                          lists[1]->begin(), lists[1]->end(),
+                          std::back_inserter(both));
+    candidates = &both;
+  }
+
+  for(uint32_t part : *candidates)
+    if(m_parts[part].text->find(t_query) != std::wstring::npos)
+      found.push_back(part);
+  return found;
+}
+
+void
+HNx::TrigramIndex::compact()
+{
+  std::vector<std::pair<Id, std::wstring>> texts;
+  texts.reserve(m_size);
+  for(size_t id = 0; id < m_ofId.size(); ++id)
+  {
+    if(!m_live[id])
+      continue;
+
+    std::wstring text;
+    for(uint32_t part : m_ofId[id])
+    {
+      if(!text.empty())
+        text.push_back(Separator);
+      text += *m_parts[part].text;
+    }
+    texts.emplace_back(static_cast<Id>(id), std::move(text));
+  }
+
+  clear();
+  reserve(texts.empty() ? 0 : size_t {texts.back().first} + 1);
+  for(auto const& entry : texts)
+    insert(entry.first, entry.second);
+}
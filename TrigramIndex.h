@@ -0,0 +1,113 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+//   Substring search over short texts such as
+//  a command's phrase, program and parameters.
+//  A text is cut at Separator into parts and
+//  every distinct part is indexed once, by
+//  each three characters in it, however many
+//  texts share it; the same program behind a
+//  thousand phrases costs one entry per key.
+//  A query only checks the parts listed under
+//  its rarest keys. Case is ignored
+//
+//  Removed texts are skipped until enough of
+//  them pile up to rebuild the index
+
+namespace HNx
+{
+
+class TrigramIndex
+{
+public:
+  using Id = uint32_t;
+
+  // between the parts of one text, such as
+  //  phrase and program, a query never
+  //  matches across two of them
+  static constexpr wchar_t Separator {L'\x1f'};
+
+  // t_id must not be in the index
+  void
+    insert(Id t_id, std::wstring_view t_text);
+
+  void
+    remove(Id t_id);
+
+  // ids of the texts with a part containing
+  //  t_query, ascending, every text for an
+  //  empty one
+  std::vector<Id>
+    find(std::wstring_view t_query) const;
+
+  // the same but only checking t_within, for
+  //  a query that extends the one t_within
+  //  came from; keeps t_within's order
+  std::vector<Id>
+    refine(std::wstring_view t_query,
+           std::vector<Id> const& t_within) const;
+
+  bool
+    contains(Id t_id) const;
+
+  size_t
+    size() const;
+
+  void
+    clear();
+
+  // room for ids below t_ids before a
+  //  bulk insert
+  void
+    reserve(size_t t_ids);
+
+  // lower case, what queries are compared to
+  static std::wstring
+    normalize(std::wstring_view t_text);
+
+private:
+  using Key = uint64_t;
+
+  struct Part
+  {
+    // the key in m_byText
+    std::wstring const* text {nullptr};
+
+    // texts holding it, removed ones too
+    std::vector<Id> ids {};
+  };
+
+  static Key
+    key_of(wchar_t a, wchar_t b, wchar_t c);
+
+  // index of the part, added if new
+  uint32_t
+    intern(std::wstring&& t_part);
+
+  // parts containing t_query, ascending
+  std::vector<uint32_t>
+    find_parts(std::wstring const& t_query) const;
+
+  // rebuilt from the texts still in it
+  void
+    compact();
+
+  std::unordered_map<std::wstring, uint32_t> m_byText {};
+  std::vector<Part> m_parts {};
+
+  // parts by the keys in them, ascending
+  std::unordered_map<Key, std::vector<uint32_t>> m_lists {};
+
+  // parts of every id, none once removed
+  std::vector<std::vector<uint32_t>> m_ofId {};
+  std::vector<bool> m_live {};
+
+  size_t m_size {0};
+  size_t m_dead {0};
+};
+
+}
@@ -0,0 +1,164 @@
+#include "UsageStats.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+
+//=================================//
+// HNx Voice Command Usage Stats   //
+//=================================//
+// Decaying per-phrase histogram   //
+//=================================//
+
+using namespace HNx;
+
+HNx::UsageStats::UsageStats(clock::duration t_halfLife)
+  : m_halfLife(t_halfLife)
+{
+  if(m_halfLife <= clock::duration::zero())
+    throw std::invalid_argument("UsageStats half life must be positive");
+}
+
+double
+HNx::UsageStats::decayed(Entry const& t_entry,
+                         clock::time_point t_now) const
+{
+  if(t_now <= t_entry.stamp)
+    return t_entry.score;
+  double halfLives = std::chrono::duration<double>(t_now - t_entry.stamp) /
+    std::chrono::duration<double>(m_halfLife);
+  return t_entry.score * std::exp2(-halfLives);
+}
+
+void
+HNx::UsageStats::record(std::wstring_view t_phrase,
+                        clock::time_point t_now)
+{
+  std::wstring key = lower_key(t_phrase);
+  if(key.empty())
+    return;
+
+  std::lock_guard<std::mutex> lock(m_mtx);
+  Entry& entry = m_entries[key];
+  if(entry.phrase.empty())
+    entry.phrase = trim_whitespace(t_phrase);
+
+  // bring the old count up to now before adding
+  entry.score = decayed(entry, t_now) + 1.0;
+  entry.stamp = std::max(entry.stamp, t_now);
+  m_pending++;
+}
+
+double
+HNx::UsageStats::score(std::wstring_view t_phrase,
+                       clock::time_point t_now) const
+{
+  std::lock_guard<std::mutex> lock(m_mtx);
+  auto it = m_entries.find(lower_key(t_phrase));
+  return it == m_entries.end() ? 0.0 : decayed(it->second, t_now);
+}
+
+std::vector<std::pair<std::wstring, double>>
+HNx::UsageStats::snapshot(clock::time_point t_now) const
+{
+  std::vector<std::pair<std::wstring, double>> scores;
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    scores.reserve(m_entries.size());
+    for(auto const& e : m_entries)
+      scores.emplace_back(e.second.phrase, decayed(e.second, t_now));
+  }
+  std::sort(scores.begin(), scores.end(),
+            [](auto const& a, auto const& b) { return a.second > b.second; });
+  return scores;
+}
+
+size_t
+HNx::UsageStats::pending() const
+{
+  std::lock_guard<std::mutex> lock(m_mtx);
+  return m_pending;
+}
+
+// one line per phrase:
+//  <seconds since epoch> <score> <phrase as UTF-8>
+bool
+HNx::UsageStats::load(std::wstring const& t_path)
+{
+  std::ifstream in(std::filesystem::path(t_path), std::ios::binary);
+  if(!in)
+    return false;
+
+  std::map<std::wstring, Entry> entries;
+  std::string line;
+  while(std::getline(in, line))
+  {
+    std::istringstream fields(line);
+    long long seconds = 0;
+    double score = 0.0;
+    if(!(fields >> seconds >> score) || fields.get() != ' ')
+      continue;
+
+    std::string phrase;
+    std::getline(fields, phrase);
+    if(!phrase.empty() && phrase.back() == '\r')
+      phrase.pop_back();
+
+    Entry entry;
+    entry.phrase = from_utf8(phrase);
+    entry.score = score;
+    entry.stamp = clock::time_point(std::chrono::duration_cast<clock::duration>(std::chrono::seconds(seconds)));
+
+    std::wstring key = lower_key(entry.phrase);
+    if(!key.empty() && std::isfinite(score) && score > 0.0)
+      entries[key] = std::move(entry);
+  }
+
+  std::lock_guard<std::mutex> lock(m_mtx);
+  m_entries.swap(entries);
+  m_pending = 0;
+  return true;
+}
+
+bool
+HNx::UsageStats::save(std::wstring const& t_path)
+{
+  std::ostringstream out;
+  size_t saved = 0;
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    for(auto const& e : m_entries)
+      out << std::chrono::duration_cast<std::chrono::seconds>(e.second.stamp.time_since_epoch()).count()
+          << ' ' << e.second.score
+          << ' ' << to_utf8(e.second.phrase) << '\n';
+    saved = m_pending;
+  }
+
+  std::filesystem::path path(t_path);
+  std::filesystem::path tmp = path;
+  tmp += L".tmp";
+  {
+    std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+    if(!file)
+      return false;
+    std::string data = out.str();
+    file.write(data.data(), static_cast<std::streamsize>(data.size()));
+    if(!file)
+      return false;
+  }
+
+  std::error_code ec;
+  std::filesystem::rename(tmp, path, ec);
+  if(ec)
+    return false;
+
+  // records made while writing stay pending
+  std::lock_guard<std::mutex> lock(m_mtx);
+  m_pending -= std::min(m_pending, saved);
+  return true;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+//   Per-phrase usage counts that decay over
+//  time, so what was used a lot last month
+//  slowly gives way to what is used now.
+//  Saved to a file to survive restarts
+
+namespace HNx
+{
+
+class UsageStats
+{
+public:
+  using clock = std::chrono::system_clock;
+
+  // a use counts for half as much after
+  //  t_halfLife has passed
+  explicit UsageStats(clock::duration t_halfLife = std::chrono::hours(24 * 7));
+
+  // counts one use of a phrase
+  void
+    record(std::wstring_view t_phrase,
+           clock::time_point t_now = clock::now());
+
+  // decayed count, 0 for unknown phrases
+  double
+    score(std::wstring_view t_phrase,
+          clock::time_point t_now = clock::now()) const;
+
+  // every phrase with its decayed count,
+  //  highest first
+  std::vector<std::pair<std::wstring, double>>
+    snapshot(clock::time_point t_now = clock::now()) const;
+
+  // records since the last save()
+  size_t
+    pending() const;
+
+  // replaces the current counts, false if the
+  //  file can't be read (counts are kept)
+  bool
+    load(std::wstring const& t_path);
+
+  // writes to a temporary file first so a
+  //  crash never leaves a half written file
+  bool
+    save(std::wstring const& t_path);
+
+private:
+  struct Entry
+  {
+    std::wstring phrase {};
+    double score {0.0};
+    clock::time_point stamp {};
+  };
+
+  double
+    decayed(Entry const& t_entry,
+            clock::time_point t_now) const;
+
+  clock::duration m_halfLife {};
+
+  // keyed by the lower case phrase
+  std::map<std::wstring, Entry> m_entries {};
+  size_t m_pending {0};
+
+  mutable std::mutex m_mtx {};
+};
+
+}
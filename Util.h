@@ -1,11 +1,14 @@
 #pragma once
 
+#include <algorithm>
+#include <cwctype>
 #include <string>
 #include <string_view>
 namespace HNx
 {
 // trims leading and trailing
 //  whitespace from a wstring
+inline
 std::wstring
 trim_whitespace(std::wstring_view str)
 {
@@ -17,9 +20,116 @@ trim_whitespace(std::wstring_view str)
 }
 
 // for comparing wstrings case insensatively
-bool icase_cmp_wchar(wchar_t a, wchar_t b)
+inline bool icase_cmp_wchar(wchar_t a, wchar_t b)
 {
   return std::tolower(a) == std::tolower(b);
 }
 
+// whole wstring case insensative equality
+inline bool icase_equal(std::wstring_view a, std::wstring_view b)
+{
+  return a.size() == b.size() &&
+    std::equal(a.begin(), a.end(), b.begin(), icase_cmp_wchar);
+}
+
+// what phrases and contexts are told apart
+//  by everywhere they are keyed, trimmed and
+//  lower case
+inline
+std::wstring
+lower_key(std::wstring_view str)
+{
+  std::wstring key = trim_whitespace(str);
+  for(auto& c : key)
+    c = static_cast<wchar_t>(std::towlower(c));
+  return key;
+}
+
+// wstrings are UTF-16 on Windows, UTF-32
+//  elsewhere, files always hold UTF-8
+inline
+std::string
+to_utf8(std::wstring_view str)
+{
+  std::string out;
+  out.reserve(str.size());
+  for(size_t i = 0; i < str.size(); ++i)
+  {
+    char32_t c = static_cast<char32_t>(str[i]);
+    if(sizeof(wchar_t) == 2 && c >= 0xD800 && c <= 0xDBFF && i + 1 < str.size())
+    {
+      char32_t low = static_cast<char32_t>(str[i + 1]);
+      if(low >= 0xDC00 && low <= 0xDFFF)
+      {
+        c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+        ++i;
+      }
+    }
+
+    if(c < 0x80)
+      out.push_back(static_cast<char>(c));
+    else if(c < 0x800)
+    {
+      out.push_back(static_cast<char>(0xC0 | (c >> 6)));
+      out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    }
+    else if(c < 0x10000)
+    {
+      out.push_back(static_cast<char>(0xE0 | (c >> 12)));
+      out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+      out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    }
+    else
+    {
+      out.push_back(static_cast<char>(0xF0 | (c >> 18)));
+      out.push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3F)));
+      out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+      out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    }
+  }
+  return out;
+}
+
+// invalid sequences become U+FFFD
+inline
+std::wstring
+from_utf8(std::string_view str)
+{
+  std::wstring out;
+  out.reserve(str.size());
+  for(size_t i = 0; i < str.size();)
+  {
+    unsigned char lead = static_cast<unsigned char>(str[i]);
+    size_t len = lead < 0x80 ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xE ? 3 : (lead >> 3) == 0x1E ? 4 : 0;
+    if(len == 0 || i + len > str.size())
+    {
+      out.push_back(static_cast<wchar_t>(0xFFFD));
+      ++i;
+      continue;
+    }
+
+    char32_t c = len == 1 ? lead : lead & (0xFF >> (len + 1));
+    bool valid = true;
+    for(size_t k = 1; k < len; ++k)
+    {
+      unsigned char next = static_cast<unsigned char>(str[i + k]);
+      valid = valid && (next & 0xC0) == 0x80;
+      c = (c << 6) | (next & 0x3F);
+    }
+    i += valid ? len : 1;
+    if(!valid)
+      c = 0xFFFD;
+
+    if(sizeof(wchar_t) == 2 && c >= 0x10000)
+    {
+      c -= 0x10000;
+      out.push_back(static_cast<wchar_t>(0xD800 + (c >> 10)));
+      out.push_back(static_cast<wchar_t>(0xDC00 + (c & 0x3FF)));
+    }
+    else
+      out.push_back(static_cast<wchar_t>(c));
+  }
+  return out;
+}
+
 }
\ No newline at end of file
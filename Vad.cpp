@@ -0,0 +1,302 @@
+#include "Vad.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HNX_VAD_SSE2 1
+#include <emmintrin.h>
+#endif
+
+//=================================//
+// HNx Voice Command VAD           //
+//=================================//
+// Keeps silence away from the     //
+//  recognizer                     //
+//=================================//
+
+using namespace HNx;
+
+namespace
+{
+
+// zero padded frame length for the spectrum
+constexpr size_t SpectrumSize {512u};
+
+// the band flatness is measured over, bins
+//  of SpectrumSize at AudioSampleRate
+constexpr size_t BandLow {300u * SpectrumSize / AudioSampleRate};
+constexpr size_t BandHigh {4000u * SpectrumSize / AudioSampleRate};
+
+// how fast the noise floor follows the
+//  energy, per frame
+constexpr float FloorFall {0.5f};
+constexpr float FloorRise {0.01f};
+
+// voiced speech barely moves the floor,
+//  fricatives are short enough that loud
+//  steady noise can be treated like one
+//  and still be learned within seconds
+constexpr float FloorRiseVoiced {0.001f};
+
+}
+
+//=========================================================================
+//  Vad
+//=========================================================================
+
+HNx::Vad::Vad(VadConfig t_config)
+  : m_config(t_config)
+  , m_fft(SpectrumSize)
+  , m_signal(AudioFrameSamples)
+  , m_power(SpectrumSize / 2 + 1)
+  , m_window(AudioFrameSamples)
+{
+  // Hann, against leakage from the
+  //  frame edges
+  for(size_t i = 0; i < AudioFrameSamples; ++i)
+    m_window[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * 3.14159265358979323846 * static_cast<double>(i) / static_cast<double>(AudioFrameSamples - 1)));
+}
+
+float
+HNx::Vad::energyDb(int16_t const* t_frame, size_t t_count)
+{
+  if(t_count == 0)
+    return -100.0f;
+
+  uint64_t sum = 0;
+  size_t i = 0;
+#ifdef HNX_VAD_SSE2
+  __m128i const zero = _mm_setzero_si128();
+  __m128i acc = _mm_setzero_si128();
+  for(; i + 8 <= t_count; i += 8)
+  {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<__m128i const*>(t_frame + i));
+
+    // pairs of squares, at most 2^31 so
+    //  they are widened as unsigned
+    __m128i sq = _mm_madd_epi16(x, x);
+    acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(sq, zero));
+    acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(sq, zero));
+  }
+  alignas(16) uint64_t lanes[2];
+  _mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc);
+  sum = lanes[0] + lanes[1];
+#endif
+  for(; i < t_count; ++i)
+    sum += static_cast<uint64_t>(static_cast<int32_t>(t_frame[i]) * t_frame[i]);
+
+  double mean = static_cast<double>(sum) / (static_cast<double>(t_count) * 32768.0 * 32768.0);
+  return std::max(-100.0f, static_cast<float>(10.0 * std::log10(mean + 1e-10)));
+}
+
+float
+HNx::Vad::zeroCrossingRate(int16_t const* t_frame, size_t t_count)
+{
+  if(t_count < 2)
+    return 0.0f;
+
+  size_t crossings = 0;
+  size_t i = 0;
+#ifdef HNX_VAD_SSE2
+  // each lane counts at most one crossing
+  //  per 8 samples, 16 bits is plenty for
+  //  a frame
+  __m128i counts = _mm_setzero_si128();
+  for(; i + 9 <= t_count; i += 8)
+  {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<__m128i const*>(t_frame + i));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<__m128i const*>(t_frame + i + 1));
+
+    // -1 where the signs differ
+    counts = _mm_sub_epi16(counts, _mm_srai_epi16(_mm_xor_si128(a, b), 15));
+  }
+  alignas(16) uint16_t lanes[8];
+  _mm_store_si128(reinterpret_cast<__m128i*>(lanes), counts);
+  for(uint16_t c : lanes)
+    crossings += c;
+#endif
+  for(; i + 1 < t_count; ++i)
+    crossings += (t_frame[i] ^ t_frame[i + 1]) < 0;
+
+  return static_cast<float>(crossings) / static_cast<float>(t_count - 1);
+}
+
+float
+HNx::Vad::flatness(int16_t const* t_frame)
+{
+  for(size_t i = 0; i < AudioFrameSamples; ++i)
+    m_signal[i] = m_window[i] * static_cast<float>(t_frame[i]);
+  m_fft.power(m_signal.data(), m_signal.size(), m_power.data());
+
+  double logSum = 0.0;
+  double sum = 0.0;
+  for(size_t k = BandLow; k <= BandHigh; ++k)
+  {
+    double p = static_cast<double>(m_power[k]) + 1e-3;
+    logSum += std::log(p);
+    sum += p;
+  }
+  double n = static_cast<double>(BandHigh - BandLow + 1);
+  return static_cast<float>(std::exp(logSum / n) / (sum / n));
+}
+
+bool
+HNx::Vad::process(int16_t const* t_frame)
+{
+  m_last.energyDb = energyDb(t_frame, AudioFrameSamples);
+  m_last.zcr = zeroCrossingRate(t_frame, AudioFrameSamples);
+  m_last.flatness = 1.0f;
+
+  float energy = m_last.energyDb;
+  if(!m_haveFloor)
+  {
+    m_floorDb = energy;
+    m_haveFloor = true;
+  }
+
+  // the spectrum is only worked out for
+  //  frames loud enough to be speech
+  bool voiced = false;
+  bool unvoiced = false;
+  if(energy > m_config.minDb && energy > m_floorDb + m_config.marginDb)
+  {
+    m_last.flatness = flatness(t_frame);
+    voiced = m_last.flatness < m_config.flatnessMax;
+    unvoiced = !voiced && m_last.zcr > m_config.zcrMin;
+  }
+  bool speech = voiced || unvoiced;
+
+  float rate = energy < m_floorDb ? FloorFall
+             : voiced ? FloorRiseVoiced
+             : FloorRise;
+  m_floorDb += (energy - m_floorDb) * rate;
+
+  m_run = speech ? m_run + 1 : 0;
+  if(m_open)
+  {
+    if(speech)
+      m_hang = m_config.hangoverFrames;
+    else if(m_hang == 0)
+      m_open = false;
+    else
+      --m_hang;
+  }
+  else if(m_run >= std::max(1u, m_config.onsetFrames))
+  {
+    m_open = true;
+    m_hang = m_config.hangoverFrames;
+  }
+  return m_open;
+}
+
+void
+HNx::Vad::reset()
+{
+  m_last = {};
+  m_haveFloor = false;
+  m_run = 0;
+  m_hang = 0;
+  m_open = false;
+}
+
+VadFeatures
+HNx::Vad::last() const
+{
+  return m_last;
+}
+
+float
+HNx::Vad::noiseFloorDb() const
+{
+  return m_floorDb;
+}
+
+//=========================================================================
+//  VadGate
+//=========================================================================
+
+HNx::VadGate::VadGate(std::shared_ptr<AudioRing> t_in,
+                      std::shared_ptr<AudioRing> t_out,
+                      VadConfig t_config)
+  : m_in(std::move(t_in))
+  , m_out(std::move(t_out))
+  , m_vad(t_config)
+  , m_preroll(t_config.prerollFrames * AudioFrameSamples)
+  , m_prerollFrames(t_config.prerollFrames)
+{
+  if(!m_in || !m_out)
+    throw std::invalid_argument("VadGate needs an input and an output ring");
+}
+
+HNx::VadGate::~VadGate()
+{
+  stop();
+}
+
+void
+HNx::VadGate::start()
+{
+  if(m_thread.joinable())
+    return;
+  m_thread = std::thread(&VadGate::run, this);
+}
+
+void
+HNx::VadGate::stop()
+{
+  m_in->close();
+  if(m_thread.joinable())
+    m_thread.join();
+  m_out->close();
+}
+
+VadStats
+HNx::VadGate::stats() const
+{
+  return {m_framesIn.load(std::memory_order_relaxed), m_framesForwarded.load(std::memory_order_relaxed)};
+}
+
+void
+HNx::VadGate::forward(int16_t const* t_frame)
+{
+  if(m_out->push(t_frame))
+    m_framesForwarded.fetch_add(1, std::memory_order_relaxed);
+}
+
+void
+HNx::VadGate::run()
+{
+  bool wasOpen = false;
+  while(m_in->waitFrame())
+  {
+    int16_t const* frame = m_in->readFrame();
+    m_framesIn.fetch_add(1, std::memory_order_relaxed);
+
+    bool open = m_vad.process(frame);
+    if(open)
+    {
+      // what led up to the onset, oldest first
+      if(!wasOpen)
+      {
+        size_t first = (m_prerollNext + m_prerollFrames - m_prerollCount) % std::max<size_t>(m_prerollFrames, 1);
+        for(size_t i = 0; i < m_prerollCount; ++i)
+          forward(m_preroll.data() + ((first + i) % m_prerollFrames) * AudioFrameSamples);
+        m_prerollCount = 0;
+      }
+      forward(frame);
+    }
+    else if(m_prerollFrames)
+    {
+      std::memcpy(m_preroll.data() + m_prerollNext * AudioFrameSamples, frame, AudioFrameSamples * sizeof(int16_t));
+      m_prerollNext = (m_prerollNext + 1) % m_prerollFrames;
+      m_prerollCount = std::min(m_prerollCount + 1, m_prerollFrames);
+    }
+    wasOpen = open;
+
+    m_in->releaseFrame();
+  }
+  m_out->close();
+}
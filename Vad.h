@@ -0,0 +1,175 @@
+#pragma once
+#include "Audio.h"
+#include "Fft.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+//   Voice activity detection in front of the
+//  recognizer. Each frame is scored on its
+//  energy against a tracked noise floor, its
+//  zero crossing rate and its spectral
+//  flatness. Frames that are plainly too
+//  quiet never reach the spectrum
+//
+//  VadGate passes only speech on to the
+//  recognizer, with a little audio from
+//  before each onset so word starts aren't
+//  clipped
+
+namespace HNx
+{
+
+struct VadConfig
+{
+  // how far over the noise floor and over
+  //  absolute silence speech has to be, dB
+  float marginDb {9.0f};
+  float minDb {-60.0f};
+
+  // voiced speech is tonal, below this
+  float flatnessMax {0.35f};
+
+  // fricatives cross zero often, above
+  //  this fraction of samples
+  float zcrMin {0.25f};
+
+  // speech frames in a row before the
+  //  gate opens
+  unsigned onsetFrames {2};
+
+  // frames kept open after speech ends
+  unsigned hangoverFrames {15};
+
+  // frames from before the onset passed
+  //  on when the gate opens
+  unsigned prerollFrames {10};
+};
+
+struct VadFeatures
+{
+  // mean power, dB under full scale
+  float energyDb {0.0f};
+
+  // fraction of samples crossing zero
+  float zcr {0.0f};
+
+  // geometric over arithmetic mean of the
+  //  speech band spectrum, 0 tonal to 1 noise
+  float flatness {1.0f};
+};
+
+class Vad
+{
+public:
+  explicit Vad(VadConfig t_config = {});
+
+  // true while the gate is open, t_frame
+  //  holds AudioFrameSamples samples
+  bool
+    process(int16_t const* t_frame);
+
+  void
+    reset();
+
+  // the features of the last frame, flatness
+  //  is 1 when it was too quiet to measure
+  VadFeatures
+    last() const;
+
+  float
+    noiseFloorDb() const;
+
+  // SSE2 where available
+  static float
+    energyDb(int16_t const* t_frame, size_t t_count);
+
+  static float
+    zeroCrossingRate(int16_t const* t_frame, size_t t_count);
+
+private:
+  float
+    flatness(int16_t const* t_frame);
+
+  VadConfig m_config;
+  Fft m_fft;
+  std::vector<float> m_signal;
+  std::vector<float> m_power;
+  std::vector<float> m_window;
+
+  VadFeatures m_last {};
+  float m_floorDb {0.0f};
+  bool m_haveFloor {false};
+
+  unsigned m_run {0};
+  unsigned m_hang {0};
+  bool m_open {false};
+};
+
+struct VadStats
+{
+  uint64_t framesIn {0};
+  uint64_t framesForwarded {0};
+
+  // share of frames that never reached
+  //  the recognizer
+  double
+    droppedFraction() const
+  {
+    return framesIn ? 1.0 - static_cast<double>(framesForwarded) / static_cast<double>(framesIn) : 0.0;
+  }
+};
+
+// moves the speech from one ring to
+//  another on a thread of its own
+class VadGate
+{
+public:
+  VadGate(std::shared_ptr<AudioRing> t_in,
+          std::shared_ptr<AudioRing> t_out,
+          VadConfig t_config = {});
+
+  // stops and closes the output ring
+  ~VadGate();
+
+  VadGate(VadGate const&) = delete;
+  VadGate& operator=(VadGate const&) = delete;
+
+  void
+    start();
+
+  // closes the input ring too, to wake
+  //  the gate if it is waiting on it
+  void
+    stop();
+
+  VadStats
+    stats() const;
+
+private:
+  void
+    run();
+
+  void
+    forward(int16_t const* t_frame);
+
+  std::shared_ptr<AudioRing> m_in;
+  std::shared_ptr<AudioRing> m_out;
+  Vad m_vad;
+
+  // the last prerollFrames frames
+  //  while the gate is closed
+  std::vector<int16_t> m_preroll;
+  size_t m_prerollFrames;
+  size_t m_prerollNext {0};
+  size_t m_prerollCount {0};
+
+  std::thread m_thread {};
+  std::atomic<uint64_t> m_framesIn {0};
+  std::atomic<uint64_t> m_framesForwarded {0};
+};
+
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <deque>
+#include <mutex>
+#include <vector>
+
+//   One queue of work per worker. Workers
+//  take from the front of their own queue
+//  and, once it runs dry, from the back of
+//  someone else's, so uneven work evens out
+//  without a single shared queue
+
+namespace HNx
+{
+
+template<class T>
+class WorkStealingQueues
+{
+public:
+  explicit WorkStealingQueues(size_t t_workers)
+    : m_queues(t_workers ? t_workers : 1)
+  {}
+
+  WorkStealingQueues(WorkStealingQueues const&) = delete;
+  WorkStealingQueues& operator=(WorkStealingQueues const&) = delete;
+
+  size_t
+    workers() const
+  {
+    return m_queues.size();
+  }
+
+  void
+    push(size_t t_worker, T t_item)
+  {
+    Queue& q = m_queues[t_worker % m_queues.size()];
+    std::lock_guard<std::mutex> lock(q.mtx);
+    q.items.push_back(std::move(t_item));
+  }
+
+  // false once every queue is empty,
+  //  t_stolen tells where it came from
+  bool
+    pop(size_t t_worker, T& t_item, bool& t_stolen)
+  {
+    for(size_t i = 0; i < m_queues.size(); ++i)
+    {
+      Queue& q = m_queues[(t_worker + i) % m_queues.size()];
+      std::lock_guard<std::mutex> lock(q.mtx);
+      if(q.items.empty())
+        continue;
+
+      t_stolen = i != 0;
+      if(t_stolen)
+      {
+        t_item = std::move(q.items.back());
+        q.items.pop_back();
+      }
+      else
+      {
+        t_item = std::move(q.items.front());
+        q.items.pop_front();
+      }
+      return true;
+    }
+    return false;
+  }
+
+private:
+  struct Queue
+  {
+    std::deque<T> items {};
+    std::mutex mtx {};
+  };
+
+  std::vector<Queue> m_queues;
+};
+
+}
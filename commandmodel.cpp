@@ -0,0 +1,346 @@
+#include "commandmodel.hpp"
+#include "Util.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+using namespace HNx;
+
+// past this many separate runs of rows a
+//  removal resets the model, a view redoes
+//  its layout once instead of per run
+constexpr size_t MaxRemovedRuns = 32;
+
+// idRows of an id whose row is gone
+constexpr size_t NoRow = std::numeric_limits<size_t>::max();
+
+namespace
+{
+// what a filter is matched against
+std::wstring searchText(HNx::Command const& cmd)
+{
+  return cmd.phrase() + TrigramIndex::Separator + cmd.exec() + TrigramIndex::Separator + cmd.param();
+}
+}
+
+CommandModel::CommandModel(QObject* parent)
+  : QAbstractTableModel(parent)
+{
+}
+
+int CommandModel::rowCount(QModelIndex const& parent) const
+{
+  if(parent.isValid())
+    return 0;
+  return static_cast<int>(filtered() ? shown.size() : cmds.size());
+}
+
+int CommandModel::columnCount(QModelIndex const& parent) const
+{
+  return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant CommandModel::data(QModelIndex const& index, int role) const
+{
+  if(!index.isValid() || index.row() >= rowCount())
+    return {};
+
+  HNx::Command const& cmd = command(index.row());
+  if(role == Qt::DisplayRole)
+  {
+    switch(index.column())
+    {
+      case Phrase:     return QString::fromStdWString(cmd.phrase());
+      case Program:    return QString::fromStdWString(cmd.exec());
+      case Parameters: return QString::fromStdWString(cmd.param());
+
+      // live, the view shows it as of
+      //  its last paint
+      case Uses:
+        if(auto action = cmd.action())
+          return QVariant::fromValue(static_cast<qulonglong>(action->uses.load()));
+        return 0;
+    }
+  }
+  else if(role == Qt::TextAlignmentRole && index.column() == Uses)
+  {
+    return QVariant(Qt::AlignRight | Qt::AlignVCenter);
+  }
+  return {};
+}
+
+QVariant CommandModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+  if(role != Qt::DisplayRole || orientation != Qt::Horizontal)
+    return QAbstractTableModel::headerData(section, orientation, role);
+
+  switch(section)
+  {
+    case Phrase:     return tr("Phrase");
+    case Program:    return tr("Program");
+    case Parameters: return tr("Parameters");
+    case Uses:       return tr("Uses");
+  }
+  return {};
+}
+
+void CommandModel::reset(std::vector<HNx::Command> t_cmds)
+{
+  beginResetModel();
+  cmds.clear();
+  rows.clear();
+  ids.clear();
+  idRows.clear();
+  search.clear();
+  rows.reserve(t_cmds.size());
+  cmds.reserve(t_cmds.size());
+
+  // later duplicates win, like upsert()
+  for(auto& cmd : t_cmds)
+  {
+    auto found = rows.try_emplace(key(cmd.phrase()), cmds.size());
+    if(found.second)
+      cmds.push_back(std::move(cmd));
+    else
+      cmds[found.first->second] = std::move(cmd);
+  }
+
+  ids.resize(cmds.size());
+  idRows.reserve(cmds.size());
+  search.reserve(cmds.size());
+  for(size_t row = 0; row < cmds.size(); ++row)
+    indexRow(row);
+
+  refilter();
+  endResetModel();
+}
+
+void CommandModel::upsert(std::vector<HNx::Command> t_cmds)
+{
+  // which rows a filter shows may change
+  //  anywhere, views start over
+  bool quiet = filtered();
+  if(quiet)
+    beginResetModel();
+
+  size_t first = cmds.size();
+  size_t lo = first;
+  size_t hi = 0;
+  std::vector<HNx::Command> added;
+
+  for(auto& cmd : t_cmds)
+  {
+    auto found = rows.try_emplace(key(cmd.phrase()), first + added.size());
+    if(found.second)
+    {
+      added.push_back(std::move(cmd));
+      continue;
+    }
+
+    size_t row = found.first->second;
+    if(row >= first)
+    {
+      added[row - first] = std::move(cmd);
+      continue;
+    }
+    unindexRow(row);
+    cmds[row] = std::move(cmd);
+    indexRow(row);
+    lo = std::min(lo, row);
+    hi = std::max(hi, row);
+  }
+
+  if(lo < first && !quiet)
+    emit dataChanged(index(static_cast<int>(lo), 0),
+                     index(static_cast<int>(hi), ColumnCount - 1));
+
+  if(!added.empty())
+  {
+    if(!quiet)
+      beginInsertRows(QModelIndex(), static_cast<int>(first), static_cast<int>(first + added.size() - 1));
+    cmds.insert(cmds.end(),
+                std::make_move_iterator(added.begin()),
+                std::make_move_iterator(added.end()));
+    ids.resize(cmds.size());
+    for(size_t row = first; row < cmds.size(); ++row)
+      indexRow(row);
+    if(!quiet)
+      endInsertRows();
+  }
+
+  if(quiet)
+  {
+    refilter();
+    endResetModel();
+  }
+}
+
+void CommandModel::remove(std::vector<std::wstring> const& t_phrases)
+{
+  std::vector<size_t> doomed;
+  doomed.reserve(t_phrases.size());
+  for(auto const& phrase : t_phrases)
+  {
+    auto it = rows.find(key(phrase));
+    if(it == rows.end())
+      continue;
+    doomed.push_back(it->second);
+    rows.erase(it);
+  }
+  if(doomed.empty())
+    return;
+
+  // last run first so the rows of the
+  //  earlier ones don't move
+  std::sort(doomed.begin(), doomed.end());
+  doomed.erase(std::unique(doomed.begin(), doomed.end()), doomed.end());
+  for(size_t row : doomed)
+    unindexRow(row);
+
+  std::vector<std::pair<size_t, size_t>> runs;
+  for(size_t row : doomed)
+  {
+    if(!runs.empty() && runs.back().second == row)
+      ++runs.back().second;
+    else
+      runs.emplace_back(row, row + 1);
+  }
+
+  if(runs.size() > MaxRemovedRuns || filtered())
+  {
+    beginResetModel();
+    size_t kept = 0;
+    size_t next = 0;
+    for(size_t row = 0; row < cmds.size(); ++row)
+    {
+      if(next < doomed.size() && doomed[next] == row)
+      {
+        ++next;
+        continue;
+      }
+      if(kept != row)
+      {
+        cmds[kept] = std::move(cmds[row]);
+        ids[kept] = ids[row];
+      }
+      ++kept;
+    }
+    cmds.resize(kept);
+    ids.resize(kept);
+    shift(doomed);
+    refilter();
+    endResetModel();
+    return;
+  }
+
+  for(auto run = runs.rbegin(); run != runs.rend(); ++run)
+  {
+    beginRemoveRows(QModelIndex(), static_cast<int>(run->first), static_cast<int>(run->second - 1));
+    cmds.erase(cmds.begin() + run->first, cmds.begin() + run->second);
+    ids.erase(ids.begin() + run->first, ids.begin() + run->second);
+    endRemoveRows();
+  }
+  shift(doomed);
+}
+
+void CommandModel::setFilter(std::wstring_view text)
+{
+  std::wstring next = TrigramIndex::normalize(text);
+  if(next == filter)
+    return;
+
+  // typing on narrows what is already
+  //  shown, nothing else can match
+  std::vector<Id> found;
+  if(!next.empty() && !filter.empty() && next.find(filter) != std::wstring::npos)
+  {
+    std::vector<Id> within;
+    within.reserve(shown.size());
+    for(size_t row : shown)
+      within.push_back(ids[row]);
+    found = search.refine(next, within);
+  }
+  else if(!next.empty())
+  {
+    found = search.find(next);
+  }
+
+  beginResetModel();
+  filter = std::move(next);
+  shown.clear();
+  shown.reserve(found.size());
+  for(Id id : found)
+    shown.push_back(idRows[id]);
+  std::sort(shown.begin(), shown.end());
+  endResetModel();
+}
+
+bool CommandModel::filtered() const
+{
+  return !filter.empty();
+}
+
+int CommandModel::rowOf(std::wstring_view phrase) const
+{
+  auto it = rows.find(key(phrase));
+  if(it == rows.end())
+    return -1;
+  if(!filtered())
+    return static_cast<int>(it->second);
+
+  auto at = std::lower_bound(shown.begin(), shown.end(), it->second);
+  if(at == shown.end() || *at != it->second)
+    return -1;
+  return static_cast<int>(at - shown.begin());
+}
+
+HNx::Command const& CommandModel::command(int row) const
+{
+  if(row < 0 || row >= rowCount())
+    throw std::invalid_argument("No such row in the command table");
+  return cmds[filtered() ? shown[row] : row];
+}
+
+std::wstring CommandModel::key(std::wstring_view phrase)
+{
+  return lower_key(phrase);
+}
+
+void CommandModel::indexRow(size_t row)
+{
+  Id id = static_cast<Id>(idRows.size());
+  idRows.push_back(row);
+  ids[row] = id;
+  search.insert(id, searchText(cmds[row]));
+}
+
+void CommandModel::unindexRow(size_t row)
+{
+  search.remove(ids[row]);
+  idRows[ids[row]] = NoRow;
+}
+
+void CommandModel::refilter()
+{
+  shown.clear();
+  if(!filtered())
+    return;
+
+  for(Id id : search.find(filter))
+    shown.push_back(idRows[id]);
+  std::sort(shown.begin(), shown.end());
+}
+
+void CommandModel::shift(std::vector<size_t> const& removed)
+{
+  for(auto& entry : rows)
+  {
+    if(entry.second < removed.front())
+      continue;
+    auto below = std::lower_bound(removed.begin(), removed.end(), entry.second);
+    entry.second -= static_cast<size_t>(below - removed.begin());
+  }
+  for(size_t row = removed.front(); row < ids.size(); ++row)
+    idRows[ids[row]] = row;
+}
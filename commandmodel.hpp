@@ -0,0 +1,115 @@
+#pragma once
+#include "Command.h"
+#include "TrigramIndex.h"
+
+#include <QAbstractTableModel>
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+//   The rows of the command table, straight
+//  from the recognizer: a row is a Command
+//  sharing the recognizer's action, text is
+//  only made for the cells the view paints
+//
+//  Changes come in batches and each batch is
+//  one insert, one dataChanged and one
+//  remove per run of rows, never a signal
+//  per command
+//
+//  A filter shows only the rows whose phrase,
+//  program or parameters contain it, looked
+//  up in a trigram index kept with the rows;
+//  a filter extending the last one only
+//  checks the rows already shown
+
+class CommandModel : public QAbstractTableModel
+{
+  Q_OBJECT
+
+public:
+  enum Column
+  {
+    Phrase,
+    Program,
+    Parameters,
+    Uses,
+    ColumnCount
+  };
+
+  explicit CommandModel(QObject* parent = nullptr);
+
+  int rowCount(QModelIndex const& parent = QModelIndex()) const override;
+
+  int columnCount(QModelIndex const& parent = QModelIndex()) const override;
+
+  QVariant data(QModelIndex const& index,
+                int role = Qt::DisplayRole) const override;
+
+  QVariant headerData(int section,
+                      Qt::Orientation orientation,
+                      int role = Qt::DisplayRole) const override;
+
+  // replaces every row, one model reset
+  void reset(std::vector<HNx::Command> cmds);
+
+  // phrases already in the table (case
+  //  insensitive) are replaced where they
+  //  are, the rest are appended
+  void upsert(std::vector<HNx::Command> cmds);
+
+  // phrases not in the table are skipped
+  void remove(std::vector<std::wstring> const& phrases);
+
+  // case insensitive, empty shows every row
+  //  again, changes while filtered reset
+  //  the model
+  void setFilter(std::wstring_view text);
+
+  bool filtered() const;
+
+  // rows are the ones shown, -1 if the
+  //  phrase isn't in the table or shown
+  int rowOf(std::wstring_view phrase) const;
+
+  HNx::Command const& command(int row) const;
+
+private: // funcs
+  using Id = HNx::TrigramIndex::Id;
+
+  static std::wstring key(std::wstring_view phrase);
+
+  // gives the row a new search id
+  void indexRow(size_t row);
+
+  void unindexRow(size_t row);
+
+  // shown from the whole index
+  void refilter();
+
+  // moves the rows in both indexes up past
+  //  the removed ones, sorted and gone from
+  //  the indexes already
+  void shift(std::vector<size_t> const& removed);
+
+private: // vars
+  std::vector<HNx::Command> cmds{};
+
+  // lowercased phrase to its row
+  std::unordered_map<std::wstring, size_t> rows{};
+
+  // search id of every row and row of every
+  //  id ever given, ids aren't reused
+  std::vector<Id> ids{};
+  std::vector<size_t> idRows{};
+
+  HNx::TrigramIndex search{};
+
+  // lower case, empty when not filtered
+  std::wstring filter{};
+
+  // rows of cmds shown, ascending
+  std::vector<size_t> shown{};
+};
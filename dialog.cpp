@@ -1,18 +1,54 @@
 #include "dialog.hpp"
 #include "ui_dialog.h"
 
+#include <QDir>
+#include <QHeaderView>
+#include <QMessageBox>
+#include <QStandardPaths>
+
 using namespace HNx;
 
 Dialog::Dialog(QWidget *parent)
   : QDialog(parent)
   , ui(new Ui::Dialog)
-  , recog(new Recog)
+  , edits(new EditQueue(L"computer", this))
+  , model(new CommandModel(this))
   , trayicon(new QSystemTrayIcon(this))
-  , settings(new QSettings())
 {
   ui->setupUi(this);
   trayicon->hide();
-  recog->initialize();
+
+  // every row the same height so the view
+  //  only asks for the rows it shows, not
+  //  the size of every one
+  ui->tableView->setModel(model);
+  ui->tableView->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+  ui->tableView->horizontalHeader()->setSectionResizeMode(CommandModel::Phrase, QHeaderView::Stretch);
+
+  // the table follows the recognizer, the
+  //  rows change once it has the edits
+  connect(edits, &EditQueue::started, model, &CommandModel::reset);
+  connect(edits, &EditQueue::applied, this, &Dialog::editsApplied);
+  connect(edits, &EditQueue::failed, this, [this](QString message)
+  {
+    QMessageBox::warning(this, "HNx Voice Command Error", message);
+  });
+
+  // last run's commands are queued for the
+  //  recognizer before it is up, they come
+  //  back through editsApplied() like any
+  QString dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+  QDir().mkpath(dir);
+  try
+  {
+    journal = new Journal(QDir(dir).filePath("commands.dat").toStdWString());
+    for(auto const& cmd : journal->commands())
+      edits->add(cmd.phrase(), cmd.exec(), cmd.param());
+  }
+  catch(std::exception const& e)
+  {
+    QMessageBox::warning(this, "HNx Voice Command Error", QString::fromUtf8(e.what()));
+  }
   
   connect(trayicon, SIGNAL(activated(QSystemTrayIcon::ActivationReason)), this, SLOT(unhide()));
 }
@@ -21,14 +57,14 @@ Dialog::~Dialog()
 {
   this->hide();
   
-  if(settings)
-    delete settings;
   if(trayicon)
     delete trayicon;
   if(dialog2)
     delete dialog2;
-  if(recog)
-    delete recog;
+  if(edits)
+    delete edits;
+  if(journal)
+    delete journal;
   if(ui)
     delete ui;
 }
@@ -54,25 +90,20 @@ void Dialog::on_pushButton_add_clicked()
 
 void Dialog::on_pushButton_remove_clicked()
 {
-  auto selItemList = ui->tableWidget->selectedItems();
-  if(selItemList.isEmpty())
+  auto selRows = ui->tableView->selectionModel()->selectedRows();
+  if(selRows.isEmpty())
   {
     return;
   }
-  std::wstring selItemText = selItemList[0]->text().toStdWString();
-  
-  if(selItemList[0]->column() == 0)
-  {
-    recog->removeCommandByPhrase(selItemText);
-  }
-  else
-  {
-    recog->removeCommandByPhrase(selItemText);
-  }
-  settings->remove(ui->tableWidget->item(selItemList[0]->row(), 0)->text());
-  this->blockSignals(true);
-  ui->tableWidget->removeRow(selItemList[0]->row());
-  this->blockSignals(false);
+
+  std::vector<std::wstring> phrases;
+  for(auto const& index : selRows)
+    phrases.push_back(model->command(index.row()).phrase());
+
+  for(auto const& phrase : phrases)
+    edits->remove(phrase);
+  ui->tableView->clearSelection();
+  ui->pushButton_remove->setEnabled(false);
 }
 
 void Dialog::on_pushButton_hide_clicked()
@@ -89,54 +120,27 @@ void Dialog::on_pushButton_exit_clicked()
 // new voice command added
 void Dialog::updateTable(QVector<QString> qvNew)
 {
-  this->blockSignals(true);
   // create workable data
-  QString qsPhrase = qvNew[0];
-  QString qsExe = qvNew[1];
-  QString qsArgs = qvNew[2];
-
-  // check if phrase already exists
-  for(int i=0;i<ui->tableWidget->rowCount();++i)
-  {
-    if(ui->tableWidget->item(i, 0)->text() == qsPhrase)
-    { // update existing
-      recog->removeCommandByPhrase(qsPhrase.toStdWString());
-      recog->addCommand(qvNew[0].toStdWString(),
-                        qvNew[1].toStdWString(),
-                        qvNew[2].toStdWString());
+  std::wstring phrase = qvNew[0].toStdWString();
+  std::wstring exe = qvNew[1].toStdWString();
+  std::wstring args = qvNew[2].toStdWString();
 
-      ui->tableWidget->item(i, 1)->text() = qsExe;
-      ui->tableWidget->item(i, 2)->text() = qsExe;
-      ui->tableWidget->item(i, 3)->text() = qsArgs;
-
-
-      //settings->setValue(qsPhrase, );
-
-      this->blockSignals(false);
-      return;
-    }
-  }
-
-  // add to the recognition engine
-  recog->addCommand(qvNew[0].toStdWString(),
-                    qvNew[1].toStdWString(),
-                    qvNew[2].toStdWString());
-
-  // update gui with new phrase
-  ui->tableWidget->insertRow(0);
-  ui->tableWidget->setItem(0,1,new QTableWidgetItem(qsPhrase));
-  ui->tableWidget->setItem(0,2,new QTableWidgetItem(qsExe));
-  ui->tableWidget->setItem(0,3,new QTableWidgetItem(qsArgs));
-
-  // save to registry
-  //settings->setValue(qsPhrase, qsCmdline);
+  // an existing phrase is updated, its
+  //  row stays where it is once applied
+  edits->add(phrase, exe, args);
+}
 
-  this->blockSignals(false);
+void Dialog::on_tableView_clicked(QModelIndex const& index)
+{
+  ui->pushButton_remove->setEnabled(index.isValid());
 }
 
-void Dialog::on_tableWidget_itemClicked( [[maybe_unused]] QTableWidgetItem* item)
+void Dialog::on_lineEdit_search_textChanged(QString const& text)
 {
-  ui->pushButton_remove->setEnabled(true);
+  // the rows shown are replaced, along
+  //  with any selection of them
+  model->setFilter(text.toStdWString());
+  ui->pushButton_remove->setEnabled(false);
 }
 
 //void Dialog::on_tableWidget_itemChanged(QTableWidgetItem *item)
@@ -187,6 +191,23 @@ void Dialog::unhide()
   this->show();
 }
 
+void Dialog::editsApplied(std::vector<Command> added, std::vector<std::wstring> removed)
+{
+  // only what the recognizer took is kept,
+  //  a journal entry is a line appended
+  if(journal)
+  {
+    for(auto const& phrase : removed)
+      journal->remove(phrase);
+    for(auto const& cmd : added)
+      journal->put(cmd);
+  }
+
+  // the rows share the recognizer's commands
+  model->remove(removed);
+  model->upsert(std::move(added));
+}
+
 void Dialog::createTrayIcon()
 {
 
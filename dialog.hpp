@@ -1,12 +1,16 @@
 #pragma once
+// ahead of any Qt header, its slots macro
+//  would eat PhraseTemplate::slots()
 #include "Recog.hpp"
+#include "Journal.h"
+#include "commandmodel.hpp"
 #include "dialog2.hpp"
+#include "editqueue.hpp"
 #include <QDialog>
-#include <QTableWidget>
+#include <QTableView>
 #include <QSystemTrayIcon>
 #include <QSharedMemory>
 #include <QTimer>
-#include <QSettings>
 
 namespace Ui {
   class Dialog;
@@ -36,7 +40,10 @@ private slots:
 
   void on_pushButton_exit_clicked();
 
-  void on_tableWidget_itemClicked(QTableWidgetItem* item);
+  void on_tableView_clicked(QModelIndex const& index);
+
+  // filters the table as it is typed
+  void on_lineEdit_search_textChanged(QString const& text);
 
   //void on_tableWidget_itemChanged(QTableWidgetItem* item);
 
@@ -48,7 +55,11 @@ public slots:
 private: // vars
   Ui::Dialog* ui{nullptr};
 
-  HNx::Recog* recog{nullptr};
+  // the recognizer, on its own thread
+  EditQueue* edits{nullptr};
+
+  // the table's rows, owned by the dialog
+  CommandModel* model{nullptr};
 
   Dialog2* dialog2{nullptr};
 
@@ -56,10 +67,17 @@ private: // vars
 
   QSystemTrayIcon* trayicon{nullptr};
 
-  QSettings* settings{nullptr};
+  // the user's commands across runs, null
+  //  if the file couldn't be opened
+  HNx::Journal* journal{nullptr};
 
 private: // funcs
   void createTrayIcon();
 
+  // a batch of edits reached the recognizer,
+  //  what it took is journaled
+  void editsApplied(std::vector<HNx::Command> added,
+                    std::vector<std::wstring> removed);
+
 };
 
@@ -0,0 +1,162 @@
+// before Qt, whose slots macro would eat
+//  PhraseTemplate::slots()
+#include "Recog.hpp"
+#include "editqueue.hpp"
+
+#include <chrono>
+#include <unordered_map>
+
+using namespace HNx;
+
+// how long the worker waits after the first
+//  edit of a burst for the rest of it
+constexpr std::chrono::milliseconds Settle{15};
+
+EditQueue::EditQueue(std::wstring hotword, QObject* parent)
+  : QObject(parent)
+  , worker(&EditQueue::run, this, std::move(hotword))
+{
+}
+
+EditQueue::~EditQueue()
+{
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    stopping = true;
+  }
+  wake.notify_all();
+  if(worker.joinable())
+    worker.join();
+}
+
+void EditQueue::add(std::wstring phrase, std::wstring exe, std::wstring args)
+{
+  // what Recog::addCommand() ignores
+  if(phrase.empty() || exe.empty())
+    return;
+  push({false, std::move(phrase), std::move(exe), std::move(args)});
+}
+
+void EditQueue::remove(std::wstring phrase)
+{
+  if(phrase.empty())
+    return;
+  push({true, std::move(phrase)});
+}
+
+size_t EditQueue::pending() const
+{
+  std::lock_guard<std::mutex> lock(mtx);
+  return queued.size();
+}
+
+std::vector<EditQueue::Edit> EditQueue::coalesce(std::vector<Edit> edits)
+{
+  std::unordered_map<std::wstring, size_t> last;
+  for(size_t i = 0; i < edits.size(); ++i)
+  {
+    last[lower_key(edits[i].phrase)] = i;
+  }
+
+  std::vector<bool> kept(edits.size(), false);
+  for(auto const& entry : last)
+    kept[entry.second] = true;
+
+  std::vector<Edit> net;
+  net.reserve(last.size());
+  for(size_t i = 0; i < edits.size(); ++i)
+    if(kept[i])
+      net.push_back(std::move(edits[i]));
+  return net;
+}
+
+void EditQueue::push(Edit edit)
+{
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    queued.push_back(std::move(edit));
+  }
+  wake.notify_one();
+}
+
+void EditQueue::run(std::wstring hotword)
+{
+  // SAPI's objects belong to the thread that
+  //  initialized them, this one
+  Recog recog(hotword);
+  if(!recog.initialize())
+  {
+    QString error = QString::fromStdWString(recog.lastError());
+    QMetaObject::invokeMethod(this, [this, error] { emit failed(error); }, Qt::QueuedConnection);
+
+    // no engine to apply anything to
+    std::unique_lock<std::mutex> lock(mtx);
+    wake.wait(lock, [this] { return stopping; });
+    return;
+  }
+
+  std::vector<Command> cmds = recog.commands();
+  QMetaObject::invokeMethod(this, [this, cmds] { emit started(cmds); }, Qt::QueuedConnection);
+
+  while(true)
+  {
+    std::vector<Edit> batch;
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      wake.wait(lock, [this] { return stopping || !queued.empty(); });
+      wake.wait_for(lock, Settle, [this] { return stopping; });
+      if(stopping)
+        break;
+      batch.swap(queued);
+    }
+    batch = coalesce(std::move(batch));
+
+    // an add undone by a remove, or a phrase
+    //  re-added as it was, never reaches
+    //  the grammar
+    std::vector<std::wstring> drop;
+    std::vector<Command> add;
+    for(auto const& edit : batch)
+    {
+      Command current = recog.command(edit.phrase);
+      bool present = !current.exec().empty();
+      if(edit.remove)
+      {
+        if(present)
+          drop.push_back(edit.phrase);
+      }
+      else if(!present || current.exec() != edit.exe || current.param() != edit.args)
+      {
+        if(present)
+          drop.push_back(edit.phrase);
+        add.emplace_back(edit.phrase, edit.exe, edit.args);
+      }
+    }
+
+    try
+    {
+      if(!drop.empty() || !add.empty())
+        recog.editCommands(drop, add);
+    }
+    catch(std::exception const& e)
+    {
+      QString error = QString::fromUtf8(e.what());
+      QMetaObject::invokeMethod(this, [this, error] { emit failed(error); }, Qt::QueuedConnection);
+    }
+
+    // what the recognizer holds now, failed
+    //  or not
+    std::vector<Command> added;
+    std::vector<std::wstring> removed;
+    for(auto& edit : batch)
+    {
+      Command cmd = recog.command(edit.phrase);
+      if(!cmd.exec().empty())
+        added.push_back(std::move(cmd));
+      else
+        removed.push_back(std::move(edit.phrase));
+    }
+    QMetaObject::invokeMethod(this, [this, added, removed] { emit applied(added, removed); },
+                              Qt::QueuedConnection);
+  }
+}
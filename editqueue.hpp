@@ -0,0 +1,87 @@
+#pragma once
+#include "Command.h"
+
+#include <QObject>
+#include <QString>
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//   The recognizer behind the window, on a
+//  thread of its own. Adds and removes are
+//  queued and return at once, the worker
+//  takes whatever has piled up, drops edits
+//  a later one undoes and applies the rest
+//  with one grammar update. The GUI thread
+//  never touches the engine, what changed
+//  comes back through the signals, emitted
+//  on the thread that made the queue
+
+class EditQueue : public QObject
+{
+  Q_OBJECT
+
+public:
+  // the worker creates and initializes the
+  //  recognizer, started() or failed() says
+  //  how that went
+  explicit EditQueue(std::wstring hotword = L"computer",
+                     QObject* parent = nullptr);
+
+  // waits for the batch being applied, the
+  //  edits still queued are dropped
+  ~EditQueue();
+
+  // replaces a command with the same phrase
+  void add(std::wstring phrase,
+           std::wstring exe,
+           std::wstring args = L"");
+
+  void remove(std::wstring phrase);
+
+  // edits not yet applied
+  size_t pending() const;
+
+  struct Edit
+  {
+    bool remove{false};
+    std::wstring phrase{};
+    std::wstring exe{};
+    std::wstring args{};
+  };
+
+  // the last edit of every phrase (case
+  //  insensitive), in the order of those
+  //  last edits
+  static std::vector<Edit> coalesce(std::vector<Edit> edits);
+
+signals:
+  // the recognizer is up with these commands
+  void started(std::vector<HNx::Command> cmds);
+
+  // one batch applied: the commands now in the
+  //  recognizer for the phrases added, sharing
+  //  its actions, and the phrases removed
+  void applied(std::vector<HNx::Command> added,
+               std::vector<std::wstring> removed);
+
+  // initializing or a batch failed, a batch's
+  //  removals may have been applied
+  void failed(QString message);
+
+private: // funcs
+  void run(std::wstring hotword);
+
+  void push(Edit edit);
+
+private: // vars
+  mutable std::mutex mtx{};
+  std::condition_variable wake{};
+  std::vector<Edit> queued{};
+  bool stopping{false};
+
+  std::thread worker{};
+};
@@ -0,0 +1,989 @@
+#pragma once
+#include "Util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <ctime>
+#include <fcntl.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//   The daemon's wire: one block of shared
+//  memory holding two rings of fixed size
+//  slots, requests from any client to the
+//  daemon and events from the daemon to
+//  every client
+//
+//  Messages are written once, straight into
+//  their slot. Requests are read where they
+//  lie, events are copied out first as the
+//  daemon may write over them mid-read. The
+//  request ring is many producers to one
+//  consumer, a sequence number per slot
+//  hands it over. The event ring has one
+//  writer and is never waited on: each
+//  client keeps its own cursor, one that
+//  falls a whole ring behind loses the
+//  oldest events and is told how many
+//
+//  Waking is only paid for by a side that
+//  sleeps: it raises its waiting flag and
+//  checks the ring once more before it
+//  blocks, the other side signals only when
+//  it finds the flag up. Named auto reset
+//  events on Windows, named semaphores
+//  elsewhere
+
+namespace HNx
+{
+
+constexpr auto IpcDefaultName {L"HNxVoiceCommand"};
+
+// "HNx" and the layout's version
+constexpr uint32_t IpcMagic {0x484E7801u};
+
+constexpr size_t IpcSlotBytes {1024};
+
+// per ring, a power of two
+constexpr size_t IpcSlots {1024};
+
+// clients subscribed at once
+constexpr size_t IpcMaxClients {32};
+
+enum class IpcType : uint32_t
+{
+  // requests, client to daemon
+  AddCommand = 1,     // phrase, exec, param, context
+  RemoveCommand = 2,  // phrase
+  SetContext = 3,     // context
+  Ping = 4,           // anything, answered by Pong
+  Trace = 5,          // on, off or a file to dump to
+
+  // events, daemon to clients
+  Recognized = 64,    // phrase, exec, param
+  Pong = 65,          // the ping's fields and stamp
+  Error = 66,         // message, what it was about
+};
+
+// the layout in shared memory, every
+//  process maps the same
+struct alignas(64) IpcSlot
+{
+  std::atomic<uint64_t> seq;
+  IpcType type;
+  uint32_t length;
+
+  // requests: the client, 1 based
+  // events: the client it answers, 0
+  //  for everyone
+  uint32_t sender;
+  uint32_t reserved;
+
+  // steady clock, nanoseconds
+  uint64_t stamp;
+
+  // NUL separated UTF-8 fields
+  char payload[IpcSlotBytes - 32];
+};
+static_assert(sizeof(IpcSlot) == IpcSlotBytes);
+
+struct alignas(64) IpcClientEntry
+{
+  // 0 while the entry is free
+  std::atomic<uint32_t> pid;
+
+  // bumped each time the entry is taken,
+  //  its signal is named after it
+  std::atomic<uint32_t> generation;
+  std::atomic<uint32_t> waiting;
+};
+
+struct IpcShared
+{
+  // written last, a client finding it can
+  //  trust the rest
+  std::atomic<uint32_t> magic;
+  std::atomic<uint32_t> serverPid;
+
+  alignas(64) std::atomic<uint64_t> requestTail;
+  std::atomic<uint32_t> requestWaiting;
+
+  alignas(64) std::atomic<uint64_t> eventTail;
+
+  IpcClientEntry clients[IpcMaxClients];
+  IpcSlot requests[IpcSlots];
+  IpcSlot events[IpcSlots];
+};
+
+// lock-free atomics are address free, the
+//  same in every process mapping them
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+static_assert(std::atomic<uint32_t>::is_always_lock_free);
+
+inline
+uint32_t
+ipcPid()
+{
+#ifdef _WIN32
+  return static_cast<uint32_t>(GetCurrentProcessId());
+#else
+  return static_cast<uint32_t>(getpid());
+#endif
+}
+
+// a pid we can't look at counts as alive
+inline
+bool
+ipcAlive(uint32_t t_pid)
+{
+  if(t_pid == 0)
+    return false;
+#ifdef _WIN32
+  HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, t_pid);
+  if(!process)
+    return GetLastError() == ERROR_ACCESS_DENIED;
+  bool alive = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+  CloseHandle(process);
+  return alive;
+#else
+  return kill(static_cast<pid_t>(t_pid), 0) == 0 || errno == EPERM;
+#endif
+}
+
+inline
+uint64_t
+ipcNow()
+{
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+//========================================//
+//   IpcSignal                            //
+//========================================//
+// a named wake-up, posts while nobody
+//  waits are kept until the next wait
+class IpcSignal
+{
+public:
+  IpcSignal() = default;
+
+  ~IpcSignal()
+  {
+    close();
+  }
+
+  IpcSignal(IpcSignal const&) = delete;
+  IpcSignal& operator=(IpcSignal const&) = delete;
+
+  // t_create false only opens one that
+  //  exists, returns false if it can't
+  bool
+    open(std::wstring const& t_name, bool t_create)
+  {
+    close();
+#ifdef _WIN32
+    std::wstring name = L"Local\\" + t_name;
+    m_handle = t_create ? CreateEventW(nullptr, FALSE, FALSE, name.c_str())
+                        : OpenEventW(EVENT_MODIFY_STATE | SYNCHRONIZE, FALSE, name.c_str());
+    return m_handle != nullptr;
+#else
+    m_name = "/" + to_utf8(t_name);
+    m_handle = t_create ? sem_open(m_name.c_str(), O_CREAT, 0600, 0u) : sem_open(m_name.c_str(), 0);
+    if(m_handle == SEM_FAILED)
+      m_handle = nullptr;
+    return m_handle != nullptr;
+#endif
+  }
+
+  void
+    close()
+  {
+#ifdef _WIN32
+    if(m_handle)
+      CloseHandle(m_handle);
+#else
+    if(m_handle)
+      sem_close(m_handle);
+#endif
+    m_handle = nullptr;
+  }
+
+  // removes the name, openers keep theirs
+  void
+    unlink()
+  {
+#ifndef _WIN32
+    if(!m_name.empty())
+      sem_unlink(m_name.c_str());
+#endif
+  }
+
+  void
+    post()
+  {
+#ifdef _WIN32
+    SetEvent(m_handle);
+#else
+    sem_post(m_handle);
+#endif
+  }
+
+  // false on timeout
+  bool
+    wait(std::chrono::milliseconds t_timeout)
+  {
+#ifdef _WIN32
+    return WaitForSingleObject(m_handle, static_cast<DWORD>(t_timeout.count())) == WAIT_OBJECT_0;
+#else
+    timespec until {};
+    clock_gettime(CLOCK_REALTIME, &until);
+    auto ns = until.tv_nsec + (t_timeout.count() % 1000) * 1000000;
+    until.tv_sec += static_cast<time_t>(t_timeout.count() / 1000 + ns / 1000000000);
+    until.tv_nsec = ns % 1000000000;
+    while(sem_timedwait(m_handle, &until) != 0)
+      if(errno != EINTR)
+        return false;
+    return true;
+#endif
+  }
+
+  bool
+    isOpen() const
+  {
+    return m_handle != nullptr;
+  }
+
+#ifdef _WIN32
+  // for WaitForMultipleObjects
+  HANDLE
+    handle() const
+  {
+    return m_handle;
+  }
+
+private:
+  HANDLE m_handle {nullptr};
+#else
+private:
+  sem_t* m_handle {nullptr};
+  std::string m_name {};
+#endif
+};
+
+//========================================//
+//   IpcMapping                           //
+//========================================//
+// the shared block, unmapped on destruction
+class IpcMapping
+{
+public:
+  IpcMapping() = default;
+
+  ~IpcMapping()
+  {
+    close();
+  }
+
+  IpcMapping(IpcMapping const&) = delete;
+  IpcMapping& operator=(IpcMapping const&) = delete;
+
+  // returns false if t_name exists already,
+  //  open() it to see who holds it
+  // throws std::runtime_error on failure
+  bool
+    create(std::wstring const& t_name, size_t t_bytes)
+  {
+    close();
+#ifdef _WIN32
+    std::wstring name = L"Local\\" + t_name;
+    m_mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                   static_cast<DWORD>(uint64_t {t_bytes} >> 32),
+                                   static_cast<DWORD>(t_bytes), name.c_str());
+    if(!m_mapping)
+      throw std::runtime_error("Failed to create the shared memory.\nError: " + std::to_string(GetLastError()));
+    if(GetLastError() == ERROR_ALREADY_EXISTS)
+    {
+      close();
+      return false;
+    }
+    map(t_bytes);
+#else
+    m_name = "/" + to_utf8(t_name);
+    int fd = shm_open(m_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if(fd < 0)
+    {
+      if(errno == EEXIST)
+        return false;
+      throw std::runtime_error("Failed to create the shared memory.\nError: " + std::to_string(errno));
+    }
+    if(ftruncate(fd, static_cast<off_t>(t_bytes)) != 0)
+    {
+      int err = errno;
+      ::close(fd);
+      shm_unlink(m_name.c_str());
+      throw std::runtime_error("Failed to size the shared memory.\nError: " + std::to_string(err));
+    }
+    map(fd, t_bytes);
+#endif
+    m_owner = true;
+    return true;
+  }
+
+  // returns false if nobody created t_name
+  bool
+    open(std::wstring const& t_name, size_t t_bytes)
+  {
+    close();
+#ifdef _WIN32
+    std::wstring name = L"Local\\" + t_name;
+    m_mapping = OpenFileMappingW(FILE_MAP_ALL_ACCESS, FALSE, name.c_str());
+    if(!m_mapping)
+      return false;
+    map(t_bytes);
+#else
+    m_name = "/" + to_utf8(t_name);
+    int fd = shm_open(m_name.c_str(), O_RDWR, 0600);
+    if(fd < 0)
+      return false;
+    struct stat st {};
+    if(fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < t_bytes)
+    {
+      ::close(fd);
+      return false;
+    }
+    map(fd, t_bytes);
+#endif
+    return true;
+  }
+
+  // the name of one left by a process that
+  //  died, so create() can succeed
+  static void
+    remove(std::wstring const& t_name)
+  {
+#ifndef _WIN32
+    shm_unlink(("/" + to_utf8(t_name)).c_str());
+#else
+    (void)t_name;
+#endif
+  }
+
+  void
+    close()
+  {
+#ifdef _WIN32
+    if(m_view)
+      UnmapViewOfFile(m_view);
+    if(m_mapping)
+      CloseHandle(m_mapping);
+    m_mapping = nullptr;
+#else
+    if(m_view)
+      munmap(m_view, m_bytes);
+    if(m_owner)
+      shm_unlink(m_name.c_str());
+#endif
+    m_view = nullptr;
+    m_owner = false;
+  }
+
+  void*
+    data() const
+  {
+    return m_view;
+  }
+
+private:
+#ifdef _WIN32
+  void
+    map(size_t t_bytes)
+  {
+    m_view = MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, t_bytes);
+    if(!m_view)
+    {
+      DWORD err = GetLastError();
+      close();
+      throw std::runtime_error("Failed to map the shared memory.\nError: " + std::to_string(err));
+    }
+  }
+
+  HANDLE m_mapping {nullptr};
+#else
+  void
+    map(int t_fd, size_t t_bytes)
+  {
+    void* view = mmap(nullptr, t_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, t_fd, 0);
+    int err = errno;
+    ::close(t_fd);
+    if(view == MAP_FAILED)
+    {
+      close();
+      throw std::runtime_error("Failed to map the shared memory.\nError: " + std::to_string(err));
+    }
+    m_view = view;
+    m_bytes = t_bytes;
+  }
+
+  std::string m_name {};
+  size_t m_bytes {0};
+#endif
+  void* m_view {nullptr};
+  bool m_owner {false};
+};
+
+//========================================//
+//   IpcView                              //
+//========================================//
+// a message where it lies in shared memory,
+//  or an event copied out of it, only good
+//  inside the handler it is passed to
+class IpcView
+{
+public:
+  IpcView(IpcSlot const& t_slot, uint64_t t_seq)
+    : m_slot(&t_slot)
+    , m_seq(t_seq)
+    , m_length(std::min<size_t>(t_slot.length, sizeof(t_slot.payload)))
+  {}
+
+  IpcType
+    type() const
+  {
+    return m_slot->type;
+  }
+
+  uint32_t
+    sender() const
+  {
+    return m_slot->sender;
+  }
+
+  uint64_t
+    stamp() const
+  {
+    return m_slot->stamp;
+  }
+
+  // empty past the last field
+  std::string_view
+    field(size_t t_index) const
+  {
+    std::string_view rest(m_slot->payload, m_length);
+    for(; t_index; --t_index)
+    {
+      size_t end = rest.find('\0');
+      if(end == std::string_view::npos)
+        return {};
+      rest.remove_prefix(end + 1);
+    }
+    return rest.substr(0, rest.find('\0'));
+  }
+
+  std::wstring
+    wfield(size_t t_index) const
+  {
+    return from_utf8(field(t_index));
+  }
+
+  // false once the slot has been written
+  //  over; receive() only hands out whole
+  //  messages, so never inside a handler
+  bool
+    valid() const
+  {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return m_slot->seq.load(std::memory_order_relaxed) == m_seq;
+  }
+
+private:
+  IpcSlot const* m_slot;
+  uint64_t m_seq;
+  size_t m_length;
+};
+
+// throws std::invalid_argument if the fields
+//  don't fit one slot
+inline
+void
+ipcCheckFits(std::initializer_list<std::string_view> t_fields)
+{
+  size_t length = 0;
+  for(auto const& f : t_fields)
+    length += f.size() + 1;
+  if(length > sizeof(IpcSlot::payload))
+    throw std::invalid_argument("IPC message longer than " + std::to_string(sizeof(IpcSlot::payload)) + " bytes");
+}
+
+// the fields have passed ipcCheckFits()
+inline
+void
+ipcWrite(IpcSlot& t_slot,
+         IpcType t_type,
+         std::initializer_list<std::string_view> t_fields,
+         uint32_t t_sender,
+         uint64_t t_stamp)
+{
+  size_t length = 0;
+  for(auto const& f : t_fields)
+    length += f.size() + 1;
+
+  char* out = t_slot.payload;
+  for(auto const& f : t_fields)
+  {
+    std::memcpy(out, f.data(), f.size());
+    out += f.size();
+    *out++ = '\0';
+  }
+  t_slot.type = t_type;
+  t_slot.length = static_cast<uint32_t>(length ? length - 1 : 0);
+  t_slot.sender = t_sender;
+  t_slot.stamp = t_stamp ? t_stamp : ipcNow();
+}
+
+//========================================//
+//   IpcServer                            //
+//========================================//
+// the daemon's end, one per name
+class IpcServer
+{
+public:
+  // takes over a name left by a daemon that
+  //  died, throws std::runtime_error if a
+  //  live one holds it
+  explicit IpcServer(std::wstring const& t_name = IpcDefaultName)
+    : m_name(t_name)
+  {
+    if(!m_mapping.create(m_name, sizeof(IpcShared)))
+    {
+      {
+        IpcMapping existing;
+        if(existing.open(m_name, sizeof(IpcShared)))
+        {
+          auto* other = static_cast<IpcShared*>(existing.data());
+          if(other->magic.load(std::memory_order_acquire) == IpcMagic && ipcAlive(other->serverPid.load()))
+            throw std::runtime_error("Another daemon already serves " + to_utf8(m_name));
+        }
+      }
+      IpcMapping::remove(m_name);
+#ifdef _WIN32
+      // clients still hold the old one, it
+      //  is the same block
+      if(!m_mapping.open(m_name, sizeof(IpcShared)))
+#else
+      if(!m_mapping.create(m_name, sizeof(IpcShared)))
+#endif
+        throw std::runtime_error("Failed to take over " + to_utf8(m_name));
+    }
+
+    if(!m_requestSignal.open(m_name + L".req", true))
+      throw std::runtime_error("Failed to create the request signal.\nError: " + std::to_string(lastError()));
+
+    void* block = m_mapping.data();
+    std::memset(block, 0, sizeof(IpcShared));
+    m_shared = new(block) IpcShared;
+    for(size_t i = 0; i < IpcSlots; ++i)
+    {
+      m_shared->requests[i].seq.store(i, std::memory_order_relaxed);
+      m_shared->events[i].seq.store(0, std::memory_order_relaxed);
+    }
+    m_shared->serverPid.store(ipcPid(), std::memory_order_relaxed);
+    m_shared->magic.store(IpcMagic, std::memory_order_release);
+  }
+
+  ~IpcServer()
+  {
+    m_shared->serverPid.store(0);
+
+    // clients waiting find the daemon gone
+    for(size_t i = 0; i < IpcMaxClients; ++i)
+      if(m_shared->clients[i].pid.load())
+        wake(i);
+    m_requestSignal.unlink();
+  }
+
+  IpcServer(IpcServer const&) = delete;
+  IpcServer& operator=(IpcServer const&) = delete;
+
+  // every queued request to t_handler, in
+  //  order, returns how many
+  // t_handler(IpcView const&)
+  template<class Handler>
+  size_t
+    receive(Handler&& t_handler)
+  {
+    size_t count = 0;
+    while(true)
+    {
+      IpcSlot& slot = m_shared->requests[m_head & (IpcSlots - 1)];
+      if(slot.seq.load(std::memory_order_acquire) != m_head + 1)
+        break;
+
+      t_handler(IpcView(slot, m_head + 1));
+      slot.seq.store(m_head + IpcSlots, std::memory_order_release);
+      ++m_head;
+      ++count;
+    }
+    return count;
+  }
+
+  // call before blocking on the request
+  //  signal, false if there is a request
+  //  to receive() already
+  bool
+    armWait()
+  {
+    m_shared->requestWaiting.store(1);
+    if(m_shared->requests[m_head & (IpcSlots - 1)].seq.load() == m_head + 1)
+    {
+      m_shared->requestWaiting.store(0, std::memory_order_relaxed);
+      return false;
+    }
+    return true;
+  }
+
+  // false on timeout
+  bool
+    wait(std::chrono::milliseconds t_timeout)
+  {
+    return !armWait() || m_requestSignal.wait(t_timeout);
+  }
+
+#ifdef _WIN32
+  // signalled for requests after armWait()
+  HANDLE
+    requestHandle() const
+  {
+    return m_requestSignal.handle();
+  }
+#endif
+
+  // to every client, or answering t_to only
+  //  though every client sees it
+  // throws std::invalid_argument if the
+  //  fields don't fit one slot
+  void
+    publish(IpcType t_type,
+            std::initializer_list<std::string_view> t_fields,
+            uint32_t t_to = 0,
+            uint64_t t_stamp = 0)
+  {
+    ipcCheckFits(t_fields);
+    uint64_t pos = m_shared->eventTail.load(std::memory_order_relaxed);
+    IpcSlot& slot = m_shared->events[pos & (IpcSlots - 1)];
+
+    // odd while written, readers that see
+    //  it change drop what they read
+    slot.seq.store(2 * pos + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    ipcWrite(slot, t_type, t_fields, t_to, t_stamp);
+    slot.seq.store(2 * pos + 2);
+    m_shared->eventTail.store(pos + 1, std::memory_order_release);
+
+    for(size_t i = 0; i < IpcMaxClients; ++i)
+    {
+      IpcClientEntry& client = m_shared->clients[i];
+      if(client.waiting.load() && client.waiting.exchange(0))
+        wake(i);
+    }
+  }
+
+  size_t
+    clients() const
+  {
+    size_t count = 0;
+    for(auto const& client : m_shared->clients)
+      if(client.pid.load(std::memory_order_relaxed))
+        ++count;
+    return count;
+  }
+
+  uint64_t
+    published() const
+  {
+    return m_shared->eventTail.load(std::memory_order_relaxed);
+  }
+
+private:
+  // a client's signal is opened the first
+  //  time it needs waking
+  void
+    wake(size_t t_client)
+  {
+    uint32_t generation = m_shared->clients[t_client].generation.load(std::memory_order_acquire);
+    if(m_subGeneration[t_client] != generation || !m_subSignals[t_client].isOpen())
+    {
+      m_subGeneration[t_client] = generation;
+      m_subSignals[t_client].open(clientSignalName(m_name, t_client, generation), false);
+    }
+    if(m_subSignals[t_client].isOpen())
+      m_subSignals[t_client].post();
+  }
+
+  static unsigned long
+    lastError()
+  {
+#ifdef _WIN32
+    return GetLastError();
+#else
+    return static_cast<unsigned long>(errno);
+#endif
+  }
+
+public:
+  static std::wstring
+    clientSignalName(std::wstring const& t_name, size_t t_client, uint32_t t_generation)
+  {
+    return t_name + L".sub" + std::to_wstring(t_client) + L"." + std::to_wstring(t_generation);
+  }
+
+private:
+  std::wstring m_name;
+  IpcMapping m_mapping {};
+  IpcShared* m_shared {nullptr};
+  IpcSignal m_requestSignal {};
+
+  // the next request, only we take them
+  uint64_t m_head {0};
+
+  IpcSignal m_subSignals[IpcMaxClients] {};
+  uint32_t m_subGeneration[IpcMaxClients] {};
+};
+
+//========================================//
+//   IpcClient                            //
+//========================================//
+// a UI or script talking to the daemon,
+//  any number of them up to IpcMaxClients
+class IpcClient
+{
+public:
+  // sees the events published from now on
+  // throws std::runtime_error if no daemon
+  //  serves t_name or every entry is taken
+  explicit IpcClient(std::wstring const& t_name = IpcDefaultName)
+    : m_name(t_name)
+  {
+    if(!m_mapping.open(m_name, sizeof(IpcShared)))
+      throw std::runtime_error("No daemon serves " + to_utf8(m_name));
+
+    m_shared = static_cast<IpcShared*>(m_mapping.data());
+    if(m_shared->magic.load(std::memory_order_acquire) != IpcMagic || !ipcAlive(m_shared->serverPid.load()))
+      throw std::runtime_error("The daemon serving " + to_utf8(m_name) + " is gone");
+
+    if(!m_requestSignal.open(m_name + L".req", false))
+      throw std::runtime_error("Failed to open the request signal of " + to_utf8(m_name));
+
+    // a free entry, or one whose client died
+    //  without giving it back
+    uint32_t self = ipcPid();
+    for(size_t pass = 0; pass < 2 && m_index == IpcMaxClients; ++pass)
+      for(size_t i = 0; i < IpcMaxClients && m_index == IpcMaxClients; ++i)
+      {
+        uint32_t pid = m_shared->clients[i].pid.load();
+        if((pid == 0 || (pass == 1 && !ipcAlive(pid))) && m_shared->clients[i].pid.compare_exchange_strong(pid, self))
+          m_index = i;
+      }
+    if(m_index == IpcMaxClients)
+      throw std::runtime_error("Too many clients of " + to_utf8(m_name));
+
+    IpcClientEntry& entry = m_shared->clients[m_index];
+    m_generation = entry.generation.load() + 1;
+    if(!m_signal.open(IpcServer::clientSignalName(m_name, m_index, m_generation), true))
+    {
+      entry.pid.store(0);
+      throw std::runtime_error("Failed to create the client signal of " + to_utf8(m_name));
+    }
+    entry.waiting.store(0);
+    entry.generation.store(m_generation, std::memory_order_release);
+
+    m_cursor = m_shared->eventTail.load(std::memory_order_acquire);
+  }
+
+  ~IpcClient()
+  {
+    m_signal.unlink();
+    m_shared->clients[m_index].waiting.store(0);
+    m_shared->clients[m_index].pid.store(0);
+  }
+
+  IpcClient(IpcClient const&) = delete;
+  IpcClient& operator=(IpcClient const&) = delete;
+
+  // false if the request ring is full
+  // throws std::invalid_argument if the
+  //  fields don't fit one slot
+  bool
+    send(IpcType t_type,
+         std::initializer_list<std::string_view> t_fields,
+         uint64_t t_stamp = 0)
+  {
+    ipcCheckFits(t_fields);
+    uint64_t pos = m_shared->requestTail.load(std::memory_order_relaxed);
+    IpcSlot* slot = nullptr;
+    while(true)
+    {
+      slot = &m_shared->requests[pos & (IpcSlots - 1)];
+      auto diff = static_cast<int64_t>(slot->seq.load(std::memory_order_acquire) - pos);
+      if(diff == 0)
+      {
+        if(m_shared->requestTail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      }
+      else if(diff < 0)
+        return false;
+      else
+        pos = m_shared->requestTail.load(std::memory_order_relaxed);
+    }
+
+    ipcWrite(*slot, t_type, t_fields, static_cast<uint32_t>(m_index + 1), t_stamp);
+    slot->seq.store(pos + 1);
+
+    if(m_shared->requestWaiting.load() && m_shared->requestWaiting.exchange(0))
+      m_requestSignal.post();
+    return true;
+  }
+
+  // every event since the last call to
+  //  t_handler, in order, returns how many
+  // t_handler(IpcView const&)
+  template<class Handler>
+  size_t
+    receive(Handler&& t_handler)
+  {
+    size_t count = 0;
+    while(true)
+    {
+      IpcSlot const& slot = m_shared->events[m_cursor & (IpcSlots - 1)];
+      uint64_t want = 2 * m_cursor + 2;
+      uint64_t seq = slot.seq.load(std::memory_order_acquire);
+      if(seq < want)
+        break;
+
+      if(seq > want)
+      {
+        // lapped, on to the oldest still there
+        uint64_t tail = m_shared->eventTail.load(std::memory_order_acquire);
+        uint64_t oldest = tail > IpcSlots ? tail - IpcSlots : 0;
+        uint64_t next = std::max(oldest, m_cursor + 1);
+        m_lost += next - m_cursor;
+        m_cursor = next;
+        continue;
+      }
+
+      // the handler gets a copy, the daemon
+      //  could lap us while it reads and one
+      //  written over midway is dropped before
+      //  anything acts on it
+      m_event.type = slot.type;
+      m_event.length = static_cast<uint32_t>(std::min<size_t>(slot.length, sizeof(slot.payload)));
+      m_event.sender = slot.sender;
+      m_event.stamp = slot.stamp;
+      std::memcpy(m_event.payload, slot.payload, m_event.length);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if(slot.seq.load(std::memory_order_relaxed) != want)
+      {
+        ++m_lost;
+        ++m_cursor;
+        continue;
+      }
+
+      m_event.seq.store(want, std::memory_order_relaxed);
+      t_handler(IpcView(m_event, want));
+      ++m_cursor;
+      ++count;
+    }
+    return count;
+  }
+
+  // false on timeout or without a daemon
+  bool
+    wait(std::chrono::milliseconds t_timeout)
+  {
+    if(!armWait())
+      return true;
+    return m_signal.wait(t_timeout) && connected();
+  }
+
+  // call before blocking on handle(), false
+  //  if there is an event to receive()
+  //  already
+  bool
+    armWait()
+  {
+    IpcClientEntry& entry = m_shared->clients[m_index];
+    entry.waiting.store(1);
+    if(m_shared->events[m_cursor & (IpcSlots - 1)].seq.load() >= 2 * m_cursor + 2)
+    {
+      entry.waiting.store(0, std::memory_order_relaxed);
+      return false;
+    }
+    return true;
+  }
+
+#ifdef _WIN32
+  // signalled for events after armWait()
+  HANDLE
+    handle() const
+  {
+    return m_signal.handle();
+  }
+#endif
+
+  // the daemon is still there
+  bool
+    connected() const
+  {
+    return ipcAlive(m_shared->serverPid.load(std::memory_order_relaxed));
+  }
+
+  // events written over before they were
+  //  read
+  uint64_t
+    lost() const
+  {
+    return m_lost;
+  }
+
+  // as it appears in sender()
+  uint32_t
+    id() const
+  {
+    return static_cast<uint32_t>(m_index + 1);
+  }
+
+private:
+  std::wstring m_name;
+  IpcMapping m_mapping {};
+  IpcShared* m_shared {nullptr};
+  IpcSignal m_requestSignal {};
+
+  size_t m_index {IpcMaxClients};
+  uint32_t m_generation {0};
+  IpcSignal m_signal {};
+
+  uint64_t m_cursor {0};
+  uint64_t m_lost {0};
+
+  // the event being handled
+  IpcSlot m_event {};
+};
+
+}
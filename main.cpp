@@ -3,14 +3,64 @@
 //  it in 2023 to fix my mistakes.
 //
 #include "dialog.hpp"
+#include "Batch.h"
+#include "Daemon.h"
+#include "Keyword.h"
+#include "Metrics.h"
+#include "ProcessInfo.h"
+#include "RecogPool.h"
 #include "SingleInstance.h"
 
 #include <QApplication>
+#include <QTimer>
+
+#include <shellapi.h>
+
+#include <iomanip>
+#include <iostream>
 
 using namespace HNx;
 
 int main(int argc, char* argv[])
 {
+  // headless batch transcription, the
+  //  compound, usage, template, prefetch, hotword
+  //  spotter's, rooms' and metrics' benchmarks
+  //  and the daemon's clients, no window and
+  //  no single instance
+  int argcW = 0;
+  if(LPWSTR* argvW = CommandLineToArgvW(GetCommandLineW(), &argcW))
+  {
+    std::vector<std::wstring> args(argvW, argvW + argcW);
+    LocalFree(argvW);
+    if(std::find(args.begin(), args.end(), L"--batch") != args.end())
+      return runBatchCli(args);
+    if(std::find(args.begin(), args.end(), L"--compound-bench") != args.end())
+      return runCompoundBenchCli(args);
+    if(std::find(args.begin(), args.end(), L"--usage-bench") != args.end())
+      return runUsageBenchCli(args);
+    if(std::find(args.begin(), args.end(), L"--template-bench") != args.end())
+      return runTemplateBenchCli(args);
+    if(std::find(args.begin(), args.end(), L"--prefetch-bench") != args.end())
+      return runPrefetchBenchCli(args);
+    if(std::find(args.begin(), args.end(), L"--kws-eval") != args.end())
+      return runKeywordCli(args);
+    if(std::find(args.begin(), args.end(), L"--rooms-bench") != args.end())
+      return runRoomsBenchCli(args);
+    if(std::find(args.begin(), args.end(), L"--metrics-bench") != args.end())
+      return runMetricsBenchCli(args);
+    if(std::find(args.begin(), args.end(), L"--send") != args.end())
+      return runSendCli(args);
+    if(std::find(args.begin(), args.end(), L"--listen") != args.end())
+      return runListenCli(args);
+    if(std::find(args.begin(), args.end(), L"--ipc-bench") != args.end())
+      return runIpcBenchCli(args);
+
+    // takes the single instance itself
+    if(std::find(args.begin(), args.end(), L"--daemon") != args.end())
+      return runDaemonCli(args);
+  }
+
   // there can be only one
   if (!isSingleInstance())
   {
@@ -30,6 +80,17 @@ int main(int argc, char* argv[])
   Dialog w;
   //w.LoadSettings();
   w.show();
-  
+
+  // what it took to get the window up, to
+  //  compare with the daemon's
+  if(QApplication::arguments().contains("--startup-report"))
+  {
+    QTimer::singleShot(0, &a, [&a]
+    {
+      std::cout << std::fixed << std::setprecision(1) << processReport() << std::endl;
+      a.quit();
+    });
+  }
+
   return a.exec();
 }
\ No newline at end of file
@@ -13,8 +13,9 @@
 #include <QtWidgets/QApplication>
 #include <QtWidgets/QDialog>
 #include <QtWidgets/QHeaderView>
+#include <QtWidgets/QLineEdit>
 #include <QtWidgets/QPushButton>
-#include <QtWidgets/QTableWidget>
+#include <QtWidgets/QTableView>
 
 QT_BEGIN_NAMESPACE
 
@@ -25,7 +26,8 @@ public:
     QPushButton *pushButton_remove;
     QPushButton *pushButton_hide;
     QPushButton *pushButton_exit;
-    QTableWidget *tableWidget;
+    QLineEdit *lineEdit_search;
+    QTableView *tableView;
 
     void setupUi(QDialog *Dialog)
     {
@@ -45,28 +47,31 @@ public:
         pushButton_exit = new QPushButton(Dialog);
         pushButton_exit->setObjectName("pushButton_exit");
         pushButton_exit->setGeometry(QRect(380, 400, 80, 30));
-        tableWidget = new QTableWidget(Dialog);
-        if (tableWidget->columnCount() < 2)
-            tableWidget->setColumnCount(2);
-        tableWidget->setObjectName("tableWidget");
-        tableWidget->setGeometry(QRect(10, 10, 361, 421));
+        lineEdit_search = new QLineEdit(Dialog);
+        lineEdit_search->setObjectName("lineEdit_search");
+        lineEdit_search->setGeometry(QRect(10, 10, 361, 24));
+        lineEdit_search->setClearButtonEnabled(true);
+        tableView = new QTableView(Dialog);
+        tableView->setObjectName("tableView");
+        tableView->setGeometry(QRect(10, 40, 361, 391));
         QSizePolicy sizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
         sizePolicy.setHorizontalStretch(0);
         sizePolicy.setVerticalStretch(0);
-        sizePolicy.setHeightForWidth(tableWidget->sizePolicy().hasHeightForWidth());
-        tableWidget->setSizePolicy(sizePolicy);
-        tableWidget->setSizeIncrement(QSize(0, 0));
-        tableWidget->setEditTriggers(QAbstractItemView::NoEditTriggers);
-        tableWidget->setProperty("showDropIndicator", QVariant(false));
-        tableWidget->setDragDropOverwriteMode(false);
-        tableWidget->setSelectionMode(QAbstractItemView::SingleSelection);
-        tableWidget->setSelectionBehavior(QAbstractItemView::SelectRows);
-        tableWidget->setHorizontalScrollMode(QAbstractItemView::ScrollPerPixel);
-        tableWidget->setWordWrap(false);
-        tableWidget->setCornerButtonEnabled(false);
-        tableWidget->setColumnCount(2);
-        tableWidget->horizontalHeader()->setVisible(false);
-        tableWidget->verticalHeader()->setVisible(false);
+        sizePolicy.setHeightForWidth(tableView->sizePolicy().hasHeightForWidth());
+        tableView->setSizePolicy(sizePolicy);
+        tableView->setSizeIncrement(QSize(0, 0));
+        tableView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+        tableView->setProperty("showDropIndicator", QVariant(false));
+        tableView->setDragDropOverwriteMode(false);
+        tableView->setSelectionMode(QAbstractItemView::SingleSelection);
+        tableView->setSelectionBehavior(QAbstractItemView::SelectRows);
+        tableView->setHorizontalScrollMode(QAbstractItemView::ScrollPerPixel);
+        tableView->setWordWrap(false);
+        tableView->setCornerButtonEnabled(false);
+        tableView->horizontalHeader()->setHighlightSections(false);
+        tableView->verticalHeader()->setVisible(false);
+        tableView->verticalHeader()->setMinimumSectionSize(20);
+        tableView->verticalHeader()->setDefaultSectionSize(20);
 
         retranslateUi(Dialog);
 
@@ -83,6 +88,7 @@ public:
         pushButton_remove->setText(QCoreApplication::translate("Dialog", "Remove", nullptr));
         pushButton_hide->setText(QCoreApplication::translate("Dialog", "Hide", nullptr));
         pushButton_exit->setText(QCoreApplication::translate("Dialog", "Exit", nullptr));
+        lineEdit_search->setPlaceholderText(QCoreApplication::translate("Dialog", "Search phrases, programs and parameters", nullptr));
     } // retranslateUi
 
 };